@@ -0,0 +1,22 @@
+#ifndef _SIM_BUS_H
+#define _SIM_BUS_H
+
+#include <3ds/types.h>
+#include <sim/device.h>
+
+#define SIM_BUS_COUNT 3
+
+// interrupts bound by I2C_Main for each bus
+static const u32 Sim_BusInterrupts[SIM_BUS_COUNT] = { 0x54, 0x55, 0x5C };
+
+void Sim_Bus_Attach(u8 port, Sim_Device *dev);
+void Sim_Bus_Detach(u8 port, Sim_Device *dev);
+void Sim_Bus_DetachAll(void);
+
+// called by a device from its ops: the current phase never completes / completes without its interrupt
+void Sim_Bus_HoldSda(u8 port);
+void Sim_Bus_DropInterrupt(u8 port);
+// the SCL register of the bus, for devices that cannot be clocked at any speed
+u16 Sim_Bus_GetScl(u8 port);
+
+#endif
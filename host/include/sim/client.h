@@ -0,0 +1,55 @@
+#ifndef _SIM_CLIENT_H
+#define _SIM_CLIENT_H
+
+#include <3ds/types.h>
+#include <i2c/snapshot.h>
+#include <i2c/cache.h>
+#include <i2c/stats.h>
+#include <i2c/trace.h>
+
+/*
+	Client side of the i2c:: services, issued from any host thread against a session
+	obtained with SimI2C_Connect. Mirrors what the system's own drivers send.
+*/
+
+Result SimI2C_Connect(Handle *session, const char *service_name);
+
+Result SimI2C_ReplaceRegisterBits8(Handle session, u8 devid, u8 regid, u8 value, u8 mask);
+Result SimI2C_SetRegisterBits8(Handle session, u8 devid, u8 regid, u8 mask);
+Result SimI2C_ClearRegisterBits8(Handle session, u8 devid, u8 regid, u8 mask);
+Result SimI2C_ReplaceRegisterBits16Multi(Handle session, const u8 *devids, u32 n_devids, u16 regid, u16 value, u16 mask);
+Result SimI2C_WriteRegister8(Handle session, u8 devid, u8 regid, u8 value);
+Result SimI2C_WriteDevice8(Handle session, u8 devid, u8 value);
+Result SimI2C_WriteRegister16(Handle session, u8 devid, u16 regid, u16 value);
+Result SimI2C_WriteRegister16Multi(Handle session, const u8 *devids, u32 n_devids, u16 regid, u16 value);
+Result SimI2C_ReadRegister8(Handle session, u8 devid, u8 regid, u8 *value);
+Result SimI2C_ReadRegister16(Handle session, u8 devid, u16 regid, u16 *value);
+Result SimI2C_WriteRegisters8(Handle session, u8 devid, u8 regid, const u8 *buf, u32 size);
+Result SimI2C_WriteRegisters16(Handle session, u8 devid, u16 regid, const u16 *buf, u32 count);
+Result SimI2C_ReadRegisters8(Handle session, u8 devid, u8 regid, u8 *buf, u32 size);
+Result SimI2C_ReadRegisters8Legacy(Handle session, u8 devid, u8 regid, u8 *buf, u32 size);
+Result SimI2C_ReadRegisters16(Handle session, u8 devid, u16 regid, u16 *buf, u32 count);
+Result SimI2C_WriteRegisters8Mapped(Handle session, u8 devid, u8 regid, const u8 *buf, u32 size);
+Result SimI2C_ReadRegisters8Mapped(Handle session, u8 devid, u8 regid, u8 *buf, u32 size);
+Result SimI2C_ReadDeviceRaw(Handle session, u8 devid, u8 *value);
+Result SimI2C_WriteDeviceRawMulti(Handle session, u8 devid, const u8 *buf, u32 size);
+Result SimI2C_ReadDeviceRawMulti(Handle session, u8 devid, u8 *buf, u32 size);
+Result SimI2C_GetLatencyHistograms(Handle session, I2C_LatencyHistogram *buf, u32 max_entries, u32 flags, u32 *count);
+Result SimI2C_GetBusStats(Handle session, I2C_BusStats *buf, u32 max_buses, u32 flags, u32 *count);
+Result SimI2C_GetTrace(Handle session, I2C_TraceEntry *buf, u32 max_entries, u32 flags, u32 *count, u32 *sequence);
+Result SimI2C_GetAsyncEvent(Handle session, Handle *event);
+Result SimI2C_SubmitReadRegisters8(Handle session, u8 devid, u8 regid, u32 size, u32 *ticket);
+Result SimI2C_SubmitWriteRegisters8(Handle session, u8 devid, u8 regid, const u8 *buf, u32 size, u32 *ticket);
+Result SimI2C_ReapAsync(Handle session, u8 *buf, u32 size, u32 *ticket, Result *result, u32 *transferred);
+Result SimI2C_SetPostedWrites(Handle session, bool enable);
+Result SimI2C_FencePostedWrites(Handle session, Result *error, u32 *failures);
+Result SimI2C_SetSnapshotRanges(Handle session, const I2C_SnapshotRange *ranges, u32 n_ranges, u32 *size, u32 *n_bursts);
+Result SimI2C_ReadSnapshot(Handle session, u8 *buf, u32 size, u32 *read, u64 *tick);
+Result SimI2C_WriteRegisterTable16(Handle session, u8 devid, const I2C_RegisterWrite16 *table, u32 count, u32 *failed_index);
+Result SimI2C_ConfigureReadCache(Handle session, u8 devid, u16 regid, u16 count, u32 ttl_ticks, u8 flags);
+Result SimI2C_GetReadCacheStats(Handle session, I2C_CacheStats *buf, u32 max_entries, u32 flags, u32 *count);
+Result SimI2C_ConfigureLegacyDelays(Handle session, u8 devid, u16 before_us, u16 between_us, u16 after_us, u16 flags, I2C_LegacyDelays *out);
+Result SimI2C_TuneScl(Handle session, u8 devid, u8 regid, u32 iterations, u8 flags, I2C_SclTuneResult *buf, u32 max_results,
+	u32 *count, u32 *best, u16 *scl);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _SIM_DEVICE_H
+#define _SIM_DEVICE_H
+
+#include <3ds/types.h>
+
+/*
+	Pluggable device models sitting on a simulated bus. The bus calls into the model
+	for every wire-level phase; the model decides whether the phase is acknowledged.
+*/
+
+typedef struct Sim_Device Sim_Device;
+
+typedef struct Sim_DeviceOps {
+	bool (*start)(Sim_Device *dev, bool read); // address phase, returns ACK
+	bool (*write)(Sim_Device *dev, u8 value);  // data byte from the controller, returns ACK
+	u8   (*read)(Sim_Device *dev, bool ack);   // data byte to the controller, ack = more bytes follow
+	void (*stop)(Sim_Device *dev);             // stop condition or cancel
+} Sim_DeviceOps;
+
+struct Sim_Device {
+	const Sim_DeviceOps *ops;
+	u8 write_addr;
+	Sim_Device *next;
+};
+
+// byte addressed register space with auto-increment, 8 or 16 bit register addresses
+typedef struct Sim_RegisterFile {
+	Sim_Device base;
+	u8 addr_bytes;
+	u8 addr_received;
+	u16 pointer;
+	u8 *regs;
+	u32 size;
+} Sim_RegisterFile;
+
+// register file with page wrap and a write cycle during which the device does not ACK
+typedef struct Sim_Eeprom {
+	Sim_RegisterFile rf;
+	u16 page_size;
+	bool written;
+	u64 write_cycle_ticks;
+	u64 busy_until;
+} Sim_Eeprom;
+
+#define SIM_FIFO_SIZE 0x200
+
+// raw byte stream device without register addressing
+typedef struct Sim_Fifo {
+	Sim_Device base;
+	u8 rx[SIM_FIFO_SIZE];
+	u32 rx_count;
+	u8 tx[SIM_FIFO_SIZE];
+	u32 tx_head;
+	u32 tx_count;
+} Sim_Fifo;
+
+void Sim_RegisterFile_Init(Sim_RegisterFile *rf, u8 write_addr, u8 addr_bytes, u8 *regs, u32 size);
+void Sim_Eeprom_Init(Sim_Eeprom *eep, u8 write_addr, u8 addr_bytes, u8 *mem, u32 size, u16 page_size, u64 write_cycle_ticks);
+void Sim_Fifo_Init(Sim_Fifo *fifo, u8 write_addr);
+u32 Sim_Fifo_Push(Sim_Fifo *fifo, const u8 *buf, u32 size); // queue bytes for the controller to read
+u32 Sim_Fifo_Pop(Sim_Fifo *fifo, u8 *buf, u32 size);        // drain bytes written by the controller
+
+// one model per devid: register files, an EEPROM on devid 14 and a FIFO on devid 15
+void Sim_AttachDefaultDevices(void);
+Sim_Device *Sim_GetDefaultDevice(u8 devid);
+
+#endif
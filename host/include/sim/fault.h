@@ -0,0 +1,63 @@
+#ifndef _SIM_FAULT_H
+#define _SIM_FAULT_H
+
+#include <sim/device.h>
+
+/*
+	Fault-injecting wrapper around any device model. It takes the wrapped device's
+	place on the bus and, at configurable rates, NACKs the address, register or data
+	phase, stretches the clock on every byte, goes busy (NACKs everything) for a
+	period, needs time to settle after each stop, fails when clocked faster than it
+	can follow, or does not answer at all. Rates are in parts per million so profiles are
+	reproducible from the seed.
+*/
+
+typedef struct Sim_FaultConfig {
+	u32 nack_addr_ppm;   // address phase NACKed
+	u32 nack_reg_ppm;    // register address byte(s) NACKed
+	u32 nack_data_ppm;   // data byte NACKed
+	u32 stretch_ns;      // SCL held low for this long on every byte
+	u32 busy_ppm;        // chance per address phase of going busy
+	u32 busy_us;         // length of a busy period, every phase is NACKed meanwhile
+	u32 settle_us;       // address phases sooner than this after a stop or cancel are NACKed
+	u32 min_scl_ns;      // shortest SCL period the device follows; faster, phases fail at overclock_ppm
+	u32 overclock_ppm;   // address and written bytes NACKed, bytes read with a bit flipped
+	bool missing;        // nothing answers at this address
+	u32 hold_sda_ppm;    // chance per phase of holding SDA low; nothing completes until a read phase clocks it out
+	u32 lost_irq_ppm;    // chance per phase that its interrupt is lost
+	u8 reg_bytes;        // register address bytes after a write start (1 or 2)
+	u32 seed;
+} Sim_FaultConfig;
+
+typedef struct Sim_FaultStats {
+	u64 nack_addr;
+	u64 nack_reg;
+	u64 nack_data;
+	u64 busy_periods;
+	u64 busy_nacks;
+	u64 settle_nacks;
+	u64 overclock_faults;
+	u64 stretched_bytes;
+	u64 sda_holds;
+	u64 lost_irqs;
+} Sim_FaultStats;
+
+typedef struct Sim_FaultDevice {
+	Sim_Device base;
+	Sim_Device *inner;
+	u8 port;
+	Sim_FaultConfig config;
+	Sim_FaultStats stats;
+	u32 rng;
+	u32 bytes_since_start;
+	bool writing;
+	u64 busy_until;
+	u64 settled_at;
+} Sim_FaultDevice;
+
+// replaces inner on the bus with the wrapper; the wrapper answers at inner's address
+void Sim_FaultDevice_Wrap(Sim_FaultDevice *fd, Sim_Device *inner, u8 port, const Sim_FaultConfig *config);
+// puts inner back on the bus
+void Sim_FaultDevice_Unwrap(Sim_FaultDevice *fd);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _SIM_KERNEL_H
+#define _SIM_KERNEL_H
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/svc.h>
+
+/*
+	In-process stand-in for the parts of the Horizon kernel the module uses: handles,
+	events, threads, address arbitration, ports/sessions with IPC translation and
+	interrupt binding. Everything runs as host threads in one process.
+*/
+
+#define SIM_TICKS_PER_SECOND 268111856ULL // SYSCLOCK_ARM11
+
+#define SIM_INVALID_HANDLE   MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_KERNEL, RD_INVALID_HANDLE) // D8E007F7
+#define SIM_PORT_NOT_FOUND   MAKERESULT(RL_PERMANENT, RS_NOTFOUND  , RM_KERNEL, RD_NOT_FOUND)
+#define SIM_OUT_OF_HANDLES   MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_KERNEL, RD_OUT_OF_RANGE)
+
+// time from a client's connect until the server accepts the session, per port
+typedef struct Sim_AcceptStats {
+	u64 accepted;
+	u64 wait_ns_total;
+	u64 wait_ns_max;
+} Sim_AcceptStats;
+
+Result Sim_CreatePort(Handle *port, const char *name, u32 name_len, u32 max_sessions);
+Result Sim_DestroyPort(const char *name, u32 name_len);
+Result Sim_ConnectToPort(Handle *session, const char *name, u32 name_len);
+bool Sim_IsPortRegistered(const char *name);
+Result Sim_GetAcceptStats(const char *name, Sim_AcceptStats *stats, bool reset);
+
+void Sim_RaiseInterrupt(u32 interrupt);
+bool Sim_IsInterruptBound(u32 interrupt);
+
+#endif
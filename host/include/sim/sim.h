@@ -0,0 +1,16 @@
+#ifndef _SIM_SIM_H
+#define _SIM_SIM_H
+
+#include <sim/kernel.h>
+#include <sim/device.h>
+#include <sim/bus.h>
+#include <sim/client.h>
+#include <sim/timing.h>
+#include <sim/fault.h>
+
+// runs I2C_Main on a simulated thread and waits until every service is registered
+void Sim_Boot(void);
+// posts the srv termination notification and waits for I2C_Main to return
+void Sim_Shutdown(void);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef _SIM_TIMING_H
+#define _SIM_TIMING_H
+
+#include <3ds/types.h>
+
+/*
+	Wire-level timing model for the simulated buses. Every START, byte, ACK/NACK, STOP
+	and cancel issued through the bus registers is charged in SCL cycles derived from
+	the bus SCL register, plus the CPU gaps (spinwait, interrupt turnaround) and thread
+	sleeps that happen while a transaction is open. Totals are kept per bus and per IPC
+	command id.
+*/
+
+typedef struct Sim_TimingConfig {
+	u32 base_clock_hz;        // controller clock feeding the SCL divider
+	u32 scl_low_base;         // fixed divider ticks added to I2C_SCL_LOW_DURATION
+	u32 scl_high_base;        // fixed divider ticks added to I2C_SCL_HIGH_DURATION
+	u32 irq_latency_ns;       // interrupt to next register write, SCL held low meanwhile
+	u32 spinwait_ns_per_iter; // one iteration of spinwait() (two counts)
+	double realtime_scale;    // > 0: the bus busy-waits modeled time * scale in wall clock
+} Sim_TimingConfig;
+
+typedef struct Sim_Timing {
+	u64 count;         // commands (per command) or transactions (per bus)
+	u64 starts;
+	u64 bytes_written; // including address bytes
+	u64 bytes_read;
+	u64 nacks;
+	u64 stops;
+	u64 cancels;
+	u64 scl_cycles;
+	u64 wire_ns;       // SCL activity
+	u64 gap_ns;        // spinwait and interrupt turnaround
+	u64 sleep_ns;      // thread sleeps inside a command
+	u64 stretch_ns;    // SCL held low by devices (clock stretching)
+} Sim_Timing;
+
+typedef enum Sim_BusPhase {
+	SIM_PHASE_START,
+	SIM_PHASE_WRITE,
+	SIM_PHASE_READ,
+	SIM_PHASE_STOP,
+	SIM_PHASE_CANCEL,
+} Sim_BusPhase;
+
+#define SIM_TIMING_MAX_CMD 0x40
+
+extern const Sim_TimingConfig Sim_DefaultTiming;
+
+void Sim_Timing_Configure(const Sim_TimingConfig *config);
+void Sim_Timing_Reset(void);
+void Sim_Timing_GetBus(u8 port, Sim_Timing *out);
+void Sim_Timing_GetCommand(u16 cmd_id, Sim_Timing *out);
+u64 Sim_Timing_SclPeriodNs(u16 scl);
+u64 Sim_Timing_TotalNs(const Sim_Timing *t);
+
+// hooks for the bus, device and kernel simulation
+void Sim_Timing_Phase(u8 port, u16 scl, Sim_BusPhase phase, bool ack);
+void Sim_Timing_Spinwait(u32 n);
+void Sim_Timing_Sleep(u64 nanoseconds);
+void Sim_Timing_Stretch(u8 port, u64 nanoseconds);
+void Sim_Timing_BeginCommand(u32 header);
+void Sim_Timing_EndCommand(void);
+
+#endif
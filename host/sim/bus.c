@@ -0,0 +1,202 @@
+#include <sim/bus.h>
+#include <sim/kernel.h>
+#include <sim/timing.h>
+
+#include <i2c/hal.h>
+
+typedef struct Sim_Bus {
+	u8 data;
+	u8 cnt;
+	u16 cntex;
+	u16 scl;
+	Sim_Device *devices;
+	Sim_Device *active;
+	bool sda_held;
+	bool drop_irq;
+} Sim_Bus;
+
+static Sim_Bus sim_buses[SIM_BUS_COUNT];
+
+void Sim_Bus_Attach(u8 port, Sim_Device *dev)
+{
+	Sim_Bus *bus = &sim_buses[port];
+
+	dev->next = bus->devices;
+	bus->devices = dev;
+}
+
+void Sim_Bus_Detach(u8 port, Sim_Device *dev)
+{
+	Sim_Bus *bus = &sim_buses[port];
+
+	for (Sim_Device **d = &bus->devices; *d; d = &(*d)->next) {
+		if (*d == dev) {
+			*d = dev->next;
+			break;
+		}
+	}
+
+	if (bus->active == dev)
+		bus->active = NULL;
+}
+
+void Sim_Bus_DetachAll(void)
+{
+	for (int i = 0; i < SIM_BUS_COUNT; i++)
+		sim_buses[i].devices = sim_buses[i].active = NULL;
+}
+
+void Sim_Bus_HoldSda(u8 port)
+{
+	sim_buses[port].sda_held = true;
+}
+
+void Sim_Bus_DropInterrupt(u8 port)
+{
+	sim_buses[port].drop_irq = true;
+}
+
+u16 Sim_Bus_GetScl(u8 port)
+{
+	return sim_buses[port].scl;
+}
+
+static Sim_Device *Sim_Bus_Find(Sim_Bus *bus, u8 write_addr)
+{
+	for (Sim_Device *dev = bus->devices; dev; dev = dev->next)
+		if (dev->write_addr == write_addr)
+			return dev;
+
+	return NULL;
+}
+
+static void Sim_Bus_Stop(Sim_Bus *bus)
+{
+	if (bus->active && bus->active->ops->stop)
+		bus->active->ops->stop(bus->active);
+
+	bus->active = NULL;
+}
+
+static void Sim_Bus_Control(u8 port, u8 cnt)
+{
+	Sim_Bus *bus = &sim_buses[port];
+	bool ack = false;
+
+	if (!(cnt & I2C_CNT_ENABLE)) {
+		bus->cnt = cnt;
+		return;
+	}
+
+	/*
+		a device holding SDA low stalls every phase but a read, whose nine clocks let it
+		finish its byte and let go; the stop after it returns the bus to idle
+	*/
+	if (bus->sda_held) {
+		if (!(cnt & I2C_CNT_DIRECTION_READ) || (cnt & I2C_CNT_TXN_START)) {
+			bus->cnt = cnt;
+			return;
+		}
+
+		bus->sda_held = false;
+		bus->data = 0xFF;
+		Sim_Bus_Stop(bus);
+		Sim_Timing_Phase(port, bus->scl, SIM_PHASE_READ, true);
+		Sim_Timing_Phase(port, bus->scl, SIM_PHASE_STOP, true);
+		bus->cnt = cnt & ~(I2C_CNT_ENABLE | I2C_CNT_TXN_ACK);
+
+		if (cnt & I2C_CNT_IRQ_ENABLE)
+			Sim_RaiseInterrupt(Sim_BusInterrupts[port]);
+		return;
+	}
+
+	if (cnt & I2C_CNT_TXN_CANCEL) {
+		Sim_Bus_Stop(bus);
+		Sim_Timing_Phase(port, bus->scl, SIM_PHASE_CANCEL, false);
+	} else {
+		Sim_BusPhase phase;
+
+		if (cnt & I2C_CNT_TXN_START) {
+			// (repeated) start, DATA holds the address byte
+			bus->active = Sim_Bus_Find(bus, bus->data & 0xFE);
+			ack = bus->active && bus->active->ops->start(bus->active, bus->data & 1);
+			phase = SIM_PHASE_START;
+
+			if (!ack)
+				bus->active = NULL;
+		} else if (cnt & I2C_CNT_DIRECTION_READ) {
+			ack = cnt & I2C_CNT_TXN_ACK;
+			bus->data = bus->active ? bus->active->ops->read(bus->active, ack) : 0xFF;
+			phase = SIM_PHASE_READ;
+		} else {
+			ack = bus->active && bus->active->ops->write(bus->active, bus->data);
+			phase = SIM_PHASE_WRITE;
+		}
+
+		Sim_Timing_Phase(port, bus->scl, phase, ack || phase == SIM_PHASE_READ);
+
+		if (cnt & I2C_CNT_TXN_FINISH) {
+			Sim_Bus_Stop(bus);
+			Sim_Timing_Phase(port, bus->scl, SIM_PHASE_STOP, true);
+		}
+	}
+
+	if (bus->sda_held) {
+		bus->cnt = cnt;
+		return;
+	}
+
+	bus->cnt = (cnt & ~(I2C_CNT_ENABLE | I2C_CNT_TXN_ACK)) | (ack ? I2C_CNT_TXN_ACK : 0);
+
+	if (bus->drop_irq)
+		bus->drop_irq = false;
+	else if (cnt & I2C_CNT_IRQ_ENABLE)
+		Sim_RaiseInterrupt(Sim_BusInterrupts[port]);
+}
+
+// HAL
+
+u16 I2C_HAL_ReadRegister(u8 port, size_t offset)
+{
+	Sim_Bus *bus = &sim_buses[port];
+
+	switch (offset)
+	{
+	case offsetof(I2C_BusRegset, DATA):
+		return bus->data;
+	case offsetof(I2C_BusRegset, CNT):
+		return bus->cnt;
+	case offsetof(I2C_BusRegset, CNTEX):
+		return bus->cntex;
+	case offsetof(I2C_BusRegset, SCL):
+		return bus->scl;
+	default:
+		return 0;
+	}
+}
+
+void I2C_HAL_WriteRegister(u8 port, size_t offset, u16 value)
+{
+	Sim_Bus *bus = &sim_buses[port];
+
+	switch (offset)
+	{
+	case offsetof(I2C_BusRegset, DATA):
+		bus->data = (u8)value;
+		break;
+	case offsetof(I2C_BusRegset, CNT):
+		Sim_Bus_Control(port, (u8)value);
+		break;
+	case offsetof(I2C_BusRegset, CNTEX):
+		bus->cntex = value;
+		break;
+	case offsetof(I2C_BusRegset, SCL):
+		bus->scl = value;
+		break;
+	}
+}
+
+void I2C_HAL_Spinwait(u32 n)
+{
+	Sim_Timing_Spinwait(n);
+}
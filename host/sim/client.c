@@ -0,0 +1,544 @@
+#include <sim/client.h>
+
+#include <3ds/srv.h>
+#include <3ds/ipc.h>
+
+#include <string.h>
+
+Result SimI2C_Connect(Handle *session, const char *service_name)
+{
+	return SRV_GetServiceHandle(session, service_name, strlen(service_name), 0);
+}
+
+static Result SimI2C_Request(Handle session)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	Result res = svcSendSyncRequest(session);
+
+	return R_SUCCEEDED(res) ? (Result)cmdbuf[1] : res;
+}
+
+static void SimI2C_SetReceiveBuffer(void *buf, u32 size)
+{
+	IPC_StaticBuffer *staticbufs = getThreadStaticBuffers();
+
+	staticbufs[0].desc = IPC_Desc_StaticBuffer(size, 0);
+	staticbufs[0].bufptr = buf;
+}
+
+Result SimI2C_ReplaceRegisterBits8(Handle session, u8 devid, u8 regid, u8 value, u8 mask)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0001, 4, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = value;
+	cmdbuf[4] = mask;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_SetRegisterBits8(Handle session, u8 devid, u8 regid, u8 mask)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0002, 3, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = mask;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_ClearRegisterBits8(Handle session, u8 devid, u8 regid, u8 mask)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0003, 3, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = mask;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_ReplaceRegisterBits16Multi(Handle session, const u8 *devids, u32 n_devids, u16 regid, u16 value, u16 mask)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0004, 4, 2);
+	cmdbuf[1] = regid;
+	cmdbuf[2] = value;
+	cmdbuf[3] = mask;
+	cmdbuf[4] = n_devids;
+	cmdbuf[5] = IPC_Desc_StaticBuffer(n_devids, 0);
+	cmdbuf[6] = IPC_PointerToWord(devids);
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_WriteRegister8(Handle session, u8 devid, u8 regid, u8 value)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0005, 3, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = value;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_WriteDevice8(Handle session, u8 devid, u8 value)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0006, 2, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = value;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_WriteRegister16(Handle session, u8 devid, u16 regid, u16 value)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0007, 3, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = value;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_WriteRegister16Multi(Handle session, const u8 *devids, u32 n_devids, u16 regid, u16 value)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0008, 3, 2);
+	cmdbuf[1] = regid;
+	cmdbuf[2] = value;
+	cmdbuf[3] = n_devids;
+	cmdbuf[4] = IPC_Desc_StaticBuffer(n_devids, 0);
+	cmdbuf[5] = IPC_PointerToWord(devids);
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_ReadRegister8(Handle session, u8 devid, u8 regid, u8 *value)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0009, 2, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+
+	Result res = SimI2C_Request(session);
+	*value = (u8)cmdbuf[2];
+	return res;
+}
+
+Result SimI2C_ReadRegister16(Handle session, u8 devid, u16 regid, u16 *value)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x000A, 2, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+
+	Result res = SimI2C_Request(session);
+	*value = (u16)cmdbuf[2];
+	return res;
+}
+
+Result SimI2C_WriteRegisters8(Handle session, u8 devid, u8 regid, const u8 *buf, u32 size)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x000B, 3, 2);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = size;
+	cmdbuf[4] = IPC_Desc_StaticBuffer(size, 1);
+	cmdbuf[5] = IPC_PointerToWord(buf);
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_WriteRegisters16(Handle session, u8 devid, u16 regid, const u16 *buf, u32 count)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x000C, 3, 2);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = count;
+	cmdbuf[4] = IPC_Desc_StaticBuffer(count * sizeof(u16), 1);
+	cmdbuf[5] = IPC_PointerToWord(buf);
+
+	return SimI2C_Request(session);
+}
+
+static Result SimI2C_ReadStatic(Handle session, u16 cmd_id, u8 devid, u16 regid, void *buf, u32 size, u32 count)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	SimI2C_SetReceiveBuffer(buf, size);
+
+	cmdbuf[0] = IPC_MakeHeader(cmd_id, 3, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = count;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_ReadRegisters8(Handle session, u8 devid, u8 regid, u8 *buf, u32 size)
+{
+	return SimI2C_ReadStatic(session, 0x000D, devid, regid, buf, size, size);
+}
+
+Result SimI2C_ReadRegisters8Legacy(Handle session, u8 devid, u8 regid, u8 *buf, u32 size)
+{
+	return SimI2C_ReadStatic(session, 0x000F, devid, regid, buf, size, size);
+}
+
+Result SimI2C_ReadRegisters16(Handle session, u8 devid, u16 regid, u16 *buf, u32 count)
+{
+	return SimI2C_ReadStatic(session, 0x0010, devid, regid, buf, count * sizeof(u16), count);
+}
+
+Result SimI2C_WriteRegisters8Mapped(Handle session, u8 devid, u8 regid, const u8 *buf, u32 size)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0011, 3, 2);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = size;
+	cmdbuf[4] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
+	cmdbuf[5] = IPC_PointerToWord(buf);
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_ReadRegisters8Mapped(Handle session, u8 devid, u8 regid, u8 *buf, u32 size)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0012, 3, 2);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = size;
+	cmdbuf[4] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[5] = IPC_PointerToWord(buf);
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_ReadDeviceRaw(Handle session, u8 devid, u8 *value)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0013, 1, 0);
+	cmdbuf[1] = devid;
+
+	Result res = SimI2C_Request(session);
+	*value = (u8)cmdbuf[2];
+	return res;
+}
+
+Result SimI2C_WriteDeviceRawMulti(Handle session, u8 devid, const u8 *buf, u32 size)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0014, 2, 2);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = size;
+	cmdbuf[3] = IPC_Desc_StaticBuffer(size, 1);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_ReadDeviceRawMulti(Handle session, u8 devid, u8 *buf, u32 size)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	SimI2C_SetReceiveBuffer(buf, size);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0015, 2, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = size;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_GetLatencyHistograms(Handle session, I2C_LatencyHistogram *buf, u32 max_entries, u32 flags, u32 *count)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u32 size = max_entries * sizeof(I2C_LatencyHistogram);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0016, 2, 2);
+	cmdbuf[1] = flags;
+	cmdbuf[2] = size;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+
+	Result res = SimI2C_Request(session);
+	*count = R_SUCCEEDED(res) ? cmdbuf[2] : 0;
+	return res;
+}
+
+Result SimI2C_GetBusStats(Handle session, I2C_BusStats *buf, u32 max_buses, u32 flags, u32 *count)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u32 size = max_buses * sizeof(I2C_BusStats);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0017, 2, 2);
+	cmdbuf[1] = flags;
+	cmdbuf[2] = size;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+
+	Result res = SimI2C_Request(session);
+	*count = R_SUCCEEDED(res) ? cmdbuf[2] : 0;
+	return res;
+}
+
+Result SimI2C_GetTrace(Handle session, I2C_TraceEntry *buf, u32 max_entries, u32 flags, u32 *count, u32 *sequence)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u32 size = max_entries * sizeof(I2C_TraceEntry);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0018, 2, 2);
+	cmdbuf[1] = flags;
+	cmdbuf[2] = size;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+
+	Result res = SimI2C_Request(session);
+	*count = R_SUCCEEDED(res) ? cmdbuf[2] : 0;
+	*sequence = R_SUCCEEDED(res) ? cmdbuf[3] : 0;
+	return res;
+}
+
+Result SimI2C_GetAsyncEvent(Handle session, Handle *event)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0019, 0, 0);
+
+	Result res = SimI2C_Request(session);
+	*event = R_SUCCEEDED(res) ? (Handle)cmdbuf[3] : 0;
+	return res;
+}
+
+Result SimI2C_SubmitReadRegisters8(Handle session, u8 devid, u8 regid, u32 size, u32 *ticket)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x001A, 3, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = size;
+
+	Result res = SimI2C_Request(session);
+	*ticket = R_SUCCEEDED(res) ? cmdbuf[2] : 0;
+	return res;
+}
+
+Result SimI2C_SubmitWriteRegisters8(Handle session, u8 devid, u8 regid, const u8 *buf, u32 size, u32 *ticket)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x001B, 3, 2);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = size;
+	cmdbuf[4] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
+	cmdbuf[5] = IPC_PointerToWord(buf);
+
+	Result res = SimI2C_Request(session);
+	*ticket = R_SUCCEEDED(res) ? cmdbuf[2] : 0;
+	return res;
+}
+
+Result SimI2C_ReapAsync(Handle session, u8 *buf, u32 size, u32 *ticket, Result *result, u32 *transferred)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x001C, 1, 2);
+	cmdbuf[1] = size;
+	cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[3] = IPC_PointerToWord(buf);
+
+	Result res = SimI2C_Request(session);
+
+	if (R_SUCCEEDED(res)) {
+		*ticket = cmdbuf[2];
+		*result = (Result)cmdbuf[3];
+		*transferred = cmdbuf[4];
+	}
+
+	return res;
+}
+
+Result SimI2C_SetPostedWrites(Handle session, bool enable)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x001D, 1, 0);
+	cmdbuf[1] = enable;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_FencePostedWrites(Handle session, Result *error, u32 *failures)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x001E, 0, 0);
+
+	Result res = SimI2C_Request(session);
+
+	if (R_SUCCEEDED(res)) {
+		*error = (Result)cmdbuf[2];
+		*failures = cmdbuf[3];
+	}
+
+	return res;
+}
+
+Result SimI2C_SetSnapshotRanges(Handle session, const I2C_SnapshotRange *ranges, u32 n_ranges, u32 *size, u32 *n_bursts)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x001F, 1, 2);
+	cmdbuf[1] = n_ranges * sizeof(I2C_SnapshotRange);
+	cmdbuf[2] = IPC_Desc_Buffer(n_ranges * sizeof(I2C_SnapshotRange), IPC_BUFFER_R);
+	cmdbuf[3] = IPC_PointerToWord(ranges);
+
+	Result res = SimI2C_Request(session);
+
+	if (R_SUCCEEDED(res)) {
+		*size = cmdbuf[2];
+		*n_bursts = cmdbuf[3];
+	}
+
+	return res;
+}
+
+Result SimI2C_ReadSnapshot(Handle session, u8 *buf, u32 size, u32 *read, u64 *tick)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0020, 1, 2);
+	cmdbuf[1] = size;
+	cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[3] = IPC_PointerToWord(buf);
+
+	Result res = SimI2C_Request(session);
+
+	if (R_SUCCEEDED(res)) {
+		*read = cmdbuf[2];
+		*tick = cmdbuf[3] | (u64)cmdbuf[4] << 32;
+	}
+
+	return res;
+}
+
+Result SimI2C_WriteRegisterTable16(Handle session, u8 devid, const I2C_RegisterWrite16 *table, u32 count, u32 *failed_index)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0021, 2, 2);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = count * sizeof(I2C_RegisterWrite16);
+	cmdbuf[3] = IPC_Desc_Buffer(count * sizeof(I2C_RegisterWrite16), IPC_BUFFER_R);
+	cmdbuf[4] = IPC_PointerToWord(table);
+
+	Result res = SimI2C_Request(session);
+	*failed_index = cmdbuf[2];
+	return res;
+}
+
+Result SimI2C_ConfigureReadCache(Handle session, u8 devid, u16 regid, u16 count, u32 ttl_ticks, u8 flags)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0022, 5, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = count;
+	cmdbuf[4] = ttl_ticks;
+	cmdbuf[5] = flags;
+
+	return SimI2C_Request(session);
+}
+
+Result SimI2C_GetReadCacheStats(Handle session, I2C_CacheStats *buf, u32 max_entries, u32 flags, u32 *count)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u32 size = max_entries * sizeof(I2C_CacheStats);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0023, 2, 2);
+	cmdbuf[1] = flags;
+	cmdbuf[2] = size;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+
+	Result res = SimI2C_Request(session);
+	*count = R_SUCCEEDED(res) ? cmdbuf[2] : 0;
+	return res;
+}
+
+Result SimI2C_ConfigureLegacyDelays(Handle session, u8 devid, u16 before_us, u16 between_us, u16 after_us, u16 flags, I2C_LegacyDelays *out)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+
+	cmdbuf[0] = IPC_MakeHeader(0x0024, 5, 0);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = before_us;
+	cmdbuf[3] = between_us;
+	cmdbuf[4] = after_us;
+	cmdbuf[5] = flags;
+
+	Result res = SimI2C_Request(session);
+
+	if (out) {
+		out->before_us = cmdbuf[2];
+		out->between_us = cmdbuf[3];
+		out->after_us = cmdbuf[4];
+		out->flags = cmdbuf[5];
+		out->reads = cmdbuf[6];
+		out->retries = cmdbuf[7];
+	}
+
+	return res;
+}
+
+Result SimI2C_TuneScl(Handle session, u8 devid, u8 regid, u32 iterations, u8 flags, I2C_SclTuneResult *buf, u32 max_results,
+	u32 *count, u32 *best, u16 *scl)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u32 size = max_results * sizeof(I2C_SclTuneResult);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0025, 5, 2);
+	cmdbuf[1] = devid;
+	cmdbuf[2] = regid;
+	cmdbuf[3] = iterations;
+	cmdbuf[4] = flags;
+	cmdbuf[5] = size;
+	cmdbuf[6] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[7] = IPC_PointerToWord(buf);
+
+	Result res = SimI2C_Request(session);
+
+	*count = cmdbuf[2];
+	*best = cmdbuf[3];
+	*scl = (u16)cmdbuf[4];
+	return res;
+}
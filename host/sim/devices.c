@@ -0,0 +1,232 @@
+#include <sim/device.h>
+#include <sim/bus.h>
+
+#include <3ds/svc.h>
+#include <i2c/i2c.h>
+
+#include <string.h>
+
+// register file
+
+static bool Sim_RegisterFile_Start(Sim_Device *dev, bool read)
+{
+	Sim_RegisterFile *rf = (Sim_RegisterFile *)dev;
+
+	if (!read)
+		rf->addr_received = 0;
+
+	return true;
+}
+
+static bool Sim_RegisterFile_Write(Sim_Device *dev, u8 value)
+{
+	Sim_RegisterFile *rf = (Sim_RegisterFile *)dev;
+
+	if (rf->addr_received < rf->addr_bytes) {
+		rf->pointer = rf->addr_received++ ? (u16)(rf->pointer << 8 | value) : value;
+		return true;
+	}
+
+	rf->regs[rf->pointer++ % rf->size] = value;
+	return true;
+}
+
+static u8 Sim_RegisterFile_Read(Sim_Device *dev, bool ack)
+{
+	Sim_RegisterFile *rf = (Sim_RegisterFile *)dev;
+	(void)ack;
+
+	return rf->regs[rf->pointer++ % rf->size];
+}
+
+static const Sim_DeviceOps Sim_RegisterFileOps = {
+	.start = Sim_RegisterFile_Start,
+	.write = Sim_RegisterFile_Write,
+	.read  = Sim_RegisterFile_Read,
+};
+
+void Sim_RegisterFile_Init(Sim_RegisterFile *rf, u8 write_addr, u8 addr_bytes, u8 *regs, u32 size)
+{
+	memset(rf, 0, sizeof(Sim_RegisterFile));
+
+	rf->base.ops = &Sim_RegisterFileOps;
+	rf->base.write_addr = write_addr;
+	rf->addr_bytes = addr_bytes;
+	rf->regs = regs;
+	rf->size = size;
+}
+
+// eeprom
+
+static bool Sim_Eeprom_Start(Sim_Device *dev, bool read)
+{
+	Sim_Eeprom *eep = (Sim_Eeprom *)dev;
+
+	if ((u64)svcGetSystemTick() < eep->busy_until)
+		return false; // write cycle in progress, ACK polling
+
+	eep->written = false;
+	return Sim_RegisterFile_Start(dev, read);
+}
+
+static bool Sim_Eeprom_Write(Sim_Device *dev, u8 value)
+{
+	Sim_Eeprom *eep = (Sim_Eeprom *)dev;
+	Sim_RegisterFile *rf = &eep->rf;
+
+	if (rf->addr_received < rf->addr_bytes)
+		return Sim_RegisterFile_Write(dev, value);
+
+	u16 page_mask = eep->page_size - 1;
+
+	rf->regs[rf->pointer % rf->size] = value;
+	rf->pointer = (rf->pointer & ~page_mask) | ((rf->pointer + 1) & page_mask);
+	eep->written = true;
+	return true;
+}
+
+static void Sim_Eeprom_Stop(Sim_Device *dev)
+{
+	Sim_Eeprom *eep = (Sim_Eeprom *)dev;
+
+	if (eep->written)
+		eep->busy_until = (u64)svcGetSystemTick() + eep->write_cycle_ticks;
+
+	eep->written = false;
+}
+
+static const Sim_DeviceOps Sim_EepromOps = {
+	.start = Sim_Eeprom_Start,
+	.write = Sim_Eeprom_Write,
+	.read  = Sim_RegisterFile_Read,
+	.stop  = Sim_Eeprom_Stop,
+};
+
+void Sim_Eeprom_Init(Sim_Eeprom *eep, u8 write_addr, u8 addr_bytes, u8 *mem, u32 size, u16 page_size, u64 write_cycle_ticks)
+{
+	memset(eep, 0, sizeof(Sim_Eeprom));
+	Sim_RegisterFile_Init(&eep->rf, write_addr, addr_bytes, mem, size);
+
+	eep->rf.base.ops = &Sim_EepromOps;
+	eep->page_size = page_size;
+	eep->write_cycle_ticks = write_cycle_ticks;
+}
+
+// fifo
+
+static bool Sim_Fifo_Start(Sim_Device *dev, bool read)
+{
+	(void)dev;
+	(void)read;
+	return true;
+}
+
+static bool Sim_Fifo_Write(Sim_Device *dev, u8 value)
+{
+	Sim_Fifo *fifo = (Sim_Fifo *)dev;
+
+	if (fifo->rx_count == SIM_FIFO_SIZE)
+		return false;
+
+	fifo->rx[fifo->rx_count++] = value;
+	return true;
+}
+
+static u8 Sim_Fifo_Read(Sim_Device *dev, bool ack)
+{
+	Sim_Fifo *fifo = (Sim_Fifo *)dev;
+	(void)ack;
+
+	if (!fifo->tx_count)
+		return 0xFF;
+
+	u8 value = fifo->tx[fifo->tx_head];
+
+	fifo->tx_head = (fifo->tx_head + 1) % SIM_FIFO_SIZE;
+	fifo->tx_count--;
+	return value;
+}
+
+static const Sim_DeviceOps Sim_FifoOps = {
+	.start = Sim_Fifo_Start,
+	.write = Sim_Fifo_Write,
+	.read  = Sim_Fifo_Read,
+};
+
+void Sim_Fifo_Init(Sim_Fifo *fifo, u8 write_addr)
+{
+	memset(fifo, 0, sizeof(Sim_Fifo));
+
+	fifo->base.ops = &Sim_FifoOps;
+	fifo->base.write_addr = write_addr;
+}
+
+u32 Sim_Fifo_Push(Sim_Fifo *fifo, const u8 *buf, u32 size)
+{
+	u32 n = 0;
+
+	for (; n < size && fifo->tx_count < SIM_FIFO_SIZE; n++, fifo->tx_count++)
+		fifo->tx[(fifo->tx_head + fifo->tx_count) % SIM_FIFO_SIZE] = buf[n];
+
+	return n;
+}
+
+u32 Sim_Fifo_Pop(Sim_Fifo *fifo, u8 *buf, u32 size)
+{
+	u32 n = MIN(size, fifo->rx_count);
+
+	memcpy(buf, fifo->rx, n);
+	memmove(fifo->rx, fifo->rx + n, fifo->rx_count - n);
+	fifo->rx_count -= n;
+	return n;
+}
+
+// default population
+
+#define SIM_DEVID_COUNT 18
+#define SIM_DEVID_EEP   14
+#define SIM_DEVID_FIFO  15
+
+static union {
+	Sim_RegisterFile rf;
+	Sim_Eeprom eep;
+	Sim_Fifo fifo;
+} sim_default_devices[SIM_DEVID_COUNT];
+
+static u8 sim_default_storage[SIM_DEVID_COUNT][0x10000];
+
+static bool Sim_IsCameraDevice(u8 devid)
+{
+	return devid == 1 || devid == 2 || devid == 4; // 16-bit register addresses
+}
+
+void Sim_AttachDefaultDevices(void)
+{
+	for (u8 devid = 0; devid < SIM_DEVID_COUNT; devid++) {
+		const I2C_DeviceConfig *dc = I2C_GetDeviceConfig(devid);
+
+		if (!dc)
+			break;
+
+		Sim_Device *dev = &sim_default_devices[devid].rf.base;
+		u8 *storage = sim_default_storage[devid];
+
+		memset(storage, 0, sizeof(sim_default_storage[devid]));
+
+		if (devid == SIM_DEVID_EEP)
+			Sim_Eeprom_Init(&sim_default_devices[devid].eep, dc->write_addr, 1, storage, 0x100, 16, 0);
+		else if (devid == SIM_DEVID_FIFO)
+			Sim_Fifo_Init(&sim_default_devices[devid].fifo, dc->write_addr);
+		else if (Sim_IsCameraDevice(devid))
+			Sim_RegisterFile_Init(&sim_default_devices[devid].rf, dc->write_addr, 2, storage, 0x10000);
+		else
+			Sim_RegisterFile_Init(&sim_default_devices[devid].rf, dc->write_addr, 1, storage, 0x100);
+
+		Sim_Bus_Attach(dc->port, dev);
+	}
+}
+
+Sim_Device *Sim_GetDefaultDevice(u8 devid)
+{
+	return devid < SIM_DEVID_COUNT && I2C_GetDeviceConfig(devid) ? &sim_default_devices[devid].rf.base : NULL;
+}
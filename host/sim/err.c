@@ -0,0 +1,25 @@
+#include <3ds/err.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+Handle errf_session;
+u32 errf_refcount;
+
+Result errfInit()
+{
+	errf_refcount++;
+	return 0;
+}
+
+void errfExit()
+{
+	errf_refcount--;
+}
+
+_Noreturn void ERRF_ThrowResultNoRet(Result failure)
+{
+	fprintf(stderr, "sim: fatal error %08lX (from %p)\n", (unsigned long)(u32)failure,
+		__builtin_extract_return_addr(__builtin_return_address(0)));
+	abort();
+}
@@ -0,0 +1,181 @@
+#include <sim/fault.h>
+#include <sim/kernel.h>
+#include <sim/timing.h>
+#include <sim/bus.h>
+
+#include <string.h>
+
+static bool Sim_Fault_Roll(Sim_FaultDevice *fd, u32 ppm)
+{
+	if (!ppm)
+		return false;
+
+	// xorshift32, only ever advanced under the module's bus lock
+	fd->rng ^= fd->rng << 13;
+	fd->rng ^= fd->rng >> 17;
+	fd->rng ^= fd->rng << 5;
+
+	return fd->rng % 1000000 < ppm;
+}
+
+static bool Sim_Fault_Busy(Sim_FaultDevice *fd)
+{
+	if ((u64)svcGetSystemTick() < fd->busy_until) {
+		fd->stats.busy_nacks++;
+		return true;
+	}
+
+	return false;
+}
+
+static void Sim_Fault_Stretch(Sim_FaultDevice *fd)
+{
+	if (fd->config.stretch_ns) {
+		fd->stats.stretched_bytes++;
+		Sim_Timing_Stretch(fd->port, fd->config.stretch_ns);
+	}
+}
+
+// a phase clocked faster than the device follows
+static bool Sim_Fault_Overclocked(Sim_FaultDevice *fd)
+{
+	if (!fd->config.min_scl_ns || Sim_Timing_SclPeriodNs(Sim_Bus_GetScl(fd->port)) >= fd->config.min_scl_ns ||
+		!Sim_Fault_Roll(fd, fd->config.overclock_ppm))
+		return false;
+
+	fd->stats.overclock_faults++;
+	return true;
+}
+
+// faults that stall the phase in the controller rather than NACK it
+static bool Sim_Fault_Stall(Sim_FaultDevice *fd)
+{
+	if (Sim_Fault_Roll(fd, fd->config.hold_sda_ppm)) {
+		fd->stats.sda_holds++;
+		Sim_Bus_HoldSda(fd->port);
+		return true;
+	}
+
+	if (Sim_Fault_Roll(fd, fd->config.lost_irq_ppm)) {
+		fd->stats.lost_irqs++;
+		Sim_Bus_DropInterrupt(fd->port);
+	}
+
+	return false;
+}
+
+static bool Sim_Fault_Start(Sim_Device *dev, bool read)
+{
+	Sim_FaultDevice *fd = (Sim_FaultDevice *)dev;
+
+	if (fd->config.missing || Sim_Fault_Busy(fd) || Sim_Fault_Stall(fd))
+		return false;
+
+	if ((u64)svcGetSystemTick() < fd->settled_at) {
+		fd->stats.settle_nacks++;
+		return false;
+	}
+
+	if (Sim_Fault_Overclocked(fd))
+		return false;
+
+	if (Sim_Fault_Roll(fd, fd->config.busy_ppm)) {
+		fd->busy_until = (u64)svcGetSystemTick() + (u64)fd->config.busy_us * SIM_TICKS_PER_SECOND / 1000000;
+		fd->stats.busy_periods++;
+		fd->stats.busy_nacks++;
+		return false;
+	}
+
+	if (Sim_Fault_Roll(fd, fd->config.nack_addr_ppm)) {
+		fd->stats.nack_addr++;
+		return false;
+	}
+
+	Sim_Fault_Stretch(fd);
+
+	if (!read) {
+		fd->writing = true;
+		fd->bytes_since_start = 0;
+	} else
+		fd->writing = false;
+
+	return fd->inner->ops->start(fd->inner, read);
+}
+
+static bool Sim_Fault_Write(Sim_Device *dev, u8 value)
+{
+	Sim_FaultDevice *fd = (Sim_FaultDevice *)dev;
+	bool reg = fd->writing && fd->bytes_since_start++ < fd->config.reg_bytes;
+
+	if (Sim_Fault_Busy(fd) || Sim_Fault_Stall(fd) || Sim_Fault_Overclocked(fd))
+		return false;
+
+	if (Sim_Fault_Roll(fd, reg ? fd->config.nack_reg_ppm : fd->config.nack_data_ppm)) {
+		if (reg)
+			fd->stats.nack_reg++;
+		else
+			fd->stats.nack_data++;
+		return false;
+	}
+
+	Sim_Fault_Stretch(fd);
+	return fd->inner->ops->write(fd->inner, value);
+}
+
+static u8 Sim_Fault_Read(Sim_Device *dev, bool ack)
+{
+	Sim_FaultDevice *fd = (Sim_FaultDevice *)dev;
+
+	if (Sim_Fault_Stall(fd))
+		return 0xFF;
+
+	Sim_Fault_Stretch(fd);
+
+	u8 value = fd->inner->ops->read(fd->inner, ack);
+
+	return Sim_Fault_Overclocked(fd) ? value ^ 0x01 : value;
+}
+
+static void Sim_Fault_Stop(Sim_Device *dev)
+{
+	Sim_FaultDevice *fd = (Sim_FaultDevice *)dev;
+
+	fd->writing = false;
+
+	if (fd->config.settle_us)
+		fd->settled_at = (u64)svcGetSystemTick() + (u64)fd->config.settle_us * SIM_TICKS_PER_SECOND / 1000000;
+
+	if (fd->inner->ops->stop)
+		fd->inner->ops->stop(fd->inner);
+}
+
+static const Sim_DeviceOps Sim_FaultOps = {
+	.start = Sim_Fault_Start,
+	.write = Sim_Fault_Write,
+	.read  = Sim_Fault_Read,
+	.stop  = Sim_Fault_Stop,
+};
+
+void Sim_FaultDevice_Wrap(Sim_FaultDevice *fd, Sim_Device *inner, u8 port, const Sim_FaultConfig *config)
+{
+	memset(fd, 0, sizeof(Sim_FaultDevice));
+
+	fd->base.ops = &Sim_FaultOps;
+	fd->base.write_addr = inner->write_addr;
+	fd->inner = inner;
+	fd->port = port;
+	fd->config = *config;
+	fd->rng = config->seed ? config->seed : 0x2545F491;
+
+	if (!fd->config.reg_bytes)
+		fd->config.reg_bytes = 1;
+
+	Sim_Bus_Detach(port, inner);
+	Sim_Bus_Attach(port, &fd->base);
+}
+
+void Sim_FaultDevice_Unwrap(Sim_FaultDevice *fd)
+{
+	Sim_Bus_Detach(fd->port, &fd->base);
+	Sim_Bus_Attach(fd->port, fd->inner);
+}
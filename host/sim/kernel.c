@@ -0,0 +1,903 @@
+#include <sim/kernel.h>
+#include <sim/timing.h>
+
+#include <3ds/synchronization.h>
+#include <3ds/ipc.h>
+#include <errors.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_MAX_HANDLES    256
+#define SIM_MAX_INTERRUPTS 0x80
+#define SIM_MAX_POINTERS   4096
+
+typedef enum Sim_ObjectType {
+	SIM_OBJ_EVENT,
+	SIM_OBJ_THREAD,
+	SIM_OBJ_ARBITER,
+	SIM_OBJ_PORT,
+	SIM_OBJ_SERVER_SESSION,
+	SIM_OBJ_CLIENT_SESSION,
+} Sim_ObjectType;
+
+typedef struct Sim_Session {
+	u32 refcount;
+	bool client_closed;
+	bool server_closed;
+	bool request_pending; // sent by the client, not yet received by the server
+	bool in_service;      // received by the server, not yet replied to
+	bool reply_ready;
+	ThreadLocalStorage *client_tls;
+	struct Sim_Session *next_pending;
+	u64 connected_ns; // monotonic time of the connect, for the port's accept wait
+} Sim_Session;
+
+typedef struct Sim_Object {
+	Sim_ObjectType type;
+	u32 refcount;
+	union {
+		struct {
+			bool signaled;
+			ResetType reset_type;
+		} event;
+		struct {
+			bool exited;
+			void (*entry)(void *);
+			void *arg;
+		} thread;
+		struct {
+			char name[12];
+			Sim_Session *pending_head;
+			Sim_Session *pending_tail;
+			Sim_AcceptStats accept_stats;
+		} port;
+		Sim_Session *session;
+	};
+} Sim_Object;
+
+typedef struct Sim_ArbiterWaiter {
+	uintptr_t addr;
+	bool woken;
+	struct Sim_ArbiterWaiter *next;
+} Sim_ArbiterWaiter;
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_cond;
+static pthread_once_t sim_once = PTHREAD_ONCE_INIT;
+
+static Sim_Object *sim_handles[SIM_MAX_HANDLES];
+static Handle sim_interrupts[SIM_MAX_INTERRUPTS];
+static Sim_ArbiterWaiter *sim_waiters;
+
+static _Thread_local ThreadLocalStorage sim_tls;
+_Thread_local s32 __exclusive_value;
+
+// cpu
+
+ThreadLocalStorage *getThreadLocalStorage(void)
+{
+	return &sim_tls;
+}
+
+void __dmb(void)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+// pointer words
+
+static pthread_mutex_t sim_pointer_lock = PTHREAD_MUTEX_INITIALIZER;
+static const void *sim_pointers[SIM_MAX_POINTERS];
+
+u32 IPC_PointerToWord(const void *ptr)
+{
+	if (!ptr)
+		return 0;
+
+	u32 slot = (u32)(((uintptr_t)ptr >> 2) * 2654435761u) % SIM_MAX_POINTERS;
+
+	pthread_mutex_lock(&sim_pointer_lock);
+
+	for (u32 i = 0; i < SIM_MAX_POINTERS; i++, slot = (slot + 1) % SIM_MAX_POINTERS) {
+		if (sim_pointers[slot] == ptr || !sim_pointers[slot]) {
+			sim_pointers[slot] = ptr;
+			pthread_mutex_unlock(&sim_pointer_lock);
+			return slot + 1;
+		}
+	}
+
+	fprintf(stderr, "sim: pointer table exhausted\n");
+	abort();
+}
+
+void *IPC_WordToPointer(u32 word)
+{
+	if (!word || word > SIM_MAX_POINTERS)
+		return NULL;
+
+	pthread_mutex_lock(&sim_pointer_lock);
+	void *ptr = (void *)sim_pointers[word - 1];
+	pthread_mutex_unlock(&sim_pointer_lock);
+
+	return ptr;
+}
+
+// handle table
+
+static void Sim_InitOnce(void)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sim_cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+static void Sim_Lock(void)
+{
+	pthread_once(&sim_once, Sim_InitOnce);
+	pthread_mutex_lock(&sim_lock);
+}
+
+static void Sim_Unlock(void)
+{
+	pthread_mutex_unlock(&sim_lock);
+}
+
+static Sim_Object *Sim_GetObject(Handle handle)
+{
+	if (handle <= 0 || handle > SIM_MAX_HANDLES)
+		return NULL;
+
+	return sim_handles[handle - 1];
+}
+
+static Result Sim_CreateHandle(Handle *out, Sim_Object *obj)
+{
+	for (s32 i = 0; i < SIM_MAX_HANDLES; i++) {
+		if (!sim_handles[i]) {
+			sim_handles[i] = obj;
+			obj->refcount++;
+			*out = i + 1;
+			return 0;
+		}
+	}
+
+	return SIM_OUT_OF_HANDLES;
+}
+
+static Sim_Object *Sim_NewObject(Sim_ObjectType type)
+{
+	Sim_Object *obj = calloc(1, sizeof(Sim_Object));
+
+	if (!obj)
+		abort();
+
+	obj->type = type;
+	return obj;
+}
+
+static void Sim_ReleaseSession(Sim_Session *session)
+{
+	if (!--session->refcount)
+		free(session);
+}
+
+static void Sim_ReleaseObject(Sim_Object *obj)
+{
+	if (--obj->refcount)
+		return;
+
+	if (obj->type == SIM_OBJ_SERVER_SESSION || obj->type == SIM_OBJ_CLIENT_SESSION)
+		Sim_ReleaseSession(obj->session);
+
+	free(obj);
+}
+
+static void Sim_WaitUntil(const struct timespec *deadline)
+{
+	if (deadline)
+		pthread_cond_timedwait(&sim_cond, &sim_lock, deadline);
+	else
+		pthread_cond_wait(&sim_cond, &sim_lock);
+}
+
+static struct timespec *Sim_Deadline(struct timespec *ts, s64 nanoseconds)
+{
+	if (nanoseconds < 0)
+		return NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, ts);
+
+	ts->tv_sec += nanoseconds / 1000000000;
+	ts->tv_nsec += nanoseconds % 1000000000;
+
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+
+	return ts;
+}
+
+static u64 Sim_NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool Sim_DeadlinePassed(const struct timespec *deadline)
+{
+	if (!deadline)
+		return false;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+static bool Sim_IsSignaled(Sim_Object *obj, bool consume)
+{
+	switch (obj->type)
+	{
+	case SIM_OBJ_EVENT:
+		if (!obj->event.signaled)
+			return false;
+		if (consume && obj->event.reset_type != RESET_STICKY)
+			obj->event.signaled = false;
+		return true;
+	case SIM_OBJ_THREAD:
+		return obj->thread.exited;
+	case SIM_OBJ_PORT:
+		return obj->port.pending_head != NULL;
+	case SIM_OBJ_SERVER_SESSION:
+		return obj->session->request_pending || obj->session->client_closed;
+	case SIM_OBJ_CLIENT_SESSION:
+		return obj->session->server_closed;
+	default:
+		return false;
+	}
+}
+
+// IPC translation
+
+static void Sim_TranslateCommand(const u32 *src, ThreadLocalStorage *dst_tls)
+{
+	u32 *dst = dst_tls->cmdbuf;
+	u32 header = src[0];
+	u32 normal = (header >> 6) & 0x3F;
+	u32 translate = header & 0x3F;
+	u32 end = 1 + normal + translate;
+
+	memcpy(dst, src, (1 + normal) * sizeof(u32));
+
+	for (u32 i = 1 + normal; i < end && i < 64;) {
+		u32 desc = src[i];
+		dst[i++] = desc;
+
+		if ((desc & 0xF) == 0) { // handles or process id
+			if (desc & 0x20) {
+				dst[i++] = 1;
+				continue;
+			}
+
+			// shared handles get a handle of their own in the receiver, moved ones are passed on
+			for (u32 n = (desc >> 26) + 1; n > 0 && i < end; n--, i++) {
+				Sim_Object *obj = (desc & 0x10) ? NULL : Sim_GetObject(src[i]);
+
+				if (!obj || R_FAILED(Sim_CreateHandle((Handle *)&dst[i], obj)))
+					dst[i] = src[i];
+			}
+		} else if ((desc & 0xF) == 0x2) { // static buffer, copied into the receiver's buffer
+			IPC_StaticBuffer *target = &dst_tls->ipc_static_buffers[(desc >> 10) & 0xF];
+			size_t size = IPC_GetStaticBufferSize(desc);
+			size_t capacity = IPC_GetStaticBufferSize(target->desc);
+
+			if (size > capacity)
+				size = capacity;
+
+			if (size)
+				memcpy(target->bufptr, IPC_WordToPointer(src[i]), size);
+
+			dst[i - 1] = (desc & 0x3FFF) | (u32)(size << 14);
+			dst[i++] = IPC_PointerToWord(target->bufptr);
+		} else { // mapped and pxi buffers share the address space
+			dst[i] = src[i];
+			i++;
+		}
+	}
+}
+
+// svc
+
+Result svcCloseHandle(Handle handle)
+{
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_GetObject(handle);
+
+	if (!obj) {
+		Sim_Unlock();
+		return SIM_INVALID_HANDLE;
+	}
+
+	sim_handles[handle - 1] = NULL;
+
+	if (obj->type == SIM_OBJ_CLIENT_SESSION)
+		obj->session->client_closed = true;
+	else if (obj->type == SIM_OBJ_SERVER_SESSION)
+		obj->session->server_closed = true;
+
+	Sim_ReleaseObject(obj);
+
+	pthread_cond_broadcast(&sim_cond);
+	Sim_Unlock();
+	return 0;
+}
+
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handles_num, bool wait_all, s64 nanoseconds)
+{
+	struct timespec ts, *deadline = Sim_Deadline(&ts, nanoseconds);
+	Result res = 0;
+
+	Sim_Lock();
+
+	while (true) {
+		s32 signaled = 0, first = -1;
+
+		for (s32 i = 0; i < handles_num; i++) {
+			Sim_Object *obj = Sim_GetObject(handles[i]);
+
+			if (!obj) {
+				res = SIM_INVALID_HANDLE;
+				goto exit;
+			}
+
+			if (Sim_IsSignaled(obj, false)) {
+				signaled++;
+				if (first < 0)
+					first = i;
+			}
+		}
+
+		if (wait_all ? signaled == handles_num : first >= 0) {
+			for (s32 i = 0; i < handles_num; i++)
+				if (wait_all || i == first)
+					Sim_IsSignaled(Sim_GetObject(handles[i]), true);
+
+			*out = wait_all ? 0 : first;
+			res = 0;
+			goto exit;
+		}
+
+		if (nanoseconds == 0 || Sim_DeadlinePassed(deadline)) {
+			res = OS_TIMEOUT;
+			goto exit;
+		}
+
+		Sim_WaitUntil(deadline);
+	}
+
+exit:
+	Sim_Unlock();
+	return res;
+}
+
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds)
+{
+	s32 index;
+	return svcWaitSynchronizationN(&index, &handle, 1, false, nanoseconds);
+}
+
+Result svcReplyAndReceive(s32 *index, const Handle *handles, s32 handleCount, Handle replyTarget)
+{
+	ThreadLocalStorage *tls = getThreadLocalStorage();
+	Result res = 0;
+
+	Sim_Lock();
+
+	Sim_Object *target = replyTarget ? Sim_GetObject(replyTarget) : NULL;
+
+	if (target && target->type == SIM_OBJ_SERVER_SESSION && tls->cmdbuf[0] != 0xFFFF0000) {
+		Sim_Session *session = target->session;
+
+		if (session->in_service) {
+			Sim_Timing_EndCommand();
+
+			if (!session->client_closed)
+				Sim_TranslateCommand(tls->cmdbuf, session->client_tls);
+
+			session->in_service = false;
+			session->reply_ready = true;
+			pthread_cond_broadcast(&sim_cond);
+		}
+	}
+
+	while (true) {
+		for (s32 i = 0; i < handleCount; i++) {
+			Sim_Object *obj = Sim_GetObject(handles[i]);
+
+			if (!obj) {
+				*index = i;
+				res = SIM_INVALID_HANDLE;
+				goto exit;
+			}
+
+			if (obj->type != SIM_OBJ_SERVER_SESSION) {
+				if (Sim_IsSignaled(obj, true)) {
+					*index = i;
+					goto exit;
+				}
+				continue;
+			}
+
+			Sim_Session *session = obj->session;
+
+			if (session->request_pending) {
+				Sim_TranslateCommand(session->client_tls->cmdbuf, tls);
+				Sim_Timing_BeginCommand(tls->cmdbuf[0]);
+				session->request_pending = false;
+				session->in_service = true;
+				*index = i;
+				goto exit;
+			}
+
+			if (session->client_closed) {
+				*index = i;
+				res = OS_REMOTE_SESSION_CLOSED;
+				goto exit;
+			}
+		}
+
+		Sim_WaitUntil(NULL);
+	}
+
+exit:
+	Sim_Unlock();
+	return res;
+}
+
+Result svcAcceptSession(Handle *session, Handle port)
+{
+	Result res = SIM_INVALID_HANDLE;
+
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_GetObject(port);
+
+	if (obj && obj->type == SIM_OBJ_PORT && obj->port.pending_head) {
+		Sim_Session *pending = obj->port.pending_head;
+
+		obj->port.pending_head = pending->next_pending;
+		if (!obj->port.pending_head)
+			obj->port.pending_tail = NULL;
+
+		Sim_AcceptStats *stats = &obj->port.accept_stats;
+		u64 wait_ns = Sim_NowNs() - pending->connected_ns;
+
+		stats->accepted++;
+		stats->wait_ns_total += wait_ns;
+		if (wait_ns > stats->wait_ns_max)
+			stats->wait_ns_max = wait_ns;
+
+		Sim_Object *server = Sim_NewObject(SIM_OBJ_SERVER_SESSION);
+		server->session = pending;
+
+		if (R_FAILED(res = Sim_CreateHandle(session, server))) {
+			server->refcount = 1;
+			Sim_ReleaseObject(server); // drops the server side session reference
+		}
+	}
+
+	Sim_Unlock();
+	return res;
+}
+
+Result svcSendSyncRequest(Handle handle)
+{
+	Result res = 0;
+
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_GetObject(handle);
+
+	if (!obj || obj->type != SIM_OBJ_CLIENT_SESSION) {
+		Sim_Unlock();
+		return SIM_INVALID_HANDLE;
+	}
+
+	Sim_Session *session = obj->session;
+
+	session->client_tls = getThreadLocalStorage();
+	session->request_pending = true;
+	pthread_cond_broadcast(&sim_cond);
+
+	while (!session->reply_ready && !session->server_closed)
+		Sim_WaitUntil(NULL);
+
+	if (session->reply_ready)
+		session->reply_ready = false;
+	else
+		res = OS_REMOTE_SESSION_CLOSED;
+
+	session->request_pending = false;
+
+	Sim_Unlock();
+	return res;
+}
+
+static void *Sim_ThreadEntry(void *arg)
+{
+	Sim_Object *obj = arg;
+
+	obj->thread.entry(obj->thread.arg);
+
+	Sim_Lock();
+	obj->thread.exited = true;
+	Sim_ReleaseObject(obj);
+	pthread_cond_broadcast(&sim_cond);
+	Sim_Unlock();
+
+	return NULL;
+}
+
+Result svcCreateThread(Handle *thread, void (* entrypoint)(void *), void *arg, void *stack_top, s32 thread_priority, s32 processor_id)
+{
+	(void)stack_top;
+	(void)thread_priority;
+	(void)processor_id;
+
+	Sim_Object *obj = Sim_NewObject(SIM_OBJ_THREAD);
+	obj->thread.entry = entrypoint;
+	obj->thread.arg = arg;
+
+	Sim_Lock();
+
+	Result res = Sim_CreateHandle(thread, obj);
+
+	if (R_SUCCEEDED(res)) {
+		pthread_t pthread;
+
+		obj->refcount++; // held by the running thread
+
+		if (pthread_create(&pthread, NULL, Sim_ThreadEntry, obj) != 0) {
+			fprintf(stderr, "sim: pthread_create failed\n");
+			abort();
+		}
+
+		pthread_detach(pthread);
+	} else
+		free(obj);
+
+	Sim_Unlock();
+	return res;
+}
+
+void svcBreak(UserBreakType breakReason)
+{
+	fprintf(stderr, "sim: svcBreak(%d)\n", breakReason);
+	abort();
+}
+
+void svcSleepThread(u64 nanoseconds)
+{
+	Sim_Timing_Sleep(nanoseconds);
+
+	struct timespec ts = {
+		.tv_sec = nanoseconds / 1000000000,
+		.tv_nsec = nanoseconds % 1000000000,
+	};
+
+	while (nanosleep(&ts, &ts) != 0) { }
+}
+
+Result svcGetProcessId(u32 *id, Handle process)
+{
+	(void)process;
+	*id = 0x1E;
+	return 0;
+}
+
+Result svcCreateAddressArbiter(Handle *arbiter)
+{
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_NewObject(SIM_OBJ_ARBITER);
+	Result res = Sim_CreateHandle(arbiter, obj);
+
+	if (R_FAILED(res))
+		free(obj);
+
+	Sim_Unlock();
+	return res;
+}
+
+Result svcArbitrateAddressNoTimeout(Handle arbiter, uintptr_t addr, ArbitrationType type, s32 value)
+{
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_GetObject(arbiter);
+
+	if (!obj || obj->type != SIM_OBJ_ARBITER) {
+		Sim_Unlock();
+		return SIM_INVALID_HANDLE;
+	}
+
+	switch (type)
+	{
+	case ARBITRATION_SIGNAL:
+		for (Sim_ArbiterWaiter **w = &sim_waiters; *w && value != 0;) {
+			if ((*w)->addr == addr) {
+				(*w)->woken = true;
+				*w = (*w)->next;
+				value--;
+			} else
+				w = &(*w)->next;
+		}
+
+		pthread_cond_broadcast(&sim_cond);
+		break;
+	case ARBITRATION_WAIT_IF_LESS_THAN:
+	case ARBITRATION_DECREMENT_AND_WAIT_IF_LESS_THAN:
+	case ARBITRATION_WAIT_IF_LESS_THAN_TIMEOUT:
+	case ARBITRATION_DECREMENT_AND_WAIT_IF_LESS_THAN_TIMEOUT:
+		{
+			s32 *word = (s32 *)addr;
+
+			if (__atomic_load_n(word, __ATOMIC_SEQ_CST) >= value)
+				break;
+
+			if (type == ARBITRATION_DECREMENT_AND_WAIT_IF_LESS_THAN ||
+				type == ARBITRATION_DECREMENT_AND_WAIT_IF_LESS_THAN_TIMEOUT)
+				__atomic_fetch_sub(word, 1, __ATOMIC_SEQ_CST);
+
+			Sim_ArbiterWaiter waiter = { .addr = addr }, **tail = &sim_waiters;
+
+			while (*tail)
+				tail = &(*tail)->next;
+			*tail = &waiter;
+
+			while (!waiter.woken)
+				Sim_WaitUntil(NULL);
+		}
+		break;
+	}
+
+	Sim_Unlock();
+	return 0;
+}
+
+Result svcCreateEvent(Handle *event, ResetType reset_type)
+{
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_NewObject(SIM_OBJ_EVENT);
+	obj->event.reset_type = reset_type;
+
+	Result res = Sim_CreateHandle(event, obj);
+
+	if (R_FAILED(res))
+		free(obj);
+
+	Sim_Unlock();
+	return res;
+}
+
+static Result Sim_SetEvent(Handle handle, bool signaled)
+{
+	Sim_Object *obj = Sim_GetObject(handle);
+
+	if (!obj || obj->type != SIM_OBJ_EVENT)
+		return SIM_INVALID_HANDLE;
+
+	obj->event.signaled = signaled;
+
+	if (signaled)
+		pthread_cond_broadcast(&sim_cond);
+
+	return 0;
+}
+
+Result svcSignalEvent(Handle handle)
+{
+	Sim_Lock();
+	Result res = Sim_SetEvent(handle, true);
+	Sim_Unlock();
+	return res;
+}
+
+Result svcClearEvent(Handle handle)
+{
+	Sim_Lock();
+	Result res = Sim_SetEvent(handle, false);
+	Sim_Unlock();
+	return res;
+}
+
+s64 svcGetSystemTick(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (s64)((u64)ts.tv_sec * SIM_TICKS_PER_SECOND + (u64)ts.tv_nsec * SIM_TICKS_PER_SECOND / 1000000000);
+}
+
+Result svcOutputDebugString(char *str, s32 length)
+{
+	fprintf(stderr, "%.*s\n", (int)length, str);
+	return 0;
+}
+
+Result svcBindInterrupt(u32 interrupt, Handle target, s32 priority, bool isManualClear)
+{
+	(void)priority;
+	(void)isManualClear;
+
+	if (interrupt >= SIM_MAX_INTERRUPTS)
+		return SIM_INVALID_HANDLE;
+
+	Sim_Lock();
+	sim_interrupts[interrupt] = target;
+	Sim_Unlock();
+	return 0;
+}
+
+Result svcUnbindInterrupt(u32 interrupt, Handle target)
+{
+	(void)target;
+
+	if (interrupt >= SIM_MAX_INTERRUPTS)
+		return SIM_INVALID_HANDLE;
+
+	Sim_Lock();
+	sim_interrupts[interrupt] = 0;
+	Sim_Unlock();
+	return 0;
+}
+
+// simulator
+
+void Sim_RaiseInterrupt(u32 interrupt)
+{
+	if (interrupt >= SIM_MAX_INTERRUPTS)
+		return;
+
+	Sim_Lock();
+
+	if (sim_interrupts[interrupt])
+		Sim_SetEvent(sim_interrupts[interrupt], true);
+
+	Sim_Unlock();
+}
+
+bool Sim_IsInterruptBound(u32 interrupt)
+{
+	if (interrupt >= SIM_MAX_INTERRUPTS)
+		return false;
+
+	Sim_Lock();
+	bool res = sim_interrupts[interrupt] != 0;
+	Sim_Unlock();
+	return res;
+}
+
+static Sim_Object *Sim_FindPort(const char *name, u32 name_len)
+{
+	for (s32 i = 0; i < SIM_MAX_HANDLES; i++) {
+		Sim_Object *obj = sim_handles[i];
+
+		if (obj && obj->type == SIM_OBJ_PORT && strlen(obj->port.name) == name_len &&
+			memcmp(obj->port.name, name, name_len) == 0)
+			return obj;
+	}
+
+	return NULL;
+}
+
+Result Sim_CreatePort(Handle *port, const char *name, u32 name_len, u32 max_sessions)
+{
+	(void)max_sessions;
+
+	if (name_len >= sizeof(((Sim_Object *)0)->port.name))
+		return SIM_PORT_NOT_FOUND;
+
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_NewObject(SIM_OBJ_PORT);
+	memcpy(obj->port.name, name, name_len);
+
+	Result res = Sim_CreateHandle(port, obj);
+
+	if (R_FAILED(res))
+		free(obj);
+
+	pthread_cond_broadcast(&sim_cond);
+	Sim_Unlock();
+	return res;
+}
+
+Result Sim_DestroyPort(const char *name, u32 name_len)
+{
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_FindPort(name, name_len);
+
+	if (obj)
+		obj->port.name[0] = '\0';
+
+	Sim_Unlock();
+	return obj ? 0 : SIM_PORT_NOT_FOUND;
+}
+
+Result Sim_GetAcceptStats(const char *name, Sim_AcceptStats *stats, bool reset)
+{
+	Sim_Lock();
+
+	Sim_Object *obj = Sim_FindPort(name, strlen(name));
+
+	if (obj) {
+		*stats = obj->port.accept_stats;
+
+		if (reset)
+			memset(&obj->port.accept_stats, 0, sizeof(obj->port.accept_stats));
+	}
+
+	Sim_Unlock();
+	return obj ? 0 : SIM_PORT_NOT_FOUND;
+}
+
+bool Sim_IsPortRegistered(const char *name)
+{
+	Sim_Lock();
+	bool res = Sim_FindPort(name, strlen(name)) != NULL;
+	Sim_Unlock();
+	return res;
+}
+
+Result Sim_ConnectToPort(Handle *session, const char *name, u32 name_len)
+{
+	Sim_Lock();
+
+	Sim_Object *port = Sim_FindPort(name, name_len);
+
+	if (!port) {
+		Sim_Unlock();
+		return SIM_PORT_NOT_FOUND;
+	}
+
+	Sim_Session *shared = calloc(1, sizeof(Sim_Session));
+	Sim_Object *client = Sim_NewObject(SIM_OBJ_CLIENT_SESSION);
+
+	if (!shared)
+		abort();
+
+	client->session = shared;
+	shared->refcount = 2; // client handle + server side (taken over on accept)
+	shared->connected_ns = Sim_NowNs();
+
+	Result res = Sim_CreateHandle(session, client);
+
+	if (R_FAILED(res)) {
+		free(shared);
+		free(client);
+	} else {
+		if (port->port.pending_tail)
+			port->port.pending_tail->next_pending = shared;
+		else
+			port->port.pending_head = shared;
+		port->port.pending_tail = shared;
+
+		pthread_cond_broadcast(&sim_cond);
+	}
+
+	Sim_Unlock();
+	return res;
+}
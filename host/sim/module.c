@@ -0,0 +1,45 @@
+#include <sim/sim.h>
+
+#include <3ds/srv.h>
+#include <3ds/err.h>
+#include <i2c/i2c.h>
+
+#include <sched.h>
+
+void I2C_Main();
+
+static Handle sim_main_thread;
+
+static const char *const sim_service_names[I2C_SERVICE_MAX] = {
+	"i2c::MCU", "i2c::CAM", "i2c::LCD", "i2c::DEB", "i2c::HID", "i2c::IR", "i2c::EEP",
+#ifdef N3DS
+	"i2c::NFC", "i2c::QTM",
+#endif
+};
+
+static void Sim_MainThread(void *arg)
+{
+	(void)arg;
+	I2C_Main();
+}
+
+void Sim_Boot(void)
+{
+	T(svcCreateThread(&sim_main_thread, Sim_MainThread, NULL, NULL, 0x18, -2));
+
+	for (int i = 0; i < I2C_SERVICE_MAX; i++)
+		while (!Sim_IsPortRegistered(sim_service_names[i]))
+			sched_yield();
+
+	for (int i = 0; i < SIM_BUS_COUNT; i++)
+		while (!Sim_IsInterruptBound(Sim_BusInterrupts[i]))
+			sched_yield();
+}
+
+void Sim_Shutdown(void)
+{
+	T(SRV_PublishToSubscriber(0x100, 0));
+	T(svcWaitSynchronization(sim_main_thread, -1));
+	T(svcCloseHandle(sim_main_thread));
+	sim_main_thread = 0;
+}
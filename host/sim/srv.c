@@ -0,0 +1,104 @@
+#include <3ds/srv.h>
+#include <sim/kernel.h>
+
+#include <pthread.h>
+
+#define SIM_MAX_NOTIFICATIONS 16
+
+u32 srv_refcount;
+Handle srv_session;
+
+static pthread_mutex_t sim_srv_lock = PTHREAD_MUTEX_INITIALIZER;
+static Handle sim_srv_semaphore;
+static u32 sim_srv_notifications[SIM_MAX_NOTIFICATIONS];
+static u32 sim_srv_notification_count;
+
+Result srvInit()
+{
+	srv_refcount++;
+	return 0;
+}
+
+void srvExit()
+{
+	srv_refcount--;
+}
+
+Result SRV_RegisterClient()
+{
+	return 0;
+}
+
+Result SRV_EnableNotification(Handle *sempahore)
+{
+	Result res = svcCreateEvent(sempahore, RESET_ONESHOT);
+
+	if (R_SUCCEEDED(res))
+		sim_srv_semaphore = *sempahore;
+
+	return res;
+}
+
+Result SRV_RegisterService(Handle *service, const char *service_name, u32 service_name_len, u32 max_sessions)
+{
+	return Sim_CreatePort(service, service_name, service_name_len, max_sessions);
+}
+
+Result SRV_UnregisterService(const char *service_name, u32 service_name_length)
+{
+	return Sim_DestroyPort(service_name, service_name_length);
+}
+
+Result SRV_GetServiceHandle(Handle *service, const char *service_name, u32 service_name_length, u32 flags)
+{
+	(void)flags;
+	return Sim_ConnectToPort(service, service_name, service_name_length);
+}
+
+Result SRV_RegisterPort(const char *port_name, u32 port_name_length, Handle client_port)
+{
+	(void)port_name;
+	(void)port_name_length;
+	(void)client_port;
+	return 0;
+}
+
+Result SRV_UnregisterPort(const char *port_name, u32 port_name_length)
+{
+	(void)port_name;
+	(void)port_name_length;
+	return 0;
+}
+
+Result SRV_ReceiveNotification(u32 *notification_id)
+{
+	pthread_mutex_lock(&sim_srv_lock);
+
+	*notification_id = 0;
+
+	if (sim_srv_notification_count) {
+		*notification_id = sim_srv_notifications[0];
+
+		for (u32 i = 1; i < sim_srv_notification_count; i++)
+			sim_srv_notifications[i - 1] = sim_srv_notifications[i];
+
+		sim_srv_notification_count--;
+	}
+
+	pthread_mutex_unlock(&sim_srv_lock);
+	return 0;
+}
+
+Result SRV_PublishToSubscriber(u32 notification_id, u32 flags)
+{
+	(void)flags;
+
+	pthread_mutex_lock(&sim_srv_lock);
+
+	if (sim_srv_notification_count < SIM_MAX_NOTIFICATIONS)
+		sim_srv_notifications[sim_srv_notification_count++] = notification_id;
+
+	pthread_mutex_unlock(&sim_srv_lock);
+
+	return sim_srv_semaphore ? svcSignalEvent(sim_srv_semaphore) : 0;
+}
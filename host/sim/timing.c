@@ -0,0 +1,233 @@
+#include <sim/timing.h>
+#include <sim/bus.h>
+
+#include <i2c/i2c.h>
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/*
+	Calibration: a 67.03MHz controller clock divided by 8, with 8 fixed ticks on each
+	SCL half, gives ~364kHz at the I2C_Initialize setting (low 0, high 5).
+*/
+const Sim_TimingConfig Sim_DefaultTiming = {
+	.base_clock_hz        = 67027964 / 8,
+	.scl_low_base         = 9,
+	.scl_high_base        = 9,
+	.irq_latency_ns       = 2000,
+	.spinwait_ns_per_iter = 8, // ~2 cycles at 268MHz per count
+	.realtime_scale       = 0,
+};
+
+static pthread_mutex_t sim_timing_lock = PTHREAD_MUTEX_INITIALIZER;
+static Sim_TimingConfig sim_timing_config = Sim_DefaultTiming;
+static Sim_Timing sim_bus_timing[SIM_BUS_COUNT];
+static bool sim_bus_open[SIM_BUS_COUNT];
+static Sim_Timing sim_cmd_timing[SIM_TIMING_MAX_CMD];
+
+static _Thread_local Sim_Timing sim_cmd_current;
+static _Thread_local u16 sim_cmd_id;
+static _Thread_local bool sim_cmd_active;
+static _Thread_local u8 sim_last_port;
+
+void Sim_Timing_Configure(const Sim_TimingConfig *config)
+{
+	pthread_mutex_lock(&sim_timing_lock);
+	sim_timing_config = *config;
+	pthread_mutex_unlock(&sim_timing_lock);
+}
+
+void Sim_Timing_Reset(void)
+{
+	pthread_mutex_lock(&sim_timing_lock);
+	memset(sim_bus_timing, 0, sizeof(sim_bus_timing));
+	memset(sim_cmd_timing, 0, sizeof(sim_cmd_timing));
+	pthread_mutex_unlock(&sim_timing_lock);
+}
+
+void Sim_Timing_GetBus(u8 port, Sim_Timing *out)
+{
+	pthread_mutex_lock(&sim_timing_lock);
+	*out = sim_bus_timing[port];
+	pthread_mutex_unlock(&sim_timing_lock);
+}
+
+void Sim_Timing_GetCommand(u16 cmd_id, Sim_Timing *out)
+{
+	pthread_mutex_lock(&sim_timing_lock);
+	*out = sim_cmd_timing[cmd_id % SIM_TIMING_MAX_CMD];
+	pthread_mutex_unlock(&sim_timing_lock);
+}
+
+static u64 Sim_Timing_SclPeriodNsLocked(u16 scl)
+{
+	u64 ticks = (u64)(scl & 0x3F) + sim_timing_config.scl_low_base +
+				(u64)((scl >> 8) & 0x1F) + sim_timing_config.scl_high_base;
+
+	return ticks * 1000000000ULL / sim_timing_config.base_clock_hz;
+}
+
+u64 Sim_Timing_SclPeriodNs(u16 scl)
+{
+	pthread_mutex_lock(&sim_timing_lock);
+	u64 ns = Sim_Timing_SclPeriodNsLocked(scl);
+	pthread_mutex_unlock(&sim_timing_lock);
+	return ns;
+}
+
+u64 Sim_Timing_TotalNs(const Sim_Timing *t)
+{
+	return t->wire_ns + t->gap_ns + t->sleep_ns + t->stretch_ns;
+}
+
+static void Sim_Timing_Add(Sim_Timing *dst, const Sim_Timing *src)
+{
+	dst->starts        += src->starts;
+	dst->bytes_written += src->bytes_written;
+	dst->bytes_read    += src->bytes_read;
+	dst->nacks         += src->nacks;
+	dst->stops         += src->stops;
+	dst->cancels       += src->cancels;
+	dst->scl_cycles    += src->scl_cycles;
+	dst->wire_ns       += src->wire_ns;
+	dst->gap_ns        += src->gap_ns;
+	dst->sleep_ns      += src->sleep_ns;
+	dst->stretch_ns    += src->stretch_ns;
+}
+
+static void Sim_Timing_Elapse(u64 ns)
+{
+	double scale = sim_timing_config.realtime_scale;
+
+	if (scale <= 0 || !ns)
+		return;
+
+	struct timespec now, end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	u64 target = (u64)end.tv_sec * 1000000000ULL + (u64)end.tv_nsec + (u64)(ns * scale);
+
+	do
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	while ((u64)now.tv_sec * 1000000000ULL + (u64)now.tv_nsec < target);
+}
+
+void Sim_Timing_Phase(u8 port, u16 scl, Sim_BusPhase phase, bool ack)
+{
+	Sim_Timing delta = { 0 };
+
+	switch (phase)
+	{
+	case SIM_PHASE_START: // start condition + address byte + ACK
+		delta.starts = 1;
+		delta.bytes_written = 1;
+		delta.scl_cycles = 1 + 9;
+		break;
+	case SIM_PHASE_WRITE:
+		delta.bytes_written = 1;
+		delta.scl_cycles = 9;
+		break;
+	case SIM_PHASE_READ:
+		delta.bytes_read = 1;
+		delta.scl_cycles = 9;
+		break;
+	case SIM_PHASE_STOP:
+		delta.stops = 1;
+		delta.scl_cycles = 1;
+		break;
+	case SIM_PHASE_CANCEL:
+		delta.cancels = 1;
+		delta.scl_cycles = 1;
+		break;
+	}
+
+	if (!ack && (phase == SIM_PHASE_START || phase == SIM_PHASE_WRITE))
+		delta.nacks = 1;
+
+	pthread_mutex_lock(&sim_timing_lock);
+
+	delta.wire_ns = delta.scl_cycles * Sim_Timing_SclPeriodNsLocked(scl);
+	if (phase != SIM_PHASE_STOP) // the stop rides on the phase that requested it
+		delta.gap_ns = sim_timing_config.irq_latency_ns;
+
+	if (phase == SIM_PHASE_START && !sim_bus_open[port]) {
+		sim_bus_open[port] = true;
+		sim_bus_timing[port].count++;
+	} else if (phase == SIM_PHASE_STOP || phase == SIM_PHASE_CANCEL)
+		sim_bus_open[port] = false;
+
+	Sim_Timing_Add(&sim_bus_timing[port], &delta);
+
+	pthread_mutex_unlock(&sim_timing_lock);
+
+	if (sim_cmd_active)
+		Sim_Timing_Add(&sim_cmd_current, &delta);
+
+	sim_last_port = port;
+
+	Sim_Timing_Elapse(delta.wire_ns + delta.gap_ns);
+}
+
+void Sim_Timing_Spinwait(u32 n)
+{
+	Sim_Timing delta = { 0 };
+
+	pthread_mutex_lock(&sim_timing_lock);
+	delta.gap_ns = (u64)(n / 2) * sim_timing_config.spinwait_ns_per_iter;
+	Sim_Timing_Add(&sim_bus_timing[sim_last_port], &delta);
+	pthread_mutex_unlock(&sim_timing_lock);
+
+	if (sim_cmd_active)
+		Sim_Timing_Add(&sim_cmd_current, &delta);
+
+	Sim_Timing_Elapse(delta.gap_ns);
+}
+
+void Sim_Timing_Sleep(u64 nanoseconds)
+{
+	if (!sim_cmd_active)
+		return;
+
+	Sim_Timing delta = { .sleep_ns = nanoseconds };
+
+	pthread_mutex_lock(&sim_timing_lock);
+	Sim_Timing_Add(&sim_bus_timing[sim_last_port], &delta);
+	pthread_mutex_unlock(&sim_timing_lock);
+
+	Sim_Timing_Add(&sim_cmd_current, &delta);
+}
+
+void Sim_Timing_Stretch(u8 port, u64 nanoseconds)
+{
+	Sim_Timing delta = { .stretch_ns = nanoseconds };
+
+	pthread_mutex_lock(&sim_timing_lock);
+	Sim_Timing_Add(&sim_bus_timing[port], &delta);
+	pthread_mutex_unlock(&sim_timing_lock);
+
+	if (sim_cmd_active)
+		Sim_Timing_Add(&sim_cmd_current, &delta);
+
+	Sim_Timing_Elapse(nanoseconds);
+}
+
+void Sim_Timing_BeginCommand(u32 header)
+{
+	memset(&sim_cmd_current, 0, sizeof(sim_cmd_current));
+	sim_cmd_id = (header >> 16) % SIM_TIMING_MAX_CMD;
+	sim_cmd_active = true;
+}
+
+void Sim_Timing_EndCommand(void)
+{
+	if (!sim_cmd_active)
+		return;
+
+	pthread_mutex_lock(&sim_timing_lock);
+	sim_cmd_timing[sim_cmd_id].count++;
+	Sim_Timing_Add(&sim_cmd_timing[sim_cmd_id], &sim_cmd_current);
+	pthread_mutex_unlock(&sim_timing_lock);
+
+	sim_cmd_active = false;
+}
@@ -0,0 +1,241 @@
+/*
+	False sharing between buses and between sessions: the per-bus state (I2C_Bus,
+	globals.h) and the session data (I2C_SessionData, ipc.h) against the packed layouts
+	they replaced, where the three bus locks shared a line with each other and a session's
+	output buffer ended on the line its neighbour's hot fields start on.
+
+	buses:    one thread per bus takes its own bus lock (RecursiveLock_LockSpin), reads
+	          the register block and timeout flag and bumps the SCL field, -n times.
+	sessions: one thread per session reads its type and device mask and writes the end
+	          of its output static buffer, as a worker does on every command, -n times.
+
+	No two threads ever touch the same field, so any slowdown of the packed layouts is the
+	cache line moving between cores. Each thread is pinned to its own CPU when there are
+	enough of them; with fewer CPUs than threads there is nothing to share a line with and
+	both layouts run alike.
+
+	usage: i2c_busline [-n iterations per thread] [-r repeats]
+*/
+
+#define _GNU_SOURCE
+
+#include <sim/sim.h>
+
+#include <3ds/synchronization.h>
+#include <i2c/globals.h>
+#include <i2c/ipc.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define THREADS 3
+
+// the per-bus arrays before I2C_Bus
+typedef struct PackedBuses {
+	RecursiveLock locks[3];
+	LightLockSpin spins[3];
+	Handle interrupts[3];
+	u16 scl[3];
+	s64 timeout_ns[3];
+	bool timed_out[3];
+	Handle lock_waiters[3];
+} PackedBuses;
+
+// the session data before the split, same fields in the old order and no alignment
+typedef struct PackedSession {
+	Handle thread;
+	Handle wake;
+	Handle pending;
+	Handle session;
+	bool shutdown;
+	I2C_SessionType session_type;
+	u32 device_mask;
+	Handle async_event;
+	u32 async_next_ticket;
+	u32 async_requests;
+	bool posted_writes;
+	u32 posted_pending;
+	Result posted_error;
+	u32 posted_failures;
+	LightEvent posted_drained;
+	I2C_Snapshot snapshot;
+	u8 input_staticbuf[I2C_INPUT_STATICBUF_SIZE];
+	u8 output_staticbuf[I2C_OUTPUT_STATICBUF_SIZE];
+} PackedSession;
+
+static PackedBuses packed_buses;
+static I2C_Bus aligned_buses[3];
+static PackedSession packed_sessions[THREADS];
+static I2C_SessionData aligned_sessions[THREADS];
+
+static u32 iterations = 2000000;
+static u32 repeats = 3;
+static long cpus;
+static atomic_bool start;
+static atomic_uint sink;
+
+typedef struct Test {
+	const char *name;
+	void (*loop)(u32 index);
+} Test;
+
+static void packed_bus_loop(u32 i)
+{
+	volatile u32 seen = 0;
+
+	for (u32 n = 0; n < iterations; n++) {
+		RecursiveLock_LockSpin(&packed_buses.locks[i], &packed_buses.spins[i]);
+		seen += *(volatile bool *)&packed_buses.timed_out[i] + (u32)*(volatile Handle *)&packed_buses.interrupts[i];
+		(*(volatile u16 *)&packed_buses.scl[i])++;
+		RecursiveLock_Unlock(&packed_buses.locks[i]);
+	}
+
+	atomic_fetch_add(&sink, seen);
+}
+
+static void aligned_bus_loop(u32 i)
+{
+	volatile u32 seen = 0;
+	I2C_Bus *bus = &aligned_buses[i];
+
+	for (u32 n = 0; n < iterations; n++) {
+		RecursiveLock_LockSpin(&bus->lock, &bus->spin);
+		seen += *(volatile bool *)&bus->timed_out + (u32)*(volatile Handle *)&bus->interrupt;
+		(*(volatile u16 *)&bus->scl)++;
+		RecursiveLock_Unlock(&bus->lock);
+	}
+
+	atomic_fetch_add(&sink, seen);
+}
+
+#define SESSION_LOOP(name, sessions) \
+	static void name(u32 i) \
+	{ \
+		volatile u32 seen = 0; \
+		for (u32 n = 0; n < iterations; n++) { \
+			seen += *(volatile u32 *)&sessions[i].device_mask + *(volatile I2C_SessionType *)&sessions[i].session_type; \
+			*(volatile u32 *)&sessions[i].output_staticbuf[I2C_OUTPUT_STATICBUF_SIZE - 4] = n; \
+		} \
+		atomic_fetch_add(&sink, seen); \
+	}
+
+SESSION_LOOP(packed_session_loop, packed_sessions)
+SESSION_LOOP(aligned_session_loop, aligned_sessions)
+
+static const Test tests[] = {
+	{ "buses, packed",     packed_bus_loop },
+	{ "buses, I2C_Bus",    aligned_bus_loop },
+	{ "sessions, packed",  packed_session_loop },
+	{ "sessions, split",   aligned_session_loop },
+};
+
+static const Test *test;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *thread_main(void *arg)
+{
+	u32 index = (u32)(uintptr_t)arg;
+
+	if (cpus >= THREADS) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(index, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+
+	while (!atomic_load(&start))
+		sched_yield();
+
+	test->loop(index);
+	return NULL;
+}
+
+// ns per iteration of one thread
+static double run(const Test *t)
+{
+	pthread_t threads[THREADS];
+
+	test = t;
+	atomic_store(&start, false);
+
+	for (u32 i = 0; i < 3; i++) {
+		RecursiveLock_Init(&packed_buses.locks[i]);
+		RecursiveLock_Init(&aligned_buses[i].lock);
+	}
+
+	for (u32 i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, thread_main, (void *)(uintptr_t)i);
+
+	u64 t0 = now_ns();
+	atomic_store(&start, true);
+
+	for (u32 i = 0; i < THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	return (double)(now_ns() - t0) / iterations;
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			repeats = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations per thread] [-r repeats]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!iterations || !repeats) {
+		fprintf(stderr, "iterations and repeats must be > 0\n");
+		return 2;
+	}
+
+	if (R_FAILED(syncInit()))
+		return 1;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	printf("%u threads, %u iterations each, best of %u, %ld cpu(s)%s, %u byte lines\n", THREADS, iterations, repeats, cpus,
+		cpus >= THREADS ? " (pinned)" : "", I2C_CPU_CACHE_LINE);
+	printf("bus state %zu bytes (%zu packed), session %zu bytes (%zu packed) with its buffers at %zu\n\n",
+		sizeof(I2C_Bus), sizeof(PackedBuses) / 3, sizeof(I2C_SessionData), sizeof(PackedSession),
+		offsetof(I2C_SessionData, snapshot));
+	printf("%-18s %12s\n", "", "ns/iteration");
+
+	for (u32 t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+		double best = 0;
+
+		for (u32 r = 0; r < repeats; r++) {
+			double ns = run(&tests[t]);
+
+			if (!r || ns < best)
+				best = ns;
+		}
+
+		printf("%-18s %12.2f\n", tests[t].name, best);
+	}
+
+	return 0;
+}
@@ -0,0 +1,177 @@
+/*
+	Dispatch cost per command: the command table (I2C_DispatchIPC) against the switch
+	it replaced (i2c_dispatch_switch.h), both called directly on this thread with a
+	request whose device the session may not access, so every command is decoded,
+	validated, permission checked and answered without touching a bus. Also times a
+	request with a bad header and one with an unknown command id.
+
+	Pointer words go through the simulator's translation table (a mutex per lookup) for
+	both dispatchers; on hardware they are free, so absolute numbers here are high.
+
+	usage: i2c_dispatch [-n iterations] [-r repeats]
+*/
+
+#include <sim/sim.h>
+
+#include <3ds/ipc.h>
+#include <3ds/err.h>
+
+#include <i2c/globals.h>
+#include <i2c/stats.h>
+#include <i2c/trace.h>
+#include <i2c/i2c.h>
+#include <i2c/ipc.h>
+
+#include "i2c_dispatch_switch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DENIED_DEVID 7 // not accessible from i2c::MCU
+
+typedef struct Case {
+	const char *name;
+	u32 request[8];
+	u32 words;
+} Case;
+
+static u8 payload[0x20];
+static u8 devids[2] = { DENIED_DEVID, DENIED_DEVID };
+static I2C_SessionData session = { .session_type = I2C_SESSION_TYPE_MCU };
+
+static u32 iterations = 1000000;
+static u32 repeats = 5;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define CASE(name, ...) { name, { __VA_ARGS__ }, sizeof((u32[]){ __VA_ARGS__ }) / sizeof(u32) }
+
+static u32 build_cases(Case *cases)
+{
+	u32 p = IPC_PointerToWord(payload), d = IPC_PointerToWord(devids);
+	const Case list[] = {
+		CASE("0001 replace bits8",   IPC_MakeHeader(0x0001, 4, 0), DENIED_DEVID, 0x10, 1, 1),
+		CASE("0002 set bits8",       IPC_MakeHeader(0x0002, 3, 0), DENIED_DEVID, 0x10, 1),
+		CASE("0003 clear bits8",     IPC_MakeHeader(0x0003, 3, 0), DENIED_DEVID, 0x10, 1),
+		CASE("0004 replace16 multi", IPC_MakeHeader(0x0004, 4, 2), 0x10, 1, 1, 2, IPC_Desc_StaticBuffer(2, 0), d),
+		CASE("0005 write reg8",      IPC_MakeHeader(0x0005, 3, 0), DENIED_DEVID, 0x10, 1),
+		CASE("0006 write dev8",      IPC_MakeHeader(0x0006, 2, 0), DENIED_DEVID, 1),
+		CASE("0007 write reg16",     IPC_MakeHeader(0x0007, 3, 0), DENIED_DEVID, 0x10, 1),
+		CASE("0008 write16 multi",   IPC_MakeHeader(0x0008, 3, 2), 0x10, 1, 2, IPC_Desc_StaticBuffer(2, 0), d),
+		CASE("0009 read reg8",       IPC_MakeHeader(0x0009, 2, 0), DENIED_DEVID, 0x10),
+		CASE("000A read reg16",      IPC_MakeHeader(0x000A, 2, 0), DENIED_DEVID, 0x10),
+		CASE("000B write regs8",     IPC_MakeHeader(0x000B, 3, 2), DENIED_DEVID, 0x10, 8, IPC_Desc_StaticBuffer(8, 1), p),
+		CASE("000C write regs16",    IPC_MakeHeader(0x000C, 3, 2), DENIED_DEVID, 0x10, 4, IPC_Desc_StaticBuffer(8, 1), p),
+		CASE("000D read regs8",      IPC_MakeHeader(0x000D, 3, 0), DENIED_DEVID, 0x10, 8),
+		CASE("000E write regs8",     IPC_MakeHeader(0x000E, 3, 2), DENIED_DEVID, 0x10, 8, IPC_Desc_StaticBuffer(8, 1), p),
+		CASE("000F read legacy",     IPC_MakeHeader(0x000F, 3, 0), DENIED_DEVID, 0x10, 8),
+		CASE("0010 read regs16",     IPC_MakeHeader(0x0010, 3, 0), DENIED_DEVID, 0x10, 4),
+		CASE("0011 write mapped",    IPC_MakeHeader(0x0011, 3, 2), DENIED_DEVID, 0x10, 8, IPC_Desc_Buffer(8, IPC_BUFFER_R), p),
+		CASE("0012 read mapped",     IPC_MakeHeader(0x0012, 3, 2), DENIED_DEVID, 0x10, 8, IPC_Desc_Buffer(8, IPC_BUFFER_W), p),
+		CASE("0013 read raw",        IPC_MakeHeader(0x0013, 1, 0), DENIED_DEVID),
+		CASE("0014 write raw multi", IPC_MakeHeader(0x0014, 2, 2), DENIED_DEVID, 8, IPC_Desc_StaticBuffer(8, 1), p),
+		CASE("0015 read raw multi",  IPC_MakeHeader(0x0015, 2, 0), DENIED_DEVID, 8),
+		CASE("bad header",           IPC_MakeHeader(0x0005, 2, 0), DENIED_DEVID, 0x10),
+		CASE("unknown id",           IPC_MakeHeader(0x0040, 1, 0), DENIED_DEVID),
+	};
+
+	memcpy(cases, list, sizeof(list));
+	return sizeof(list) / sizeof(list[0]);
+}
+
+static double time_dispatch(const Case *c, void (*dispatch)(I2C_SessionData *session))
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u64 best = ~0ULL;
+
+	for (u32 r = 0; r < repeats; r++) {
+		u64 start = now_ns();
+
+		for (u32 i = 0; i < iterations; i++) {
+			memcpy(cmdbuf, c->request, sizeof(c->request));
+			dispatch(&session);
+			__asm__ volatile("" ::: "memory");
+		}
+
+		u64 elapsed = now_ns() - start;
+
+		if (elapsed < best)
+			best = elapsed;
+	}
+
+	return (double)best / iterations;
+}
+
+static bool same_reply(const Case *c)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u32 a[4], b[4];
+
+	memcpy(cmdbuf, c->request, sizeof(c->request));
+	I2C_DispatchIPC_Switch(&session);
+	memcpy(a, cmdbuf, sizeof(a));
+
+	memcpy(cmdbuf, c->request, sizeof(c->request));
+	I2C_DispatchIPC(&session);
+	memcpy(b, cmdbuf, sizeof(b));
+
+	u32 words = ((a[0] >> 6) & 0x3F) + (a[0] & 0x3F) + 1;
+
+	return a[0] == b[0] && !memcmp(a, b, (words < 4 ? words : 4) * sizeof(u32));
+}
+
+int main(int argc, char **argv)
+{
+	Case cases[32];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			repeats = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-r repeats]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!iterations || !repeats) {
+		fprintf(stderr, "iterations and repeats must be > 0\n");
+		return 2;
+	}
+
+	session.device_mask = I2C_GetDeviceAccessMask(session.session_type);
+
+	u32 count = build_cases(cases);
+	double total_switch = 0, total_table = 0;
+
+	printf("%-22s %10s %10s %7s  %s\n", "command", "switch ns", "table ns", "ratio", "reply");
+
+	for (u32 i = 0; i < count; i++) {
+		double s = time_dispatch(&cases[i], I2C_DispatchIPC_Switch);
+		double t = time_dispatch(&cases[i], I2C_DispatchIPC);
+
+		total_switch += s;
+		total_table += t;
+
+		printf("%-22s %10.1f %10.1f %6.2fx  %s\n", cases[i].name, s, t, s / t,
+			same_reply(&cases[i]) ? "same" : "differs");
+	}
+
+	printf("%-22s %10.1f %10.1f %6.2fx\n", "mean", total_switch / count, total_table / count, total_switch / total_table);
+	return 0;
+}
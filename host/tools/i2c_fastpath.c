@@ -0,0 +1,244 @@
+/*
+	Cost per call of the fast paths (I2C_Fast*, i2c.c) against the generic functions, for
+	every (command, device) pair in the fast path lists. Both run the same transaction on
+	the same simulated device; the fast one has the port and address of the device as
+	constants instead of looking them up in devConf on every phase. Each pair is first
+	checked to read back the same data both ways.
+
+	The functions are called directly on this thread, not through IPC, so the simulated
+	bus (register accesses, interrupt events) is most of every call on the host, and the
+	ns columns are the best of five alternating runs of each path. -c adds
+	user space cycles and instructions per call through perf_event_open; on an ARM host
+	those are the numbers to compare.
+
+	usage: i2c_fastpath [-n iterations] [-c]
+*/
+
+#include <sim/sim.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+typedef enum Op {
+	OP_READ_REGISTER8,
+	OP_WRITE_REGISTER8,
+	OP_READ_REGISTERS8,
+} Op;
+
+static const struct {
+	Op op;
+	u8 devid;
+	u8 size;
+	const char *desc;
+} pairs[] = {
+	{ OP_READ_REGISTER8,  3,  1,    "0009 read reg 8, MCU" },
+	{ OP_WRITE_REGISTER8, 3,  1,    "0005 write reg 8, MCU" },
+	{ OP_READ_REGISTERS8, 3,  0x10, "000D read regs 8 (16B), MCU" },
+	{ OP_READ_REGISTER8,  10, 1,    "0009 read reg 8, gyro" },
+	{ OP_READ_REGISTERS8, 10, 6,    "000D read regs 8 (6B), gyro" },
+	{ OP_READ_REGISTER8,  11, 1,    "0009 read reg 8, gyro 2" },
+	{ OP_READ_REGISTERS8, 11, 6,    "000D read regs 8 (6B), gyro 2" },
+};
+
+#define REPEATS 5
+
+static u32 iterations = 20000;
+static int cycles_fd = -1, instructions_fd = -1;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int open_counter(u64 config)
+{
+	int fd = -1;
+#ifdef __linux__
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	(void)config;
+#endif
+	return fd;
+}
+
+static u64 read_counter(int fd)
+{
+	u64 value = 0;
+
+	if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+		return 0;
+
+	return value;
+}
+
+static bool call(Op op, bool fast, u8 devid, u8 *buf, u32 size)
+{
+	switch (op)
+	{
+	case OP_READ_REGISTER8:
+		return fast ? I2C_FastReadRegister8(devid, 0x20, buf) : I2C_ReadRegister8(devid, 0x20, buf);
+	case OP_WRITE_REGISTER8:
+		return fast ? I2C_FastWriteRegister8(devid, 0x20, buf[0]) : I2C_WriteRegister8(devid, 0x20, buf[0]);
+	case OP_READ_REGISTERS8:
+		return fast ? I2C_FastReadRegisters8(devid, 0x20, buf, size) : I2C_ReadRegisters8(devid, 0x20, buf, size);
+	}
+
+	return false;
+}
+
+typedef struct Sample {
+	double ns, cycles, instructions;
+} Sample;
+
+static bool measure(u32 index, bool fast, Sample *out)
+{
+	u8 buf[0x10] = { 0x5A };
+	bool ok = true;
+	u64 c0 = read_counter(cycles_fd), i0 = read_counter(instructions_fd), t0 = now_ns();
+
+	for (u32 n = 0; n < iterations; n++)
+		ok &= call(pairs[index].op, fast, pairs[index].devid, buf, pairs[index].size);
+
+	out->ns = (double)(now_ns() - t0) / iterations;
+	out->cycles = (double)(read_counter(cycles_fd) - c0) / iterations;
+	out->instructions = (double)(read_counter(instructions_fd) - i0) / iterations;
+	return ok;
+}
+
+// both paths read back what the other wrote
+static bool check(u32 index)
+{
+	u8 generic[0x10], fast[0x10], value = (u8)(0xA0 + index), inverse = (u8)~value;
+	u8 devid = pairs[index].devid, size = pairs[index].size;
+
+	if (pairs[index].op == OP_WRITE_REGISTER8)
+		return I2C_FastWriteRegister8(devid, 0x20, value) && I2C_ReadRegister8(devid, 0x20, generic) && generic[0] == value &&
+			I2C_WriteRegister8(devid, 0x20, inverse) && I2C_FastReadRegister8(devid, 0x20, fast) && fast[0] == inverse;
+
+	for (u8 i = 0; i < size; i++) {
+		if (!I2C_WriteRegister8(devid, 0x20 + i, (u8)(value + i)))
+			return false;
+	}
+
+	memset(generic, 0, sizeof(generic));
+	memset(fast, 0xFF, sizeof(fast));
+
+	return call(pairs[index].op, false, devid, generic, size) && call(pairs[index].op, true, devid, fast, size) &&
+		!memcmp(generic, fast, size) && generic[size - 1] == (u8)(value + size - 1);
+}
+
+static void print_sample(const Sample *s)
+{
+	if (cycles_fd >= 0)
+		printf(" %8.0f/%6.0f/%6.0f", s->ns, s->cycles, s->instructions);
+	else
+		printf(" %10.1f", s->ns);
+}
+
+int main(int argc, char **argv)
+{
+	bool want_cycles = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:c")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			want_cycles = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-c]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!iterations) {
+		fprintf(stderr, "iterations must be > 0\n");
+		return 2;
+	}
+
+	if (want_cycles) {
+		cycles_fd = open_counter(PERF_COUNT_HW_CPU_CYCLES);
+		instructions_fd = open_counter(PERF_COUNT_HW_INSTRUCTIONS);
+
+		if (cycles_fd < 0 || instructions_fd < 0) {
+			fprintf(stderr, "cycle counter unavailable, timing in ns only\n");
+			cycles_fd = instructions_fd = -1;
+		}
+	}
+
+	Sim_AttachDefaultDevices();
+	Sim_Boot();
+
+	int failures = 0;
+
+	printf("%u calls per path, %s per call\n\n", iterations, cycles_fd >= 0 ? "ns/cycles/instructions" : "ns");
+	int width = cycles_fd >= 0 ? 22 : 10;
+
+	printf("%-30s %*s %*s %8s\n", "", width, "generic", width, "fast", "speedup");
+
+	for (u32 i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+		Sample generic, fast;
+
+		printf("%-30s", pairs[i].desc);
+
+		if (!check(i)) {
+			printf(" %*s\n", width, "WRONG");
+			failures++;
+			continue;
+		}
+
+		// best of REPEATS, alternating the two paths so drift in the host hits both alike
+		bool ok = measure(i, false, &generic) & measure(i, true, &fast);
+
+		for (u32 r = 1; r < REPEATS; r++) {
+			Sample again;
+
+			ok &= measure(i, false, &again);
+
+			if (again.ns < generic.ns)
+				generic = again;
+
+			ok &= measure(i, true, &again);
+
+			if (again.ns < fast.ns)
+				fast = again;
+		}
+
+		if (!ok)
+			failures++;
+
+		print_sample(&generic);
+		print_sample(&fast);
+		printf(" %7.2fx%s\n", cycles_fd >= 0 ? generic.cycles / fast.cycles : generic.ns / fast.ns, ok ? "" : " FAILED");
+	}
+
+	Sim_Shutdown();
+
+	printf("\n%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
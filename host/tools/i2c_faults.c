@@ -0,0 +1,221 @@
+/*
+	Measures what a misbehaving device costs the other users of its bus, including one
+	that hangs the bus (SDA held low, lost interrupts) until the module recovers it. For
+	each fault profile the DEB device (devid 7, bus 1) is wrapped in a fault-injecting model, then
+	a client hammering it and a client using the healthy MCU device (devid 3, same bus)
+	run concurrently with the bus in modeled real time. Throughput, p50/p99/max latency
+	and failed commands are reported for both clients, next to what the fault model
+	injected.
+
+	usage: i2c_faults [-n iterations] [-r realtime_scale] [-p profile]
+*/
+
+#include <sim/sim.h>
+
+#include <i2c/i2c.h>
+#include <3ds/err.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FLAKY_DEVID  7
+#define VICTIM_DEVID 3
+#define FLAKY_PORT   1
+
+typedef struct Profile {
+	const char *name;
+	Sim_FaultConfig config;
+} Profile;
+
+static const Profile profiles[] = {
+	{ "none",       { .seed = 1 } },
+	{ "nack-addr",  { .nack_addr_ppm = 200000, .seed = 1 } },
+	{ "nack-reg",   { .nack_reg_ppm = 200000, .seed = 1 } },
+	{ "nack-data",  { .nack_data_ppm = 200000, .seed = 1 } },
+	{ "stretch",    { .stretch_ns = 50000, .seed = 1 } },
+	{ "stuck-busy", { .busy_ppm = 20000, .busy_us = 2000, .seed = 1 } },
+	{ "missing",    { .missing = true, .seed = 1 } },
+	{ "hold-sda",   { .hold_sda_ppm = 5000, .seed = 1 } },
+	{ "lost-irq",   { .lost_irq_ppm = 5000, .seed = 1 } },
+};
+
+#define PROFILE_COUNT (sizeof(profiles) / sizeof(profiles[0]))
+
+typedef struct Client {
+	const char *service;
+	u32 (*run)(Handle s, u32 n); // returns the number of failed commands
+	u64 *latencies_ns;
+	u32 ops;
+	u32 failures;
+	u64 elapsed_ns;
+} Client;
+
+static u32 iterations = 500;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static u32 run_flaky(Handle s, u32 n)
+{
+	u8 buf[4];
+
+	switch (n % 3)
+	{
+	case 0:
+		return R_FAILED(SimI2C_WriteRegister8(s, FLAKY_DEVID, 0x10, (u8)n));
+	case 1:
+		return R_FAILED(SimI2C_ReadRegister8(s, FLAKY_DEVID, 0x10, buf));
+	default:
+		return R_FAILED(SimI2C_ReadRegisters8Legacy(s, FLAKY_DEVID, 0x0F, buf, sizeof(buf)));
+	}
+}
+
+static u32 run_victim(Handle s, u32 n)
+{
+	u8 value;
+
+	if (n & 1)
+		return R_FAILED(SimI2C_ReadRegister8(s, VICTIM_DEVID, 0x20, &value));
+
+	return R_FAILED(SimI2C_WriteRegister8(s, VICTIM_DEVID, 0x20, (u8)n));
+}
+
+static void *client_main(void *arg)
+{
+	Client *c = (Client *)arg;
+	Handle s;
+
+	T(SimI2C_Connect(&s, c->service));
+
+	u64 start = now_ns();
+
+	for (u32 n = 0; n < iterations; n++) {
+		u64 t = now_ns();
+
+		c->failures += c->run(s, n);
+		c->latencies_ns[n] = now_ns() - t;
+		c->ops++;
+	}
+
+	c->elapsed_ns = now_ns() - start;
+
+	svcCloseHandle(s);
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void print_client(const char *profile, const char *role, Client *c)
+{
+	qsort(c->latencies_ns, c->ops, sizeof(u64), compare_u64);
+
+	u64 p50 = c->latencies_ns[c->ops / 2];
+	u64 p99 = c->latencies_ns[(u32)(c->ops * 0.99) < c->ops ? (u32)(c->ops * 0.99) : c->ops - 1];
+	u64 max = c->latencies_ns[c->ops - 1];
+
+	printf("%-11s %-7s %9.0f %10.1f %10.1f %10.1f %8u\n", profile, role,
+		c->ops * 1e9 / c->elapsed_ns, p50 / 1e3, p99 / 1e3, max / 1e3, c->failures);
+}
+
+static void run_profile(const Profile *p)
+{
+	static Sim_FaultDevice fault;
+	u64 flaky_latencies[iterations], victim_latencies[iterations];
+	Client flaky = { "i2c::DEB", run_flaky, flaky_latencies, 0, 0, 0 };
+	Client victim = { "i2c::MCU", run_victim, victim_latencies, 0, 0, 0 };
+	pthread_t threads[2];
+
+	Sim_FaultDevice_Wrap(&fault, Sim_GetDefaultDevice(FLAKY_DEVID), FLAKY_PORT, &p->config);
+
+	pthread_create(&threads[0], NULL, client_main, &flaky);
+	pthread_create(&threads[1], NULL, client_main, &victim);
+	pthread_join(threads[0], NULL);
+	pthread_join(threads[1], NULL);
+
+	Sim_FaultDevice_Unwrap(&fault);
+
+	print_client(p->name, "flaky", &flaky);
+	print_client(p->name, "victim", &victim);
+	printf("%-11s injected: %llu addr, %llu reg, %llu data NACKs; %llu busy periods (%llu NACKs); %llu stretched bytes\n",
+		"", (unsigned long long)fault.stats.nack_addr, (unsigned long long)fault.stats.nack_reg,
+		(unsigned long long)fault.stats.nack_data, (unsigned long long)fault.stats.busy_periods,
+		(unsigned long long)fault.stats.busy_nacks, (unsigned long long)fault.stats.stretched_bytes);
+	printf("%-11s injected: %llu SDA holds, %llu lost interrupts\n", "",
+		(unsigned long long)fault.stats.sda_holds, (unsigned long long)fault.stats.lost_irqs);
+
+#ifdef I2C_STATS
+	I2C_BusStats buses[3];
+	u32 count;
+	Handle s;
+
+	T(SimI2C_Connect(&s, "i2c::DEB"));
+	T(SimI2C_GetBusStats(s, buses, 3, I2C_BUS_STATS_DUMP_RESET, &count));
+	svcCloseHandle(s);
+
+	printf("%-11s bus %u: %u timeouts, %u recoveries (%u clock-outs, %u failed)\n", "", FLAKY_PORT,
+		buses[FLAKY_PORT].timeouts, buses[FLAKY_PORT].recoveries, buses[FLAKY_PORT].clock_outs,
+		buses[FLAKY_PORT].recovery_failures);
+#endif
+
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	Sim_TimingConfig config = Sim_DefaultTiming;
+	const char *only = NULL;
+	int opt;
+
+	config.realtime_scale = 1.0;
+
+	while ((opt = getopt(argc, argv, "n:r:p:")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			config.realtime_scale = strtod(optarg, NULL);
+			break;
+		case 'p':
+			only = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-r realtime_scale] [-p profile]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!iterations) {
+		fprintf(stderr, "iterations must be > 0\n");
+		return 2;
+	}
+
+	Sim_Timing_Configure(&config);
+	Sim_AttachDefaultDevices();
+	Sim_Boot();
+
+	printf("%-11s %-7s %9s %10s %10s %10s %8s\n", "profile", "client", "ops/s", "p50 us", "p99 us", "max us", "failed");
+
+	for (size_t i = 0; i < PROFILE_COUNT; i++) {
+		if (!only || !strcmp(only, profiles[i].name))
+			run_profile(&profiles[i]);
+	}
+
+	Sim_Shutdown();
+	return 0;
+}
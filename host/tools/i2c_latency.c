@@ -0,0 +1,227 @@
+/*
+	Drives several services concurrently against the default simulated devices, with
+	the bus running in modeled real time, then dumps the module's latency histograms
+	(command 0x0016, from i2c::DEB) and prints p50/p99 of each component per (service, command, devid),
+	followed by the per-bus lock counters and utilization (command 0x0017).
+
+	Four clients share bus 1 (MCU, CAM, LCD, DEB) to produce lock contention; the EEP
+	client writes and immediately reads back an EEPROM with a write cycle, which NACKs
+	and produces retries.
+
+	usage: i2c_latency [-n iterations] [-r realtime_scale] [-w eeprom_write_cycle_us]
+*/
+
+#include <sim/sim.h>
+
+#include <i2c/stats.h>
+#include <i2c/i2c.h>
+#include <3ds/err.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static u32 iterations = 200;
+
+static const char *const service_names[] = {
+	"MCU", "CAM", "LCD", "DEB", "HID", "IR", "EEP", "NFC", "QTM",
+};
+
+typedef struct Worker {
+	const char *service;
+	void (*run)(Handle s, u32 n);
+} Worker;
+
+static void run_mcu(Handle s, u32 n)
+{
+	u8 value;
+
+	if (n & 1) {
+		T(SimI2C_ReadRegister8(s, 3, 0x20, &value));
+	} else {
+		T(SimI2C_WriteRegister8(s, 3, 0x20, (u8)n));
+	}
+}
+
+static void run_cam(Handle s, u32 n)
+{
+	u16 value;
+
+	T(SimI2C_ReadRegister16(s, 4, 0x3010, &value));
+	(void)n;
+}
+
+static void run_lcd(Handle s, u32 n)
+{
+	u8 buf[16] = { (u8)n };
+
+	T(SimI2C_WriteRegisters8(s, 5, 0x40, buf, sizeof(buf)));
+}
+
+static void run_deb(Handle s, u32 n)
+{
+	T(SimI2C_ReplaceRegisterBits8(s, 7, 0x10, (u8)n, 0x0F));
+}
+
+static void run_eep(Handle s, u32 n)
+{
+	u8 value;
+
+	T(SimI2C_WriteRegister8(s, 14, (u8)n, (u8)n));
+	T(SimI2C_ReadRegister8(s, 14, (u8)n, &value)); // NACKed while the write cycle runs
+}
+
+static const Worker workers[] = {
+	{ "i2c::MCU", run_mcu },
+	{ "i2c::CAM", run_cam },
+	{ "i2c::LCD", run_lcd },
+	{ "i2c::DEB", run_deb },
+	{ "i2c::EEP", run_eep },
+};
+
+static void *worker_main(void *arg)
+{
+	const Worker *w = (const Worker *)arg;
+	Handle s;
+
+	T(SimI2C_Connect(&s, w->service));
+
+	for (u32 n = 0; n < iterations; n++)
+		w->run(s, n);
+
+	svcCloseHandle(s);
+	return NULL;
+}
+
+// upper bound of the bucket holding the p-th sample, in microseconds (< 0: open-ended)
+static double percentile_us(const u32 *buckets, u32 count, double p)
+{
+	u32 target = (u32)(count * p + 0.5), seen = 0;
+
+	if (!target)
+		target = 1;
+
+	for (u32 b = 0; b < I2C_LATENCY_BUCKET_COUNT; b++) {
+		seen += buckets[b];
+
+		if (seen >= target)
+			return b == I2C_LATENCY_BUCKET_COUNT - 1 ? -1 :
+				(double)(1ULL << (b + I2C_LATENCY_BUCKET_SHIFT)) * 1e6 / SIM_TICKS_PER_SECOND;
+	}
+
+	return -1;
+}
+
+static void print_percentile(double us)
+{
+	if (us < 0)
+		printf(" %8s", "open");
+	else
+		printf(" %8.1f", us);
+}
+
+int main(int argc, char **argv)
+{
+	Sim_TimingConfig config = Sim_DefaultTiming;
+	u32 write_cycle_us = 100;
+	int opt;
+
+	config.realtime_scale = 1.0;
+
+	while ((opt = getopt(argc, argv, "n:r:w:")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			config.realtime_scale = strtod(optarg, NULL);
+			break;
+		case 'w':
+			write_cycle_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-r realtime_scale] [-w eeprom_write_cycle_us]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	Sim_Timing_Configure(&config);
+	Sim_AttachDefaultDevices();
+
+	Sim_Eeprom *eep = (Sim_Eeprom *)Sim_GetDefaultDevice(14);
+	eep->write_cycle_ticks = (u64)write_cycle_us * SIM_TICKS_PER_SECOND / 1000000;
+
+	Sim_Boot();
+
+	pthread_t threads[sizeof(workers) / sizeof(workers[0])];
+
+	for (size_t i = 0; i < sizeof(workers) / sizeof(workers[0]); i++)
+		pthread_create(&threads[i], NULL, worker_main, (void *)&workers[i]);
+
+	for (size_t i = 0; i < sizeof(workers) / sizeof(workers[0]); i++)
+		pthread_join(threads[i], NULL);
+
+	static I2C_LatencyHistogram histograms[I2C_LATENCY_MAX_ENTRIES];
+	Handle s;
+	u32 count = 0;
+
+	T(SimI2C_Connect(&s, "i2c::DEB"));
+
+	Result res = SimI2C_GetLatencyHistograms(s, histograms, I2C_LATENCY_MAX_ENTRIES, I2C_LATENCY_DUMP_RESET, &count);
+
+	if (res == I2C_NOT_IMPLEMENTED) {
+		fprintf(stderr, "module built without I2C_STATS\n");
+		return 1;
+	}
+
+	T(res);
+
+	printf("%-4s %-4s %-5s %6s %7s %8s | %8s %8s | %8s %8s | %8s %8s | %8s %8s  (us)\n",
+		"svc", "cmd", "devid", "count", "retries", "max",
+		"tot p50", "p99", "lock p50", "p99", "bus p50", "p99", "rtry p50", "p99");
+
+	for (u32 i = 0; i < count; i++) {
+		const I2C_LatencyHistogram *h = &histograms[i];
+		char devid[8];
+
+		if (h->devid == I2C_LATENCY_DEVID_MULTI)
+			snprintf(devid, sizeof(devid), "multi");
+		else
+			snprintf(devid, sizeof(devid), "%u", h->devid);
+
+		printf("%-4s %04X %-5s %6u %7u %8.1f |", service_names[h->service], h->cmd_id, devid,
+			h->count, h->retries, h->max_ticks * 1e6 / SIM_TICKS_PER_SECOND);
+
+		for (u32 c = 0; c < I2C_LATENCY_COMPONENT_COUNT; c++) {
+			print_percentile(percentile_us(h->buckets[c], h->count, 0.50));
+			print_percentile(percentile_us(h->buckets[c], h->count, 0.99));
+			printf(c == I2C_LATENCY_COMPONENT_COUNT - 1 ? "\n" : " |");
+		}
+	}
+
+	T(SimI2C_GetLatencyHistograms(s, histograms, I2C_LATENCY_MAX_ENTRIES, 0, &count));
+	printf("\n%u histogram(s) left after reset\n", count);
+
+	I2C_BusStats buses[3];
+
+	T(SimI2C_GetBusStats(s, buses, 3, I2C_BUS_STATS_DUMP_RESET, &count));
+
+	printf("\n%-4s %8s %9s %6s %10s %10s %10s %10s %-8s %6s  (us)\n", "bus", "acquired", "contended", "spun",
+		"wait", "max wait", "hold", "max hold", "holder", "util");
+
+	for (u32 port = 0; port < count; port++) {
+		const I2C_BusStats *b = &buses[port];
+
+		printf("%-4u %8u %9u %6u %10.1f %10.1f %10.1f %10.1f %-8s %5.1f%%\n", port, b->acquisitions, b->contended, b->spun,
+			b->wait_ticks * 1e6 / SIM_TICKS_PER_SECOND, b->max_wait_ticks * 1e6 / SIM_TICKS_PER_SECOND,
+			b->hold_ticks * 1e6 / SIM_TICKS_PER_SECOND, b->max_hold_ticks * 1e6 / SIM_TICKS_PER_SECOND,
+			b->acquisitions ? service_names[b->max_hold_service] : "-",
+			b->window_ticks ? 100.0 * b->window_busy_ticks / b->window_ticks : 0.0);
+	}
+
+	svcCloseHandle(s);
+	Sim_Shutdown();
+	return 0;
+}
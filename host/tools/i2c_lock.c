@@ -0,0 +1,183 @@
+/*
+	Contention benchmark of the spin-then-block LightLock (LightLock_LockSpin,
+	synchronization.h) against arbitrating as soon as the lock is held, which is what
+	LightLock_Lock does (a spin bound of 0).
+
+	1, 2, 4 and 8 threads each take one lock -n times, hold it for -h ns of busy work
+	(a register read polling its bus is tens of us) and then work -o ns outside of it.
+	Every lock runs the same loop: blocking at once, a fixed spin of -s rounds, and the
+	adaptive spin with the same bound. A counter bumped without atomics inside the
+	critical section checks that the lock still excludes.
+
+	Runs on the host atomics that emulate ldrex/strex and on the simulated address
+	arbiter, so arbitrating costs a futex round trip rather than an SVC. Spinning only
+	wins while the holder runs on another core: with one CPU the spinner burns the
+	holder's time slice, which is why the bus locks only spin on N3DS.
+
+	usage: i2c_lock [-n acquisitions per thread] [-h hold ns] [-o outside ns] [-s spins] [-r repeats]
+*/
+
+#include <sim/sim.h>
+
+#include <3ds/synchronization.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 8
+
+typedef struct Mode {
+	const char *name;
+	u32 max_spins; // UINT32_MAX: -s
+	bool adaptive;
+} Mode;
+
+static const Mode modes[] = {
+	{ "block",         0,          false },
+	{ "spin",          UINT32_MAX, false },
+	{ "adaptive spin", UINT32_MAX, true  },
+};
+
+static u32 acquisitions = 20000;
+static u32 hold_ns = 2000;
+static u32 outside_ns = 2000;
+static u32 spins = 1024;
+static u32 repeats = 3;
+
+static LightLock lock;
+static LightLockSpin spin;
+static atomic_bool start;
+static u32 counter;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void busy(u32 ns)
+{
+	u64 end = now_ns() + ns;
+
+	while (now_ns() < end)
+		;
+}
+
+static void *worker_main(void *arg)
+{
+	(void)arg;
+
+	while (!atomic_load(&start))
+		sched_yield();
+
+	for (u32 i = 0; i < acquisitions; i++) {
+		LightLock_LockSpin(&lock, &spin);
+
+		u32 seen = *(volatile u32 *)&counter;
+
+		busy(hold_ns);
+		*(volatile u32 *)&counter = seen + 1;
+
+		LightLock_Unlock(&lock);
+		busy(outside_ns);
+	}
+
+	return NULL;
+}
+
+// acquisitions per second
+static double run(const Mode *mode, u32 threads)
+{
+	pthread_t tids[MAX_THREADS];
+
+	LightLock_Init(&lock);
+	spin = (LightLockSpin){ .max_spins = mode->max_spins == UINT32_MAX ? spins : mode->max_spins, .adaptive = mode->adaptive };
+	counter = 0;
+	atomic_store(&start, false);
+
+	for (u32 i = 0; i < threads; i++)
+		pthread_create(&tids[i], NULL, worker_main, NULL);
+
+	u64 t0 = now_ns();
+	atomic_store(&start, true);
+
+	for (u32 i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+
+	return (double)threads * acquisitions * 1e9 / (double)(now_ns() - t0);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:h:o:s:r:")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			acquisitions = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			hold_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			outside_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			spins = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			repeats = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n acquisitions per thread] [-h hold ns] [-o outside ns] [-s spins] [-r repeats]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!acquisitions || !spins || !repeats) {
+		fprintf(stderr, "acquisitions, spins and repeats must be > 0\n");
+		return 2;
+	}
+
+	if (R_FAILED(syncInit()))
+		return 1;
+
+	u32 errors = 0;
+
+	printf("%u acquisitions per thread, held %u ns, %u ns outside, up to %u spins, best of %u, %ld cpu(s)\n",
+		acquisitions, hold_ns, outside_ns, spins, repeats, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%-14s %7s %10s %9s %9s %9s %11s\n", "", "threads", "locks/s", "contended", "spun", "blocked", "rounds/spin");
+
+	for (u32 n = 1; n <= MAX_THREADS; n *= 2) {
+		for (u32 m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+			LightLockSpin best_spin = { 0 };
+			double best = 0;
+
+			for (u32 r = 0; r < repeats; r++) {
+				double rate = run(&modes[m], n);
+
+				if (counter != n * acquisitions && !errors++)
+					fprintf(stderr, "%s: %u of %u increments survived\n", modes[m].name, counter, n * acquisitions);
+
+				if (rate > best) {
+					best = rate;
+					best_spin = spin;
+				}
+			}
+
+			printf("%-14s %7u %10.0f %9u %9u %9u %11.1f\n", modes[m].name, n, best, best_spin.contended, best_spin.spun,
+				best_spin.blocked, best_spin.contended ? (double)best_spin.rounds / best_spin.contended : 0.0);
+		}
+	}
+
+	printf("%u error(s)\n", errors);
+	return errors ? 1 : 0;
+}
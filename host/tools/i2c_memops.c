@@ -0,0 +1,268 @@
+/*
+	_memcpy/_memset from memops.h across sizes and (dest, src) alignments, against the
+	loops they replaced and libc. Every combination is first checked byte for byte,
+	including guard bytes around the destination.
+
+	On x86 and other hosts the block kernels are the portable versions in memops.h. On an
+	ARM host (the host Makefile assembles source/memops.s there) they are the LDM/STM
+	kernels, and -c adds CPU cycles per call read through perf_event_open, which makes
+	this the cycle-count harness for ARMv6 (e.g. an ARM1176 board).
+
+	usage: i2c_memops [-n iterations] [-c]
+*/
+
+#include <memops.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define GUARD 8
+#define MAX_SIZE 4096
+
+static uint32_t iterations = 20000;
+static int cycles_fd = -1;
+
+// the memops.h loops before the block kernels: word loop when both are aligned, bytes otherwise
+static void loop_memcpy(void *dest, const void *src, size_t size)
+{
+	if (((uintptr_t)dest & 0x3) == 0 && ((uintptr_t)src & 0x3) == 0) {
+		uint32_t *_dest = (uint32_t *)dest;
+		const uint32_t *_src = (const uint32_t *)src;
+		for (; size >= 4; size -= 4)
+			*_dest++ = *_src++;
+		dest = _dest;
+		src = _src;
+	}
+
+	uint8_t *_dest8 = (uint8_t *)dest;
+	const uint8_t *_src8 = (const uint8_t *)src;
+	for (; size > 0; size--)
+		*_dest8++ = *_src8++;
+}
+
+static void loop_memset(void *dest, uint32_t c, size_t size)
+{
+	if (((uintptr_t)dest & 0x3) == 0) {
+		uint32_t *_dest = (uint32_t *)dest;
+		for (; size >= 4; size -= 4)
+			*_dest++ = c;
+		dest = _dest;
+	}
+
+	uint8_t *_dest8 = (uint8_t *)dest;
+	for (; size > 0; size--)
+		*_dest8++ = c;
+}
+
+static void blocks_memcpy(void *dest, const void *src, size_t size)
+{
+	_memcpy(dest, src, size);
+}
+
+static void blocks_memset(void *dest, uint32_t c, size_t size)
+{
+	_memset(dest, c, size);
+}
+
+static void libc_memcpy(void *dest, const void *src, size_t size)
+{
+	memcpy(dest, src, size);
+}
+
+static void libc_memset(void *dest, uint32_t c, size_t size)
+{
+	memset(dest, (int)(c & 0xFF), size);
+}
+
+typedef struct Impl {
+	const char *name;
+	void (*copy)(void *dest, const void *src, size_t size);
+	void (*fill)(void *dest, uint32_t c, size_t size);
+} Impl;
+
+static const Impl impls[] = {
+	{ "loop",   loop_memcpy,   loop_memset },
+	{ "blocks", blocks_memcpy, blocks_memset },
+	{ "libc",   libc_memcpy,   libc_memset },
+};
+
+#define IMPL_COUNT (sizeof(impls) / sizeof(impls[0]))
+
+static const size_t sizes[] = { 8, 31, 32, 64, 256, 1024, 4096 };
+static const struct { unsigned dest, src; } alignments[] = {
+	{ 0, 0 }, { 1, 1 }, { 0, 1 }, { 0, 2 }, { 0, 3 }, { 3, 1 }, { 2, 0 },
+};
+
+static uint8_t src_buf[MAX_SIZE + 64] __attribute__((aligned(64)));
+static uint8_t dest_buf[MAX_SIZE + 64 + 2 * GUARD] __attribute__((aligned(64)));
+static uint8_t expect_buf[MAX_SIZE + 64 + 2 * GUARD] __attribute__((aligned(64)));
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void open_cycle_counter(void)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	cycles_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	if (cycles_fd < 0)
+		fprintf(stderr, "cycle counter unavailable, timing in ns only\n");
+}
+
+static uint64_t read_cycles(void)
+{
+	uint64_t value = 0;
+
+	if (cycles_fd < 0 || read(cycles_fd, &value, sizeof(value)) != sizeof(value))
+		return 0;
+
+	return value;
+}
+
+static bool check(const Impl *impl, bool fill, size_t size, unsigned dest_align, unsigned src_align)
+{
+	uint8_t *dest = dest_buf + GUARD + dest_align, *expect = expect_buf + GUARD + dest_align;
+
+	memset(dest_buf, 0xEE, sizeof(dest_buf));
+	memset(expect_buf, 0xEE, sizeof(expect_buf));
+
+	if (fill) {
+		impl->fill(dest, 0x5A5A5A5A, size);
+		memset(expect, 0x5A, size);
+	} else {
+		impl->copy(dest, src_buf + src_align, size);
+		memcpy(expect, src_buf + src_align, size);
+	}
+
+	return !memcmp(dest_buf, expect_buf, sizeof(dest_buf));
+}
+
+static void measure(const Impl *impl, bool fill, size_t size, unsigned dest_align, unsigned src_align, double *ns, double *cycles)
+{
+	uint8_t *dest = dest_buf + GUARD + dest_align;
+	const uint8_t *src = src_buf + src_align;
+	uint64_t c0 = read_cycles(), t0 = now_ns();
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		if (fill)
+			impl->fill(dest, 0, size);
+		else
+			impl->copy(dest, src, size);
+		__asm__ volatile("" ::: "memory");
+	}
+
+	*ns = (double)(now_ns() - t0) / iterations;
+	*cycles = (double)(read_cycles() - c0) / iterations;
+}
+
+static int run(bool fill)
+{
+	int failures = 0;
+
+	printf("\n%s%-6s %-7s", fill ? "memset" : "memcpy", "", "size");
+	for (size_t i = 0; i < IMPL_COUNT; i++)
+		printf(" %10s", impls[i].name);
+	printf(cycles_fd >= 0 ? "   (ns / cycles per call)\n" : "   (ns per call)\n");
+
+	// memset has no source, so it runs over the four destination alignments instead
+	size_t n_alignments = fill ? 4 : sizeof(alignments) / sizeof(alignments[0]);
+
+	for (size_t a = 0; a < n_alignments; a++) {
+		unsigned dest_align = fill ? (unsigned)a : alignments[a].dest, src_align = fill ? 0 : alignments[a].src;
+
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			if (fill)
+				printf("dest+%u       %-7zu", dest_align, sizes[s]);
+			else
+				printf("dest+%u src+%u %-7zu", dest_align, src_align, sizes[s]);
+
+			for (size_t i = 0; i < IMPL_COUNT; i++) {
+				double ns, cycles;
+
+				if (!check(&impls[i], fill, sizes[s], dest_align, src_align)) {
+					printf(" %10s", "WRONG");
+					failures++;
+					continue;
+				}
+
+				measure(&impls[i], fill, sizes[s], dest_align, src_align, &ns, &cycles);
+
+				if (cycles_fd >= 0)
+					printf(" %5.0f/%-4.0f", ns, cycles);
+				else
+					printf(" %10.1f", ns);
+			}
+
+			printf("\n");
+		}
+	}
+
+	return failures;
+}
+
+int main(int argc, char **argv)
+{
+	bool want_cycles = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:c")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			want_cycles = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-c]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!iterations) {
+		fprintf(stderr, "iterations must be > 0\n");
+		return 2;
+	}
+
+	for (size_t i = 0; i < sizeof(src_buf); i++)
+		src_buf[i] = (uint8_t)(i * 7 + 1);
+
+	if (want_cycles)
+		open_cycle_counter();
+
+#ifdef I2C_MEMOPS_ARMV6
+	printf("block kernels: LDM/STM (source/memops.s)\n");
+#else
+	printf("block kernels: portable (memops.h)\n");
+#endif
+
+	int failures = run(false) + run(true);
+
+	printf("\n%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,273 @@
+/*
+	Stress test and throughput of the bus submission queue (i2c/mpsc.h) against the
+	lock-based handoff it replaced: a ring of the same capacity behind a LightLock, with
+	the same empty to non-empty wakeup so only the handoff differs.
+
+	For 1, 2, 4 and 8 producer threads, each pushes -n items tagged with its index and a
+	sequence number into one queue while a consumer thread pops them; a full queue makes
+	the producer yield and retry. The consumer checks that every item arrives exactly
+	once and in each producer's order. With -s the consumer yields instead of sleeping
+	when the queue is empty, which leaves the cost of the handoff itself.
+
+	Runs on the host atomics that emulate ldrex/strex (synchronization.h), so a pass here
+	covers the algorithm, not the ARM11 memory model. On a single-core host the producers
+	only contend when one is preempted, so the lock-free side mostly shows up as fewer
+	convoys behind a preempted lock holder on multi-core hosts.
+
+	usage: i2c_mpsc [-n items per producer] [-r repeats] [-s]
+*/
+
+#include <sim/sim.h>
+
+#include <3ds/synchronization.h>
+#include <i2c/mpsc.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PRODUCERS 8
+
+typedef struct LockedQueue {
+	LightLock lock;
+	u32 head;
+	u32 count;
+	LightEvent ready;
+	void *items[I2C_MPSC_CAPACITY];
+} LockedQueue;
+
+typedef struct Queue {
+	const char *name;
+	void (*init)(void);
+	bool (*push)(void *item);
+	void *(*pop)(void);
+	void (*wait)(void);
+} Queue;
+
+static u32 items_per_producer = 100000;
+static u32 repeats = 3;
+static bool spin;
+
+static I2C_Mpsc mpsc;
+static LockedQueue locked;
+
+static atomic_bool start;
+static atomic_uint full_retries;
+static u32 producers;
+static u32 waits;
+static u32 errors;
+
+static void mpsc_init(void) { I2C_Mpsc_Init(&mpsc, 0); }
+static bool mpsc_push(void *item) { return I2C_Mpsc_Push(&mpsc, item); }
+static void *mpsc_pop(void) { return I2C_Mpsc_Pop(&mpsc); }
+static void mpsc_wait(void) { I2C_Mpsc_Wait(&mpsc); }
+
+static void locked_init(void)
+{
+	LightLock_Init(&locked.lock);
+	LightEvent_Init(&locked.ready, RESET_ONESHOT);
+	locked.head = 0;
+	locked.count = 0;
+}
+
+static bool locked_push(void *item)
+{
+	LightLock_Lock(&locked.lock);
+
+	bool ok = locked.count < I2C_MPSC_CAPACITY;
+	bool was_empty = !locked.count;
+
+	if (ok)
+		locked.items[(locked.head + locked.count++) % I2C_MPSC_CAPACITY] = item;
+
+	LightLock_Unlock(&locked.lock);
+
+	if (ok && was_empty)
+		LightEvent_Signal(&locked.ready);
+
+	return ok;
+}
+
+static void *locked_pop(void)
+{
+	void *item = NULL;
+
+	LightLock_Lock(&locked.lock);
+
+	if (locked.count) {
+		item = locked.items[locked.head];
+		locked.head = (locked.head + 1) % I2C_MPSC_CAPACITY;
+		locked.count--;
+	}
+
+	LightLock_Unlock(&locked.lock);
+	return item;
+}
+
+static void locked_wait(void)
+{
+	LightEvent_Wait(&locked.ready);
+}
+
+static const Queue queues[] = {
+	{ "mpsc (ldrex/strex)", mpsc_init, mpsc_push, mpsc_pop, mpsc_wait },
+	{ "LightLock ring",     locked_init, locked_push, locked_pop, locked_wait },
+};
+
+static const Queue *queue;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *producer_main(void *arg)
+{
+	uintptr_t index = (uintptr_t)arg;
+	u32 retries = 0;
+
+	while (!atomic_load(&start))
+		sched_yield();
+
+	for (u32 seq = 1; seq <= items_per_producer; seq++) {
+		void *item = (void *)((index << 24) | seq);
+
+		while (!queue->push(item)) {
+			retries++;
+			sched_yield();
+		}
+	}
+
+	atomic_fetch_add(&full_retries, retries);
+	return NULL;
+}
+
+// pops every item on this thread and checks the order of each producer
+static void consume(void)
+{
+	u32 next[MAX_PRODUCERS];
+	u32 total = producers * items_per_producer;
+
+	for (u32 i = 0; i < producers; i++)
+		next[i] = 1;
+
+	for (u32 received = 0; received < total; ) {
+		void *item = queue->pop();
+
+		if (!item) {
+			waits++;
+
+			if (spin)
+				sched_yield();
+			else
+				queue->wait();
+			continue;
+		}
+
+		uintptr_t value = (uintptr_t)item;
+		u32 index = (u32)(value >> 24), seq = (u32)(value & 0xFFFFFF);
+
+		if (index >= producers || seq != next[index]) {
+			if (!errors++)
+				fprintf(stderr, "%s: producer %u item %u arrived, expected %u\n", queue->name, index, seq,
+					index < producers ? next[index] : 0);
+		} else
+			next[index]++;
+
+		received++;
+	}
+
+	if (queue->pop() && !errors++)
+		fprintf(stderr, "%s: more items than were pushed\n", queue->name);
+}
+
+// items per second
+static double run(const Queue *q, u32 n)
+{
+	pthread_t threads[MAX_PRODUCERS];
+
+	queue = q;
+	producers = n;
+	queue->init();
+	atomic_store(&start, false);
+
+	for (u32 i = 0; i < n; i++)
+		pthread_create(&threads[i], NULL, producer_main, (void *)(uintptr_t)i);
+
+	u64 t0 = now_ns();
+	atomic_store(&start, true);
+	consume();
+	u64 elapsed = now_ns() - t0;
+
+	for (u32 i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	return (double)n * items_per_producer * 1e9 / (double)elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:s")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			items_per_producer = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			repeats = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			spin = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n items per producer] [-r repeats] [-s]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!items_per_producer || items_per_producer > 0xFFFFFF || !repeats) {
+		fprintf(stderr, "items must be in 1..0xFFFFFF and repeats > 0\n");
+		return 2;
+	}
+
+	if (R_FAILED(syncInit()))
+		return 1;
+
+	printf("%u items per producer, capacity %u, best of %u, consumer %s when empty\n", items_per_producer,
+		I2C_MPSC_CAPACITY, repeats, spin ? "yields" : "sleeps");
+	printf("%-20s %9s %12s %10s %12s\n", "", "producers", "items/s", "waits", "full retries");
+
+	for (u32 n = 1; n <= MAX_PRODUCERS; n *= 2) {
+		for (u32 q = 0; q < sizeof(queues) / sizeof(queues[0]); q++) {
+			double best = 0;
+			u32 best_waits = 0, best_retries = 0;
+
+			for (u32 r = 0; r < repeats; r++) {
+				waits = 0;
+				atomic_store(&full_retries, 0);
+
+				double rate = run(&queues[q], n);
+
+				if (rate > best) {
+					best = rate;
+					best_waits = waits;
+					best_retries = atomic_load(&full_retries);
+				}
+			}
+
+			printf("%-20s %9u %12.0f %10u %12u\n", queues[q].name, n, best, best_waits, best_retries);
+		}
+	}
+
+	printf("%u error(s)\n", errors);
+	return errors ? 1 : 0;
+}
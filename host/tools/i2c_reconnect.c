@@ -0,0 +1,179 @@
+/*
+	Session setup cost. A client closes its session and reconnects to the same service
+	in a loop, timing connect plus the first command; then a probe client connects to a
+	second service, once while the module is otherwise idle and once while another
+	client churns reconnects on the first, to show how long one service's session setup
+	stalls the accepts of the others.
+
+	Next to the client-side latency, the simulator reports per port how long a
+	connected session waited before the module accepted it (Sim_GetAcceptStats).
+
+	usage: i2c_reconnect [-n iterations]
+*/
+
+#include <sim/sim.h>
+
+#include <i2c/i2c.h>
+#include <3ds/err.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHURN_SERVICE "i2c::MCU"
+#define PROBE_SERVICE "i2c::CAM"
+
+static u32 iterations = 2000;
+static atomic_bool churning;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void command(Handle s, const char *service)
+{
+	if (!strcmp(service, PROBE_SERVICE)) {
+		u16 value;
+		T(SimI2C_ReadRegister16(s, 4, 0x3010, &value));
+	} else {
+		u8 value;
+		T(SimI2C_ReadRegister8(s, 3, 0x20, &value));
+	}
+}
+
+// connect, first command, close; returns the time until the first reply
+static u64 reconnect(const char *service)
+{
+	Handle s;
+	u64 start = now_ns();
+
+	T(SimI2C_Connect(&s, service));
+	command(s, service);
+
+	u64 elapsed = now_ns() - start;
+
+	svcCloseHandle(s);
+	return elapsed;
+}
+
+static void *churn_main(void *arg)
+{
+	(void)arg;
+
+	while (atomic_load(&churning))
+		reconnect(CHURN_SERVICE);
+
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, u64 *samples, const char *service)
+{
+	qsort(samples, iterations, sizeof(u64), compare_u64);
+
+	printf("%-34s %9.1f %9.1f %9.1f", name,
+		samples[iterations / 2] / 1e3,
+		samples[(u64)iterations * 99 / 100] / 1e3,
+		samples[iterations - 1] / 1e3);
+
+	if (service) {
+		Sim_AcceptStats stats;
+
+		T(Sim_GetAcceptStats(service, &stats, true));
+		printf(" %9.1f %9.1f", stats.accepted ? (double)stats.wait_ns_total / stats.accepted / 1e3 : 0.0,
+			stats.wait_ns_max / 1e3);
+	}
+
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	Sim_AcceptStats discard;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!iterations) {
+		fprintf(stderr, "iterations must be > 0\n");
+		return 2;
+	}
+
+	u64 *samples = calloc(iterations, sizeof(u64));
+
+	if (!samples)
+		return 1;
+
+	Sim_AttachDefaultDevices();
+	Sim_Boot();
+
+	printf("%-34s %9s %9s %9s %9s %9s  (us)\n", "", "p50", "p99", "max", "acc mean", "acc max");
+
+	// reference: the same command on a session that stays open
+	Handle s;
+
+	T(SimI2C_Connect(&s, CHURN_SERVICE));
+
+	for (u32 i = 0; i < iterations; i++) {
+		u64 start = now_ns();
+		command(s, CHURN_SERVICE);
+		samples[i] = now_ns() - start;
+	}
+
+	svcCloseHandle(s);
+	report("command, open session", samples, NULL);
+
+	T(Sim_GetAcceptStats(CHURN_SERVICE, &discard, true));
+
+	for (u32 i = 0; i < iterations; i++)
+		samples[i] = reconnect(CHURN_SERVICE);
+
+	report("reconnect " CHURN_SERVICE, samples, CHURN_SERVICE);
+
+	T(Sim_GetAcceptStats(PROBE_SERVICE, &discard, true));
+
+	for (u32 i = 0; i < iterations; i++)
+		samples[i] = reconnect(PROBE_SERVICE);
+
+	report("connect " PROBE_SERVICE ", idle", samples, PROBE_SERVICE);
+
+	pthread_t churn;
+
+	atomic_store(&churning, true);
+	pthread_create(&churn, NULL, churn_main, NULL);
+
+	for (u32 i = 0; i < iterations; i++)
+		samples[i] = reconnect(PROBE_SERVICE);
+
+	atomic_store(&churning, false);
+	pthread_join(churn, NULL);
+
+	report("connect " PROBE_SERVICE ", " CHURN_SERVICE " churning", samples, PROBE_SERVICE);
+
+	Sim_Shutdown();
+	free(samples);
+	return 0;
+}
@@ -0,0 +1,968 @@
+/*
+	Boots the module against the default simulated devices and drives every service
+	through its command set, checking that what reaches the devices reads back.
+*/
+
+#include <sim/sim.h>
+
+#include <i2c/globals.h>
+#include <i2c/async.h>
+#include <i2c/flight.h>
+#include <i2c/i2c.h>
+#include <errors.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+static int failures;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			failures++; \
+			printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while (0)
+
+static const struct {
+	const char *name;
+	u8 devids[4];
+	u8 n_devids;
+} services[I2C_SERVICE_MAX] = {
+	{ "i2c::MCU", { 0, 3 }, 2 },
+	{ "i2c::CAM", { 1, 2, 4 }, 3 },
+	{ "i2c::LCD", { 5, 6 }, 2 },
+	{ "i2c::DEB", { 7, 8 }, 2 },
+	{ "i2c::HID", { 9, 10, 11, 12 }, 4 },
+#ifdef N3DS
+	{ "i2c::IR" , { 13, 17 }, 2 },
+#else
+	{ "i2c::IR" , { 13 }, 1 },
+#endif
+	{ "i2c::EEP", { 14 }, 1 },
+#ifdef N3DS
+	{ "i2c::NFC", { 15 }, 1 },
+	{ "i2c::QTM", { 16 }, 1 },
+#endif
+};
+
+static bool is_camera(u8 devid)
+{
+	return devid == 1 || devid == 2 || devid == 4;
+}
+
+static void exercise_register8(Handle s, u8 devid)
+{
+	u8 value = 0, buf[16], readback[16];
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(s, devid, 0x10, 0xA5)), "write8 devid %u", devid);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(s, devid, 0x10, &value)) && value == 0xA5, "read8 devid %u: %02X", devid, value);
+
+	CHECK(R_SUCCEEDED(SimI2C_ReplaceRegisterBits8(s, devid, 0x10, 0x0F, 0x3C)), "replace8 devid %u", devid);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(s, devid, 0x10, &value)) && value == 0x8D, "replace8 devid %u: %02X", devid, value);
+	CHECK(R_SUCCEEDED(SimI2C_SetRegisterBits8(s, devid, 0x10, 0x70)), "set8 devid %u", devid);
+	CHECK(R_SUCCEEDED(SimI2C_ClearRegisterBits8(s, devid, 0x10, 0x81)), "clear8 devid %u", devid);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(s, devid, 0x10, &value)) && value == 0x7C, "set/clear8 devid %u: %02X", devid, value);
+
+	for (u32 i = 0; i < sizeof(buf); i++)
+		buf[i] = (u8)(devid * 16 + i);
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegisters8(s, devid, 0x20, buf, sizeof(buf))), "writes8 devid %u", devid);
+	memset(readback, 0, sizeof(readback));
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegisters8(s, devid, 0x20, readback, sizeof(readback))) &&
+		memcmp(buf, readback, sizeof(buf)) == 0, "reads8 devid %u", devid);
+
+	memset(readback, 0, sizeof(readback));
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegisters8Legacy(s, devid, 0x20, readback, 4)) &&
+		memcmp(buf, readback, 4) == 0, "legacy reads8 devid %u", devid);
+
+	for (u32 i = 0; i < sizeof(buf); i++)
+		buf[i] = (u8)~buf[i];
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegisters8Mapped(s, devid, 0x40, buf, sizeof(buf))), "mapped writes8 devid %u", devid);
+	memset(readback, 0, sizeof(readback));
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegisters8Mapped(s, devid, 0x40, readback, sizeof(readback))) &&
+		memcmp(buf, readback, sizeof(buf)) == 0, "mapped reads8 devid %u", devid);
+}
+
+static void exercise_register16(Handle s, u8 devid)
+{
+	u16 value = 0, buf[4] = { 0x1234, 0x5678, 0x9ABC, 0xDEF0 }, readback[4] = { 0 };
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister16(s, devid, 0x3010, 0xBEEF)), "write16 devid %u", devid);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister16(s, devid, 0x3010, &value)) && value == 0xBEEF, "read16 devid %u: %04X", devid, value);
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegisters16(s, devid, 0x0100, buf, 4)), "writes16 devid %u", devid);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegisters16(s, devid, 0x0100, readback, 4)) &&
+		memcmp(buf, readback, sizeof(buf)) == 0, "reads16 devid %u", devid);
+}
+
+static void exercise_camera_multi(Handle s)
+{
+	static const u8 devids[] = { 1, 2, 4 };
+	u16 value;
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister16Multi(s, devids, 3, 0x0200, 0xF00F)), "write16 multi");
+	CHECK(R_SUCCEEDED(SimI2C_ReplaceRegisterBits16Multi(s, devids, 3, 0x0200, 0x0AA0, 0x0FF0)), "replace16 multi");
+
+	for (u32 i = 0; i < 3; i++)
+		CHECK(R_SUCCEEDED(SimI2C_ReadRegister16(s, devids[i], 0x0200, &value)) && value == 0xFAAF, "multi devid %u: %04X", devids[i], value);
+
+	// one foreign or out of range devid rejects the whole list before any I/O
+	static const u8 mixed[] = { 1, 5, 4 }, out_of_range[] = { 1, 0x80 };
+
+	CHECK(SimI2C_WriteRegister16Multi(s, mixed, 3, 0x0200, 0) == I2C_UNAUTHORIZED, "write16 multi with a foreign devid");
+	CHECK(SimI2C_WriteRegister16Multi(s, out_of_range, 2, 0x0200, 0) == I2C_UNAUTHORIZED, "write16 multi with devid 0x80");
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister16(s, 1, 0x0200, &value)) && value == 0xFAAF, "rejected multi wrote devid 1: %04X", value);
+}
+
+static void exercise_camera_table(Handle s)
+{
+	static const I2C_RegisterWrite16 table[] = {
+		{ 0x0300, 0x1111, 0 }, { 0x0302, 0x2222, 0 }, { 0x0304, 0x3333, 0 }, { 0x0306, 0x4444, 200 },
+		{ 0x0308, 0x5555, 0 }, { 0x0320, 0x6666, 0 }, { 0x0322, 0x7777, 0 },
+	};
+	u32 count = sizeof(table) / sizeof(table[0]), failed_index = 0;
+	Sim_FaultDevice fd;
+	u16 values[5] = { 0 }, value = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegisterTable16(s, 2, table, count, &failed_index)) && failed_index == count,
+		"register table: index %lu", (unsigned long)failed_index);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegisters16(s, 2, 0x0300, values, 5)) && values[0] == 0x1111 && values[3] == 0x4444 &&
+		values[4] == 0x5555, "register table run: %04X %04X %04X", values[0], values[3], values[4]);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister16(s, 2, 0x0322, &value)) && value == 0x7777, "register table tail: %04X", value);
+
+	CHECK(SimI2C_WriteRegisterTable16(s, 3, table, count, &failed_index) == I2C_UNAUTHORIZED, "register table on devid 3");
+	CHECK(SimI2C_WriteRegisterTable16(s, 2, table, 0, &failed_index) == I2C_INVALID_SIZE, "empty register table");
+
+	Sim_FaultDevice_Wrap(&fd, Sim_GetDefaultDevice(2), 0, &(Sim_FaultConfig){ .missing = true });
+	CHECK(SimI2C_WriteRegisterTable16(s, 2, table, count, &failed_index) == I2C_FATAL_FAIL && failed_index == 0,
+		"register table on a missing device: index %lu", (unsigned long)failed_index);
+	Sim_FaultDevice_Unwrap(&fd);
+}
+
+#ifdef N3DS
+static void exercise_raw(Handle s, u8 devid)
+{
+	Sim_Fifo *fifo = (Sim_Fifo *)Sim_GetDefaultDevice(devid);
+	static const u8 out[5] = { 1, 2, 3, 4, 5 };
+	u8 in[5] = { 0 }, value = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteDeviceRawMulti(s, devid, out, sizeof(out))), "raw write devid %u", devid);
+	CHECK(Sim_Fifo_Pop(fifo, in, sizeof(in)) == sizeof(in) && memcmp(in, out, sizeof(in)) == 0, "raw write payload devid %u", devid);
+
+	Sim_Fifo_Push(fifo, out, sizeof(out));
+	CHECK(R_SUCCEEDED(SimI2C_ReadDeviceRaw(s, devid, &value)) && value == 1, "raw read devid %u: %02X", devid, value);
+	memset(in, 0, sizeof(in));
+	CHECK(R_SUCCEEDED(SimI2C_ReadDeviceRawMulti(s, devid, in, 4)) && memcmp(in, out + 1, 4) == 0, "raw read multi devid %u", devid);
+}
+#else
+// o3ds refuses the raw commands in the reply layout they have on n3ds
+static void exercise_raw(Handle s, u8 devid)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	static const u8 out[5] = { 1, 2, 3, 4, 5 };
+	u8 in[5] = { 0 }, value = 0xFF;
+
+	CHECK(SimI2C_ReadDeviceRaw(s, devid, &value) == I2C_NOT_IMPLEMENTED && cmdbuf[0] == IPC_MakeHeader(0x0013, 2, 0) && !value,
+		"raw read on o3ds: %08lX", (unsigned long)cmdbuf[0]);
+	CHECK(SimI2C_WriteDeviceRawMulti(s, devid, out, sizeof(out)) == I2C_NOT_IMPLEMENTED && cmdbuf[0] == IPC_MakeHeader(0x0014, 1, 0),
+		"raw write multi on o3ds: %08lX", (unsigned long)cmdbuf[0]);
+	CHECK(SimI2C_ReadDeviceRawMulti(s, devid, in, 4) == I2C_NOT_IMPLEMENTED && cmdbuf[0] == IPC_MakeHeader(0x0015, 1, 2),
+		"raw read multi on o3ds: %08lX", (unsigned long)cmdbuf[0]);
+}
+#endif
+
+static void exercise_latency_stats(void)
+{
+	static I2C_LatencyHistogram histograms[I2C_LATENCY_MAX_ENTRIES];
+	I2C_BusStats buses[3];
+	Handle s, deb;
+	u32 count = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s, "i2c::MCU")), "connect i2c::MCU");
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&deb, "i2c::DEB")), "connect i2c::DEB");
+
+	// only the diagnostics service may see or reset the other services' latencies
+	CHECK(SimI2C_GetLatencyHistograms(s, histograms, I2C_LATENCY_MAX_ENTRIES, I2C_LATENCY_DUMP_RESET, &count) == I2C_UNAUTHORIZED,
+		"latency dump from i2c::MCU");
+	CHECK(SimI2C_GetBusStats(s, buses, 3, I2C_BUS_STATS_DUMP_RESET, &count) == I2C_UNAUTHORIZED, "bus stats dump from i2c::MCU");
+
+#ifdef I2C_STATS
+	CHECK(R_SUCCEEDED(SimI2C_GetLatencyHistograms(deb, histograms, I2C_LATENCY_MAX_ENTRIES, I2C_LATENCY_DUMP_RESET, &count)) &&
+		count > 0, "latency dump: %u entries", count);
+
+	for (u32 i = 0; i < count; i++)
+		CHECK(histograms[i].count && histograms[i].cmd_id && histograms[i].cmd_id < 0x0016,
+			"latency entry %u: cmd %04X count %u", i, histograms[i].cmd_id, histograms[i].count);
+
+	CHECK(R_SUCCEEDED(SimI2C_GetLatencyHistograms(deb, histograms, I2C_LATENCY_MAX_ENTRIES, 0, &count)) &&
+		count == 0, "latency reset: %u entries", count);
+
+	CHECK(R_SUCCEEDED(SimI2C_GetBusStats(deb, buses, 3, I2C_BUS_STATS_DUMP_RESET, &count)) && count == 3, "bus stats dump: %u", count);
+
+	for (u32 port = 0; port < count; port++)
+		CHECK(buses[port].acquisitions && buses[port].hold_ticks && buses[port].contended <= buses[port].acquisitions &&
+			buses[port].spun <= buses[port].contended &&
+			buses[port].window_busy_ticks <= buses[port].window_ticks, "bus %u stats", port);
+
+	CHECK(R_SUCCEEDED(SimI2C_GetBusStats(deb, buses, 3, 0, &count)) && buses[0].acquisitions == 0, "bus stats reset");
+#else
+	CHECK(SimI2C_GetLatencyHistograms(deb, histograms, I2C_LATENCY_MAX_ENTRIES, 0, &count) == I2C_NOT_IMPLEMENTED,
+		"latency dump without I2C_STATS");
+	CHECK(SimI2C_GetBusStats(deb, buses, 3, 0, &count) == I2C_NOT_IMPLEMENTED, "bus stats without I2C_STATS");
+#endif
+
+	svcCloseHandle(deb);
+	svcCloseHandle(s);
+	printf("%-9s ok\n", "stats");
+}
+
+static void exercise_trace(void)
+{
+	static I2C_TraceEntry entries[I2C_TRACE_RING_SIZE];
+	Handle s, deb;
+	u32 count = 0, sequence = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s, "i2c::MCU")), "connect i2c::MCU");
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&deb, "i2c::DEB")), "connect i2c::DEB");
+
+	// the ring holds every service's register traffic
+	CHECK(SimI2C_GetTrace(s, entries, I2C_TRACE_RING_SIZE, 0, &count, &sequence) == I2C_UNAUTHORIZED, "trace dump from i2c::MCU");
+
+#ifdef I2C_TRACE
+	CHECK(R_SUCCEEDED(SimI2C_GetTrace(deb, entries, I2C_TRACE_RING_SIZE, I2C_TRACE_DUMP_RESET, &count, &sequence)) &&
+		count == I2C_TRACE_RING_SIZE && sequence > count, "trace dump: %u entries, sequence %u", count, sequence);
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(s, 3, 0x31, 0x5C)), "traced write");
+	CHECK(R_SUCCEEDED(SimI2C_GetTrace(deb, entries, I2C_TRACE_RING_SIZE, I2C_TRACE_DUMP_RESET, &count, &sequence)) &&
+		count == 3, "trace after one write: %u entries", count);
+
+	static const struct { u8 phase, data; } expected[3] = {
+		{ I2C_TRACE_SELECT, 0x4A }, { I2C_TRACE_REGISTER, 0x31 }, { I2C_TRACE_FINISH_WRITE, 0x5C },
+	};
+
+	for (u32 i = 0; i < count && i < 3; i++)
+		CHECK(entries[i].phase == expected[i].phase && entries[i].data == expected[i].data && entries[i].devid == 3 &&
+			(entries[i].flags & I2C_TRACE_FLAG_BUS_MASK) == 1 && (entries[i].flags & I2C_TRACE_FLAG_ACK) &&
+			(entries[i].flags >> I2C_TRACE_SESSION_SHIFT) == I2C_SESSION_TYPE_MCU,
+			"trace entry %u: phase %u data %02X flags %02X", i, entries[i].phase, entries[i].data, entries[i].flags);
+#else
+	CHECK(SimI2C_GetTrace(deb, entries, I2C_TRACE_RING_SIZE, 0, &count, &sequence) == I2C_NOT_IMPLEMENTED,
+		"trace dump without I2C_TRACE");
+#endif
+
+	svcCloseHandle(deb);
+	svcCloseHandle(s);
+	printf("%-9s ok\n", "trace");
+}
+
+static void exercise_async(void)
+{
+	u8 out[2][0x40], in[2][0x40];
+	u32 tickets[4], ticket = 0, transferred = 0;
+	Result result = 0;
+	Handle s, event;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s, "i2c::MCU")), "connect i2c::MCU");
+	CHECK(R_SUCCEEDED(SimI2C_GetAsyncEvent(s, &event)) && event, "async event");
+
+	for (u32 i = 0; i < sizeof(out[0]); i++) {
+		out[0][i] = (u8)(0x80 + i);
+		out[1][i] = (u8)(0xC0 - i);
+	}
+
+	// devid 0 is on bus 0 and devid 3 on bus 1; each read is queued behind the write to its device
+	CHECK(R_SUCCEEDED(SimI2C_SubmitWriteRegisters8(s, 0, 0x60, out[0], sizeof(out[0]), &tickets[0])), "submit write devid 0");
+	CHECK(R_SUCCEEDED(SimI2C_SubmitWriteRegisters8(s, 3, 0x60, out[1], sizeof(out[1]), &tickets[1])), "submit write devid 3");
+	CHECK(R_SUCCEEDED(SimI2C_SubmitReadRegisters8(s, 0, 0x60, sizeof(in[0]), &tickets[2])), "submit read devid 0");
+	CHECK(R_SUCCEEDED(SimI2C_SubmitReadRegisters8(s, 3, 0x60, sizeof(in[1]), &tickets[3])), "submit read devid 3");
+	CHECK(tickets[0] && tickets[1] != tickets[0] && tickets[2] != tickets[1] && tickets[3] != tickets[2], "async tickets");
+	CHECK(SimI2C_SubmitReadRegisters8(s, 3, 0x60, 1, &ticket) == I2C_ASYNC_QUEUE_FULL, "fifth async transfer queued");
+
+	for (u32 reaped = 0; reaped < 4;) {
+		u8 buf[0x40];
+		Result res = SimI2C_ReapAsync(s, buf, sizeof(buf), &ticket, &result, &transferred);
+
+		if (res == I2C_ASYNC_NOTHING_DONE) {
+			CHECK(R_SUCCEEDED(svcWaitSynchronization(event, 1000000000LL)), "async completion event");
+			continue;
+		}
+
+		CHECK(R_SUCCEEDED(res) && R_SUCCEEDED(result) && transferred == sizeof(buf), "reap: %08lX %08lX %lu",
+			(unsigned long)res, (unsigned long)result, (unsigned long)transferred);
+
+		if (ticket == tickets[2])
+			memcpy(in[0], buf, sizeof(buf));
+		else if (ticket == tickets[3])
+			memcpy(in[1], buf, sizeof(buf));
+
+		reaped++;
+	}
+
+	CHECK(memcmp(in, out, sizeof(in)) == 0, "async reads");
+	CHECK(SimI2C_ReapAsync(s, NULL, 0, &ticket, &result, &transferred) == I2C_ASYNC_NOTHING_DONE, "reap with nothing done");
+	CHECK(svcWaitSynchronization(event, 0) == OS_TIMEOUT, "completion event cleared");
+
+	CHECK(SimI2C_SubmitReadRegisters8(s, 5, 0, 1, &ticket) == I2C_UNAUTHORIZED, "async read of devid 5");
+	CHECK(SimI2C_SubmitReadRegisters8(s, 3, 0, 0, &ticket) == I2C_INVALID_SIZE, "async read of 0 bytes");
+	CHECK(SimI2C_SubmitReadRegisters8(s, 3, 0, I2C_ASYNC_MAX_SIZE + 1, &ticket) == I2C_INVALID_SIZE, "oversized async read");
+
+	// transfers left behind by a closed session give their slots back
+	for (u32 i = 0; i < 4; i++)
+		CHECK(R_SUCCEEDED(SimI2C_SubmitReadRegisters8(s, 3, 0x60, sizeof(in[1]), &ticket)), "submit before close");
+
+	svcCloseHandle(s);
+	svcCloseHandle(event);
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s, "i2c::MCU")), "reconnect i2c::MCU");
+	for (u32 i = 0; i < 4; i++)
+		CHECK(R_SUCCEEDED(SimI2C_SubmitReadRegisters8(s, 3, 0x60, 1, &ticket)) && ticket == i + 1, "submit after reconnect");
+	svcCloseHandle(s);
+
+	printf("%-9s ok\n", "async");
+}
+
+// one transfer on each bus: the driver thread runs them side by side, stepping whichever bus interrupted
+static void exercise_driver(void)
+{
+	static const u8 devids[3] = { 0, 3, 9 }; // buses 0, 1 and 2
+	u8 out[3][0x20], in[0x20];
+	u32 tickets[3], ticket = 0, transferred = 0;
+	Result result = 0;
+	Handle s[2], event[2];
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s[0], "i2c::MCU")), "connect i2c::MCU");
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s[1], "i2c::HID")), "connect i2c::HID");
+
+	for (u32 i = 0; i < 2; i++)
+		CHECK(R_SUCCEEDED(SimI2C_GetAsyncEvent(s[i], &event[i])), "async event %lu", (unsigned long)i);
+
+	for (u32 i = 0; i < 3; i++)
+		for (u32 j = 0; j < sizeof(out[i]); j++)
+			out[i][j] = (u8)(i * 0x40 + j);
+
+#ifdef I2C_TRACE
+	static I2C_TraceEntry entries[I2C_TRACE_RING_SIZE];
+	u32 count = 0, sequence = 0;
+	Handle deb;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&deb, "i2c::DEB")), "connect i2c::DEB");
+	CHECK(R_SUCCEEDED(SimI2C_GetTrace(deb, entries, I2C_TRACE_RING_SIZE, I2C_TRACE_DUMP_RESET, &count, &sequence)), "reset trace");
+#endif
+
+	// held buses keep all three transfers queued until they can start together
+	for (u32 i = 0; i < 3; i++)
+		I2C_HoldBus(i);
+
+	for (u32 i = 0; i < 3; i++)
+		CHECK(R_SUCCEEDED(SimI2C_SubmitWriteRegisters8(s[i == 2], devids[i], 0x40, out[i], sizeof(out[i]), &tickets[i])),
+			"submit write devid %u", devids[i]);
+
+	svcSleepThread(10000000);
+
+	for (u32 i = 0; i < 3; i++)
+		I2C_ReleaseBus(i);
+
+	for (u32 i = 0; i < 3; i++) {
+		u32 session = i == 2;
+
+		CHECK(R_SUCCEEDED(svcWaitSynchronization(event[session], 1000000000LL)), "driver completion devid %u", devids[i]);
+		CHECK(R_SUCCEEDED(SimI2C_ReapAsync(s[session], NULL, 0, &ticket, &result, &transferred)) && ticket == tickets[i] &&
+			R_SUCCEEDED(result), "driver write devid %u: %08lX", devids[i], (unsigned long)result);
+	}
+
+#ifdef I2C_TRACE
+	CHECK(R_SUCCEEDED(SimI2C_GetTrace(deb, entries, I2C_TRACE_RING_SIZE, 0, &count, &sequence)), "driver trace");
+	svcCloseHandle(deb);
+
+	u32 switches = 0;
+
+	for (u32 i = 0; i < count; i++) {
+		u8 bus = entries[i].flags & I2C_TRACE_FLAG_BUS_MASK;
+
+		CHECK(entries[i].devid == devids[bus] && (entries[i].flags >> I2C_TRACE_SESSION_SHIFT) ==
+			(bus == 2 ? I2C_SESSION_TYPE_HID : I2C_SESSION_TYPE_MCU), "driver trace entry %lu: devid %u flags %02X",
+			(unsigned long)i, entries[i].devid, entries[i].flags);
+
+		switches += i && bus != (entries[i - 1].flags & I2C_TRACE_FLAG_BUS_MASK);
+	}
+
+	// one transfer after the other would switch buses twice
+	CHECK(count == 3 * (2 + sizeof(out[0])) && switches > 2, "driver trace: %lu entries, %lu bus switches",
+		(unsigned long)count, (unsigned long)switches);
+#endif
+
+	for (u32 i = 0; i < 3; i++) {
+		Handle session = s[i == 2];
+
+		CHECK(R_SUCCEEDED(SimI2C_ReadRegisters8(session, devids[i], 0x40, in, sizeof(in))) && !memcmp(in, out[i], sizeof(in)),
+			"driver write readback devid %u", devids[i]);
+	}
+
+	for (u32 i = 0; i < 2; i++) {
+		svcCloseHandle(event[i]);
+		svcCloseHandle(s[i]);
+	}
+
+	printf("%-9s ok\n", "driver");
+}
+
+static void exercise_posted(void)
+{
+	Sim_FaultDevice fd;
+	Result error = -1;
+	u32 failures = ~0u;
+	u16 value16 = 0;
+	u8 value = 0;
+	Handle s;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s, "i2c::LCD")), "connect i2c::LCD");
+	CHECK(R_SUCCEEDED(SimI2C_SetPostedWrites(s, true)), "enable posted writes");
+
+	// a read of the same session waits for the posted writes ahead of it
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(s, 5, 0x30, 0x11)), "posted write8");
+	CHECK(R_SUCCEEDED(SimI2C_SetRegisterBits8(s, 5, 0x30, 0xC0)), "posted set bits");
+	CHECK(R_SUCCEEDED(SimI2C_ClearRegisterBits8(s, 5, 0x30, 0x01)), "posted clear bits");
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(s, 5, 0x30, &value)) && value == 0xD0, "read after posted writes: %02X", value);
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister16(s, 6, 0x40, 0xBEEF)), "posted write16");
+	CHECK(R_SUCCEEDED(SimI2C_FencePostedWrites(s, &error, &failures)) && error == 0 && failures == 0, "fence: %08lX %lu",
+		(unsigned long)error, (unsigned long)failures);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister16(s, 6, 0x40, &value16)) && value16 == 0xBEEF, "read16 after fence: %04X", value16);
+
+	CHECK(SimI2C_WriteRegister8(s, 0, 0, 0) == I2C_UNAUTHORIZED, "posted write to devid 0");
+
+	// a failure is acknowledged, then reported once by the fence
+	Sim_FaultDevice_Wrap(&fd, Sim_GetDefaultDevice(6), 1, &(Sim_FaultConfig){ .missing = true });
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(s, 6, 0x30, 0x22)), "posted write to a missing device");
+	CHECK(R_SUCCEEDED(SimI2C_FencePostedWrites(s, &error, &failures)) && error == I2C_FATAL_FAIL && failures == 1,
+		"fence after a failure: %08lX %lu", (unsigned long)error, (unsigned long)failures);
+	CHECK(R_SUCCEEDED(SimI2C_FencePostedWrites(s, &error, &failures)) && error == 0 && failures == 0, "fence cleared");
+
+	Sim_FaultDevice_Unwrap(&fd);
+
+	// synchronous again: the failure is returned by the write itself
+	CHECK(R_SUCCEEDED(SimI2C_SetPostedWrites(s, false)), "disable posted writes");
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(s, 5, 0x30, 0x33)) && R_SUCCEEDED(SimI2C_ReadRegister8(s, 5, 0x30, &value)) &&
+		value == 0x33, "synchronous write after posted mode: %02X", value);
+
+	// posted writes outlive their session
+	CHECK(R_SUCCEEDED(SimI2C_SetPostedWrites(s, true)), "enable posted writes");
+	for (u32 i = 0; i < 12; i++)
+		CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(s, 5, 0x31, (u8)i)), "posted write before close");
+	svcCloseHandle(s);
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s, "i2c::LCD")), "reconnect i2c::LCD");
+	CHECK(R_SUCCEEDED(SimI2C_FencePostedWrites(s, &error, &failures)) && error == 0 && failures == 0, "fence on a new session");
+	svcCloseHandle(s);
+
+	printf("%-9s ok\n", "posted");
+}
+
+static void exercise_snapshot(void)
+{
+	static const I2C_SnapshotRange ranges[] = {
+		{ 3, 0x30, 7, 0 }, { 3, 0x0B, 2, 0 }, { 3, 0x08, 1, 0 }, { 3, 0x10, 4, 0 }, { 3, 0x0F, 1, 0 }, { 0, 0x02, 3, 0 },
+	};
+	u8 regs[2][0x40], expect[0x20], buf[0x20];
+	u32 size = 0, n_bursts = 0, read = 0, packed = 0;
+	u64 tick = 0, last_tick = 0;
+	Handle s;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s, "i2c::MCU")), "connect i2c::MCU");
+
+	for (u32 i = 0; i < sizeof(regs[0]); i++) {
+		regs[0][i] = (u8)(0x11 * i + 3);
+		regs[1][i] = (u8)(0xA0 ^ i);
+	}
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegisters8Mapped(s, 0, 0, regs[0], sizeof(regs[0]))), "fill devid 0");
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegisters8Mapped(s, 3, 0, regs[1], sizeof(regs[1]))), "fill devid 3");
+
+	for (u32 i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+		memcpy(expect + packed, &regs[ranges[i].devid == 0 ? 0 : 1][ranges[i].regid], ranges[i].size);
+		packed += ranges[i].size;
+	}
+
+	CHECK(SimI2C_ReadSnapshot(s, buf, sizeof(buf), &read, &tick) == I2C_SNAPSHOT_NOT_CONFIGURED, "snapshot before configuring");
+
+	// 0x08-0x13 of devid 3 is one burst, 0x30 another, devid 0 (bus 0) a third
+	CHECK(R_SUCCEEDED(SimI2C_SetSnapshotRanges(s, ranges, sizeof(ranges) / sizeof(ranges[0]), &size, &n_bursts)) &&
+		size == packed && n_bursts == 3, "configure snapshot: %lu bytes, %lu bursts", (unsigned long)size, (unsigned long)n_bursts);
+
+	for (u32 i = 0; i < 2; i++) {
+		memset(buf, 0, sizeof(buf));
+		CHECK(R_SUCCEEDED(SimI2C_ReadSnapshot(s, buf, sizeof(buf), &read, &tick)) && read == packed &&
+			!memcmp(buf, expect, packed), "snapshot %lu", (unsigned long)i);
+		CHECK(tick > last_tick, "snapshot tick");
+		last_tick = tick;
+	}
+
+	CHECK(SimI2C_ReadSnapshot(s, buf, packed - 1, &read, &tick) == I2C_INVALID_SIZE, "snapshot into a short buffer");
+
+	// an exact range is not merged across a gap
+	I2C_SnapshotRange flags[] = { { 3, 0x10, 4, I2C_SNAPSHOT_RANGE_EXACT }, { 3, 0x16, 1, 0 } };
+
+	CHECK(R_SUCCEEDED(SimI2C_SetSnapshotRanges(s, flags, 2, &size, &n_bursts)) && n_bursts == 2, "exact range: %lu bursts",
+		(unsigned long)n_bursts);
+	flags[0].flags = 0;
+	CHECK(R_SUCCEEDED(SimI2C_SetSnapshotRanges(s, flags, 2, &size, &n_bursts)) && n_bursts == 1, "gap merged: %lu bursts",
+		(unsigned long)n_bursts);
+
+	I2C_SnapshotRange bad[] = { { 3, 0x00, 1, 0 }, { 5, 0x00, 1, 0 } };
+
+	CHECK(SimI2C_SetSnapshotRanges(s, bad, 2, &size, &n_bursts) == I2C_UNAUTHORIZED, "snapshot of devid 5");
+	CHECK(SimI2C_ReadSnapshot(s, buf, sizeof(buf), &read, &tick) == I2C_SNAPSHOT_NOT_CONFIGURED, "failed configure clears");
+	bad[1] = (I2C_SnapshotRange){ 3, 0xFF, 2, 0 };
+	CHECK(SimI2C_SetSnapshotRanges(s, bad, 2, &size, &n_bursts) == I2C_INVALID_SIZE, "snapshot past register 0xFF");
+	bad[1] = (I2C_SnapshotRange){ 3, 0x10, 0, 0 };
+	CHECK(SimI2C_SetSnapshotRanges(s, bad, 2, &size, &n_bursts) == I2C_INVALID_SIZE, "empty snapshot range");
+
+	CHECK(R_SUCCEEDED(SimI2C_SetSnapshotRanges(s, ranges, 1, &size, &n_bursts)), "configure before close");
+	svcCloseHandle(s);
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&s, "i2c::MCU")), "reconnect i2c::MCU");
+	CHECK(SimI2C_ReadSnapshot(s, buf, sizeof(buf), &read, &tick) == I2C_SNAPSHOT_NOT_CONFIGURED, "snapshot after reconnect");
+	svcCloseHandle(s);
+
+	printf("%-9s ok\n", "snapshot");
+}
+
+static void exercise_read_cache(void)
+{
+	Sim_RegisterFile *mcu_regs = (Sim_RegisterFile *)Sim_GetDefaultDevice(3);
+	Sim_RegisterFile *cam_regs = (Sim_RegisterFile *)Sim_GetDefaultDevice(2);
+	I2C_CacheStats stats[I2C_CACHE_MAX_ENTRIES];
+	u32 count = 0;
+	u16 value16 = 0;
+	u8 value = 0;
+	Handle mcu, cam, deb;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&mcu, "i2c::MCU")), "connect i2c::MCU");
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&cam, "i2c::CAM")), "connect i2c::CAM");
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&deb, "i2c::DEB")), "connect i2c::DEB");
+
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(mcu, 3, 0x0B, 0x40)), "write before caching");
+	CHECK(SimI2C_ConfigureReadCache(mcu, 3, 0x0A, 4, I2C_CACHE_MAX_TTL_TICKS + 1, 0) == I2C_CACHE_TTL_TOO_LONG, "cache ttl past the cap");
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureReadCache(mcu, 3, 0x0A, 4, I2C_CACHE_MAX_TTL_TICKS, 0)), "cache devid 3 0x0A-0x0D");
+
+	// the device changes behind the module's back: a fresh cached value hides it, a write to the device drops it
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(mcu, 3, 0x0B, &value)) && value == 0x40, "cache fill: %02X", value);
+	mcu_regs->regs[0x0B] = 0x41;
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(mcu, 3, 0x0B, &value)) && value == 0x40, "cache hit: %02X", value);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(mcu, 3, 0x0E, &value)) && value == mcu_regs->regs[0x0E], "register past the range");
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(mcu, 3, 0x20, 0x00)), "write elsewhere on the device");
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(mcu, 3, 0x0B, &value)) && value == 0x41, "invalidated by a write: %02X", value);
+
+	// the same entry with a 1ms ttl
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureReadCache(mcu, 3, 0x0A, 4, SIM_TICKS_PER_SECOND / 1000, 0)), "reconfigure ttl");
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(mcu, 3, 0x0B, &value)) && value == 0x41, "refill: %02X", value);
+	mcu_regs->regs[0x0B] = 0x42;
+	svcSleepThread(2000000);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(mcu, 3, 0x0B, &value)) && value == 0x42, "expired: %02X", value);
+
+	// 16 bit registers are regid + 2 apart
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister16(cam, 2, 0x0402, 0x1234)), "write16 before caching");
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureReadCache(cam, 2, 0x0400, 2, I2C_CACHE_MAX_TTL_TICKS, I2C_CACHE_REGISTERS16)), "cache devid 2");
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister16(cam, 2, 0x0402, &value16)) && value16 == 0x1234, "cache fill16: %04X", value16);
+	cam_regs->regs[0x0402] = 0x56;
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister16(cam, 2, 0x0402, &value16)) && value16 == 0x1234, "cache hit16: %04X", value16);
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister16(cam, 2, 0x0401, &value16)) && (value16 & 0xFF) == 0x56, "odd regid is not cached: %04X", value16);
+
+	CHECK(SimI2C_ConfigureReadCache(mcu, 3, 0x0C, 4, 1000, 0) == I2C_CACHE_OVERLAP, "overlapping entry");
+	CHECK(SimI2C_ConfigureReadCache(mcu, 5, 0x00, 1, 1000, 0) == I2C_UNAUTHORIZED, "cache of devid 5");
+	CHECK(SimI2C_ConfigureReadCache(mcu, 3, 0x00, 0, 1000, 0) == I2C_INVALID_SIZE, "empty cache entry");
+	CHECK(SimI2C_ConfigureReadCache(mcu, 3, 0xF8, 9, 1000, 0) == I2C_INVALID_SIZE, "cache past register 0xFF");
+	CHECK(SimI2C_ConfigureReadCache(mcu, 3, 0x40, 1, 0, 0) == I2C_CACHE_NOT_FOUND, "remove a missing entry");
+
+	for (u32 i = 2; i < I2C_CACHE_MAX_ENTRIES; i++)
+		CHECK(R_SUCCEEDED(SimI2C_ConfigureReadCache(mcu, 0, (u16)(i * 0x10), 1, 1000, 0)), "cache entry %lu", (unsigned long)i);
+	CHECK(SimI2C_ConfigureReadCache(mcu, 0, 0xF0, 1, 1000, 0) == I2C_CACHE_FULL, "cache full");
+
+	CHECK(SimI2C_GetReadCacheStats(mcu, stats, I2C_CACHE_MAX_ENTRIES, I2C_CACHE_STATS_DUMP_RESET, &count) == I2C_UNAUTHORIZED,
+		"cache stats from i2c::MCU");
+	CHECK(R_SUCCEEDED(SimI2C_GetReadCacheStats(deb, stats, I2C_CACHE_MAX_ENTRIES, I2C_CACHE_STATS_DUMP_RESET, &count)) &&
+		count == I2C_CACHE_MAX_ENTRIES, "cache stats: %lu entries", (unsigned long)count);
+
+	for (u32 i = 0; i < count; i++) {
+		if (stats[i].devid == 3) {
+			CHECK(stats[i].hits == 1 && stats[i].misses == 4 && stats[i].saved_ticks && stats[i].ttl_ticks == SIM_TICKS_PER_SECOND / 1000,
+				"devid 3 cache stats: %u hits, %u misses", stats[i].hits, stats[i].misses);
+		} else if (stats[i].devid == 2) {
+			CHECK(stats[i].hits == 1 && stats[i].misses == 1 && stats[i].flags == I2C_CACHE_REGISTERS16,
+				"devid 2 cache stats: %u hits, %u misses", stats[i].hits, stats[i].misses);
+		}
+	}
+
+	CHECK(R_SUCCEEDED(SimI2C_GetReadCacheStats(deb, stats, I2C_CACHE_MAX_ENTRIES, 0, &count)) && !stats[0].hits && !stats[0].misses,
+		"cache stats reset");
+
+	for (u32 i = 2; i < I2C_CACHE_MAX_ENTRIES; i++)
+		CHECK(R_SUCCEEDED(SimI2C_ConfigureReadCache(mcu, 0, (u16)(i * 0x10), 1, 0, 0)), "remove cache entry %lu", (unsigned long)i);
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureReadCache(mcu, 3, 0x0A, 4, 0, 0)), "remove devid 3 entry");
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureReadCache(cam, 2, 0x0400, 2, 0, I2C_CACHE_REGISTERS16)), "remove devid 2 entry");
+	CHECK(R_SUCCEEDED(SimI2C_GetReadCacheStats(deb, stats, I2C_CACHE_MAX_ENTRIES, 0, &count)) && !count, "cache emptied");
+
+	svcCloseHandle(mcu);
+	svcCloseHandle(cam);
+	svcCloseHandle(deb);
+	printf("%-9s ok\n", "cache");
+}
+
+typedef struct MergedReader {
+	Handle session;
+	u32 ticket;
+	Result submit_res;
+	Result read_res;
+	u8 value;
+	bool driver_open;
+} MergedReader;
+
+// polls the flight table of a bus until the count reaches at least min, for up to 5 s
+static bool wait_flights(u8 port, bool joiners, u32 min)
+{
+	for (u32 i = 0; i < 5000; i++) {
+		u32 driver_open, waiting;
+
+		I2C_Flight_Count(port, &driver_open, &waiting);
+
+		if ((joiners ? waiting : driver_open) >= min)
+			return true;
+
+		svcSleepThread(1000000);
+	}
+
+	return false;
+}
+
+static void *merged_reader_main(void *arg)
+{
+	MergedReader *reader = arg;
+
+	/*
+		the transfer driver picks the submitted read up and opens its flight, then this thread
+		issues the same read synchronously; a session read only looks for a driver flight
+	*/
+	reader->submit_res = SimI2C_SubmitReadRegisters8(reader->session, 3, 0x24, 1, &reader->ticket);
+	reader->driver_open = wait_flights(1, false, 1);
+	reader->read_res = SimI2C_ReadRegister8(reader->session, 3, 0x24, &reader->value);
+	return NULL;
+}
+
+static void exercise_merged_reads(void)
+{
+	MergedReader reader = { 0 };
+	Sim_Timing before, after;
+	pthread_t thread;
+	Handle event;
+	u8 async_value = 0;
+	u32 ticket = 0, transferred = 0;
+	Result result = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&reader.session, "i2c::MCU")), "connect i2c::MCU");
+	CHECK(R_SUCCEEDED(SimI2C_GetAsyncEvent(reader.session, &event)), "async event");
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(reader.session, 3, 0x24, 0x6B)), "write merged register");
+
+#ifdef I2C_STATS
+	I2C_BusStats buses[3];
+	Handle deb;
+	u32 count = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&deb, "i2c::DEB")), "connect i2c::DEB");
+	CHECK(R_SUCCEEDED(SimI2C_GetBusStats(deb, buses, 3, I2C_BUS_STATS_DUMP_RESET, &count)), "reset bus stats");
+#endif
+
+	// with bus 1 held, both reads are in flight at once and only one of them goes to the wire
+	I2C_HoldBus(1);
+	Sim_Timing_GetBus(1, &before);
+
+	pthread_create(&thread, NULL, merged_reader_main, &reader);
+	bool joined = wait_flights(1, true, 1);
+
+	I2C_ReleaseBus(1);
+	pthread_join(thread, NULL);
+
+	CHECK(reader.driver_open && joined, "merged reads in flight: driver %d, joiner %d", reader.driver_open, joined);
+
+	CHECK(R_SUCCEEDED(svcWaitSynchronization(event, 1000000000LL)), "merged async completion");
+	CHECK(R_SUCCEEDED(SimI2C_ReapAsync(reader.session, &async_value, 1, &ticket, &result, &transferred)) &&
+		ticket == reader.ticket && R_SUCCEEDED(result) && async_value == 0x6B, "merged async read: %08lX %02X",
+		(unsigned long)result, async_value);
+
+	Sim_Timing_GetBus(1, &after);
+
+	CHECK(R_SUCCEEDED(reader.submit_res) && R_SUCCEEDED(reader.read_res) && reader.value == 0x6B, "merged read: %08lX %02X",
+		(unsigned long)reader.read_res, reader.value);
+	CHECK(after.count - before.count == 1, "merged reads took %llu transactions", (unsigned long long)(after.count - before.count));
+
+#ifdef I2C_STATS
+	CHECK(R_SUCCEEDED(SimI2C_GetBusStats(deb, buses, 3, 0, &count)) && buses[1].merged_reads == 1,
+		"merged read counter: %u", buses[1].merged_reads);
+	svcCloseHandle(deb);
+#endif
+
+	svcCloseHandle(reader.session);
+	printf("%-9s ok\n", "merge");
+}
+
+static void exercise_bus_recovery(void)
+{
+	static const Sim_FaultConfig hangs[] = { { .hold_sda_ppm = 1000000 }, { .lost_irq_ppm = 1000000 } };
+	Sim_FaultDevice fd;
+	Handle deb, mcu;
+	u8 value = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&deb, "i2c::DEB")), "connect i2c::DEB");
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&mcu, "i2c::MCU")), "connect i2c::MCU");
+
+	// a device that hangs every phase fails its command in bounded time, and its bus neighbour still works
+	for (u32 i = 0; i < sizeof(hangs) / sizeof(hangs[0]); i++) {
+		Sim_FaultDevice_Wrap(&fd, Sim_GetDefaultDevice(7), 1, &hangs[i]);
+
+		s64 start = svcGetSystemTick();
+		CHECK(SimI2C_ReadRegister8(deb, 7, 0x10, &value) == I2C_FATAL_FAIL, "read of a hanging device (%lu)", (unsigned long)i);
+		u64 elapsed = svcGetSystemTick() - start;
+		CHECK(elapsed < SIM_TICKS_PER_SECOND / 10, "hanging device took %llu ms", (unsigned long long)(elapsed * 1000 / SIM_TICKS_PER_SECOND));
+
+		// the transfer driver times the phases out and recovers the bus the same way
+		u32 ticket = 0, reaped = 0, transferred = 0;
+		Result result = 0;
+
+		CHECK(R_SUCCEEDED(SimI2C_SubmitReadRegisters8(deb, 7, 0x10, 1, &ticket)), "async read of a hanging device (%lu)", (unsigned long)i);
+
+		for (u32 tries = 0; tries < 100 && SimI2C_ReapAsync(deb, &value, 1, &reaped, &result, &transferred) == I2C_ASYNC_NOTHING_DONE; tries++)
+			svcSleepThread(1000000);
+
+		CHECK(reaped == ticket && result == I2C_FATAL_FAIL, "async read of a hanging device (%lu): %08lX", (unsigned long)i,
+			(unsigned long)result);
+
+		Sim_FaultDevice_Unwrap(&fd);
+
+		CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(mcu, 3, 0x21, 0x5A)) && R_SUCCEEDED(SimI2C_ReadRegister8(mcu, 3, 0x21, &value)) &&
+			value == 0x5A, "bus neighbour after recovery (%lu): %02X", (unsigned long)i, value);
+	}
+
+#ifdef I2C_STATS
+	I2C_BusStats buses[3];
+	u32 count = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_GetBusStats(deb, buses, 3, I2C_BUS_STATS_DUMP_RESET, &count)) && buses[1].timeouts &&
+		buses[1].recoveries == buses[1].timeouts && buses[1].clock_outs && buses[1].clock_outs < buses[1].recoveries &&
+		!buses[1].recovery_failures, "recovery counters: %u timeouts, %u recoveries, %u clock-outs, %u failed",
+		buses[1].timeouts, buses[1].recoveries, buses[1].clock_outs, buses[1].recovery_failures);
+#endif
+
+	svcCloseHandle(deb);
+	svcCloseHandle(mcu);
+	printf("%-9s ok\n", "recovery");
+}
+
+static void exercise_legacy_delays(void)
+{
+	Sim_RegisterFile *mcu_regs = (Sim_RegisterFile *)Sim_GetDefaultDevice(3);
+	Sim_FaultConfig settle = { .settle_us = 100 }, busy_reg = { .nack_reg_ppm = 1000000 };
+	Sim_FaultDevice fd;
+	I2C_LegacyDelays delays;
+	Sim_Timing before, after;
+	Handle mcu;
+	u8 buf[4];
+	u32 failed = 0;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&mcu, "i2c::MCU")), "connect i2c::MCU");
+
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureLegacyDelays(mcu, 3, 0, 0, 0, I2C_LEGACY_DELAYS_QUERY, &delays)) &&
+		delays.before_us == 50 && delays.between_us == 150 && delays.after_us == 150 && !delays.flags,
+		"default legacy delays: %u/%u/%u", delays.before_us, delays.between_us, delays.after_us);
+	CHECK(SimI2C_ConfigureLegacyDelays(mcu, 5, 0, 0, 0, 0, NULL) == I2C_UNAUTHORIZED, "legacy delays of a foreign devid");
+	CHECK(SimI2C_ConfigureLegacyDelays(mcu, 3, 0, I2C_LEGACY_DELAY_MAX_US + 1, 0, 0, NULL) == I2C_INVALID_SIZE, "legacy delay over the limit");
+	CHECK(SimI2C_ConfigureLegacyDelays(mcu, 3, 0, 0, 0, 0x80, NULL) == I2C_INTERNAL_RANGE, "unknown legacy delay flag");
+
+	for (u32 i = 0; i < 4; i++)
+		mcu_regs->regs[0x50 + i] = (u8)(0xC0 + i);
+
+	// a device that ACKs at once: the delays decay to nothing, no read needs a second try
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureLegacyDelays(mcu, 3, 50, 150, 150, I2C_LEGACY_DELAYS_ADAPTIVE, NULL)), "adaptive legacy delays");
+
+	for (u32 i = 0; i < 40 * I2C_LEGACY_DECAY_STREAK; i++)
+		failed += R_FAILED(SimI2C_ReadRegisters8Legacy(mcu, 3, 0x50, buf, sizeof(buf))) || buf[3] != 0xC3;
+
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureLegacyDelays(mcu, 3, 0, 0, 0, I2C_LEGACY_DELAYS_QUERY, &delays)) && !failed &&
+		!delays.before_us && !delays.between_us && !delays.after_us && !delays.retries && delays.reads == 40 * I2C_LEGACY_DECAY_STREAK,
+		"learned %u/%u/%u us, %u failed, %u retries", delays.before_us, delays.between_us, delays.after_us, failed, delays.retries);
+
+	// one that NACKs every register byte: each attempt counts as a retry, the last one too, and raises the delay after a read
+	u32 retries = delays.retries;
+
+	Sim_FaultDevice_Wrap(&fd, &mcu_regs->base, 1, &busy_reg);
+	CHECK(SimI2C_ReadRegisters8Legacy(mcu, 3, 0x50, buf, sizeof(buf)) == I2C_FATAL_FAIL, "legacy read of a busy device");
+	Sim_FaultDevice_Unwrap(&fd);
+
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureLegacyDelays(mcu, 3, 0, 0, 0, I2C_LEGACY_DELAYS_QUERY, &delays)) &&
+		delays.retries - retries == fd.stats.nack_reg && delays.after_us && !delays.before_us && !delays.between_us,
+		"busy device: %u retries for %llu NACKs, learned %u/%u/%u us", delays.retries - retries,
+		(unsigned long long)fd.stats.nack_reg, delays.before_us, delays.between_us, delays.after_us);
+
+	// one that NACKs for 100 us after every stop: the delays go back up to where it ACKs, and hold the bus for less than fixed ones
+	Sim_FaultDevice_Wrap(&fd, &mcu_regs->base, 1, &settle);
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureLegacyDelays(mcu, 3, 150, 150, 150, I2C_LEGACY_DELAYS_ADAPTIVE, NULL)), "adaptive legacy delays");
+	Sim_Timing_GetCommand(0x000F, &before);
+
+	for (u32 i = 0; i < 20 * I2C_LEGACY_DECAY_STREAK; i++)
+		failed += R_FAILED(SimI2C_ReadRegisters8Legacy(mcu, 3, 0x50, buf, sizeof(buf))) || buf[3] != 0xC3;
+
+	Sim_Timing_GetCommand(0x000F, &after);
+	Sim_FaultDevice_Unwrap(&fd);
+
+	u64 sleep_us = (after.sleep_ns - before.sleep_ns) / 1000 / (20 * I2C_LEGACY_DECAY_STREAK);
+
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureLegacyDelays(mcu, 3, 0, 0, 0, I2C_LEGACY_DELAYS_QUERY, &delays)) && !failed &&
+		delays.retries && fd.stats.settle_nacks && sleep_us < 350,
+		"settling device: %u failed, %u retries, %llu us slept per read, learned %u/%u/%u us", failed, delays.retries,
+		(unsigned long long)sleep_us, delays.before_us, delays.between_us, delays.after_us);
+
+	CHECK(R_SUCCEEDED(SimI2C_ConfigureLegacyDelays(mcu, 3, 50, 150, 150, 0, NULL)), "fixed legacy delays");
+	svcCloseHandle(mcu);
+	printf("%-9s ok\n", "legacy");
+}
+
+static void exercise_scl_tune(void)
+{
+	Sim_RegisterFile *mcu_regs = (Sim_RegisterFile *)Sim_GetDefaultDevice(3);
+	u16 limit_scl = I2C_SCL_LOW_DURATION(12) | I2C_SCL_HIGH_DURATION(12);
+	Sim_FaultConfig slow = { .min_scl_ns = (u32)Sim_Timing_SclPeriodNs(limit_scl), .overclock_ppm = 1000000 };
+	I2C_SclTuneResult results[I2C_SCL_TUNE_SETTINGS];
+	Sim_FaultDevice fd;
+	u32 count, best;
+	u16 scl, initial;
+	Handle mcu, lcd, deb;
+
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&mcu, "i2c::MCU")), "connect i2c::MCU");
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&lcd, "i2c::LCD")), "connect i2c::LCD");
+	CHECK(R_SUCCEEDED(SimI2C_Connect(&deb, "i2c::DEB")), "connect i2c::DEB");
+
+	// the sweep reaches every device, only i2c::DEB may run it
+	u8 untouched = mcu_regs->regs[0x60];
+
+	CHECK(SimI2C_TuneScl(mcu, 3, 0x60, 1, I2C_SCL_TUNE_SCRATCH, results, I2C_SCL_TUNE_SETTINGS, &count, &best, &scl) ==
+		I2C_UNAUTHORIZED && !count && mcu_regs->regs[0x60] == untouched, "scl tune from i2c::MCU");
+	CHECK(SimI2C_TuneScl(deb, 3, 0x60, 0, 0, results, I2C_SCL_TUNE_SETTINGS, &count, &best, &scl) == I2C_INVALID_SIZE,
+		"scl tune without iterations");
+	CHECK(SimI2C_TuneScl(deb, 3, 0x60, 1, 0x80, results, I2C_SCL_TUNE_SETTINGS, &count, &best, &scl) == I2C_INTERNAL_RANGE,
+		"unknown scl tune flag");
+
+	// a device that follows any setting: every one is clean, the fastest wins
+	CHECK(R_SUCCEEDED(SimI2C_TuneScl(deb, 3, 0x60, 4, 0, results, I2C_SCL_TUNE_SETTINGS, &count, &best, &initial)) &&
+		count == I2C_SCL_TUNE_SETTINGS && best == I2C_SCL_TUNE_SETTINGS - 1 && !results[best].scl &&
+		results[0].period_ns > results[best].period_ns, "scl tune of a fast device: %u settings, best %u", count, best);
+
+	// one that cannot be clocked faster than the limit: the sweep stops at the first setting past it
+	Sim_FaultDevice_Wrap(&fd, &mcu_regs->base, 1, &slow);
+	mcu_regs->regs[0x60] = 0x3C;
+
+	u32 expected = I2C_SCL_TUNE_SETTINGS - 1 - 12;
+
+	for (u8 flags = 0; flags <= I2C_SCL_TUNE_SCRATCH; flags += I2C_SCL_TUNE_SCRATCH) {
+		CHECK(R_SUCCEEDED(SimI2C_TuneScl(deb, 3, 0x60, 16, flags, results, I2C_SCL_TUNE_SETTINGS, &count, &best, &scl)) &&
+			best == expected && count == expected + 2 && results[best].scl == limit_scl && !results[best].errors &&
+			results[count - 1].errors == 16 && scl == initial && mcu_regs->regs[0x60] == 0x3C,
+			"scl tune of a slow device (flags %u): best %u of %u, errors %u, bus %04x, reg %02x", flags, best, count,
+			count ? results[count - 1].errors : 0, scl, mcu_regs->regs[0x60]);
+	}
+
+	// a result buffer shorter than the sweep ends it early
+	CHECK(R_SUCCEEDED(SimI2C_TuneScl(deb, 3, 0x60, 1, 0, results, 4, &count, &best, &scl)) && count == 4 && best == 3,
+		"scl tune with 4 results: best %u of %u", best, count);
+
+	CHECK(R_SUCCEEDED(SimI2C_TuneScl(deb, 3, 0x60, 4, I2C_SCL_TUNE_APPLY, results, I2C_SCL_TUNE_SETTINGS, &count, &best, &scl)) &&
+		best == expected && scl == limit_scl && Sim_Bus_GetScl(1) == initial, "applied scl %04x, bus %04x", scl, Sim_Bus_GetScl(1));
+
+	u64 overclocks = fd.stats.overclock_faults;
+	u8 value = 0;
+
+	// the device is selected at its own setting, the others on its bus keep theirs
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(mcu, 3, 0x60, 0x5A)) && mcu_regs->regs[0x60] == 0x5A &&
+		Sim_Bus_GetScl(1) == limit_scl && fd.stats.overclock_faults == overclocks, "write at the applied scl");
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(lcd, 5, 0x60, &value)) && Sim_Bus_GetScl(1) == initial,
+		"another device of the bus at %04x", Sim_Bus_GetScl(1));
+	CHECK(R_SUCCEEDED(SimI2C_ReadRegister8(mcu, 3, 0x60, &value)) && value == 0x5A && Sim_Bus_GetScl(1) == limit_scl &&
+		fd.stats.overclock_faults == overclocks, "read at the applied scl after another device");
+
+	Sim_FaultDevice_Unwrap(&fd);
+
+	CHECK(R_SUCCEEDED(SimI2C_TuneScl(deb, 3, 0x60, 0, I2C_SCL_TUNE_RESET, results, I2C_SCL_TUNE_SETTINGS, &count, &best, &scl)) &&
+		!count && scl == initial && Sim_Bus_GetScl(1) == initial, "scl back to %04x", initial);
+	CHECK(R_SUCCEEDED(SimI2C_WriteRegister8(mcu, 3, 0x60, 0x3C)) && Sim_Bus_GetScl(1) == initial, "write after the reset");
+
+	svcCloseHandle(deb);
+	svcCloseHandle(lcd);
+	svcCloseHandle(mcu);
+	printf("%-9s ok\n", "scl tune");
+}
+
+int main(void)
+{
+	Sim_AttachDefaultDevices();
+	Sim_Boot();
+
+	for (int i = 0; i < I2C_SERVICE_MAX; i++) {
+		Handle s;
+		u8 value;
+
+		CHECK(R_SUCCEEDED(SimI2C_Connect(&s, services[i].name)), "connect %s", services[i].name);
+
+		for (u8 j = 0; j < services[i].n_devids; j++) {
+			u8 devid = services[i].devids[j];
+
+#ifdef N3DS
+			if (devid == 15) {
+				exercise_raw(s, devid);
+				continue;
+			}
+#endif
+
+			if (is_camera(devid))
+				exercise_register16(s, devid);
+			else
+				exercise_register8(s, devid);
+		}
+
+		if (i == I2C_SESSION_TYPE_CAM) {
+			exercise_camera_multi(s);
+			exercise_camera_table(s);
+		}
+
+#ifndef N3DS
+		if (i == I2C_SESSION_TYPE_IR)
+			exercise_raw(s, 13);
+#endif
+
+		u8 foreign = services[i].devids[0] == 0 ? 5 : 0;
+		CHECK(SimI2C_ReadRegister8(s, foreign, 0, &value) == I2C_UNAUTHORIZED, "%s accessed devid %u", services[i].name, foreign);
+		CHECK(SimI2C_WriteRegister8(s, 0xFF, 0, 0) == I2C_UNAUTHORIZED, "%s accessed devid 0xFF", services[i].name);
+
+		svcCloseHandle(s);
+		printf("%-9s ok\n", services[i].name);
+	}
+
+	exercise_latency_stats();
+	exercise_trace();
+	exercise_async();
+	exercise_driver();
+	exercise_posted();
+	exercise_snapshot();
+	exercise_read_cache();
+	exercise_merged_reads();
+	exercise_bus_recovery();
+	exercise_legacy_delays();
+	exercise_scl_tune();
+
+	Sim_Shutdown();
+
+	printf("%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+/*
+	Runs every I2C_HandleIPC command against the default simulated devices and reports
+	the modeled bus time of each, then the per-bus totals.
+
+	usage: i2c_timing [-n iterations] [-s low,high] [-i irq_latency_ns]
+*/
+
+#include <sim/sim.h>
+
+#include <i2c/hal.h>
+#include <3ds/err.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static Handle mcu, cam;
+#ifdef N3DS
+static Handle nfc;
+#endif
+
+static u8 buf8[0x200];
+static u16 buf16[0x100];
+
+static const u8 cam_devids[] = { 1, 2, 4 };
+
+// an MCU status poll: volume, battery, power state, interrupt flags, RTC
+static const I2C_SnapshotRange mcu_status[] = {
+	{ 3, 0x09, 1, 0 }, { 3, 0x0B, 2, 0 }, { 3, 0x0F, 1, 0 }, { 3, 0x10, 4, I2C_SNAPSHOT_RANGE_EXACT }, { 3, 0x30, 7, 0 },
+};
+
+#define MCU_STATUS_REGS 15
+
+// a camera mode switch: 16 register writes in three runs of consecutive registers
+static I2C_RegisterWrite16 cam_table[16];
+
+static void fill_cam_table(void)
+{
+	static const u16 starts[] = { 0x0010, 0x0200, 0x3040 };
+	static const u8 lengths[] = { 6, 6, 4 };
+	u32 n = 0;
+
+	for (u32 i = 0; i < 3; i++)
+		for (u32 j = 0; j < lengths[i]; j++, n++)
+			cam_table[n] = (I2C_RegisterWrite16){ (u16)(starts[i] + 2 * j), (u16)(0x1000 + n), 0 };
+}
+
+static Result run_command(u16 cmd_id)
+{
+	u8 value8;
+	u16 value16;
+	u32 read, index;
+	u64 tick;
+
+	switch (cmd_id)
+	{
+	case 0x0001: return SimI2C_ReplaceRegisterBits8(mcu, 3, 0x20, 0x5A, 0xF0);
+	case 0x0002: return SimI2C_SetRegisterBits8(mcu, 3, 0x20, 0x01);
+	case 0x0003: return SimI2C_ClearRegisterBits8(mcu, 3, 0x20, 0x01);
+	case 0x0004: return SimI2C_ReplaceRegisterBits16Multi(cam, cam_devids, 3, 0x0010, 0x1234, 0x00FF);
+	case 0x0005: return SimI2C_WriteRegister8(mcu, 3, 0x20, 0x5A);
+	case 0x0006: return SimI2C_WriteDevice8(mcu, 3, 0x20);
+	case 0x0007: return SimI2C_WriteRegister16(cam, 1, 0x0010, 0x1234);
+	case 0x0008: return SimI2C_WriteRegister16Multi(cam, cam_devids, 3, 0x0010, 0x1234);
+	case 0x0009: return SimI2C_ReadRegister8(mcu, 3, 0x20, &value8);
+	case 0x000A: return SimI2C_ReadRegister16(cam, 1, 0x0010, &value16);
+	case 0x000B: return SimI2C_WriteRegisters8(mcu, 3, 0x20, buf8, 0x10);
+	case 0x000C: return SimI2C_WriteRegisters16(cam, 1, 0x0010, buf16, 0x08);
+	case 0x000D: return SimI2C_ReadRegisters8(mcu, 3, 0x20, buf8, 0x10);
+	case 0x000F: return SimI2C_ReadRegisters8Legacy(mcu, 3, 0x20, buf8, 0x10);
+	case 0x0010: return SimI2C_ReadRegisters16(cam, 1, 0x0010, buf16, 0x08);
+	case 0x0011: return SimI2C_WriteRegisters8Mapped(mcu, 3, 0x00, buf8, 0x200);
+	case 0x0012: return SimI2C_ReadRegisters8Mapped(mcu, 3, 0x00, buf8, 0x200);
+	case 0x0020: return SimI2C_ReadSnapshot(mcu, buf8, sizeof(buf8), &read, &tick);
+	case 0x0021: return SimI2C_WriteRegisterTable16(cam, 1, cam_table, 16, &index);
+#ifdef N3DS
+	case 0x0013: return SimI2C_ReadDeviceRaw(nfc, 15, &value8);
+	case 0x0014: return SimI2C_WriteDeviceRawMulti(nfc, 15, buf8, 0x10);
+	case 0x0015: return SimI2C_ReadDeviceRawMulti(nfc, 15, buf8, 0x10);
+#endif
+	default: return -1;
+	}
+}
+
+static const struct {
+	u16 cmd_id;
+	const char *desc;
+} commands[] = {
+	{ 0x0001, "replace bits 8" },
+	{ 0x0002, "set bits 8" },
+	{ 0x0003, "clear bits 8" },
+	{ 0x0004, "replace bits 16 x3 devs" },
+	{ 0x0005, "write reg 8" },
+	{ 0x0006, "write device 8" },
+	{ 0x0007, "write reg 16" },
+	{ 0x0008, "write reg 16 x3 devs" },
+	{ 0x0009, "read reg 8" },
+	{ 0x000A, "read reg 16" },
+	{ 0x000B, "write regs 8 (16B)" },
+	{ 0x000C, "write regs 16 (8W)" },
+	{ 0x000D, "read regs 8 (16B)" },
+	{ 0x000F, "legacy read 8 (16B)" },
+	{ 0x0010, "read regs 16 (8W)" },
+	{ 0x0011, "write mapped (512B)" },
+	{ 0x0012, "read mapped (512B)" },
+	{ 0x0020, "snapshot (MCU status)" },
+	{ 0x0021, "reg table 16 (16 pairs)" },
+#ifdef N3DS
+	{ 0x0013, "read raw" },
+	{ 0x0014, "write raw (16B)" },
+	{ 0x0015, "read raw (16B)" },
+#endif
+};
+
+static void print_row(const char *label, const char *desc, const Sim_Timing *t, u64 n)
+{
+	printf("%-6s %-24s %6.1f %6.1f %6.1f %7.1f %9.1f %9.1f %9.1f %10.1f\n", label, desc,
+		(double)t->starts / n, (double)(t->bytes_written + t->bytes_read) / n,
+		(double)t->nacks / n, (double)t->scl_cycles / n,
+		t->wire_ns / 1000.0 / n, t->gap_ns / 1000.0 / n, t->sleep_ns / 1000.0 / n,
+		Sim_Timing_TotalNs(t) / 1000.0 / n);
+}
+
+int main(int argc, char **argv)
+{
+	Sim_TimingConfig config = Sim_DefaultTiming;
+	u16 scl = I2C_SCL_HIGH_DURATION(5); // as set by I2C_Initialize
+	u32 iterations = 10;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:i:")) != -1) {
+		switch (opt)
+		{
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			{
+				unsigned low, high;
+				if (sscanf(optarg, "%u,%u", &low, &high) != 2)
+					return 2;
+				scl = I2C_SCL_LOW_DURATION(low) | I2C_SCL_HIGH_DURATION(high);
+			}
+			break;
+		case 'i':
+			config.irq_latency_ns = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-s low,high] [-i irq_latency_ns]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (!iterations)
+		iterations = 1;
+
+	Sim_Timing_Configure(&config);
+	Sim_AttachDefaultDevices();
+	Sim_Boot();
+
+	for (u8 port = 0; port < SIM_BUS_COUNT; port++)
+		I2C_HAL_WriteRegister(port, offsetof(I2C_BusRegset, SCL), scl);
+
+	T(SimI2C_Connect(&mcu, "i2c::MCU"));
+	T(SimI2C_Connect(&cam, "i2c::CAM"));
+#ifdef N3DS
+	T(SimI2C_Connect(&nfc, "i2c::NFC"));
+#endif
+
+	u32 snapshot_size, snapshot_bursts;
+
+	fill_cam_table();
+	T(SimI2C_SetSnapshotRanges(mcu, mcu_status, sizeof(mcu_status) / sizeof(mcu_status[0]), &snapshot_size, &snapshot_bursts));
+
+	printf("SCL register %04X: period %llu ns, irq latency %u ns, %u iteration(s)\n\n",
+		scl, (unsigned long long)Sim_Timing_SclPeriodNs(scl), config.irq_latency_ns, iterations);
+	printf("%-6s %-24s %6s %6s %6s %7s %9s %9s %9s %10s\n", "cmd", "", "starts", "bytes", "nacks", "scl",
+		"wire(us)", "gap(us)", "sleep(us)", "total(us)");
+
+	Sim_Timing_Reset();
+
+	for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+		char label[8];
+		Sim_Timing t;
+
+		for (u32 n = 0; n < iterations; n++)
+			T(run_command(commands[i].cmd_id));
+
+		Sim_Timing_GetCommand(commands[i].cmd_id, &t);
+		snprintf(label, sizeof(label), "%04X", commands[i].cmd_id);
+		print_row(label, commands[i].desc, &t, t.count ? t.count : 1);
+	}
+
+	Sim_Timing single, snapshot;
+
+	Sim_Timing_GetCommand(0x0009, &single);
+	Sim_Timing_GetCommand(0x0020, &snapshot);
+	printf("\nMCU status poll: %u x 0009 %.1f us, 0020 %.1f us (%u bursts)\n", MCU_STATUS_REGS,
+		Sim_Timing_TotalNs(&single) / 1000.0 / (single.count ? single.count : 1) * MCU_STATUS_REGS,
+		Sim_Timing_TotalNs(&snapshot) / 1000.0 / (snapshot.count ? snapshot.count : 1), snapshot_bursts);
+
+	Sim_Timing pair, table;
+
+	Sim_Timing_GetCommand(0x0007, &pair);
+	Sim_Timing_GetCommand(0x0021, &table);
+	printf("camera table:    16 x 0007 %.1f us, 0021 %.1f us\n",
+		Sim_Timing_TotalNs(&pair) / 1000.0 / (pair.count ? pair.count : 1) * 16,
+		Sim_Timing_TotalNs(&table) / 1000.0 / (table.count ? table.count : 1));
+
+	// the 0009 rows again with its register cached for the longest ttl: only a read every 50ms goes to the bus
+	I2C_CacheStats cache;
+	u32 cache_entries;
+	Sim_Timing cached;
+	Handle deb;
+
+	T(SimI2C_Connect(&deb, "i2c::DEB"));
+	T(SimI2C_ConfigureReadCache(mcu, 3, 0x20, 1, I2C_CACHE_MAX_TTL_TICKS, 0));
+
+	for (u32 n = 0; n < iterations; n++)
+		T(run_command(0x0009));
+
+	Sim_Timing_GetCommand(0x0009, &cached);
+	T(SimI2C_GetReadCacheStats(deb, &cache, 1, I2C_CACHE_STATS_DUMP_RESET, &cache_entries));
+	T(SimI2C_ConfigureReadCache(mcu, 3, 0x20, 1, 0, 0));
+	svcCloseHandle(deb);
+	printf("read cache:      %u x 0009 %.1f us, cached %.1f us (%u hits, %u misses)\n", iterations,
+		Sim_Timing_TotalNs(&single) / 1000.0 / (single.count ? single.count : 1) * iterations,
+		(Sim_Timing_TotalNs(&cached) - Sim_Timing_TotalNs(&single)) / 1000.0, cache.hits, cache.misses);
+
+	/*
+		the 000F rows again with adaptive delays, after enough reads to learn them; the
+		delays are slept with the bus held, so they are its hold time beyond the wire
+	*/
+	I2C_LegacyDelays delays;
+	Sim_Timing fixed, warm, adaptive;
+	u32 warmup = 40 * I2C_LEGACY_DECAY_STREAK;
+
+	Sim_Timing_GetCommand(0x000F, &fixed);
+	T(SimI2C_ConfigureLegacyDelays(mcu, 3, 50, 150, 150, I2C_LEGACY_DELAYS_ADAPTIVE, NULL));
+
+	for (u32 n = 0; n < warmup; n++)
+		T(run_command(0x000F));
+
+	Sim_Timing_GetCommand(0x000F, &warm);
+
+	for (u32 n = 0; n < iterations; n++)
+		T(run_command(0x000F));
+
+	Sim_Timing_GetCommand(0x000F, &adaptive);
+	T(SimI2C_ConfigureLegacyDelays(mcu, 3, 0, 0, 0, I2C_LEGACY_DELAYS_QUERY, &delays));
+	T(SimI2C_ConfigureLegacyDelays(mcu, 3, 50, 150, 150, 0, NULL));
+	printf("legacy delays:   000F fixed %.1f us (%.1f us held asleep), adaptive %.1f us (%.1f us) after %u reads, learned %u/%u/%u us\n",
+		Sim_Timing_TotalNs(&fixed) / 1000.0 / (fixed.count ? fixed.count : 1), fixed.sleep_ns / 1000.0 / (fixed.count ? fixed.count : 1),
+		(Sim_Timing_TotalNs(&adaptive) - Sim_Timing_TotalNs(&warm)) / 1000.0 / iterations,
+		(adaptive.sleep_ns - warm.sleep_ns) / 1000.0 / iterations, warmup, delays.before_us, delays.between_us, delays.after_us);
+
+	printf("\n%-6s %-24s\n", "bus", "totals (transactions)");
+
+	for (u8 port = 0; port < SIM_BUS_COUNT; port++) {
+		char label[8], desc[32];
+		Sim_Timing t;
+
+		Sim_Timing_GetBus(port, &t);
+		snprintf(label, sizeof(label), "%u", port);
+		snprintf(desc, sizeof(desc), "%llu", (unsigned long long)t.count);
+		print_row(label, desc, &t, 1);
+	}
+
+	svcCloseHandle(mcu);
+	svcCloseHandle(cam);
+#ifdef N3DS
+	svcCloseHandle(nfc);
+#endif
+	Sim_Shutdown();
+	return 0;
+}
@@ -0,0 +1,436 @@
+/*
+	Decodes the module's bus trace ring (command 0x0018, read from i2c::DEB) into
+	transactions and exports it as a VCD file (one SCL/SDA pair per bus) that
+	sigrok/PulseView can open next to a logic analyzer capture.
+
+	Without -i, boots the module against the default simulated devices, runs a short
+	workload in modeled real time (including an EEPROM that NACKs during its write
+	cycle, to show retries) and dumps the ring. -w saves the raw dump, -i decodes a saved one instead.
+
+	usage: i2c_trace [-i dump.bin] [-w dump.bin] [-v out.vcd] [-p scl_period_ns] [-q]
+*/
+
+#include <sim/sim.h>
+
+#include <i2c/trace.h>
+#include <i2c/i2c.h>
+#include <3ds/err.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACE_FILE_MAGIC 0x54433249 // "I2CT"
+
+typedef struct TraceFileHeader {
+	u32 magic;
+	u32 sequence; // sequence number after the last record
+	u32 count;
+	u32 entry_size;
+} TraceFileHeader;
+
+static const char *const service_names[16] = {
+	"MCU", "CAM", "LCD", "DEB", "HID", "IR", "EEP", "NFC", "QTM",
+};
+
+static I2C_TraceEntry entries[I2C_TRACE_RING_SIZE];
+static u64 entry_ns[I2C_TRACE_RING_SIZE];
+static u32 n_entries, sequence;
+
+// capture
+
+static void capture(void)
+{
+	Handle mcu, cam, eep, deb;
+	u8 buf[8] = { 1, 2, 3, 4, 5, 6, 7, 8 }, value;
+	u16 value16;
+
+	Sim_TimingConfig config = Sim_DefaultTiming;
+
+	config.realtime_scale = 1.0; // so the record ticks follow the modeled wire time
+	Sim_Timing_Configure(&config);
+
+	Sim_AttachDefaultDevices();
+	((Sim_Eeprom *)Sim_GetDefaultDevice(14))->write_cycle_ticks = SIM_TICKS_PER_SECOND / 20000; // 50us
+	Sim_Boot();
+
+	T(SimI2C_Connect(&mcu, "i2c::MCU"));
+	T(SimI2C_Connect(&cam, "i2c::CAM"));
+	T(SimI2C_Connect(&eep, "i2c::EEP"));
+	T(SimI2C_Connect(&deb, "i2c::DEB"));
+
+	T(SimI2C_GetTrace(deb, entries, I2C_TRACE_RING_SIZE, I2C_TRACE_DUMP_RESET, &n_entries, &sequence));
+
+	T(SimI2C_WriteRegister8(mcu, 3, 0x20, 0x5A));
+	T(SimI2C_ReadRegister8(mcu, 3, 0x20, &value));
+	T(SimI2C_ReadRegisters8(mcu, 3, 0x20, buf, 4));
+	T(SimI2C_WriteRegister16(cam, 1, 0x3010, 0xBEEF));
+	T(SimI2C_ReadRegister16(cam, 1, 0x3010, &value16));
+	T(SimI2C_WriteRegisters8(eep, 14, 0x00, buf, sizeof(buf)));
+	T(SimI2C_ReadRegister8(eep, 14, 0x00, &value)); // NACKed until the write cycle ends
+
+	T(SimI2C_GetTrace(deb, entries, I2C_TRACE_RING_SIZE, I2C_TRACE_DUMP_RESET, &n_entries, &sequence));
+
+	svcCloseHandle(mcu);
+	svcCloseHandle(cam);
+	svcCloseHandle(eep);
+	svcCloseHandle(deb);
+	Sim_Shutdown();
+}
+
+static int save(const char *path)
+{
+	TraceFileHeader hdr = { TRACE_FILE_MAGIC, sequence, n_entries, sizeof(I2C_TraceEntry) };
+	FILE *f = fopen(path, "wb");
+
+	if (!f || fwrite(&hdr, sizeof(hdr), 1, f) != 1 || fwrite(entries, sizeof(I2C_TraceEntry), n_entries, f) != n_entries) {
+		perror(path);
+		return -1;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static int load(const char *path)
+{
+	TraceFileHeader hdr;
+	FILE *f = fopen(path, "rb");
+
+	if (!f || fread(&hdr, sizeof(hdr), 1, f) != 1) {
+		perror(path);
+		return -1;
+	}
+
+	if (hdr.magic != TRACE_FILE_MAGIC || hdr.entry_size != sizeof(I2C_TraceEntry) || hdr.count > I2C_TRACE_RING_SIZE ||
+		fread(entries, sizeof(I2C_TraceEntry), hdr.count, f) != hdr.count) {
+		fprintf(stderr, "%s: not a trace dump\n", path);
+		return -1;
+	}
+
+	n_entries = hdr.count;
+	sequence = hdr.sequence;
+	fclose(f);
+	return 0;
+}
+
+// decoding
+
+static u8 entry_bus(const I2C_TraceEntry *e)
+{
+	return e->flags & I2C_TRACE_FLAG_BUS_MASK;
+}
+
+static bool entry_ack(const I2C_TraceEntry *e)
+{
+	return e->flags & I2C_TRACE_FLAG_ACK;
+}
+
+static const char *entry_service(const I2C_TraceEntry *e)
+{
+	const char *name = service_names[e->flags >> I2C_TRACE_SESSION_SHIFT];
+	return name ? name : "?";
+}
+
+// 32-bit ticks to monotonic ns relative to the first record; records from different
+// buses may be slightly out of order, so deltas are taken as signed
+static void unwrap_ticks(void)
+{
+	s64 ticks = 0, min = 0;
+
+	for (u32 i = 0; i < n_entries; i++) {
+		if (i)
+			ticks += (s32)(entries[i].tick - entries[i - 1].tick);
+		if (ticks < min)
+			min = ticks;
+		entry_ns[i] = (u64)ticks; // rebased below
+	}
+
+	for (u32 i = 0; i < n_entries; i++)
+		entry_ns[i] = (u64)((s64)entry_ns[i] - min) * 1000000000ULL / SIM_TICKS_PER_SECOND;
+}
+
+typedef struct Transaction {
+	bool open;
+	u32 first;        // index of the first record
+	char text[512];
+	size_t len;
+	u32 cancelled_in_row;
+} Transaction;
+
+__attribute__((format(printf, 2, 3)))
+static void append(Transaction *t, const char *fmt, ...)
+{
+	va_list va;
+
+	if (t->len >= sizeof(t->text) - 16)
+		return; // long burst, the summary line is enough
+
+	va_start(va, fmt);
+	t->len += vsnprintf(t->text + t->len, sizeof(t->text) - t->len, fmt, va);
+	va_end(va);
+}
+
+static char ack_char(const I2C_TraceEntry *e)
+{
+	return (e->flags & I2C_TRACE_FLAG_ACK) ? '+' : '-';
+}
+
+static void decode(void)
+{
+	Transaction txn[4] = { 0 };
+	u32 transactions = 0, cancelled = 0, nacks = 0, storms = 0;
+
+	printf("%u record(s), sequence %u%s\n\n", n_entries, sequence,
+		sequence != n_entries ? " (older records overwritten or reset)" : "");
+	printf("%11s %-3s %-3s %5s  %s\n", "time(us)", "bus", "svc", "devid", "transaction (S start, Sr repeated start, P stop, X cancel, +/- ACK/NACK)");
+
+	for (u32 i = 0; i < n_entries; i++) {
+		const I2C_TraceEntry *e = &entries[i];
+		Transaction *t = &txn[entry_bus(e)];
+
+		if (!t->open) {
+			t->open = true;
+			t->first = i;
+			t->len = 0;
+		}
+
+		switch (e->phase)
+		{
+		case I2C_TRACE_SELECT:
+		case I2C_TRACE_BEGIN_READ:
+			append(t, "%s %02X%c ", t->len ? "Sr" : "S", e->data, ack_char(e));
+			break;
+		case I2C_TRACE_REGISTER:
+			append(t, "[%02X]%c ", e->data, ack_char(e));
+			break;
+		case I2C_TRACE_WRITE:
+		case I2C_TRACE_FINISH_WRITE:
+		case I2C_TRACE_READ:
+		case I2C_TRACE_FINISH_READ:
+			append(t, "%02X%c ", e->data, ack_char(e));
+			break;
+		case I2C_TRACE_CANCEL:
+			append(t, "X");
+			break;
+		default:
+			append(t, "?%u ", e->phase);
+			break;
+		}
+
+		if (!entry_ack(e) && e->phase != I2C_TRACE_FINISH_READ && e->phase != I2C_TRACE_CANCEL)
+			nacks++;
+
+		if (e->phase == I2C_TRACE_FINISH_WRITE || e->phase == I2C_TRACE_FINISH_READ || e->phase == I2C_TRACE_CANCEL) {
+			const I2C_TraceEntry *first = &entries[t->first];
+
+			if (e->phase != I2C_TRACE_CANCEL)
+				append(t, "P");
+
+			printf("%11.3f %-3u %-3s %5u  %s", entry_ns[t->first] / 1000.0, entry_bus(first), entry_service(first), first->devid, t->text);
+
+			if (e->phase == I2C_TRACE_CANCEL) {
+				cancelled++;
+
+				if (++t->cancelled_in_row == 3)
+					storms++;
+				if (t->cancelled_in_row >= 3)
+					printf("  <- retry %u", t->cancelled_in_row);
+			} else
+				t->cancelled_in_row = 0;
+
+			printf("\n");
+			t->open = false;
+			transactions++;
+		}
+	}
+
+	for (u32 bus = 0; bus < 4; bus++)
+		if (txn[bus].open)
+			printf("%11.3f %-3u %-3s %5u  %s(incomplete)\n", entry_ns[txn[bus].first] / 1000.0, bus,
+				entry_service(&entries[txn[bus].first]), entries[txn[bus].first].devid, txn[bus].text);
+
+	printf("\n%u transaction(s), %u cancelled, %u NACK(s), %u retry storm(s) (3+ cancels in a row)\n",
+		transactions, cancelled, nacks, storms);
+}
+
+// VCD export
+
+typedef struct VcdEvent {
+	u64 ns;
+	u32 order;
+	u8 signal; // bus * 2 + (0 scl, 1 sda)
+	u8 value;
+} VcdEvent;
+
+static VcdEvent *events;
+static u32 n_events, max_events;
+
+static void vcd_event(u64 ns, u8 bus, u8 sda, u8 value)
+{
+	if (n_events == max_events) {
+		max_events = max_events ? max_events * 2 : 4096;
+		events = realloc(events, max_events * sizeof(VcdEvent));
+	}
+
+	events[n_events] = (VcdEvent){ ns, n_events, (u8)(bus * 2 + sda), value };
+	n_events++;
+}
+
+static int vcd_compare(const void *a, const void *b)
+{
+	const VcdEvent *x = a, *y = b;
+
+	if (x->ns != y->ns)
+		return x->ns < y->ns ? -1 : 1;
+	return x->order < y->order ? -1 : 1;
+}
+
+// one byte plus the ACK bit, MSB first; returns the time after the ninth clock
+static u64 vcd_byte(u64 t, u8 bus, u8 value, bool ack, u64 period)
+{
+	for (int bit = 8; bit >= 0; bit--) {
+		u8 sda = bit ? (value >> (bit - 1)) & 1 : !ack;
+
+		vcd_event(t, bus, 1, sda);
+		vcd_event(t + period / 4, bus, 0, 1);
+		vcd_event(t + period * 3 / 4, bus, 0, 0);
+		t += period;
+	}
+
+	return t;
+}
+
+static int export_vcd(const char *path, u64 period)
+{
+	u64 cursor[4] = { 0 };
+	bool busy[4] = { false };
+
+	for (u32 i = 0; i < n_entries; i++) {
+		const I2C_TraceEntry *e = &entries[i];
+		u8 bus = entry_bus(e);
+		u64 t = entry_ns[i] > cursor[bus] ? entry_ns[i] : cursor[bus];
+
+		switch (e->phase)
+		{
+		case I2C_TRACE_SELECT:
+		case I2C_TRACE_BEGIN_READ:
+			if (busy[bus]) { // repeated start: release SDA, raise SCL, then start
+				vcd_event(t, bus, 1, 1);
+				vcd_event(t + period / 2, bus, 0, 1);
+				t += period / 2;
+			}
+			vcd_event(t + period / 4, bus, 1, 0);
+			vcd_event(t + period / 2, bus, 0, 0);
+			t = vcd_byte(t + period / 2, bus, e->data, entry_ack(e), period);
+			busy[bus] = true;
+			break;
+		case I2C_TRACE_REGISTER:
+		case I2C_TRACE_WRITE:
+		case I2C_TRACE_READ:
+		case I2C_TRACE_FINISH_WRITE:
+		case I2C_TRACE_FINISH_READ:
+			t = vcd_byte(t, bus, e->data, entry_ack(e), period);
+			break;
+		}
+
+		if (e->phase == I2C_TRACE_FINISH_WRITE || e->phase == I2C_TRACE_FINISH_READ || e->phase == I2C_TRACE_CANCEL) {
+			vcd_event(t, bus, 1, 0); // stop: SDA low, SCL high, SDA high
+			vcd_event(t + period / 4, bus, 0, 1);
+			vcd_event(t + period / 2, bus, 1, 1);
+			t += period / 2;
+			busy[bus] = false;
+		}
+
+		cursor[bus] = t;
+	}
+
+	qsort(events, n_events, sizeof(VcdEvent), vcd_compare);
+
+	FILE *f = fopen(path, "w");
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	fprintf(f, "$comment i2c sysmodule bus trace, %u record(s) $end\n", n_entries);
+	fprintf(f, "$timescale 1ns $end\n$scope module i2c $end\n");
+	for (u8 bus = 0; bus < 3; bus++)
+		fprintf(f, "$var wire 1 %c scl%u $end\n$var wire 1 %c sda%u $end\n", '!' + bus * 2, bus, '!' + bus * 2 + 1, bus);
+	fprintf(f, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+	for (u8 sig = 0; sig < 6; sig++)
+		fprintf(f, "1%c\n", '!' + sig);
+	fprintf(f, "$end\n");
+
+	u64 last = (u64)-1;
+
+	for (u32 i = 0; i < n_events; i++) {
+		if (events[i].ns != last)
+			fprintf(f, "#%llu\n", (unsigned long long)(last = events[i].ns));
+		fprintf(f, "%u%c\n", events[i].value, '!' + events[i].signal);
+	}
+
+	fclose(f);
+	printf("wrote %s: %u edge(s), SCL period %llu ns\n", path, n_events, (unsigned long long)period);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *in = NULL, *out = NULL, *vcd = NULL;
+	u64 period = Sim_Timing_SclPeriodNs(I2C_SCL_HIGH_DURATION(5)); // as set by I2C_Initialize
+	bool quiet = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:w:v:p:q")) != -1) {
+		switch (opt)
+		{
+		case 'i':
+			in = optarg;
+			break;
+		case 'w':
+			out = optarg;
+			break;
+		case 'v':
+			vcd = optarg;
+			break;
+		case 'p':
+			period = strtoull(optarg, NULL, 0);
+			break;
+		case 'q':
+			quiet = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-i dump.bin] [-w dump.bin] [-v out.vcd] [-p scl_period_ns] [-q]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (in) {
+		if (load(in))
+			return 1;
+	} else {
+#ifndef I2C_TRACE
+		fprintf(stderr, "module built without I2C_TRACE\n");
+		return 1;
+#endif
+		capture();
+	}
+
+	if (out && save(out))
+		return 1;
+
+	unwrap_ticks();
+
+	if (!quiet)
+		decode();
+
+	if (vcd && export_vcd(vcd, period ? period : 1))
+		return 1;
+
+	free(events);
+	return 0;
+}
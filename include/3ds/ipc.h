@@ -41,6 +41,13 @@ typedef enum
 	IPC_BUFFER_RW = IPC_BUFFER_R | IPC_BUFFER_W ///< Readable and Writable
 } IPC_BufferRights;
 
+#ifdef I2C_HOST
+ThreadLocalStorage *getThreadLocalStorage(void);
+
+// command buffer words are 32-bit, host pointers are not; the simulator translates them
+u32 IPC_PointerToWord(const void *ptr);
+void *IPC_WordToPointer(u32 word);
+#else
 static inline ThreadLocalStorage *getThreadLocalStorage(void)
 {
 	ThreadLocalStorage *tls;
@@ -48,6 +55,17 @@ static inline ThreadLocalStorage *getThreadLocalStorage(void)
 	return tls;
 }
 
+static inline u32 IPC_PointerToWord(const void *ptr)
+{
+	return (u32)ptr;
+}
+
+static inline void *IPC_WordToPointer(u32 word)
+{
+	return (void *)word;
+}
+#endif
+
 static inline u32 *getThreadCommandBuffer(void)
 {
 	return getThreadLocalStorage()->cmdbuf;
@@ -53,7 +53,7 @@ Result svcGetProcessId(u32 *id, Handle process);
 void   svcBreak(UserBreakType breakReason);
 void   svcSleepThread(u64 nanoseconds);
 Result svcCreateAddressArbiter(Handle *arbiter);
-Result svcArbitrateAddressNoTimeout(Handle arbiter, u32 addr, ArbitrationType type, s32 value);
+Result svcArbitrateAddressNoTimeout(Handle arbiter, uintptr_t addr, ArbitrationType type, s32 value);
 Result svcCreateEvent(Handle* event, ResetType reset_type);
 Result svcSignalEvent(Handle handle);
 s64 svcGetSystemTick(void);
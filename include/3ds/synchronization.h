@@ -35,6 +35,42 @@ void syncExit();
 extern void __dmb(void);
 #endif
 
+#ifdef I2C_HOST
+
+/*
+	The host build emulates the exclusive monitor with a compare-and-swap against the
+	value observed by the last load-exclusive of the calling thread.
+*/
+extern _Thread_local s32 __exclusive_value;
+
+static inline void __clrex(void)
+{
+}
+
+static inline s32 __ldrex(s32 *addr)
+{
+	return __exclusive_value = __atomic_load_n(addr, __ATOMIC_SEQ_CST);
+}
+
+static inline bool __strex(s32 *addr, s32 val)
+{
+	s32 expected = __exclusive_value;
+	return !__atomic_compare_exchange_n(addr, &expected, val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline u8 __ldrexb(u8 *addr)
+{
+	return (u8)(__exclusive_value = __atomic_load_n(addr, __ATOMIC_SEQ_CST));
+}
+
+static inline bool __strexb(u8 *addr, u8 val)
+{
+	u8 expected = (u8)__exclusive_value;
+	return !__atomic_compare_exchange_n(addr, &expected, val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#else
+
 static inline void __clrex(void)
 {
 	__asm__ __volatile__("clrex" ::: "memory");
@@ -70,13 +106,69 @@ static inline bool __strexb(u8 *addr, u8 val)
 	return res;
 }
 
+#endif
+
+// spin-wait hint: lets the other hardware thread of the core, or the bus, have the cycles
+static inline void __yield(void)
+{
+#if !defined(I2C_HOST) || defined(__arm__) || defined(__aarch64__)
+	__asm__ __volatile__("yield" ::: "memory");
+#elif defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/*
+	Spin-then-block locking, for critical sections shorter than a trip through the kernel.
+
+	A contended LightLock_LockSpin polls the lock word for up to max_spins rounds, and for
+	at most max_ticks system ticks if that is set, before it arbitrates like LightLock_Lock.
+	Spinning only pays off while the holder runs on another core: a holder on the same
+	core does not run until the spinner gives up, so the bound is what such a wait costs.
+
+	With adaptive set, the bound is also kept at twice the moving average of the recent
+	spins plus LIGHTLOCK_SPIN_MARGIN, close to what adaptive pthread mutexes do; a spin
+	that ends up arbitrating counts as zero rounds. A lock whose holders usually outlast
+	the spin soon polls only the margin, and one that is released within a few rounds
+	keeps spinning about as long as that takes.
+
+	The counters are updated by the thread that took the lock, while it holds it.
+*/
+#define LIGHTLOCK_SPIN_MARGIN      16
+#define LIGHTLOCK_SPIN_TICK_CHECKS 16 // rounds between two looks at the system tick
+
+typedef struct LightLockSpin
+{
+	u32 max_spins;  ///< poll rounds before arbitrating, 0 arbitrates at once
+	u32 max_ticks;  ///< system ticks to poll for at most, 0 for no time bound
+	bool adaptive;  ///< bound the rounds by the recent successful spins too
+	s32 average;    ///< moving average of the rounds spun, in adaptive mode
+	u32 contended;  ///< acquisitions that found the lock held
+	u32 spun;       ///< ... and got it while polling
+	u32 blocked;    ///< ... and arbitrated for it
+	u64 rounds;     ///< poll rounds in total
+} LightLockSpin;
+
+typedef enum LightLockWait
+{
+	LIGHTLOCK_FREE    = 0, ///< the lock was free, or already held by the caller (recursive locks)
+	LIGHTLOCK_SPUN    = 1, ///< taken while spinning
+	LIGHTLOCK_BLOCKED = 2, ///< taken after arbitrating
+} LightLockWait;
+
 void LightLock_Init(LightLock *lock);
 void LightLock_Lock(LightLock *lock);
+bool LightLock_TryLock(LightLock *lock); // true if the lock was taken
 void LightLock_Unlock(LightLock *lock);
+LightLockWait LightLock_LockSpin(LightLock *lock, LightLockSpin *spin);
 
 void RecursiveLock_Init(RecursiveLock *lock);
 void RecursiveLock_Lock(RecursiveLock *lock);
+bool RecursiveLock_TryLock(RecursiveLock *lock); // true if the lock was taken
 void RecursiveLock_Unlock(RecursiveLock *lock);
+LightLockWait RecursiveLock_LockSpin(RecursiveLock *lock, LightLockSpin *spin);
 
 void LightEvent_Init(LightEvent* event, ResetType reset_type);
 void LightEvent_Signal(LightEvent* event);
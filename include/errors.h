@@ -13,6 +13,7 @@
 // general os
 
 #define OS_MISALIGNED_ADDRESS            MAKERESULT(RL_USAGE, RS_INVALIDARG, RM_OS, RD_MISALIGNED_ADDRESS)
+#define OS_TIMEOUT                       MAKERESULT(RL_INFO , RS_STATUSCHANGED, RM_OS, RD_TIMEOUT) // 09401BFE
 
 // general i2c
 
@@ -22,5 +23,21 @@
 #define I2C_FATAL_FAIL                   MAKERESULT(RL_FATAL, RS_INTERNAL    , RM_I2C, RD_NO_DATA)
 #define I2C_NOT_IMPLEMENTED              MAKERESULT(RL_USAGE, RS_NOTSUPPORTED, RM_I2C, RD_NOT_IMPLEMENTED)
 
+// asynchronous transfers
+
+#define I2C_ASYNC_QUEUE_FULL             MAKERESULT(RL_TEMPORARY, RS_OUTOFRESOURCE, RM_I2C, RD_BUSY)
+#define I2C_ASYNC_NOTHING_DONE           MAKERESULT(RL_STATUS   , RS_NOTFOUND     , RM_I2C, RD_NOT_FOUND)
+
+// register snapshots
+
+#define I2C_SNAPSHOT_NOT_CONFIGURED      MAKERESULT(RL_USAGE, RS_INVALIDSTATE, RM_I2C, RD_NOT_INITIALIZED)
+
+// read cache
+
+#define I2C_CACHE_FULL                   MAKERESULT(RL_TEMPORARY, RS_OUTOFRESOURCE, RM_I2C, RD_OUT_OF_MEMORY)
+#define I2C_CACHE_OVERLAP                MAKERESULT(RL_USAGE    , RS_INVALIDARG   , RM_I2C, RD_ALREADY_EXISTS)
+#define I2C_CACHE_NOT_FOUND              MAKERESULT(RL_USAGE    , RS_NOTFOUND     , RM_I2C, RD_NOT_FOUND)
+#define I2C_CACHE_TTL_TOO_LONG           MAKERESULT(RL_USAGE    , RS_INVALIDARG   , RM_I2C, RD_OUT_OF_RANGE)
+
 
 #endif
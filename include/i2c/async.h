@@ -0,0 +1,67 @@
+#ifndef _I2C_ASYNC_H
+#define _I2C_ASYNC_H
+
+#include <3ds/types.h>
+#include <i2c/ipc.h>
+
+/*
+	Asynchronous transfers (commands 0x0019-0x001C).
+
+	A submit validates the request, copies write data into a request slot, queues the
+	slot on the bus of its device and replies with a ticket straight away. A single
+	driver thread, started with the first transfer queued, runs each bus queue in order
+	as non-blocking transfers (I2C_Transfer, i2c.h): it waits on the interrupts of all
+	three buses at once and steps whichever completed a phase, so transfers on different
+	buses overlap without a thread and a stack per bus. When a transfer is done the submitting session's
+	completion event (sticky, fetched with 0x0019) is signaled; the reap command returns
+	the oldest finished transfer, read data included, and clears the event once nothing
+	finished is left.
+
+	Posted writes (0x001D, then 0x0001/0x0002/0x0003/0x0005/0x0007) take the same path
+	but reply as soon as they are queued and are never reaped. A failed one leaves the
+	first error and a failure count on the session until a fence (0x001E) waits for the
+	session's posted writes to drain and returns and clears them. Any other command of
+	that session first waits for its posted writes, so it observes them as if they had
+	been synchronous. A posted write that finds no free slot, or whose session already
+	holds I2C_ASYNC_MAX_PER_SESSION of them, runs synchronously.
+
+	Asynchronous requests still queued when their session closes are dropped; one
+	already running finishes and is discarded. Posted writes run regardless.
+*/
+
+#define I2C_ASYNC_MAX_REQUESTS    8     // shared by all sessions
+#define I2C_ASYNC_MAX_PER_SESSION 4     // queued, running or finished but not reaped, posted writes included
+#define I2C_ASYNC_MAX_SIZE        0x200 // per transfer
+
+typedef enum I2C_AsyncOp {
+	I2C_ASYNC_READ_REGISTERS8         = 0,
+	I2C_ASYNC_WRITE_REGISTERS8        = 1,
+	I2C_ASYNC_POSTED_REPLACE_BITS8    = 2,
+	I2C_ASYNC_POSTED_WRITE_REGISTER8  = 3,
+	I2C_ASYNC_POSTED_WRITE_REGISTER16 = 4,
+} I2C_AsyncOp;
+
+#define I2C_ASYNC_IS_POSTED(op) ((op) >= I2C_ASYNC_POSTED_REPLACE_BITS8)
+
+typedef struct I2C_AsyncResult {
+	u32 ticket;
+	Result result; // of the transfer
+	u32 size;      // bytes read or written
+} I2C_AsyncResult;
+
+void I2C_Async_Init(void);
+void I2C_Async_Exit(void); // the driver finishes the queues, then it is joined
+
+Result I2C_Async_GetEvent(I2C_SessionData *session, Handle *event);
+Result I2C_Async_Submit(I2C_SessionData *session, I2C_AsyncOp op, u8 devid, u8 regid, const u8 *data, u32 size, u32 *ticket);
+Result I2C_Async_Reap(I2C_SessionData *session, u8 *buf, u32 size, I2C_AsyncResult *out);
+
+// value and mask as the synchronous command takes them; mask is only used by I2C_ASYNC_POSTED_REPLACE_BITS8
+Result I2C_Async_Post(I2C_SessionData *session, u16 cmd_id, I2C_AsyncOp op, u8 devid, u16 regid, u16 value, u16 mask);
+void I2C_Async_Drain(I2C_SessionData *session);
+void I2C_Async_Fence(I2C_SessionData *session, Result *first_error, u32 *failures);
+
+void I2C_Async_InitSession(I2C_SessionData *session);
+void I2C_Async_ReleaseSession(I2C_SessionData *session);
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef _I2C_CACHE_H
+#define _I2C_CACHE_H
+
+#include <3ds/types.h>
+#include <i2c/i2c.h>
+
+/*
+	Read cache for slowly changing registers (commands 0x0022-0x0023), e.g. the MCU
+	battery level or temperature that several processes poll.
+
+	A client with access to a device opts a range of its registers in, as 8 bit (0x0009)
+	or 16 bit (0x000A) registers, with a time-to-live in system ticks of at most
+	I2C_CACHE_MAX_TTL_TICKS. Entries are shared by every session and stay until removed
+	(ttl 0). The counters of every entry are dumped by 0x0023, from i2c::DEB only. A single register read of a cached
+	register served within the ttl of its last bus read comes straight from the cache,
+	without the bus lock; otherwise it goes to the bus and the value read refills it.
+
+	Every write to a device, through any command, drops the cached values of that device
+	before it goes out. Registers with read side effects (interrupt flags that clear when
+	read) must not be cached.
+
+	Each entry is a sequence lock: the value is written only by a holder of the bus lock
+	of its device (a fill, an invalidation or a reconfiguration), and lock-free readers
+	that see the sequence change under them go to the bus instead.
+*/
+
+#define I2C_CACHE_MAX_ENTRIES   8
+#define I2C_CACHE_MAX_REGISTERS 16 // per entry
+#define I2C_CACHE_MAX_TTL_TICKS 13405592 // 50ms of the 268111856 Hz system tick, so no session serves another a stale value for long
+
+enum {
+	I2C_CACHE_REGISTERS16 = BIT(0), // the range is 16 bit registers, regid + 2 apart
+};
+
+enum {
+	I2C_CACHE_STATS_DUMP_RESET = BIT(0), // clear the counters after copying them out
+};
+
+// one configured entry, as returned by 0x0023
+typedef struct I2C_CacheStats {
+	u8 devid;
+	u8 flags;        // I2C_CACHE_*
+	u16 regid;
+	u16 count;       // registers
+	u16 reserved;
+	u32 ttl_ticks;
+	u32 hits;        // reads served from the cache
+	u32 misses;      // reads of a cached register that went to the bus
+	u64 bus_ticks;   // bus time of those misses
+	u64 saved_ticks; // hits times the average bus time of a miss
+} I2C_CacheStats;
+
+extern u32 I2C_CachedDevices; // devid mask of the configured entries
+
+void I2C_Cache_Init(void);
+
+// ttl_ticks 0 removes the entry configured with the same devid, regid and width
+Result I2C_Cache_Configure(u8 devid, u16 regid, u16 count, u32 ttl_ticks, u8 flags);
+u32 I2C_Cache_Dump(I2C_CacheStats *out, u32 max_entries, bool reset);
+
+// lock-free; true if the value was served from the cache
+bool I2C_Cache_Lookup(u8 devid, u16 regid, bool reg16, u16 *value);
+
+// called from i2c.c with the bus lock of devid held; start_tick is when the bus read began
+void I2C_Cache_Fill(u8 devid, u16 regid, bool reg16, u16 value, u64 start_tick);
+void I2C_Cache_InvalidateDevice(u8 devid);
+
+static inline bool I2C_Cache_IsCached(u8 devid)
+{
+	return devid < 32 && (I2C_CachedDevices & BIT(devid));
+}
+
+static inline bool I2C_Cache_ReadRegister8(u8 devid, u8 regid, u8 *out_value)
+{
+	u16 value;
+
+	if (!I2C_Cache_IsCached(devid) || !I2C_Cache_Lookup(devid, regid, false, &value))
+		return false;
+
+	*out_value = (u8)value;
+	return true;
+}
+
+static inline bool I2C_Cache_ReadRegister16(u8 devid, u16 regid, u16 *out_value)
+{
+	return I2C_Cache_IsCached(devid) && I2C_Cache_Lookup(devid, regid, true, out_value);
+}
+
+// with the bus lock of devid held, before a write to it goes out
+static inline void I2C_Cache_Invalidate(u8 devid)
+{
+	if (I2C_Cache_IsCached(devid))
+		I2C_Cache_InvalidateDevice(devid);
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef _I2C_FLIGHT_H
+#define _I2C_FLIGHT_H
+
+#include <3ds/synchronization.h>
+#include <3ds/types.h>
+
+/*
+	Single-flight register reads.
+
+	A register read first joins the in-flight read of the same kind, device, register and
+	length on its bus, if there is one: the first requester (the leader) reads the bus,
+	the later ones wait for it and get a copy of its result and data. The requesters are
+	whatever threads read a device at once, e.g. a session and the transfer driver running
+	its queued asynchronous reads; merging happens here, below the commands, so it does
+	not matter which command or thread issued a read.
+
+	A read is joinable from the moment its leader asks for the bus lock until the leader,
+	still holding it, has the data. Any write that completes before a joiner asks must
+	have held the bus lock before that point, so a joiner never gets data older than a
+	write it could have observed. Two clients reading a register that clears when read
+	both get the value read, instead of the second one getting it cleared.
+
+	Each service takes a single session (I2C_MAX_SESSIONS_PER_SERVICE) served by a single
+	thread, and the devices of two services never overlap, so two reads of one device can only meet when one of them is
+	the transfer driver's. A session's read therefore skips the flight table, and its
+	lock, unless the driver has a read of its own open on the bus; only the driver's reads
+	always look.
+
+	Reads longer than I2C_FLIGHT_MAX_SIZE, and reads that find no free slot, go to the bus
+	on their own. The transfer driver cannot block on a leader, so it polls for the data
+	instead each time the bus lock is released (the leader lands its flight before).
+*/
+
+#define I2C_FLIGHT_SLOTS    4    // per bus
+#define I2C_FLIGHT_MAX_SIZE 0x40
+
+typedef enum I2C_FlightKind {
+	I2C_FLIGHT_READ_REGISTERS8  = 0,
+	I2C_FLIGHT_READ_REGISTERS16 = 1,
+} I2C_FlightKind;
+
+typedef struct I2C_Flight {
+	LightEvent done;
+	u8 state; // I2C_FLIGHT_FREE / OPEN / CLOSED
+	u8 kind;
+	u8 devid;
+	u8 refs;  // the leader and its joiners still to copy the result
+	u16 regid;
+	u16 size;
+	bool ok;
+	bool driver;             // opened by the transfer driver
+	volatile bool published; // ok and data are valid, for joiners that poll
+	u8 data[I2C_FLIGHT_MAX_SIZE];
+} I2C_Flight;
+
+void I2C_Flight_Init(void);
+
+/*
+	NULL when the read has to go to the bus without merging. *leader is true if the
+	caller opened the flight and has to read the bus and call I2C_Flight_Complete;
+	otherwise it calls I2C_Flight_Wait (the transfer driver I2C_Flight_Poll).
+*/
+I2C_Flight *I2C_Flight_Join(u8 port, I2C_FlightKind kind, u8 devid, u16 regid, u32 size, bool *leader);
+
+// a session's read: NULL without taking the flight lock while the driver has no read open on the bus
+I2C_Flight *I2C_Flight_JoinSession(u8 port, I2C_FlightKind kind, u8 devid, u16 regid, u32 size, bool *leader);
+
+// leader, with the bus lock held; returns how many joiners the data went to
+u32 I2C_Flight_Complete(u8 port, I2C_Flight *flight, bool ok, const void *data);
+
+// joiner: waits for the leader and copies its data, returns its result
+bool I2C_Flight_Wait(u8 port, I2C_Flight *flight, void *data);
+
+// joiner that cannot block: false while the leader has not published its data, else as I2C_Flight_Wait
+bool I2C_Flight_Poll(u8 port, I2C_Flight *flight, void *data, bool *ok);
+
+// the open flights of a bus the transfer driver leads, and the joiners waiting on open flights
+void I2C_Flight_Count(u8 port, u32 *driver_open, u32 *joiners);
+
+#endif
@@ -2,8 +2,51 @@
 #define _I2C_GLOBALS_H
 
 #include <3ds/synchronization.h>
+#include <3ds/err.h>
+#include <i2c/i2c.h>
 
-extern RecursiveLock g_I2C_BusLocks[3];
-extern Handle g_I2C_BusInterrupts[3];
+/*
+	Per-bus state, one cache line (or more) per bus so that threads working on different
+	buses from different cores (core 3 for CAM/HID/QTM on N3DS, the system core for the
+	rest) never write to a line the other bus's threads read. The first line holds what
+	every phase touches: the lock, the interrupt, the register block and the timeout flag;
+	the SCL profile and the spin counters follow.
+*/
+typedef struct __attribute__((aligned(I2C_CPU_CACHE_LINE))) I2C_Bus {
+	RecursiveLock lock;
+	Handle interrupt;
+	Handle lock_waiter;           // signaled on unlock, set while a non-blocking transfer waits for the lock
+	volatile I2C_BusRegset *regs; // NULL on the host build, see hal.h
+	u16 scl;                      // SCL register value programmed by I2C_ConfigureBus
+	bool timed_out;               // a data phase timed out since the last successful I2C_BeginRead
+	u8 scl_devices;               // devices with their own SCL, loaded when they are selected (I2C_TuneScl)
+	u16 base_scl;                 // SCL of the other devices while scl_devices is set
+	s64 timeout_ns;               // interrupt wait of one phase at scl
+	LightLockSpin spin;           // spin-then-block tuning and counters of lock
+} I2C_Bus;
+
+_Static_assert(offsetof(I2C_Bus, timed_out) < I2C_CPU_CACHE_LINE, "the fields of every phase share the first line");
+
+extern I2C_Bus g_I2C_Buses[3];
+
+/*
+	A bus lock held for anything but bus traffic (cache reconfiguration, the dumps), without
+	the lock stats of I2C_LockBus (i2c.c). Every release goes through I2C_ReleaseBus: the
+	transfer driver waits for a held bus without a timeout, on the lock_waiter event.
+*/
+static inline void I2C_HoldBus(u8 port) {
+	RecursiveLock_Lock(&g_I2C_Buses[port].lock);
+}
+
+static inline void I2C_ReleaseBus(u8 port) {
+	RecursiveLock_Unlock(&g_I2C_Buses[port].lock);
+	
+	__dmb();
+	
+	Handle waiter = *(volatile Handle *)&g_I2C_Buses[port].lock_waiter;
+	
+	if (waiter)
+		T(svcSignalEvent(waiter));
+}
 
 #endif
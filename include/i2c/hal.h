@@ -0,0 +1,45 @@
+#ifndef _I2C_HAL_H
+#define _I2C_HAL_H
+
+#include <3ds/types.h>
+#include <i2c/globals.h>
+#include <i2c/i2c.h>
+
+/*
+	Bus register access. On hardware these are plain MMIO accesses through the register
+	block of the bus (I2C_Bus.regs), on the host build (I2C_HOST) they are routed to the
+	simulated bus in host/sim.
+*/
+
+// register blocks of the three buses
+#define I2C_BUS_ADDR(port) ((port) == 0 ? 0x1EC61000 : (port) == 1 ? 0x1EC44000 : 0x1EC48000)
+
+#ifdef I2C_HOST
+
+u16 I2C_HAL_ReadRegister(u8 port, size_t offset);
+void I2C_HAL_WriteRegister(u8 port, size_t offset, u16 value);
+void I2C_HAL_Spinwait(u32 n);
+
+#define I2C_REG_READ(port, reg) I2C_HAL_ReadRegister(port, offsetof(I2C_BusRegset, reg))
+#define I2C_REG_WRITE(port, reg, val) I2C_HAL_WriteRegister(port, offsetof(I2C_BusRegset, reg), val)
+
+static inline void spinwait(u32 n) {
+	I2C_HAL_Spinwait(n);
+}
+
+#else
+
+// a port known at compile time (the fast paths, i2c.c) addresses its block directly
+#define I2C_BUS_REGSET(port) \
+	(__builtin_constant_p(port) ? (volatile I2C_BusRegset *)I2C_BUS_ADDR(port) : g_I2C_Buses[port].regs)
+
+#define I2C_REG_READ(port, reg) (I2C_BUS_REGSET(port)->reg)
+#define I2C_REG_WRITE(port, reg, val) (I2C_BUS_REGSET(port)->reg = (val))
+
+static inline void spinwait(u32 n) {
+	for (u32 i = n; i > 2; i -= 2) { }
+}
+
+#endif
+
+#endif
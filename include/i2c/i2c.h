@@ -27,6 +27,13 @@ typedef struct __attribute__((packed)) I2C_BusRegset {
 	vu16 SCL;
 } I2C_BusRegset;
 
+// ARM11 MPCore; the host build separates for its own (x86, ARMv8) lines
+#ifdef I2C_HOST
+#define I2C_CPU_CACHE_LINE 64
+#else
+#define I2C_CPU_CACHE_LINE 32
+#endif
+
 typedef struct I2C_DeviceConfig {
 	u8 port;
 	u8 write_addr;
@@ -50,8 +57,15 @@ enum {
 #define I2C_SCL_HIGH_DURATION(val) ((val & 0x1F) << 8)
 
 void I2C_Initialize();
+const I2C_DeviceConfig *I2C_GetDeviceConfig(u8 devid);
+u32 I2C_GetDeviceAccessMask(I2C_SessionType session_type);
 bool I2C_CheckDeviceAccess(I2C_SessionType session_type, u8 devid);
 
+// bit of devid in a device access mask; devids that cannot be represented map to every bit, which no mask covers
+static inline u32 I2C_DevidMask(u8 devid) {
+	return devid < 32 ? (u32)BIT(devid) : 0xFFFFFFFF;
+}
+
 bool I2C_ReplaceRegisterBits8(u8 devid, u8 regid, u8 value, u8 mask);
 bool I2C_ReplaceRegisterBits16(u8 devid, u16 regid, u16 value, u16 mask);
 
@@ -65,15 +79,187 @@ bool I2C_ReadRegister16(u8 devid, u16 regid, u16 *out_value);
 bool I2C_WriteRegisters8(u8 devid, u8 regid, const u8 *buf, u32 size);
 bool I2C_WriteRegisters16(u8 devid, u16 regid, const u16 *buf, u32 count);
 
+// one entry of a register table, e.g. a camera mode switch
+typedef struct I2C_RegisterWrite16 {
+	u16 regid;
+	u16 value;
+	u32 delay_us; // slept after this write, with the bus released
+} I2C_RegisterWrite16;
+
+/*
+	writes the table in order; entries whose registers follow each other (regid + 2) go out
+	as one burst, and every burst up to a delay runs under one hold of the bus lock. on
+	failure *failed_index is the first entry of the burst that failed, count on success
+*/
+bool I2C_WriteRegisterTable16(u8 devid, const I2C_RegisterWrite16 *table, u32 count, u32 *failed_index);
+
 bool I2C_ReadRegisters8(u8 devid, u8 regid, u8 *buf, u32 size);
 bool I2C_ReadRegisters16(u8 devid, u16 regid, u16 *buf, u32 count);
 bool I2C_ReadRegisters8Legacy(u8 devid, u8 regid, u8 *buf, u32 size);
 
+/*
+	Delays of the legacy read (0x000F) of each device, slept with the bus lock held: before
+	every attempt, between the register write and the read, and after the read. They
+	default to the 50/150/150 us the original module sleeps.
+
+	With I2C_LEGACY_DELAYS_ADAPTIVE the configured delays are ceilings and the read learns
+	the shortest ones its device still ACKs on the first try: a NACKed select raises the
+	delays before it (before, and after, which separates it from the previous read), a
+	NACKed read start raises the delay between, each to twice its value up to its ceiling;
+	I2C_LEGACY_DECAY_STREAK first-try reads in a row take an eighth off all three. Only
+	devices that NACK while they settle can be learned, not ones that return stale data,
+	so this is opt-in per device.
+*/
+#define I2C_LEGACY_DELAY_MAX_US 5000
+#define I2C_LEGACY_DECAY_STREAK 16
+
+enum {
+	I2C_LEGACY_DELAYS_ADAPTIVE = BIT(0), // learn the shortest delays up to the configured ones
+	I2C_LEGACY_DELAYS_QUERY    = BIT(1), // 0x0024: only reply the current delays
+};
+
+typedef struct I2C_LegacyDelays {
+	u16 before_us;
+	u16 between_us;
+	u16 after_us;
+	u16 flags;   // I2C_LEGACY_DELAYS_ADAPTIVE
+	u32 reads;   // legacy reads since the device was configured
+	u32 retries; // NACKed attempts, each one retried unless it was the last one allowed
+} I2C_LegacyDelays;
+
+void I2C_LegacyDelays_Init(void);
+
+// takes the bus lock of devid; resets the learned delays and the counters
+Result I2C_ConfigureLegacyDelays(u8 devid, u16 before_us, u16 between_us, u16 after_us, u16 flags);
+// the delays in use, learned ones in adaptive mode
+Result I2C_GetLegacyDelays(u8 devid, I2C_LegacyDelays *out);
+
+// same as the functions above, on the constant port and address of the hottest devices (i2c.c)
+bool I2C_FastReadRegister8(u8 devid, u8 regid, u8 *out_value);
+bool I2C_FastWriteRegister8(u8 devid, u8 regid, u8 value);
+bool I2C_FastReadRegisters8(u8 devid, u8 regid, u8 *buf, u32 size);
+
+/*
+	SCL tuning (0x0025, i2c::DEB only): finds how fast the bus of devid can be clocked for that device.
+	Settings from I2C_SCL_TUNE_SETTINGS - 1 down to 0 for both the low and high duration
+	are tried slowest first; at each one the register is read, with one attempt and no
+	retries, iterations times. A read-only register is compared against its value at the
+	slowest setting, so it must not change on its own; with I2C_SCL_TUNE_SCRATCH a pattern
+	is written to the register and read back instead, and the register gets its value
+	back afterwards.
+
+	Each setting is programmed only while its iterations run, under the bus lock, and the
+	current one is restored before other devices get the bus; a scratch sweep keeps the bus
+	from its first read to the restore, so no other command sees a pattern. The sweep stops
+	after the first setting with errors; *best is the index of the fastest clean one.
+
+	The bus is shared, so I2C_SCL_TUNE_APPLY never programs it: the fastest clean setting
+	becomes devid's own SCL, loaded whenever devid is selected, and the other devices of the
+	bus keep running at the SCL it had before its first device got one. I2C_SCL_TUNE_RESET
+	drops devid's own SCL without a sweep.
+*/
+#define I2C_SCL_TUNE_SETTINGS       32
+#define I2C_SCL_TUNE_MAX_ITERATIONS 256
+#define I2C_SCL_TUNE_NONE           0xFFFFFFFF
+
+enum {
+	I2C_SCL_TUNE_SCRATCH = BIT(0), // regid may be written, verify written patterns
+	I2C_SCL_TUNE_APPLY   = BIT(1), // select devid at the fastest clean setting from now on
+	I2C_SCL_TUNE_RESET   = BIT(2), // no sweep, devid runs at the SCL of the other devices again
+};
+
+typedef struct I2C_SclTuneResult {
+	u16 scl;          // SCL register value
+	u16 errors;       // failed or mismatched iterations
+	u32 period_ns;    // SCL period of the setting
+	u32 iteration_ns; // average time of one iteration (a read, or a write and a read)
+} I2C_SclTuneResult;
+
+Result I2C_TuneScl(u8 devid, u8 regid, u32 iterations, u8 flags, I2C_SclTuneResult *results, u32 max_results, u32 *count, u32 *best);
+u16 I2C_GetDeviceScl(u8 devid); // what devid is selected at
+
+// one burst of a batch: size bytes starting at regid of devid, stored at buf + offset
+typedef struct I2C_ReadBurst {
+	u8 devid;
+	u8 regid;
+	u16 size;
+	u16 offset;
+} I2C_ReadBurst;
+
+// consecutive bursts on the same bus run under one hold of its lock; stops at the first failed burst
+bool I2C_ReadRegisters8Bursts(const I2C_ReadBurst *bursts, u32 n_bursts, u8 *buf);
+
 #ifdef N3DS
 bool I2C_ReadDeviceRaw(u8 devid, u8 *out_value);
 bool I2C_WriteDeviceRawMulti(u8 devid, const u8 *buf, u32 size);
 bool I2C_ReadDeviceRawMulti(u8 devid, u8 *buf, u32 size);
 #endif
 
+/*
+	Non-blocking transfers, for a driver that runs one transfer on each bus at once from
+	a single thread (async.c). A transfer is stepped one phase at a time: the driver waits
+	for the interrupt of every bus that has a phase on the wire, or for its timeout, and
+	steps the bus it got. Each one issues the same phases, retries, bus recovery, trace
+	records and stats hooks as the blocking function it is named after, and holds the bus
+	lock from its first phase to its last.
+*/
+typedef enum I2C_TransferOp {
+	I2C_TRANSFER_READ_REGISTERS8  = 0, // data receives size bytes
+	I2C_TRANSFER_WRITE_REGISTERS8 = 1, // size bytes from data
+	I2C_TRANSFER_REPLACE_BITS8    = 2, // data[0] value, data[1] mask
+	I2C_TRANSFER_WRITE_REGISTER8  = 3, // data[0]
+	I2C_TRANSFER_WRITE_REGISTER16 = 4, // data[0] low byte, data[1] high byte
+} I2C_TransferOp;
+
+typedef enum I2C_TransferState {
+	I2C_TRANSFER_LOCKING = 0, // waiting for the bus lock
+	I2C_TRANSFER_PHASE   = 1, // waiting for the interrupt of the phase on the wire
+	I2C_TRANSFER_DONE    = 2,
+} I2C_TransferState;
+
+typedef struct I2C_Transfer {
+	u8 op;            // I2C_TransferOp
+	u8 state;         // I2C_TransferState
+	u8 devid;
+	u8 port;
+	u16 regid;
+	bool ok;          // once done
+	bool contended;   // the bus lock was held when the transfer first asked for it
+	u8 phase;         // the rest is private to i2c.c
+	u8 failed_phase;  // the phase a bus recovery runs for
+	u8 tries;
+	u8 trace_data;
+	bool lock_requested;
+	bool joined;      // a read merged into an identical one in flight, which it polls for
+	bool reading;
+	bool timed_out;
+	bool clocked_out;
+	u8 scratch[2];
+	u32 size;
+	u32 index;
+	u32 count;        // bytes of the current read or write
+	u8 *data;
+	u8 *buf;          // data or scratch
+	u32 trace_tick;
+	u64 phase_tick;
+	struct I2C_Flight *flight;
+} I2C_Transfer;
+
+void I2C_Transfer_Init(I2C_Transfer *xfer, I2C_TransferOp op, u8 devid, u16 regid, u8 *data, u32 size);
+
+/*
+	takes the bus lock and puts the first phase on the wire; false while another thread
+	holds the lock, in which case wake is signaled when it is released (a driver waiting
+	on other objects as well should still retry now and then). A read that joined one in
+	flight is done as soon as this finds the data of its leader.
+*/
+bool I2C_Transfer_Begin(I2C_Transfer *xfer, Handle wake);
+
+// the phase on the wire completed (interrupted) or timed out, puts the next one out
+void I2C_Transfer_Step(I2C_Transfer *xfer, bool interrupted);
+
+// nanoseconds until the phase on the wire times out
+s64 I2C_Transfer_TimeLeft(const I2C_Transfer *xfer);
+
 
 #endif
@@ -1,7 +1,9 @@
 #ifndef _I2C_IPC_H
 #define _I2C_IPC_H
 
+#include <3ds/synchronization.h>
 #include <3ds/types.h>
+#include <i2c/snapshot.h>
 #include <i2c/i2c.h>
 
 #ifdef N3DS
@@ -12,15 +14,36 @@
 #define I2C_OUTPUT_STATICBUF_SIZE 0x20
 #endif
 
-typedef struct I2C_SessionData
+/*
+	The fields the worker reads on every command come first, then the ones the main
+	thread uses to hand sessions over. The snapshot and the static buffers start on a
+	cache line of their own and the struct is padded to whole lines, so a worker filling
+	its buffers never writes to a line another worker (on another core on N3DS) reads.
+*/
+typedef struct __attribute__((aligned(I2C_CPU_CACHE_LINE))) I2C_SessionData
 {
-	Handle thread;
 	Handle session; // needs to be freed in thread itself!
 	I2C_SessionType session_type;
+	u32 device_mask; // devids this session may access, see I2C_GetDeviceAccessMask
+	Handle async_event; // completion event of the asynchronous transfers, created on request
+	u32 async_next_ticket;
+	u32 async_requests; // asynchronous transfers not reaped yet
+	bool posted_writes; // routine writes are acknowledged once queued, see async.h
+	u32 posted_pending; // queued or running
+	Result posted_error; // first failed posted write since the last fence
+	u32 posted_failures;
+	LightEvent posted_drained; // sticky, signaled while nothing is pending
+	Handle thread; // session worker, started on the first connect and reused for every later one
+	Handle wake; // signaled when a session is handed to the worker, or on shutdown
+	Handle pending; // accepted session the worker has not picked up yet
+	bool shutdown;
+	I2C_Snapshot snapshot __attribute__((aligned(I2C_CPU_CACHE_LINE))); // register ranges read by 0x0020, see snapshot.h
 	u8 input_staticbuf[I2C_INPUT_STATICBUF_SIZE];
 	u8 output_staticbuf[I2C_OUTPUT_STATICBUF_SIZE];
 } I2C_SessionData;
 
+// validates and runs the request in the thread command buffer, without the instrumentation around it
+void I2C_DispatchIPC(I2C_SessionData *session);
 void I2C_HandleIPC(I2C_SessionData *session);
 
 #endif
@@ -0,0 +1,72 @@
+#ifndef _I2C_MPSC_H
+#define _I2C_MPSC_H
+
+#include <3ds/synchronization.h>
+#include <3ds/types.h>
+#include <3ds/svc.h>
+
+/*
+	Bounded lock-free multi-producer, single-consumer queue of pointers, used to hand
+	transfers to the transfer driver.
+
+	Producers claim a cell by moving the tail with ldrex/strex, write the item and then
+	publish it through the cell's sequence number; the single consumer owns the head and
+	hands each cell back to the producers one lap later. Nothing blocks on a push, and a
+	full queue fails it instead of waiting.
+
+	The consumer sleeps on a oneshot LightEvent that is only signaled when a push makes
+	the queue non-empty (published but not popped items going from 0 to 1), so a burst
+	of submissions to a busy bus costs no arbitration. A producer preempted between
+	claiming its cell and publishing it holds up the ones after it; the consumer backs
+	off for I2C_MPSC_STALL_NS while that lasts instead of sleeping on the event.
+
+	A consumer that also waits on kernel objects (the transfer driver) passes a kernel
+	event to I2C_Mpsc_Init, which is then signaled in place of the LightEvent.
+*/
+
+#define I2C_MPSC_CAPACITY 8 // a power of two
+#define I2C_MPSC_STALL_NS 10000LL
+
+_Static_assert(!(I2C_MPSC_CAPACITY & (I2C_MPSC_CAPACITY - 1)), "the capacity must be a power of two");
+
+typedef struct I2C_MpscCell {
+	s32 sequence; // position + 1 once published, position + capacity once popped
+	void *item;
+} I2C_MpscCell;
+
+typedef struct I2C_Mpsc {
+	s32 tail;         // next position to claim, producers only
+	s32 pending;      // published and not popped yet
+	u32 head;         // next position to pop, consumer only
+	LightEvent ready; // oneshot
+	Handle event;     // signaled instead of ready if set
+	I2C_MpscCell cells[I2C_MPSC_CAPACITY];
+} I2C_Mpsc;
+
+void I2C_Mpsc_Init(I2C_Mpsc *queue, Handle event);
+
+// any thread; false if the queue is full. item must not be NULL
+bool I2C_Mpsc_Push(I2C_Mpsc *queue, void *item);
+
+// consumer only; NULL if nothing is published at the head
+void *I2C_Mpsc_Pop(I2C_Mpsc *queue);
+
+// consumer only; returns once the queue may be non-empty or after I2C_Mpsc_Wake
+void I2C_Mpsc_Wait(I2C_Mpsc *queue);
+
+// consumer only, after I2C_Mpsc_Pop came back empty: true if a producer is still publishing the head
+static inline bool I2C_Mpsc_Stalled(I2C_Mpsc *queue)
+{
+	return *(volatile s32 *)&queue->pending != 0;
+}
+
+// wakes the consumer without pushing, e.g. to make it see a shutdown request
+static inline void I2C_Mpsc_Wake(I2C_Mpsc *queue)
+{
+	if (queue->event)
+		svcSignalEvent(queue->event);
+	else
+		LightEvent_Signal(&queue->ready);
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef _I2C_SNAPSHOT_H
+#define _I2C_SNAPSHOT_H
+
+#include <3ds/types.h>
+#include <i2c/i2c.h>
+
+/*
+	Register snapshots (commands 0x001F-0x0020), meant for periodic MCU status polling.
+
+	A session configures a list of 8 bit register ranges once. Configuring sorts them by
+	bus, device and register and merges ranges of one device that overlap or lie at most
+	I2C_SNAPSHOT_MAX_GAP registers apart into a single burst read, since reading a few
+	unwanted registers costs less than another select, register and repeated start.
+	Taking a snapshot runs the bursts, each bus under one hold of its lock, and returns
+	the ranges packed in the order they were configured, with the system tick at which
+	the last burst finished.
+
+	Registers in a gap are read and thrown away. A range next to registers that must not
+	be read (an MCU interrupt flag clears when read) is marked I2C_SNAPSHOT_RANGE_EXACT;
+	its burst is then only merged with ranges it overlaps or touches.
+*/
+
+#define I2C_SNAPSHOT_MAX_RANGES 16
+#define I2C_SNAPSHOT_MAX_SIZE   0x80 // packed ranges, and registers read by all bursts
+#define I2C_SNAPSHOT_MAX_GAP    4
+
+enum {
+	I2C_SNAPSHOT_RANGE_EXACT = BIT(0), // no gap is read on either side of this range
+};
+
+// as configured by the client
+typedef struct I2C_SnapshotRange {
+	u8 devid;
+	u8 regid;
+	u8 size;
+	u8 flags; // I2C_SNAPSHOT_RANGE_*
+} I2C_SnapshotRange;
+
+typedef struct I2C_Snapshot {
+	I2C_ReadBurst bursts[I2C_SNAPSHOT_MAX_RANGES];
+	u8 range_offsets[I2C_SNAPSHOT_MAX_RANGES]; // where each range starts in the burst data
+	u8 range_sizes[I2C_SNAPSHOT_MAX_RANGES];
+	u8 n_bursts;
+	u8 n_ranges;   // 0 while not configured
+	u8 size;       // packed
+	u8 read_size;  // burst data, gaps included
+} I2C_Snapshot;
+
+// replaces the configuration; on failure the snapshot is left unconfigured
+Result I2C_Snapshot_Configure(I2C_Snapshot *snapshot, const I2C_SnapshotRange *ranges, u32 n_ranges);
+Result I2C_Snapshot_Read(const I2C_Snapshot *snapshot, u8 *out, u32 size, u64 *tick);
+
+static inline void I2C_Snapshot_Clear(I2C_Snapshot *snapshot)
+{
+	snapshot->n_bursts = snapshot->n_ranges = 0;
+	snapshot->size = snapshot->read_size = 0;
+}
+
+#endif
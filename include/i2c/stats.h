@@ -0,0 +1,119 @@
+#ifndef _I2C_STATS_H
+#define _I2C_STATS_H
+
+#include <3ds/synchronization.h>
+#include <3ds/types.h>
+
+/*
+	Optional latency instrumentation (build with STATS=1, defines I2C_STATS).
+
+	Every command is timestamped with svcGetSystemTick at dispatch and at reply, and the
+	duration is bucketed into log2 histograms keyed by (service, command, devid). Each
+	histogram is split into components: the whole command, time spent waiting for the
+	bus lock, time spent holding the bus, and the part of that spent on attempts that
+	were cancelled and retried.
+
+	Each bus also keeps lock counters (acquisitions, contention, wait and hold time, the
+	longest hold and who held it), its utilization over a sliding window, how often a
+	phase timed out and what it took to recover the bus, and how many reads were merged
+	into an identical one in flight.
+*/
+
+enum {
+	I2C_LATENCY_TOTAL     = 0,
+	I2C_LATENCY_LOCK_WAIT = 1,
+	I2C_LATENCY_BUS       = 2,
+	I2C_LATENCY_RETRY     = 3,
+	I2C_LATENCY_COMPONENT_COUNT,
+};
+
+/*
+	bucket 0 counts durations below 2^I2C_LATENCY_BUCKET_SHIFT ticks (~1us), bucket n
+	counts [2^(n-1), 2^n) in those units, the last bucket is open-ended (>= ~15ms).
+*/
+#define I2C_LATENCY_BUCKET_SHIFT 8
+#define I2C_LATENCY_BUCKET_COUNT 16
+#define I2C_LATENCY_MAX_ENTRIES  32
+
+#define I2C_LATENCY_DEVID_MULTI 0xFF // commands addressing a list of devices
+#define I2C_LATENCY_DEVID_NONE  0xFE // commands that address no device
+
+typedef struct I2C_LatencyHistogram {
+	u8 service;
+	u8 devid;
+	u16 cmd_id;
+	u32 count;
+	u32 retries;     // cancelled attempts
+	u32 max_ticks;   // longest I2C_LATENCY_TOTAL sample
+	u64 sum_ticks[I2C_LATENCY_COMPONENT_COUNT];
+	u32 buckets[I2C_LATENCY_COMPONENT_COUNT][I2C_LATENCY_BUCKET_COUNT];
+} I2C_LatencyHistogram;
+
+enum {
+	I2C_LATENCY_DUMP_RESET = BIT(0), // clear the histograms after copying them out
+};
+
+/*
+	utilization is tracked in I2C_BUS_STATS_WINDOW_SLOTS slots of 2^I2C_BUS_STATS_SLOT_SHIFT
+	ticks (~250ms each, ~2s window); a hold is charged to the slot it ends in.
+*/
+#define I2C_BUS_STATS_SLOT_SHIFT   26
+#define I2C_BUS_STATS_WINDOW_SLOTS 8
+
+typedef struct I2C_BusStats {
+	u32 acquisitions;
+	u32 contended;         // acquisitions that found the lock held by another session
+	u64 wait_ticks;
+	u64 hold_ticks;
+	u32 max_wait_ticks;
+	u32 max_hold_ticks;
+	u8 max_hold_service;   // session type that held the bus during the longest hold
+	u8 reserved[3];
+	u32 window_busy_ticks; // bus held during the sliding window
+	u32 window_ticks;      // length of the sliding window, busy / window = utilization
+	u32 timeouts;          // phases whose interrupt did not arrive in time
+	u32 recoveries;        // recovery sequences run after a timeout
+	u32 clock_outs;        // recoveries that had to reset the controller and clock out a device
+	u32 recovery_failures; // recoveries after which the bus still did not complete a phase
+	u32 merged_reads;      // reads answered with the data of an identical read already in flight
+	u32 spun;              // contended acquisitions that got the lock while spinning, see LightLock_LockSpin
+} I2C_BusStats;
+
+enum {
+	I2C_BUS_STATS_DUMP_RESET = BIT(0), // clear the counters after copying them out
+};
+
+#ifdef I2C_STATS
+void I2C_Stats_Init(void);
+
+// per-command hooks, called by the session thread handling the command
+void I2C_Stats_BeginCommand(u8 service, u16 cmd_id, u8 devid);
+void I2C_Stats_EndCommand(void);
+
+// bus hooks, called from i2c.c; all but requested run with the bus lock held
+void I2C_Stats_LockRequested(u8 port);
+void I2C_Stats_LockAcquired(u8 port, LightLockWait how);
+void I2C_Stats_LockReleased(u8 port);
+void I2C_Stats_AttemptFinished(void);
+void I2C_Stats_AttemptCancelled(void);
+void I2C_Stats_BusTimeout(u8 port);
+void I2C_Stats_BusRecovery(u8 port, bool clocked_out, bool recovered);
+void I2C_Stats_ReadsMerged(u8 port, u32 n);
+
+u32 I2C_Stats_Dump(I2C_LatencyHistogram *out, u32 max_entries, bool reset);
+u32 I2C_Stats_DumpBuses(I2C_BusStats *out, u32 max_buses, bool reset);
+#else
+static inline void I2C_Stats_Init(void) { }
+static inline void I2C_Stats_BeginCommand(u8 service, u16 cmd_id, u8 devid) { (void)service; (void)cmd_id; (void)devid; }
+static inline void I2C_Stats_EndCommand(void) { }
+static inline void I2C_Stats_LockRequested(u8 port) { (void)port; }
+static inline void I2C_Stats_LockAcquired(u8 port, LightLockWait how) { (void)port; (void)how; }
+static inline void I2C_Stats_LockReleased(u8 port) { (void)port; }
+static inline void I2C_Stats_AttemptFinished(void) { }
+static inline void I2C_Stats_AttemptCancelled(void) { }
+static inline void I2C_Stats_BusTimeout(u8 port) { (void)port; }
+static inline void I2C_Stats_BusRecovery(u8 port, bool clocked_out, bool recovered) { (void)port; (void)clocked_out; (void)recovered; }
+static inline void I2C_Stats_ReadsMerged(u8 port, u32 n) { (void)port; (void)n; }
+#endif
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _I2C_THREAD_H
+#define _I2C_THREAD_H
+
+#include <3ds/types.h>
+#include <3ds/ipc.h>
+
+/*
+	Layout of the any_purpose area of a session thread's TLS. Set up once when the
+	session thread starts, read by the diagnostics code without any locking.
+*/
+typedef struct I2C_ThreadContext {
+	u8 session_type;
+	u8 reserved[7];
+	u64 stats[15]; // I2C_ThreadStats, private to stats.c
+} I2C_ThreadContext;
+
+_Static_assert(sizeof(I2C_ThreadContext) <= sizeof(((ThreadLocalStorage *)0)->any_purpose), "I2C_ThreadContext does not fit in TLS");
+
+// main.c; stack_top must be 8 byte aligned
+Result startThread(Handle *thread, void (* function)(void *), void *arg, void *stack_top, s32 priority, s32 processor_id);
+
+static inline I2C_ThreadContext *I2C_GetThreadContext(void)
+{
+	return (I2C_ThreadContext *)getThreadLocalStorage()->any_purpose;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _I2C_TRACE_H
+#define _I2C_TRACE_H
+
+#include <3ds/types.h>
+
+/*
+	Optional bus trace (build with TRACE=1, defines I2C_TRACE).
+
+	Every low-level phase issued by i2c.c is appended to an in-memory ring as an 8 byte
+	record stamped with the low 32 bits of svcGetSystemTick taken when the phase was
+	started. The ring is copied out, oldest record first, with command 0x0018, which only
+	i2c::DEB may issue since the ring holds every service's register traffic. Without
+	I2C_TRACE the hooks are empty and the ring does not exist.
+*/
+
+typedef enum I2C_TracePhase {
+	I2C_TRACE_SELECT       = 0, // start + device write address
+	I2C_TRACE_REGISTER     = 1, // register id byte
+	I2C_TRACE_WRITE        = 2, // data byte
+	I2C_TRACE_BEGIN_READ   = 3, // (repeated) start + device read address
+	I2C_TRACE_READ         = 4, // data byte read, ACKed by the controller
+	I2C_TRACE_FINISH_WRITE = 5, // last data byte + stop
+	I2C_TRACE_FINISH_READ  = 6, // last data byte read, NACKed by the controller + stop
+	I2C_TRACE_CANCEL       = 7, // transaction cancelled (stop)
+} I2C_TracePhase;
+
+typedef struct I2C_TraceEntry {
+	u32 tick;  // low 32 bits of the system tick at the start of the phase
+	u8 phase;  // I2C_TracePhase
+	u8 devid;
+	u8 data;   // byte on the wire (address byte for select/begin read)
+	u8 flags;  // I2C_TRACE_FLAG_* | bus | session type << I2C_TRACE_SESSION_SHIFT
+} I2C_TraceEntry;
+
+#define I2C_TRACE_FLAG_BUS_MASK  0x03
+#define I2C_TRACE_FLAG_ACK       BIT(2) // the phase was acknowledged (read phases: by the controller)
+#define I2C_TRACE_SESSION_SHIFT  4
+
+#define I2C_TRACE_RING_SIZE      512 // entries, power of two
+
+enum {
+	I2C_TRACE_DUMP_RESET = BIT(0), // empty the ring after copying it out
+};
+
+#ifdef I2C_TRACE
+#include <3ds/svc.h>
+
+void I2C_Trace_Record(u32 tick, I2C_TracePhase phase, u8 devid, u8 port, u8 data, bool ack);
+u32 I2C_Trace_Dump(I2C_TraceEntry *out, u32 max_entries, bool reset, u32 *out_sequence);
+
+static inline u32 I2C_Trace_Now(void)
+{
+	return (u32)svcGetSystemTick();
+}
+#else
+static inline void I2C_Trace_Record(u32 tick, I2C_TracePhase phase, u8 devid, u8 port, u8 data, bool ack)
+{
+	(void)tick; (void)phase; (void)devid; (void)port; (void)data; (void)ack;
+}
+
+static inline u32 I2C_Trace_Now(void)
+{
+	return 0;
+}
+#endif
+
+#endif
@@ -8,7 +8,103 @@
     credit goes to luigoalma for this code
 */
 
+/*
+	Sizes of at least I2C_MEMOPS_BLOCK_MIN bytes go to block kernels that align the
+	destination first and then move several words per iteration, merging shifted source
+	words when source and destination alignment differ. On ARM these are the LDM/STM
+	kernels in source/memops.s; elsewhere (the host build) the portable versions below,
+	which follow the same steps. Smaller sizes keep the inline loops.
+
+	c is a word pattern for the word stores; byte stores use its low byte.
+*/
+
+#define I2C_MEMOPS_BLOCK_MIN 32
+
+#if defined(__arm__) && !defined(I2C_MEMOPS_PORTABLE)
+#define I2C_MEMOPS_ARMV6
+
+void _memcpy_armv6(void *dest, const void *src, size_t size);
+void _memset_armv6(void *dest, uint32_t c, size_t size);
+
+#define _memcpy_blocks _memcpy_armv6
+#define _memset_blocks _memset_armv6
+#else
+#define _memcpy_blocks _memcpy_portable
+#define _memset_blocks _memset_portable
+#endif
+
+inline static void _memset_portable(void* dest, uint32_t c, size_t size) {
+	uint8_t *_dest8 = (uint8_t*)dest;
+	for (; size > 0 && ((uintptr_t)_dest8 & 0x3); size--) {
+		*_dest8 = c;
+		_dest8++;
+	}
+	uint32_t *_dest = (uint32_t*)_dest8;
+	for (; size >= 32; size -= 32) {
+		_dest[0] = c; _dest[1] = c; _dest[2] = c; _dest[3] = c;
+		_dest[4] = c; _dest[5] = c; _dest[6] = c; _dest[7] = c;
+		_dest += 8;
+	}
+	for (; size >= 4; size -= 4) {
+		*_dest = c;
+		_dest++;
+	}
+	_dest8 = (uint8_t*)_dest;
+	for (; size > 0; size--) {
+		*_dest8 = c;
+		_dest8++;
+	}
+}
+
+inline static void _memcpy_portable(void* dest, const void* src, size_t size) {
+	uint8_t *_dest8 = (uint8_t*)dest;
+	const uint8_t *_src8 = (const uint8_t*)src;
+	for (; size > 0 && ((uintptr_t)_dest8 & 0x3); size--) {
+		*_dest8 = *_src8;
+		_dest8++;
+		_src8++;
+	}
+	uint32_t *_dest = (uint32_t*)_dest8;
+	unsigned shift = ((uintptr_t)_src8 & 0x3) * 8;
+	if (!shift) {
+		const uint32_t *_src = (const uint32_t*)_src8;
+		for (; size >= 32; size -= 32) {
+			_dest[0] = _src[0]; _dest[1] = _src[1]; _dest[2] = _src[2]; _dest[3] = _src[3];
+			_dest[4] = _src[4]; _dest[5] = _src[5]; _dest[6] = _src[6]; _dest[7] = _src[7];
+			_dest += 8;
+			_src += 8;
+		}
+		for (; size >= 4; size -= 4) {
+			*_dest = *_src;
+			_dest++;
+			_src++;
+		}
+		_src8 = (const uint8_t*)_src;
+	} else if (size >= 4) {
+		// little endian: each output word is the top of one aligned source word and the bottom of the next
+		const uint32_t *_src = (const uint32_t*)((uintptr_t)_src8 & ~(uintptr_t)0x3);
+		uint32_t cur = *_src++;
+		for (; size >= 4; size -= 4) {
+			uint32_t next = *_src++;
+			*_dest = (cur >> shift) | (next << (32 - shift));
+			cur = next;
+			_dest++;
+		}
+		_src8 = (const uint8_t*)_src - 4 + shift / 8;
+	}
+	_dest8 = (uint8_t*)_dest;
+	for (; size > 0; size--) {
+		*_dest8 = *_src8;
+		_dest8++;
+		_src8++;
+	}
+}
+
 inline static void _memset32_aligned(void* dest, uint32_t c, size_t size) {
+	if (size >= I2C_MEMOPS_BLOCK_MIN) {
+		_memset_blocks(dest, c, size);
+		return;
+	}
 	uint32_t *_dest = (uint32_t*)dest;
 	for (; size >= 4; size -= 4) {
 		*_dest = c;
@@ -22,7 +118,7 @@ inline static void _memset32_aligned(void* dest, uint32_t c, size_t size) {
 }
 
 inline static void _memset(void* dest, uint32_t c, size_t size) {
-	if (((uintptr_t)dest & 0x3) == 0) {
+	if (((uintptr_t)dest & 0x3) == 0 || size >= I2C_MEMOPS_BLOCK_MIN) {
 		_memset32_aligned(dest, c, size);
 		return;
 	}
@@ -36,6 +132,10 @@ inline static void _memset(void* dest, uint32_t c, size_t size) {
 void *memset(void *s, int c, size_t n);
 
 inline static void _memcpy32_aligned(void* dest, const void* src, size_t size) {
+	if (size >= I2C_MEMOPS_BLOCK_MIN) {
+		_memcpy_blocks(dest, src, size);
+		return;
+	}
 	uint32_t *_dest = (uint32_t*)dest;
 	const uint32_t *_src = (const uint32_t*)src;
 	for (; size >= 4; size -= 4) {
@@ -53,7 +153,7 @@ inline static void _memcpy32_aligned(void* dest, const void* src, size_t size) {
 }
 
 inline static void _memcpy(void* dest, const void* src, size_t size) {
-	if (((uintptr_t)dest & 0x3) == 0 && ((uintptr_t)src & 0x3) == 0) {
+	if ((((uintptr_t)dest & 0x3) == 0 && ((uintptr_t)src & 0x3) == 0) || size >= I2C_MEMOPS_BLOCK_MIN) {
 		_memcpy32_aligned(dest, src, size);
 		return;
 	}
@@ -14,7 +14,7 @@ inline void syncExit()
 
 Result syncArbitrateAddress(s32 *addr, ArbitrationType type, s32 value)
 {
-	return svcArbitrateAddressNoTimeout(g_AddressArbiter, (u32)addr, type, value);
+	return svcArbitrateAddressNoTimeout(g_AddressArbiter, (uintptr_t)addr, type, value);
 }
 
 void LightLock_Init(LightLock *lock)
@@ -72,6 +72,26 @@ void LightLock_Lock(LightLock *lock)
 	__dmb();
 }
 
+bool LightLock_TryLock(LightLock *lock)
+{
+	s32 val;
+
+	do
+	{
+		val = __ldrex(lock);
+		if (val == 0) val = 1; // 0 is an invalid state - treat it as 1 (unlocked)
+		if (val < 0)
+		{
+			// held by another thread, leave the waiter count alone
+			__clrex();
+			return false;
+		}
+	} while (__strex(lock, -val));
+
+	__dmb();
+	return true;
+}
+
 void LightLock_Unlock(LightLock *lock)
 {
 	__dmb();
@@ -86,6 +106,55 @@ void LightLock_Unlock(LightLock *lock)
 		syncArbitrateAddress(lock, ARBITRATION_SIGNAL, 1);
 }
 
+LightLockWait LightLock_LockSpin(LightLock *lock, LightLockSpin *spin)
+{
+	if (LightLock_TryLock(lock))
+		return LIGHTLOCK_FREE;
+
+	u32 limit = spin->max_spins;
+
+	if (spin->adaptive && limit > (u32)spin->average * 2 + LIGHTLOCK_SPIN_MARGIN)
+		limit = (u32)spin->average * 2 + LIGHTLOCK_SPIN_MARGIN;
+
+	u64 deadline = spin->max_ticks ? (u64)svcGetSystemTick() + spin->max_ticks : 0;
+	LightLockWait wait = LIGHTLOCK_BLOCKED;
+	u32 rounds = 0;
+
+	while (rounds < limit)
+	{
+		rounds++;
+
+		// plain loads until the lock looks free, the exclusive access only to take it
+		if (*(volatile s32 *)lock >= 0 && LightLock_TryLock(lock))
+		{
+			wait = LIGHTLOCK_SPUN;
+			break;
+		}
+
+		__yield();
+
+		if (deadline && !(rounds % LIGHTLOCK_SPIN_TICK_CHECKS) && (u64)svcGetSystemTick() >= deadline)
+			break;
+	}
+
+	if (wait == LIGHTLOCK_BLOCKED)
+		LightLock_Lock(lock);
+
+	spin->contended++;
+	spin->rounds += rounds;
+
+	if (wait == LIGHTLOCK_SPUN)
+		spin->spun++;
+	else
+		spin->blocked++;
+
+	// a spin that ended in the kernel counts as none: it only cost the rounds
+	if (spin->adaptive)
+		spin->average += ((wait == LIGHTLOCK_SPUN ? (s32)rounds : 0) - spin->average) / 8;
+
+	return wait;
+}
+
 void RecursiveLock_Init(RecursiveLock *lock)
 {
 	LightLock_Init(&lock->lock);
@@ -104,6 +173,33 @@ void RecursiveLock_Lock(RecursiveLock *lock)
 	lock->counter ++;
 }
 
+bool RecursiveLock_TryLock(RecursiveLock *lock)
+{
+	ThreadLocalStorage *tag = getThreadLocalStorage();
+	if (lock->thread_tag != tag)
+	{
+		if (!LightLock_TryLock(&lock->lock))
+			return false;
+		lock->thread_tag = tag;
+	}
+	lock->counter ++;
+	return true;
+}
+
+LightLockWait RecursiveLock_LockSpin(RecursiveLock *lock, LightLockSpin *spin)
+{
+	ThreadLocalStorage *tag = getThreadLocalStorage();
+	LightLockWait wait = LIGHTLOCK_FREE;
+
+	if (lock->thread_tag != tag)
+	{
+		wait = LightLock_LockSpin(&lock->lock, spin);
+		lock->thread_tag = tag;
+	}
+	lock->counter ++;
+	return wait;
+}
+
 void RecursiveLock_Unlock(RecursiveLock *lock)
 {
 	if (!--lock->counter)
@@ -0,0 +1,575 @@
+#include <3ds/synchronization.h>
+#include <3ds/svc.h>
+#include <3ds/err.h>
+
+#include <i2c/globals.h>
+#include <i2c/thread.h>
+#include <i2c/async.h>
+#include <i2c/mpsc.h>
+#include <i2c/stats.h>
+#include <i2c/i2c.h>
+#include <memops.h>
+
+#define I2C_ASYNC_THREAD_STACKSIZE 0x400
+
+typedef enum I2C_AsyncState {
+	I2C_ASYNC_FREE = 0,
+	I2C_ASYNC_QUEUED,
+	I2C_ASYNC_RUNNING,
+	I2C_ASYNC_DONE,
+} I2C_AsyncState;
+
+typedef struct I2C_AsyncRequest {
+	I2C_SessionData *session;      // NULL once the session closed while the request was queued or ran
+	u32 ticket;
+	u32 done_sequence;             // reaped in completion order
+	Result result;
+	u32 size;
+	u16 cmd_id;
+	u16 regid;
+	u8 state;                      // I2C_AsyncState
+	u8 op;                         // I2C_AsyncOp
+	u8 devid;
+	u8 service;
+	u8 data[I2C_ASYNC_MAX_SIZE] __attribute__((aligned(4)));
+} I2C_AsyncRequest;
+
+// the request running on a bus, stepped by the driver thread
+typedef struct I2C_AsyncBus {
+	I2C_AsyncRequest *req;
+	I2C_Transfer xfer;
+	I2C_ThreadContext context; // the request's trace session and stats, in the driver's TLS while it is stepped
+} I2C_AsyncBus;
+
+_Static_assert((int)I2C_ASYNC_READ_REGISTERS8 == I2C_TRANSFER_READ_REGISTERS8 &&
+	(int)I2C_ASYNC_WRITE_REGISTERS8 == I2C_TRANSFER_WRITE_REGISTERS8 &&
+	(int)I2C_ASYNC_POSTED_REPLACE_BITS8 == I2C_TRANSFER_REPLACE_BITS8 &&
+	(int)I2C_ASYNC_POSTED_WRITE_REGISTER8 == I2C_TRANSFER_WRITE_REGISTER8 &&
+	(int)I2C_ASYNC_POSTED_WRITE_REGISTER16 == I2C_TRANSFER_WRITE_REGISTER16, "async ops are transfer ops");
+
+__attribute__((section(".bss.thread_stacks"), aligned(8))) static u8 I2C_AsyncThreadStack[I2C_ASYNC_THREAD_STACKSIZE];
+
+/*
+	One lock covers the slots and the per-session counters; it is only held to move
+	requests between states, never across a transfer. Queued requests are handed to the
+	driver through lock-free queues, so submitting to a bus never waits for the driver
+	to pop. The driver owns I2C_AsyncBuses.
+*/
+static LightLock I2C_AsyncLock;
+static I2C_AsyncRequest I2C_AsyncRequests[I2C_ASYNC_MAX_REQUESTS];
+static I2C_Mpsc I2C_AsyncQueues[3];
+static I2C_AsyncBus I2C_AsyncBuses[3];
+
+_Static_assert(I2C_ASYNC_MAX_REQUESTS <= I2C_MPSC_CAPACITY, "a bus queue has to hold every request slot");
+
+static Handle I2C_AsyncThread;
+static Handle I2C_AsyncDriverEvent; // queued work, a bus lock released or shutdown
+static u32 I2C_AsyncDoneSequence;
+static bool I2C_AsyncShutdown;
+
+void I2C_Async_Init(void)
+{
+	LightLock_Init(&I2C_AsyncLock);
+	T(svcCreateEvent(&I2C_AsyncDriverEvent, RESET_ONESHOT));
+
+	for (u32 i = 0; i < 3; i++)
+		I2C_Mpsc_Init(&I2C_AsyncQueues[i], I2C_AsyncDriverEvent);
+}
+
+void I2C_Async_Exit(void)
+{
+	I2C_AsyncShutdown = true;
+
+	if (I2C_AsyncThread)
+	{
+		T(svcSignalEvent(I2C_AsyncDriverEvent));
+		T(svcWaitSynchronization(I2C_AsyncThread, -1));
+		T(svcCloseHandle(I2C_AsyncThread));
+		I2C_AsyncThread = 0;
+	}
+
+	T(svcCloseHandle(I2C_AsyncDriverEvent));
+	I2C_AsyncDriverEvent = 0;
+}
+
+static void I2C_Async_Free(I2C_AsyncRequest *req)
+{
+	I2C_SessionData *session = req->session;
+
+	if (session && !I2C_ASYNC_IS_POSTED(req->op))
+		session->async_requests--;
+	else if (session && !--session->posted_pending)
+		LightEvent_Signal(&session->posted_drained);
+
+	req->state = I2C_ASYNC_FREE;
+	req->session = NULL;
+}
+
+// false if the request was dropped because its session closed while it was queued
+static bool I2C_Async_Start(I2C_AsyncRequest *req)
+{
+	LightLock_Lock(&I2C_AsyncLock);
+
+	bool run = req->session || I2C_ASYNC_IS_POSTED(req->op);
+
+	if (run)
+		req->state = I2C_ASYNC_RUNNING;
+	else
+		I2C_Async_Free(req);
+
+	LightLock_Unlock(&I2C_AsyncLock);
+	return run;
+}
+
+static bool I2C_Async_Transfer(u8 op, u8 devid, u16 regid, u8 *data, u32 size)
+{
+	switch (op)
+	{
+	case I2C_ASYNC_READ_REGISTERS8:
+		return I2C_ReadRegisters8(devid, (u8)regid, data, size);
+	case I2C_ASYNC_WRITE_REGISTERS8:
+		return I2C_WriteRegisters8(devid, (u8)regid, data, size);
+	case I2C_ASYNC_POSTED_REPLACE_BITS8:
+		return I2C_ReplaceRegisterBits8(devid, (u8)regid, data[0], data[1]);
+	case I2C_ASYNC_POSTED_WRITE_REGISTER8:
+		return I2C_WriteRegister8(devid, (u8)regid, data[0]);
+	case I2C_ASYNC_POSTED_WRITE_REGISTER16:
+		return I2C_WriteRegister16(devid, regid, (u16)(data[0] | (data[1] << 8)));
+	default:
+		return false;
+	}
+}
+
+static void I2C_Async_Finish(I2C_AsyncRequest *req, bool ok)
+{
+	bool posted = I2C_ASYNC_IS_POSTED(req->op);
+
+	if (!posted)
+		I2C_Stats_EndCommand();
+
+	LightLock_Lock(&I2C_AsyncLock);
+
+	I2C_SessionData *session = req->session;
+
+	if (posted) {
+		if (session && !ok && !session->posted_failures++)
+			session->posted_error = I2C_FATAL_FAIL;
+
+		I2C_Async_Free(req);
+	} else if (session) {
+		req->result = ok ? 0 : I2C_FATAL_FAIL;
+		req->done_sequence = ++I2C_AsyncDoneSequence;
+		req->state = I2C_ASYNC_DONE;
+
+		if (session->async_event)
+			T(svcSignalEvent(session->async_event));
+	} else
+		I2C_Async_Free(req);
+
+	LightLock_Unlock(&I2C_AsyncLock);
+}
+
+static inline void I2C_Async_SwitchTo(I2C_AsyncBus *bus)
+{
+	*I2C_GetThreadContext() = bus->context;
+}
+
+static inline void I2C_Async_SwitchFrom(I2C_AsyncBus *bus)
+{
+	bus->context = *I2C_GetThreadContext();
+}
+
+/*
+	Finishes the transfer of the bus if it is done, then starts the next queued ones
+	until one is waiting for the bus lock or has a phase on the wire. Returns true if
+	the bus is busy.
+*/
+static bool I2C_Async_Advance(u8 port)
+{
+	I2C_AsyncBus *bus = &I2C_AsyncBuses[port];
+
+	while (true)
+	{
+		if (bus->req && bus->xfer.state == I2C_TRANSFER_DONE) {
+			I2C_Async_SwitchTo(bus);
+			I2C_Async_Finish(bus->req, bus->xfer.ok);
+			bus->req = NULL;
+		}
+
+		if (!bus->req) {
+			I2C_AsyncRequest *req = I2C_Mpsc_Pop(&I2C_AsyncQueues[port]);
+
+			if (!req)
+				return false;
+
+			if (!I2C_Async_Start(req))
+				continue;
+
+			/*
+				the transfer is traced as the submitting session's command; asynchronous ones are
+				also sampled under their submit command id, posted writes were already sampled
+				when they were acknowledged
+			*/
+			I2C_GetThreadContext()->session_type = req->service;
+			I2C_Stats_BeginCommand(req->service, req->cmd_id, req->devid);
+
+			I2C_Transfer_Init(&bus->xfer, (I2C_TransferOp)req->op, req->devid, req->regid, req->data, req->size);
+			bus->req = req;
+			I2C_Async_SwitchFrom(bus);
+		}
+
+		if (bus->xfer.state == I2C_TRANSFER_LOCKING) {
+			I2C_Async_SwitchTo(bus);
+			bool started = I2C_Transfer_Begin(&bus->xfer, I2C_AsyncDriverEvent);
+			I2C_Async_SwitchFrom(bus);
+
+			if (!started)
+				return true;
+		}
+
+		if (bus->xfer.state == I2C_TRANSFER_PHASE)
+			return true;
+	}
+}
+
+static void I2C_Async_Step(u8 port, bool interrupted)
+{
+	I2C_AsyncBus *bus = &I2C_AsyncBuses[port];
+
+	I2C_Async_SwitchTo(bus);
+	I2C_Transfer_Step(&bus->xfer, interrupted);
+	I2C_Async_SwitchFrom(bus);
+}
+
+/*
+	The driver: one thread runs the transfers of all three buses at once. It waits on
+	the interrupts of the buses that have a phase on the wire and on the driver event,
+	and steps whichever bus completed its phase or ran out of time for it.
+*/
+static void I2C_Async_DriverMain(void *arg)
+{
+	(void)arg;
+
+	while (true)
+	{
+		Handle handles[4] = { I2C_AsyncDriverEvent };
+		u8 ports[4];
+		s32 n = 1;
+		s64 timeout = -1;
+		bool busy = false;
+
+		for (u8 port = 0; port < 3; port++) {
+			I2C_Transfer *xfer = &I2C_AsyncBuses[port].xfer;
+			s64 wait = -1;
+
+			if (I2C_Async_Advance(port)) {
+				busy = true;
+
+				if (xfer->state == I2C_TRANSFER_PHASE) {
+					handles[n] = g_I2C_Buses[port].interrupt;
+					ports[n++] = port;
+					wait = I2C_Transfer_TimeLeft(xfer);
+					wait = wait > 0 ? wait : 0;
+				}
+				// otherwise it waits for the bus lock, whose release signals the driver event
+			} else if (I2C_Mpsc_Stalled(&I2C_AsyncQueues[port]))
+				wait = I2C_MPSC_STALL_NS;
+
+			if (wait >= 0 && (timeout < 0 || wait < timeout))
+				timeout = wait;
+		}
+
+		if (!busy && I2C_AsyncShutdown)
+			break;
+
+		s32 index = -1;
+		Result res = svcWaitSynchronizationN(&index, handles, n, false, timeout);
+
+		if (res != OS_TIMEOUT)
+			TIS(res);
+
+		// the wait only reports the first signaled handle; every bus whose phase is over steps this round
+		for (s32 i = 1; i < n; i++) {
+			u8 port = ports[i];
+
+			if (i == index || svcWaitSynchronization(g_I2C_Buses[port].interrupt, 0) != OS_TIMEOUT)
+				I2C_Async_Step(port, true);
+			else if (I2C_Transfer_TimeLeft(&I2C_AsyncBuses[port].xfer) <= 0)
+				I2C_Async_Step(port, false);
+		}
+	}
+}
+
+Result I2C_Async_GetEvent(I2C_SessionData *session, Handle *event)
+{
+	Result res = 0;
+
+	LightLock_Lock(&I2C_AsyncLock);
+
+	if (!session->async_event) {
+		res = svcCreateEvent(&session->async_event, RESET_STICKY);
+
+		// transfers may have finished before anyone asked for the event
+		for (u32 i = 0; R_SUCCEEDED(res) && i < I2C_ASYNC_MAX_REQUESTS; i++) {
+			if (I2C_AsyncRequests[i].session == session && I2C_AsyncRequests[i].state == I2C_ASYNC_DONE) {
+				res = svcSignalEvent(session->async_event);
+				break;
+			}
+		}
+	}
+
+	*event = session->async_event;
+
+	LightLock_Unlock(&I2C_AsyncLock);
+	return res;
+}
+
+// called with the lock held; a session holds at most I2C_ASYNC_MAX_PER_SESSION slots, posted writes included
+static I2C_AsyncRequest *I2C_Async_Alloc(const I2C_SessionData *session)
+{
+	if (session->async_requests + session->posted_pending >= I2C_ASYNC_MAX_PER_SESSION)
+		return NULL;
+
+	for (u32 i = 0; i < I2C_ASYNC_MAX_REQUESTS; i++)
+		if (I2C_AsyncRequests[i].state == I2C_ASYNC_FREE)
+			return &I2C_AsyncRequests[i];
+
+	return NULL;
+}
+
+// called with the lock held; a module nobody submits to costs no thread
+static Result I2C_Async_StartDriver(void)
+{
+	if (I2C_AsyncThread)
+		return 0;
+
+	return startThread(&I2C_AsyncThread, &I2C_Async_DriverMain, NULL,
+		I2C_AsyncThreadStack + sizeof(I2C_AsyncThreadStack), 11, -2);
+}
+
+// without the lock, once the request is filled in
+static void I2C_Async_Enqueue(I2C_AsyncRequest *req, u8 port)
+{
+	// every request in a queue holds a slot, so a bus queue never fills up
+	if (!I2C_Mpsc_Push(&I2C_AsyncQueues[port], req))
+		svcBreak(USERBREAK_PANIC);
+}
+
+static void I2C_Async_Fill(I2C_AsyncRequest *req, I2C_SessionData *session, u16 cmd_id, I2C_AsyncOp op, u8 devid, u16 regid, u32 size)
+{
+	req->session = session;
+	req->result = 0;
+	req->size = size;
+	req->cmd_id = cmd_id;
+	req->op = op;
+	req->devid = devid;
+	req->regid = regid;
+	req->service = session->session_type;
+	req->state = I2C_ASYNC_QUEUED;
+}
+
+Result I2C_Async_Submit(I2C_SessionData *session, I2C_AsyncOp op, u8 devid, u8 regid, const u8 *data, u32 size, u32 *ticket)
+{
+	const I2C_DeviceConfig *dc = I2C_GetDeviceConfig(devid);
+
+	if (!dc)
+		return I2C_INTERNAL_RANGE;
+
+	if (!size || size > I2C_ASYNC_MAX_SIZE)
+		return I2C_INVALID_SIZE;
+
+	LightLock_Lock(&I2C_AsyncLock);
+
+	I2C_AsyncRequest *req = I2C_Async_Alloc(session);
+
+	if (!req) {
+		LightLock_Unlock(&I2C_AsyncLock);
+		return I2C_ASYNC_QUEUE_FULL;
+	}
+
+	Result res = I2C_Async_StartDriver();
+
+	if (R_FAILED(res)) {
+		LightLock_Unlock(&I2C_AsyncLock);
+		return res;
+	}
+
+	if (!++session->async_next_ticket) // 0 is never a ticket
+		session->async_next_ticket = 1;
+
+	session->async_requests++;
+
+	I2C_Async_Fill(req, session, op == I2C_ASYNC_READ_REGISTERS8 ? 0x001A : 0x001B, op, devid, regid, size);
+	req->ticket = session->async_next_ticket;
+
+	*ticket = req->ticket;
+
+	// the slot is taken, so the copy can run outside the lock as long as it is queued after
+	LightLock_Unlock(&I2C_AsyncLock);
+
+	if (op == I2C_ASYNC_WRITE_REGISTERS8)
+		_memcpy(req->data, data, size);
+
+	I2C_Async_Enqueue(req, dc->port);
+	return 0;
+}
+
+Result I2C_Async_Post(I2C_SessionData *session, u16 cmd_id, I2C_AsyncOp op, u8 devid, u16 regid, u16 value, u16 mask)
+{
+	const I2C_DeviceConfig *dc = I2C_GetDeviceConfig(devid);
+	u8 data[2];
+
+	if (!dc)
+		return I2C_FATAL_FAIL; // what the synchronous command returns
+
+	if (op == I2C_ASYNC_POSTED_REPLACE_BITS8) {
+		data[0] = (u8)value;
+		data[1] = (u8)mask;
+	} else {
+		data[0] = (u8)value;
+		data[1] = (u8)(value >> 8);
+	}
+
+	LightLock_Lock(&I2C_AsyncLock);
+
+	I2C_AsyncRequest *req = I2C_Async_Alloc(session);
+
+	if (req && R_FAILED(I2C_Async_StartDriver()))
+		req = NULL;
+
+	if (!req) {
+		LightLock_Unlock(&I2C_AsyncLock);
+
+		// no slot, or the session holds its share of them: run it here, behind the ones already posted
+		I2C_Async_Drain(session);
+		return I2C_Async_Transfer(op, devid, regid, data, sizeof(data)) ? 0 : I2C_FATAL_FAIL;
+	}
+
+	I2C_Async_Fill(req, session, cmd_id, op, devid, regid, sizeof(data));
+	req->data[0] = data[0];
+	req->data[1] = data[1];
+
+	if (!session->posted_pending++)
+		LightEvent_Clear(&session->posted_drained);
+
+	LightLock_Unlock(&I2C_AsyncLock);
+
+	I2C_Async_Enqueue(req, dc->port);
+	return 0;
+}
+
+void I2C_Async_Drain(I2C_SessionData *session)
+{
+	while (true)
+	{
+		LightLock_Lock(&I2C_AsyncLock);
+		u32 pending = session->posted_pending;
+		LightLock_Unlock(&I2C_AsyncLock);
+
+		if (!pending)
+			return;
+
+		// only this session's thread posts, so the event cannot be cleared again meanwhile
+		LightEvent_Wait(&session->posted_drained);
+	}
+}
+
+void I2C_Async_Fence(I2C_SessionData *session, Result *first_error, u32 *failures)
+{
+	I2C_Async_Drain(session);
+
+	LightLock_Lock(&I2C_AsyncLock);
+
+	*first_error = session->posted_error;
+	*failures = session->posted_failures;
+	session->posted_error = 0;
+	session->posted_failures = 0;
+
+	LightLock_Unlock(&I2C_AsyncLock);
+}
+
+Result I2C_Async_Reap(I2C_SessionData *session, u8 *buf, u32 size, I2C_AsyncResult *out)
+{
+	I2C_AsyncRequest *oldest = NULL;
+	bool more = false;
+
+	LightLock_Lock(&I2C_AsyncLock);
+
+	for (u32 i = 0; i < I2C_ASYNC_MAX_REQUESTS; i++) {
+		I2C_AsyncRequest *req = &I2C_AsyncRequests[i];
+
+		if (req->session != session || req->state != I2C_ASYNC_DONE)
+			continue;
+
+		if (oldest)
+			more = true;
+
+		if (!oldest || (s32)(req->done_sequence - oldest->done_sequence) < 0)
+			oldest = req;
+	}
+
+	if (!oldest) {
+		LightLock_Unlock(&I2C_AsyncLock);
+		return I2C_ASYNC_NOTHING_DONE;
+	}
+
+	out->ticket = oldest->ticket;
+	out->result = oldest->result;
+	out->size = oldest->size;
+
+	if (oldest->op == I2C_ASYNC_READ_REGISTERS8 && R_SUCCEEDED(oldest->result)) {
+		if (out->size > size)
+			out->size = size;
+
+		_memcpy(buf, oldest->data, out->size);
+	}
+
+	I2C_Async_Free(oldest);
+
+	if (!more && session->async_event)
+		T(svcClearEvent(session->async_event));
+
+	LightLock_Unlock(&I2C_AsyncLock);
+	return 0;
+}
+
+void I2C_Async_InitSession(I2C_SessionData *session)
+{
+	LightEvent_Init(&session->posted_drained, RESET_STICKY);
+	LightEvent_Signal(&session->posted_drained);
+}
+
+void I2C_Async_ReleaseSession(I2C_SessionData *session)
+{
+	LightLock_Lock(&I2C_AsyncLock);
+
+	for (u32 i = 0; i < I2C_ASYNC_MAX_REQUESTS; i++) {
+		I2C_AsyncRequest *req = &I2C_AsyncRequests[i];
+
+		if (req->session != session)
+			continue;
+
+		if (I2C_ASYNC_IS_POSTED(req->op)) {
+			// posted writes were acknowledged, so they still run, on nobody's behalf
+			req->session = NULL;
+		} else if (req->state == I2C_ASYNC_DONE)
+			I2C_Async_Free(req);
+		else // queued: the driver drops it when it pops it; running: frees it when the transfer ends
+			req->session = NULL;
+	}
+
+	session->async_requests = 0;
+	session->async_next_ticket = 0;
+	session->posted_writes = false;
+	session->posted_pending = 0;
+	session->posted_error = 0;
+	session->posted_failures = 0;
+	LightEvent_Signal(&session->posted_drained);
+
+	if (session->async_event) {
+		T(svcCloseHandle(session->async_event));
+		session->async_event = 0;
+	}
+
+	LightLock_Unlock(&I2C_AsyncLock);
+}
@@ -0,0 +1,307 @@
+#include <3ds/synchronization.h>
+#include <3ds/svc.h>
+#include <3ds/err.h>
+
+#include <i2c/globals.h>
+#include <i2c/cache.h>
+#include <i2c/i2c.h>
+
+enum {
+	I2C_CACHE_ACTIVE = BIT(7), // internal, set while the slot holds an entry
+};
+
+typedef struct I2C_CacheEntry {
+	volatile u32 sequence; // odd while the holder of the bus lock changes the entry
+	u8 devid;
+	u8 flags;              // I2C_CACHE_*, I2C_CACHE_ACTIVE
+	u16 regid;
+	u16 count;
+	u16 valid;             // registers holding a value
+	u32 ttl_ticks;
+	s32 hits;              // bumped by lock-free readers with ldrex/strex
+	u32 misses;
+	u64 bus_ticks;
+	u64 filled[I2C_CACHE_MAX_REGISTERS]; // tick each value was read at
+	u16 values[I2C_CACHE_MAX_REGISTERS];
+} I2C_CacheEntry;
+
+_Static_assert(I2C_CACHE_MAX_REGISTERS <= 16, "valid is a 16 bit mask");
+
+u32 I2C_CachedDevices;
+
+static LightLock I2C_CacheLock; // serializes configuration and dumps
+static I2C_CacheEntry I2C_CacheEntries[I2C_CACHE_MAX_ENTRIES];
+
+void I2C_Cache_Init(void)
+{
+	LightLock_Init(&I2C_CacheLock);
+}
+
+static inline void I2C_Cache_BeginWrite(I2C_CacheEntry *e)
+{
+	e->sequence++;
+	__dmb();
+}
+
+static inline void I2C_Cache_EndWrite(I2C_CacheEntry *e)
+{
+	__dmb();
+	e->sequence++;
+}
+
+static inline u8 I2C_Cache_Port(u8 devid)
+{
+	return I2C_GetDeviceConfig(devid)->port;
+}
+
+static inline bool I2C_Cache_Matches(const I2C_CacheEntry *e, u8 devid, bool reg16)
+{
+	return (e->flags & I2C_CACHE_ACTIVE) && e->devid == devid && !(e->flags & I2C_CACHE_REGISTERS16) == !reg16;
+}
+
+// index of regid in the entry, or I2C_CACHE_MAX_REGISTERS if it is not covered
+static inline u32 I2C_Cache_Index(const I2C_CacheEntry *e, u16 regid)
+{
+	u32 offset = (u32)(u16)(regid - e->regid);
+
+	if (e->flags & I2C_CACHE_REGISTERS16) {
+		if (offset & 1)
+			return I2C_CACHE_MAX_REGISTERS;
+		offset >>= 1;
+	}
+
+	return offset < e->count ? offset : I2C_CACHE_MAX_REGISTERS;
+}
+
+bool I2C_Cache_Lookup(u8 devid, u16 regid, bool reg16, u16 *value)
+{
+	u64 now = (u64)svcGetSystemTick();
+
+	for (u32 i = 0; i < I2C_CACHE_MAX_ENTRIES; i++) {
+		I2C_CacheEntry *e = &I2C_CacheEntries[i];
+		u32 sequence = e->sequence;
+
+		if (sequence & 1)
+			continue;
+
+		__dmb();
+
+		if (!I2C_Cache_Matches(e, devid, reg16))
+			continue;
+
+		u32 index = I2C_Cache_Index(e, regid);
+
+		if (index == I2C_CACHE_MAX_REGISTERS)
+			continue;
+
+		bool fresh = (e->valid & BIT(index)) && now - e->filled[index] < e->ttl_ticks;
+		u16 cached = e->values[index];
+
+		__dmb();
+
+		// a range is only cached once per devid and width, so a stale or torn entry is a miss
+		if (!fresh || e->sequence != sequence)
+			return false;
+
+		s32 hits;
+
+		do
+			hits = __ldrex(&e->hits);
+		while (__strex(&e->hits, hits + 1));
+
+		*value = cached;
+		return true;
+	}
+
+	return false;
+}
+
+void I2C_Cache_Fill(u8 devid, u16 regid, bool reg16, u16 value, u64 start_tick)
+{
+	for (u32 i = 0; i < I2C_CACHE_MAX_ENTRIES; i++) {
+		I2C_CacheEntry *e = &I2C_CacheEntries[i];
+
+		if (!I2C_Cache_Matches(e, devid, reg16))
+			continue;
+
+		u32 index = I2C_Cache_Index(e, regid);
+
+		if (index == I2C_CACHE_MAX_REGISTERS)
+			continue;
+
+		u64 now = (u64)svcGetSystemTick();
+
+		I2C_Cache_BeginWrite(e);
+		e->values[index] = value;
+		e->filled[index] = now;
+		e->valid |= BIT(index);
+		I2C_Cache_EndWrite(e);
+
+		e->misses++;
+		e->bus_ticks += now - start_tick;
+		return;
+	}
+}
+
+void I2C_Cache_InvalidateDevice(u8 devid)
+{
+	for (u32 i = 0; i < I2C_CACHE_MAX_ENTRIES; i++) {
+		I2C_CacheEntry *e = &I2C_CacheEntries[i];
+
+		if (!(e->flags & I2C_CACHE_ACTIVE) || e->devid != devid || !e->valid)
+			continue;
+
+		I2C_Cache_BeginWrite(e);
+		e->valid = 0;
+		I2C_Cache_EndWrite(e);
+	}
+}
+
+static void I2C_Cache_UpdateDevices(void)
+{
+	u32 devices = 0;
+
+	for (u32 i = 0; i < I2C_CACHE_MAX_ENTRIES; i++)
+		if (I2C_CacheEntries[i].flags & I2C_CACHE_ACTIVE)
+			devices |= BIT(I2C_CacheEntries[i].devid);
+
+	I2C_CachedDevices = devices;
+}
+
+Result I2C_Cache_Configure(u8 devid, u16 regid, u16 count, u32 ttl_ticks, u8 flags)
+{
+	bool reg16 = flags & I2C_CACHE_REGISTERS16;
+	u32 end = (u32)regid + (reg16 ? 2 * (u32)count : count);
+
+	if (!I2C_GetDeviceConfig(devid) || (flags & ~I2C_CACHE_REGISTERS16))
+		return I2C_INTERNAL_RANGE;
+
+	if (ttl_ticks && (!count || count > I2C_CACHE_MAX_REGISTERS || end > (reg16 ? 0x10000 : 0x100)))
+		return I2C_INVALID_SIZE;
+
+	if (ttl_ticks > I2C_CACHE_MAX_TTL_TICKS)
+		return I2C_CACHE_TTL_TOO_LONG;
+
+	LightLock_Lock(&I2C_CacheLock);
+
+	I2C_CacheEntry *slot = NULL, *free_slot = NULL;
+	Result res = 0;
+
+	for (u32 i = 0; i < I2C_CACHE_MAX_ENTRIES; i++) {
+		I2C_CacheEntry *e = &I2C_CacheEntries[i];
+
+		if (!(e->flags & I2C_CACHE_ACTIVE)) {
+			if (!free_slot)
+				free_slot = e;
+			continue;
+		}
+
+		if (!I2C_Cache_Matches(e, devid, reg16))
+			continue;
+
+		if (e->regid == regid) {
+			slot = e; // reconfigured or removed in place
+			continue;
+		}
+
+		u32 e_end = (u32)e->regid + (reg16 ? 2 * (u32)e->count : e->count);
+
+		if (ttl_ticks && regid < e_end && e->regid < end) {
+			res = I2C_CACHE_OVERLAP;
+			goto exit;
+		}
+	}
+
+	bool exists = slot != NULL;
+
+	if (!ttl_ticks && !exists)
+		res = I2C_CACHE_NOT_FOUND;
+	else if (!exists && !(slot = free_slot))
+		res = I2C_CACHE_FULL;
+
+	if (R_FAILED(res))
+		goto exit;
+
+	u8 port = I2C_Cache_Port(devid);
+
+	// fills and invalidations of this device hold its bus lock, so they see the entry either way
+	I2C_HoldBus(port);
+
+	I2C_Cache_BeginWrite(slot);
+
+	if (ttl_ticks) {
+		slot->devid = devid;
+		slot->regid = regid;
+		slot->count = count;
+		slot->valid = 0;
+		slot->ttl_ticks = ttl_ticks;
+
+		if (!exists) {
+			slot->hits = 0;
+			slot->misses = 0;
+			slot->bus_ticks = 0;
+		}
+
+		slot->flags = flags | I2C_CACHE_ACTIVE;
+	} else {
+		slot->flags = 0;
+		slot->valid = 0;
+	}
+
+	I2C_Cache_EndWrite(slot);
+	I2C_Cache_UpdateDevices();
+
+	I2C_ReleaseBus(port);
+
+exit:
+	LightLock_Unlock(&I2C_CacheLock);
+	return res;
+}
+
+u32 I2C_Cache_Dump(I2C_CacheStats *out, u32 max_entries, bool reset)
+{
+	u32 n = 0;
+
+	LightLock_Lock(&I2C_CacheLock);
+
+	for (u32 i = 0; i < I2C_CACHE_MAX_ENTRIES && n < max_entries; i++) {
+		I2C_CacheEntry *e = &I2C_CacheEntries[i];
+
+		if (!(e->flags & I2C_CACHE_ACTIVE))
+			continue;
+
+		u8 port = I2C_Cache_Port(e->devid);
+		I2C_CacheStats *s = &out[n++];
+
+		I2C_HoldBus(port);
+
+		s32 hits = *(volatile s32 *)&e->hits;
+
+		if (reset) {
+			do
+				hits = __ldrex(&e->hits);
+			while (__strex(&e->hits, 0));
+		}
+
+		s->devid = e->devid;
+		s->flags = e->flags & I2C_CACHE_REGISTERS16;
+		s->regid = e->regid;
+		s->count = e->count;
+		s->reserved = 0;
+		s->ttl_ticks = e->ttl_ticks;
+		s->hits = (u32)hits;
+		s->misses = e->misses;
+		s->bus_ticks = e->bus_ticks;
+		s->saved_ticks = e->misses ? (u64)(u32)hits * (e->bus_ticks / e->misses) : 0;
+
+		if (reset) {
+			e->misses = 0;
+			e->bus_ticks = 0;
+		}
+
+		I2C_ReleaseBus(port);
+	}
+
+	LightLock_Unlock(&I2C_CacheLock);
+	return n;
+}
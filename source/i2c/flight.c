@@ -0,0 +1,165 @@
+#include <3ds/synchronization.h>
+
+#include <i2c/flight.h>
+#include <i2c/i2c.h>
+#include <memops.h>
+
+enum {
+	I2C_FLIGHT_FREE   = 0,
+	I2C_FLIGHT_OPEN   = 1, // the leader has not read the data yet, identical reads join
+	I2C_FLIGHT_CLOSED = 2, // data published, the remaining refs are copying it
+};
+
+// the slot table of a bus is only looked at and changed under its flight lock, never under the bus lock alone
+typedef struct __attribute__((aligned(I2C_CPU_CACHE_LINE))) I2C_FlightTable {
+	LightLock lock;
+	u32 driver_open; // flights opened by the transfer driver and not completed yet
+	I2C_Flight slots[I2C_FLIGHT_SLOTS];
+} I2C_FlightTable;
+
+static I2C_FlightTable I2C_FlightTables[3]; // a line apart, see I2C_Bus
+
+void I2C_Flight_Init(void)
+{
+	for (u32 port = 0; port < 3; port++)
+		LightLock_Init(&I2C_FlightTables[port].lock);
+}
+
+static I2C_Flight *I2C_Flight_Open(u8 port, I2C_FlightKind kind, u8 devid, u16 regid, u32 size, bool driver, bool *leader)
+{
+	if (size > I2C_FLIGHT_MAX_SIZE)
+		return NULL;
+
+	I2C_Flight *flight = NULL;
+
+	LightLock_Lock(&I2C_FlightTables[port].lock);
+
+	for (u32 i = 0; i < I2C_FLIGHT_SLOTS; i++) {
+		I2C_Flight *f = &I2C_FlightTables[port].slots[i];
+
+		if (f->state == I2C_FLIGHT_OPEN && f->kind == kind && f->devid == devid && f->regid == regid && f->size == size) {
+			flight = f;
+			flight->refs++;
+			*leader = false;
+			goto exit;
+		}
+
+		if (!flight && f->state == I2C_FLIGHT_FREE)
+			flight = f;
+	}
+
+	if (flight) {
+		LightEvent_Init(&flight->done, RESET_STICKY);
+		flight->published = false;
+		flight->state = I2C_FLIGHT_OPEN;
+		flight->kind = (u8)kind;
+		flight->devid = devid;
+		flight->regid = regid;
+		flight->size = (u16)size;
+		flight->refs = 1;
+		flight->driver = driver;
+		I2C_FlightTables[port].driver_open += driver;
+		*leader = true;
+	}
+
+exit:
+	LightLock_Unlock(&I2C_FlightTables[port].lock);
+	return flight;
+}
+
+I2C_Flight *I2C_Flight_Join(u8 port, I2C_FlightKind kind, u8 devid, u16 regid, u32 size, bool *leader)
+{
+	return I2C_Flight_Open(port, kind, devid, regid, size, true, leader);
+}
+
+/*
+	A driver flight opened after the unlocked test is just not joined: both reads go to
+	the bus, as they would have without merging.
+*/
+I2C_Flight *I2C_Flight_JoinSession(u8 port, I2C_FlightKind kind, u8 devid, u16 regid, u32 size, bool *leader)
+{
+	if (!*(volatile u32 *)&I2C_FlightTables[port].driver_open)
+		return NULL;
+
+	return I2C_Flight_Open(port, kind, devid, regid, size, false, leader);
+}
+
+static void I2C_Flight_Release(u8 port, I2C_Flight *flight)
+{
+	LightLock_Lock(&I2C_FlightTables[port].lock);
+
+	if (!--flight->refs)
+		flight->state = I2C_FLIGHT_FREE;
+
+	LightLock_Unlock(&I2C_FlightTables[port].lock);
+}
+
+u32 I2C_Flight_Complete(u8 port, I2C_Flight *flight, bool ok, const void *data)
+{
+	LightLock_Lock(&I2C_FlightTables[port].lock);
+	flight->state = I2C_FLIGHT_CLOSED;
+	I2C_FlightTables[port].driver_open -= flight->driver;
+	u32 joined = flight->refs - 1u;
+	LightLock_Unlock(&I2C_FlightTables[port].lock);
+
+	// nobody joins a closed flight, so the data can be written without the flight lock
+	if (joined) {
+		flight->ok = ok;
+
+		if (ok)
+			_memcpy(flight->data, data, flight->size);
+
+		__dmb();
+		flight->published = true;
+		LightEvent_Signal(&flight->done);
+	}
+
+	I2C_Flight_Release(port, flight);
+	return joined;
+}
+
+static bool I2C_Flight_Copy(u8 port, I2C_Flight *flight, void *data)
+{
+	__dmb();
+
+	bool ok = flight->ok;
+
+	if (ok)
+		_memcpy(data, flight->data, flight->size);
+
+	I2C_Flight_Release(port, flight);
+	return ok;
+}
+
+bool I2C_Flight_Wait(u8 port, I2C_Flight *flight, void *data)
+{
+	LightEvent_Wait(&flight->done);
+	return I2C_Flight_Copy(port, flight, data);
+}
+
+bool I2C_Flight_Poll(u8 port, I2C_Flight *flight, void *data, bool *ok)
+{
+	if (!flight->published)
+		return false;
+
+	*ok = I2C_Flight_Copy(port, flight, data);
+	return true;
+}
+
+void I2C_Flight_Count(u8 port, u32 *driver_open, u32 *joiners)
+{
+	u32 waiting = 0;
+
+	LightLock_Lock(&I2C_FlightTables[port].lock);
+
+	for (u32 i = 0; i < I2C_FLIGHT_SLOTS; i++) {
+		const I2C_Flight *f = &I2C_FlightTables[port].slots[i];
+
+		if (f->state == I2C_FLIGHT_OPEN)
+			waiting += f->refs - 1u;
+	}
+
+	*driver_open = I2C_FlightTables[port].driver_open;
+	*joiners = waiting;
+	LightLock_Unlock(&I2C_FlightTables[port].lock);
+}
@@ -1,11 +1,40 @@
 #include <3ds/synchronization.h>
 #include <3ds/err.h>
 
+#include <i2c/flight.h>
+#include <i2c/cache.h>
 #include <i2c/ipc.h>
 #include <i2c/i2c.h>
+#include <i2c/hal.h>
+#include <i2c/stats.h>
+#include <i2c/trace.h>
 
-Handle g_I2C_BusInterrupts[3] = { 0 };
-RecursiveLock g_I2C_BusLocks[3] = { 0 };
+/*
+	A register read holds its bus for ~100us, so a waiter arriving late in it is better
+	off polling than arbitrating; the spin is bounded by I2C_BUS_LOCK_SPIN_TICKS (~20us)
+	and adapts to how long the holders actually take. Only N3DS runs session workers on
+	a second core (core 3); on O3DS every holder shares the spinner's core and cannot
+	release the lock before the spin ends, so the locks block at once there.
+*/
+#ifdef N3DS
+#define I2C_BUS_LOCK_SPINS 1024
+#else
+#define I2C_BUS_LOCK_SPINS 0
+#endif
+#define I2C_BUS_LOCK_SPIN_TICKS 5362 // 268111856 Hz system tick
+#define I2C_BUS_LOCK_SPIN { .max_spins = I2C_BUS_LOCK_SPINS, .max_ticks = I2C_BUS_LOCK_SPIN_TICKS, .adaptive = true }
+
+#ifdef I2C_HOST
+#define I2C_BUS_REGS(addr) NULL // the simulated bus is reached through the HAL
+#else
+#define I2C_BUS_REGS(addr) ((volatile I2C_BusRegset *)(addr))
+#endif
+
+I2C_Bus g_I2C_Buses[3] = {
+	{ .regs = I2C_BUS_REGS(I2C_BUS_ADDR(0)), .spin = I2C_BUS_LOCK_SPIN },
+	{ .regs = I2C_BUS_REGS(I2C_BUS_ADDR(1)), .spin = I2C_BUS_LOCK_SPIN },
+	{ .regs = I2C_BUS_REGS(I2C_BUS_ADDR(2)), .spin = I2C_BUS_LOCK_SPIN },
+};
 
 #ifdef N3DS
 #define I2C_DEVID_MAX 17
@@ -38,153 +67,316 @@ static const I2C_DeviceConfig devConf[I2C_DEVID_MAX + 1] = {
 #endif
 };
 
-bool I2C_CheckDeviceAccess(I2C_SessionType session_type, u8 devid) {
-	switch (session_type)
-	{
-	case I2C_SESSION_TYPE_MCU:
-		return devid == 0 || devid == 3;
-	case I2C_SESSION_TYPE_CAM:
-		return devid == 1 || devid == 2 || devid == 4;
-	case I2C_SESSION_TYPE_LCD:
-		return devid == 5 || devid == 6;
-	case I2C_SESSION_TYPE_DEB:
-		return devid == 7 || devid == 8;
-	case I2C_SESSION_TYPE_HID:
-		return devid == 9 || devid == 10 || devid == 11 || devid == 12;
-	case I2C_SESSION_TYPE_IR:
+// devids each service may access, indexed by I2C_SessionType
+static const u32 I2C_DeviceAccess[I2C_SERVICE_MAX] = {
+	[I2C_SESSION_TYPE_MCU] = BIT(0) | BIT(3),
+	[I2C_SESSION_TYPE_CAM] = BIT(1) | BIT(2) | BIT(4),
+	[I2C_SESSION_TYPE_LCD] = BIT(5) | BIT(6),
+	[I2C_SESSION_TYPE_DEB] = BIT(7) | BIT(8),
+	[I2C_SESSION_TYPE_HID] = BIT(9) | BIT(10) | BIT(11) | BIT(12),
 #ifdef N3DS
-		return devid == 13 || devid == 17;
+	[I2C_SESSION_TYPE_IR]  = BIT(13) | BIT(17),
 #else
-		return devid == 13;
+	[I2C_SESSION_TYPE_IR]  = BIT(13),
 #endif
-	case I2C_SESSION_TYPE_EEP:
-		return devid == 14;
+	[I2C_SESSION_TYPE_EEP] = BIT(14),
 #ifdef N3DS
-	case I2C_SESSION_TYPE_NFC:
-		return devid == 15;
-	case I2C_SESSION_TYPE_QTM:
-		return devid == 16;
+	[I2C_SESSION_TYPE_NFC] = BIT(15),
+	[I2C_SESSION_TYPE_QTM] = BIT(16),
 #endif
-	default:
-		return false;
-	}
+};
+
+_Static_assert(I2C_DEVID_MAX < 32, "device access masks are 32 bits wide");
+
+u32 I2C_GetDeviceAccessMask(I2C_SessionType session_type) {
+	return (u32)session_type < I2C_SERVICE_MAX ? I2C_DeviceAccess[session_type] : 0;
 }
 
-volatile I2C_BusRegset *const I2C_BUS[3] = {
-	(I2C_BusRegset *)0x1EC61000,
-	(I2C_BusRegset *)0x1EC44000,
-	(I2C_BusRegset *)0x1EC48000,
-};
+bool I2C_CheckDeviceAccess(I2C_SessionType session_type, u8 devid) {
+	return (I2C_GetDeviceAccessMask(session_type) & I2C_DevidMask(devid)) == I2C_DevidMask(devid);
+}
+
+const I2C_DeviceConfig *I2C_GetDeviceConfig(u8 devid) {
+	return devid > I2C_DEVID_MAX ? NULL : &devConf[devid];
+}
+
+/*
+	Every phase waits for the bus interrupt for at most the timeout_ns of its bus: a fixed
+	allowance for clock stretching and interrupt latency, plus I2C_TIMEOUT_PHASES times
+	the wire time of one phase (start or stop, a byte and its ACK) at the configured SCL.
+*/
+#define I2C_SCL_BASE_CLOCK_HZ (67027964 / 8)
+#define I2C_SCL_FIXED_TICKS   18 // divider ticks added to the programmed low and high durations
+#define I2C_PHASE_SCL_CYCLES  11
+#define I2C_TIMEOUT_BASE_NS   1000000
+#define I2C_TIMEOUT_PHASES    8
+
+static inline u64 I2C_SclPeriodNs(u16 scl) {
+	return ((u64)(scl & 0x3F) + ((scl >> 8) & 0x1F) + I2C_SCL_FIXED_TICKS) * 1000000000ULL / I2C_SCL_BASE_CLOCK_HZ;
+}
 
-static inline void spinwait(u32 n) {
-	for (u32 i = n; i > 2; i -= 2) { }
+static void I2C_ConfigureBus(u8 port, u16 scl) {
+	u64 period_ns = I2C_SclPeriodNs(scl);
+	
+	g_I2C_Buses[port].scl = scl;
+	g_I2C_Buses[port].timeout_ns = I2C_TIMEOUT_BASE_NS + I2C_TIMEOUT_PHASES * I2C_PHASE_SCL_CYCLES * period_ns;
+	
+	I2C_REG_WRITE(port, CNTEX, I2C_CNTEX_WAIT_SCL_IDLE);
+	I2C_REG_WRITE(port, SCL, scl);
 }
 
 void I2C_Initialize() {
 	for (int i = 0; i < 3; i++) {
-		I2C_BUS[i]->CNTEX = I2C_CNTEX_WAIT_SCL_IDLE;
-		I2C_BUS[i]->SCL = I2C_SCL_HIGH_DURATION(5);
-		T(svcClearEvent(g_I2C_BusInterrupts[i]));
+		I2C_ConfigureBus(i, I2C_SCL_HIGH_DURATION(5));
+		T(svcClearEvent(g_I2C_Buses[i].interrupt));
 	}
 }
 
-#define BUS(dc) (I2C_BUS[dc->port])
-#define CHECK_ACK(dc) ((BUS(dc)->CNT & I2C_CNT_TXN_ACK) == I2C_CNT_TXN_ACK)
+static inline void I2C_LockBus(u8 port) {
+	I2C_Stats_LockRequested(port);
+	
+	LightLockWait wait = RecursiveLock_LockSpin(&g_I2C_Buses[port].lock, &g_I2C_Buses[port].spin);
+	
+	I2C_Stats_LockAcquired(port, wait);
+}
 
-// low level
+static inline void I2C_UnlockBus(u8 port) {
+	I2C_Stats_LockReleased(port);
+	I2C_ReleaseBus(port);
+}
 
-static bool I2C_SelectDevice(u8 devid) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
+// with the bus lock held, once the leader of a merged read has its data
+static inline void I2C_LandFlight(u8 port, I2C_Flight *flight, bool res, const void *data) {
+	if (flight)
+		I2C_Stats_ReadsMerged(port, I2C_Flight_Complete(port, flight, res, data));
+}
+
+#define CHECK_ACK(port) ((I2C_REG_READ(port, CNT) & I2C_CNT_TXN_ACK) == I2C_CNT_TXN_ACK)
+
+static inline bool I2C_WaitInterrupt(u8 port) {
+	Result res = svcWaitSynchronization(g_I2C_Buses[port].interrupt, g_I2C_Buses[port].timeout_ns);
 	
-	BUS(dc)->DATA = dc->write_addr;
+	if (res == OS_TIMEOUT)
+		return false;
 	
-	spinwait(1125);
+	TIS(res);
+	return true;
+}
+
+/*
+	A phase that never completed leaves the controller busy, either because its
+	interrupt got lost or because a device holds SDA low. Cancelling is enough for the
+	former. Otherwise the controller is reset and given a read phase: the nine SCL
+	pulses let a device that stopped mid-byte finish it and release SDA, and the stop
+	after it puts the bus back in idle.
+*/
+static void I2C_RecoverBus(u8 port) {
+	bool clocked_out = false;
+	
+	I2C_REG_WRITE(port, CNT, I2C_CNT_TXN_FINISH | I2C_CNT_TXN_CANCEL | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE);
+	bool recovered = I2C_WaitInterrupt(port);
+	
+	if (!recovered) {
+		clocked_out = true;
+		
+		I2C_REG_WRITE(port, CNT, 0);
+		I2C_ConfigureBus(port, g_I2C_Buses[port].scl);
+		I2C_REG_WRITE(port, CNT, I2C_CNT_TXN_FINISH | I2C_CNT_DIRECTION_READ | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE);
+		
+		if (!(recovered = I2C_WaitInterrupt(port)))
+			I2C_REG_WRITE(port, CNT, 0); // still stuck, the next phase times out again
+	}
 	
-	BUS(dc)->CNT = I2C_CNT_TXN_START | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE;
+	T(svcClearEvent(g_I2C_Buses[port].interrupt));
+	I2C_Stats_BusRecovery(port, clocked_out, recovered);
+}
+
+// waits for the phase just started; on a timeout the bus is recovered and the phase reported failed
+static bool I2C_WaitBus(u8 port) {
+	if (I2C_WaitInterrupt(port))
+		return true;
+	
+	I2C_Stats_BusTimeout(port);
+	I2C_RecoverBus(port);
+	return false;
+}
+
+// per-device SCL, see I2C_TuneScl; written with the bus lock of the device's port held
+typedef struct I2C_DeviceScl {
+	u16 scl;
+	bool own; // set by I2C_SCL_TUNE_APPLY, the device no longer runs at its bus's base SCL
+} I2C_DeviceScl;
+
+static I2C_DeviceScl I2C_DeviceScls[I2C_DEVID_MAX + 1];
+
+// before a device is selected on a bus where some device has its own SCL, load the device's
+static inline void I2C_LoadDeviceScl(u8 devid, u8 port) {
+	I2C_Bus *bus = &g_I2C_Buses[port];
+	
+	if (!bus->scl_devices)
+		return;
 	
-	TIS(svcWaitSynchronization(g_I2C_BusInterrupts[dc->port], -1));
+	u16 scl = I2C_DeviceScls[devid].own ? I2C_DeviceScls[devid].scl : bus->base_scl;
 	
-	return CHECK_ACK(dc);
+	if (scl != bus->scl)
+		I2C_ConfigureBus(port, scl);
 }
 
-static bool I2C_SelectRegister(u8 devid, u8 regid) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
+// low level
+
+/*
+	Every phase takes the port and write address of its device. The devid functions below
+	look them up in devConf for each phase; the fast paths of the hot devices pass them as
+	constants, so the bus state, its register block (hal.h) and the address bytes fold into
+	immediates there.
+*/
+#define I2C_PHASE static inline __attribute__((always_inline))
+#define I2C_GENERIC __attribute__((noinline)) // one copy of each for every other caller
+
+I2C_PHASE bool I2C_Phase_Select(u8 devid, u8 port, u8 addr) {
+	I2C_REG_WRITE(port, DATA, addr);
+	
+	spinwait(1125);
+	
+	u32 tick = I2C_Trace_Now();
 	
-	BUS(dc)->DATA = regid;
-	BUS(dc)->CNT = I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE;
+	I2C_REG_WRITE(port, CNT, I2C_CNT_TXN_START | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE);
 	
-	TIS(svcWaitSynchronization(g_I2C_BusInterrupts[dc->port], -1));
+	bool ack = I2C_WaitBus(port) && CHECK_ACK(port);
 	
-	return CHECK_ACK(dc);
+	I2C_Trace_Record(tick, I2C_TRACE_SELECT, devid, port, addr, ack);
+	
+	return ack;
 }
 
-static bool I2C_WriteIntermediate(u8 devid, u8 value) {
-	return I2C_SelectRegister(devid, value); /* identical, apparently */
+I2C_PHASE bool I2C_Phase_Transmit(u8 devid, u8 port, u8 value, I2C_TracePhase phase) {
+	u32 tick = I2C_Trace_Now();
+	
+	I2C_REG_WRITE(port, DATA, value);
+	I2C_REG_WRITE(port, CNT, I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE);
+	
+	bool ack = I2C_WaitBus(port) && CHECK_ACK(port);
+	
+	I2C_Trace_Record(tick, phase, devid, port, value, ack);
+	
+	return ack;
 }
 
-static void I2C_CancelTransaction(u8 devid) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
+I2C_PHASE void I2C_Phase_Cancel(u8 devid, u8 port) {
+	u32 tick = I2C_Trace_Now();
 	
-	BUS(dc)->CNT = I2C_CNT_TXN_FINISH | I2C_CNT_TXN_CANCEL | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE;
+	I2C_REG_WRITE(port, CNT, I2C_CNT_TXN_FINISH | I2C_CNT_TXN_CANCEL | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE);
 	
-	TIS(svcWaitSynchronization(g_I2C_BusInterrupts[dc->port], -1));
+	I2C_WaitBus(port);
+	
+	I2C_Trace_Record(tick, I2C_TRACE_CANCEL, devid, port, 0, false);
+	I2C_Stats_AttemptCancelled();
 }
 
-static bool I2C_BeginRead(u8 devid) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
-
-	BUS(dc)->DATA = dc->write_addr | 1; // read address
+I2C_PHASE bool I2C_Phase_BeginRead(u8 devid, u8 port, u8 addr) {
+	I2C_REG_WRITE(port, DATA, addr | 1); // read address
+	g_I2C_Buses[port].timed_out = false;
 	
 	spinwait(1125);
 	
-	BUS(dc)->CNT = I2C_CNT_TXN_START | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE;
+	u32 tick = I2C_Trace_Now();
+	
+	I2C_REG_WRITE(port, CNT, I2C_CNT_TXN_START | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE);
 	
-	TIS(svcWaitSynchronization(g_I2C_BusInterrupts[dc->port], -1));
+	bool ack = I2C_WaitBus(port) && CHECK_ACK(port);
 	
-	return CHECK_ACK(dc);
+	I2C_Trace_Record(tick, I2C_TRACE_BEGIN_READ, devid, port, addr | 1, ack);
+	
+	return ack;
 }
 
-static u8 I2C_ReadIntermediate(u8 devid) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
+// a data byte in; the last one of a read finishes the transaction
+I2C_PHASE u8 I2C_Phase_Receive(u8 devid, u8 port, bool last) {
+	u32 tick = I2C_Trace_Now();
 	
-	BUS(dc)->CNT = I2C_CNT_TXN_ACK | I2C_CNT_DIRECTION_READ | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE;
+	I2C_REG_WRITE(port, CNT, (last ? I2C_CNT_TXN_FINISH : I2C_CNT_TXN_ACK) | I2C_CNT_DIRECTION_READ | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE);
 	
-	TIS(svcWaitSynchronization(g_I2C_BusInterrupts[dc->port], -1));
+	if (!I2C_WaitBus(port))
+		g_I2C_Buses[port].timed_out = true;
 	
-	return BUS(dc)->DATA;
-}
-
-static u8 I2C_FinishRead(u8 devid) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
+	u8 value = I2C_REG_READ(port, DATA);
 	
-	BUS(dc)->CNT = I2C_CNT_TXN_FINISH | I2C_CNT_DIRECTION_READ | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE;
+	I2C_Trace_Record(tick, last ? I2C_TRACE_FINISH_READ : I2C_TRACE_READ, devid, port, value, !last);
 	
-	TIS(svcWaitSynchronization(g_I2C_BusInterrupts[dc->port], -1));
+	if (last)
+		I2C_Stats_AttemptFinished();
 	
-	return BUS(dc)->DATA;
+	return value;
 }
 
-static bool I2C_FinishWrite(u8 devid, u8 value) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
+I2C_PHASE bool I2C_Phase_FinishWrite(u8 devid, u8 port, u8 value) {
+	u32 tick = I2C_Trace_Now();
+	
+	I2C_REG_WRITE(port, DATA, value);
+	I2C_REG_WRITE(port, CNT, I2C_CNT_TXN_FINISH | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE);
 	
-	BUS(dc)->DATA = value;
-	BUS(dc)->CNT = I2C_CNT_TXN_FINISH | I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE;
+	bool ack = I2C_WaitBus(port) && CHECK_ACK(port);
 	
-	TIS(svcWaitSynchronization(g_I2C_BusInterrupts[dc->port], -1));
+	I2C_Trace_Record(tick, I2C_TRACE_FINISH_WRITE, devid, port, value, ack);
+	I2C_Stats_AttemptFinished();
 	
-	return CHECK_ACK(dc);
+	return ack;
+}
+
+// the address phase alone, at whatever SCL the bus runs; the SCL sweep selects through it
+static I2C_GENERIC bool I2C_SelectAddress(u8 devid) {
+	return I2C_Phase_Select(devid, devConf[devid].port, devConf[devid].write_addr);
+}
+
+static bool I2C_SelectDevice(u8 devid) {
+	I2C_LoadDeviceScl(devid, devConf[devid].port);
+	return I2C_SelectAddress(devid);
+}
+
+static I2C_GENERIC bool I2C_SelectRegister(u8 devid, u8 regid) {
+	return I2C_Phase_Transmit(devid, devConf[devid].port, regid, I2C_TRACE_REGISTER);
+}
+
+static I2C_GENERIC bool I2C_WriteIntermediate(u8 devid, u8 value) {
+	return I2C_Phase_Transmit(devid, devConf[devid].port, value, I2C_TRACE_WRITE); /* identical to selecting a register on the wire */
+}
+
+static I2C_GENERIC void I2C_CancelTransaction(u8 devid) {
+	I2C_Phase_Cancel(devid, devConf[devid].port);
+}
+
+static I2C_GENERIC bool I2C_BeginRead(u8 devid) {
+	return I2C_Phase_BeginRead(devid, devConf[devid].port, devConf[devid].write_addr);
+}
+
+static I2C_GENERIC u8 I2C_ReadIntermediate(u8 devid) {
+	return I2C_Phase_Receive(devid, devConf[devid].port, false);
+}
+
+static I2C_GENERIC u8 I2C_FinishRead(u8 devid) {
+	return I2C_Phase_Receive(devid, devConf[devid].port, true);
+}
+
+static I2C_GENERIC bool I2C_FinishWrite(u8 devid, u8 value) {
+	return I2C_Phase_FinishWrite(devid, devConf[devid].port, value);
 }
 
 // low-ish level
 
-static bool _I2C_ReadRegister8(u8 devid, u8 regid, u8 *out_val) {
+/*
+	The transactions of the hot commands, on the phases with the port and address explicit
+	so that the fast paths (I2C_Fast*) get them as constants.
+*/
+I2C_PHASE bool I2C_ReadRegisters8_At(u8 devid, u8 port, u8 addr, u8 regid, u8 *buf, u32 size) {
 	bool res = false;
 	
 	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
-		if (!(res = I2C_SelectDevice(devid)) ||
-			!(res = I2C_SelectRegister(devid, regid)) ||
-			!(res = I2C_BeginRead(devid))) {
-				I2C_CancelTransaction(devid);
+		I2C_LoadDeviceScl(devid, port);
+		
+		if (!(res = I2C_Phase_Select(devid, port, addr)) ||
+			!(res = I2C_Phase_Transmit(devid, port, regid, I2C_TRACE_REGISTER)) ||
+			!(res = I2C_Phase_BeginRead(devid, port, addr))) {
+				I2C_Phase_Cancel(devid, port);
 				continue;
 		} else {
 			break;
@@ -193,19 +385,27 @@ static bool _I2C_ReadRegister8(u8 devid, u8 regid, u8 *out_val) {
 	
 	if (!res) return res;
 	
-	*out_val = I2C_FinishRead(devid);
+	for (u32 index = 0; index < size - 1; index++) {
+		buf[index] = I2C_Phase_Receive(devid, port, false);
+	}
 	
-	return true;
+	buf[size - 1] = I2C_Phase_Receive(devid, port, true);
+	
+	return !g_I2C_Buses[port].timed_out;
 }
 
-static bool _I2C_WriteRegister8(u8 devid, u8 regid, u8 value) {
+I2C_PHASE bool I2C_WriteRegister8_At(u8 devid, u8 port, u8 addr, u8 regid, u8 value) {
+	I2C_Cache_Invalidate(devid);
+	
 	bool res = false;
 	
 	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
-		if (!(res = I2C_SelectDevice(devid)) ||
-			!(res = I2C_SelectRegister(devid, regid)) ||
-			!(res = I2C_FinishWrite(devid, value))) {
-				I2C_CancelTransaction(devid);
+		I2C_LoadDeviceScl(devid, port);
+		
+		if (!(res = I2C_Phase_Select(devid, port, addr)) ||
+			!(res = I2C_Phase_Transmit(devid, port, regid, I2C_TRACE_REGISTER)) ||
+			!(res = I2C_Phase_FinishWrite(devid, port, value))) {
+				I2C_Phase_Cancel(devid, port);
 				continue;
 		} else {
 			break;
@@ -215,7 +415,21 @@ static bool _I2C_WriteRegister8(u8 devid, u8 regid, u8 value) {
 	return res;
 }
 
+static I2C_GENERIC bool _I2C_ReadRegisters8(u8 devid, u8 regid, u8 *buf, u32 size) {
+	return I2C_ReadRegisters8_At(devid, devConf[devid].port, devConf[devid].write_addr, regid, buf, size);
+}
+
+static I2C_GENERIC bool _I2C_ReadRegister8(u8 devid, u8 regid, u8 *out_val) {
+	return _I2C_ReadRegisters8(devid, regid, out_val, 1);
+}
+
+static I2C_GENERIC bool _I2C_WriteRegister8(u8 devid, u8 regid, u8 value) {
+	return I2C_WriteRegister8_At(devid, devConf[devid].port, devConf[devid].write_addr, regid, value);
+}
+
 static bool _I2C_WriteDevice8(u8 devid, u8 value) {
+	I2C_Cache_Invalidate(devid);
+	
 	bool res = false;
 	
 	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
@@ -251,10 +465,12 @@ static bool _I2C_ReadRegister16(u8 devid, u16 regid, u16 *out_val) {
 	*out_val = I2C_ReadIntermediate(devid) << 8;
 	*out_val |= I2C_FinishRead(devid);
 	
-	return true;
+	return !g_I2C_Buses[devConf[devid].port].timed_out;
 }
 
 static bool _I2C_WriteRegister16(u8 devid, u16 regid, u16 value) {
+	I2C_Cache_Invalidate(devid);
+	
 	bool res = false;
 	
 	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
@@ -280,7 +496,7 @@ bool I2C_ReplaceRegisterBits8(u8 devid, u8 regid, u8 value, u8 mask) {
 	const I2C_DeviceConfig *dc = &devConf[devid];
 	bool res = false;
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
 	
 	u8 curval = 0;
 	
@@ -292,7 +508,7 @@ bool I2C_ReplaceRegisterBits8(u8 devid, u8 regid, u8 value, u8 mask) {
 	res = _I2C_WriteRegister8(devid, regid, curval);
 	
 exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	return res;
 }
 
@@ -303,7 +519,7 @@ bool I2C_ReplaceRegisterBits16(u8 devid, u16 regid, u16 value, u16 mask) {
 	const I2C_DeviceConfig *dc = &devConf[devid];
 	bool res = false;
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
 	
 	u16 curval = 0;
 	
@@ -315,65 +531,125 @@ bool I2C_ReplaceRegisterBits16(u8 devid, u16 regid, u16 value, u16 mask) {
 	res = _I2C_WriteRegister16(devid, regid, curval);
 	
 exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	return res;
 }
 
-bool I2C_WriteRegister8(u8 devid, u8 regid, u8 value) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
+/*
+	The command bodies, with the bus lock. fast is a constant: the fast paths inline the
+	transaction on their constant port and address, the generic functions call the one
+	out-of-line copy.
+*/
+I2C_PHASE bool I2C_Do_WriteRegister8_At(bool fast, u8 devid, u8 port, u8 addr, u8 regid, u8 value) {
+	I2C_LockBus(port);
+	
+	bool res = fast ? I2C_WriteRegister8_At(devid, port, addr, regid, value) : _I2C_WriteRegister8(devid, regid, value);
+	
+	I2C_UnlockBus(port);
+	
+	return res;
+}
+
+I2C_PHASE bool I2C_Do_ReadRegister8_At(bool fast, u8 devid, u8 port, u8 addr, u8 regid, u8 *out_value) {
+	bool leader;
+	I2C_Flight *flight = I2C_Flight_JoinSession(port, I2C_FLIGHT_READ_REGISTERS8, devid, regid, 1, &leader);
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	if (flight && !leader)
+		return I2C_Flight_Wait(port, flight, out_value);
+	
+	I2C_LockBus(port);
+	
+	u64 start = I2C_Cache_IsCached(devid) ? (u64)svcGetSystemTick() : 0;
+	bool res = fast ? I2C_ReadRegisters8_At(devid, port, addr, regid, out_value, 1) : _I2C_ReadRegister8(devid, regid, out_value);
+	
+	if (res && start)
+		I2C_Cache_Fill(devid, regid, false, *out_value, start);
+	
+	I2C_LandFlight(port, flight, res, out_value);
+	I2C_UnlockBus(port);
+	return res;
+}
+
+I2C_PHASE bool I2C_Do_ReadRegisters8_At(bool fast, u8 devid, u8 port, u8 addr, u8 regid, u8 *buf, u32 size) {
+	bool leader;
+	I2C_Flight *flight = I2C_Flight_JoinSession(port, I2C_FLIGHT_READ_REGISTERS8, devid, regid, size, &leader);
 	
-	bool res = _I2C_WriteRegister8(devid, regid, value);
+	if (flight && !leader)
+		return I2C_Flight_Wait(port, flight, buf);
 	
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(port);
+	bool res = fast ? I2C_ReadRegisters8_At(devid, port, addr, regid, buf, size) : _I2C_ReadRegisters8(devid, regid, buf, size);
+	I2C_LandFlight(port, flight, res, buf);
+	I2C_UnlockBus(port);
 	
 	return res;
 }
 
+bool I2C_WriteRegister8(u8 devid, u8 regid, u8 value) {
+	if (devid > I2C_DEVID_MAX)
+		return false;
+	
+	return I2C_Do_WriteRegister8_At(false, devid, devConf[devid].port, devConf[devid].write_addr, regid, value);
+}
+
 bool I2C_WriteDevice8(u8 devid, u8 value) {
+	if (devid > I2C_DEVID_MAX)
+		return false;
+	
 	const I2C_DeviceConfig *dc = &devConf[devid];
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
 	
 	bool res = _I2C_WriteDevice8(devid, value);
 	
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	
 	return res;
 }
 
 bool I2C_WriteRegister16(u8 devid, u16 regid, u16 value) {
+	if (devid > I2C_DEVID_MAX)
+		return false;
+	
 	const I2C_DeviceConfig *dc = &devConf[devid];
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
 	
 	bool res = _I2C_WriteRegister16(devid, regid, value);
 	
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	
 	return res;
 }
 
 bool I2C_ReadRegister8(u8 devid, u8 regid, u8 *out_value) {
-	const I2C_DeviceConfig *dc = &devConf[devid];
-	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
-	
-	bool res = _I2C_ReadRegister8(devid, regid, out_value);
+	if (devid > I2C_DEVID_MAX)
+		return false;
 	
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
-	return res;
+	return I2C_Do_ReadRegister8_At(false, devid, devConf[devid].port, devConf[devid].write_addr, regid, out_value);
 }
 
 bool I2C_ReadRegister16(u8 devid, u16 regid, u16 *out_value) {
+	if (devid > I2C_DEVID_MAX)
+		return false;
+	
 	const I2C_DeviceConfig *dc = &devConf[devid];
+	bool leader;
+	I2C_Flight *flight = I2C_Flight_JoinSession(dc->port, I2C_FLIGHT_READ_REGISTERS16, devid, regid, sizeof(u16), &leader);
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	if (flight && !leader)
+		return I2C_Flight_Wait(dc->port, flight, out_value);
 	
+	I2C_LockBus(dc->port);
+	
+	u64 start = I2C_Cache_IsCached(devid) ? (u64)svcGetSystemTick() : 0;
 	bool res = _I2C_ReadRegister16(devid, regid, out_value);
 	
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	if (res && start)
+		I2C_Cache_Fill(devid, regid, true, *out_value, start);
+	
+	I2C_LandFlight(dc->port, flight, res, out_value);
+	I2C_UnlockBus(dc->port);
 	return res;
 }
 
@@ -384,7 +660,9 @@ bool I2C_WriteRegisters8(u8 devid, u8 regid, const u8 *buf, u32 size) {
 	const I2C_DeviceConfig *dc = &devConf[devid];
 	bool res = false;
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
+	
+	I2C_Cache_Invalidate(devid);
 	
 	u32 index = 0;
 	
@@ -416,19 +694,14 @@ retry:
 	res = I2C_FinishWrite(devid, buf[size - 1]);
 	
 exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	return res;
 }
 	
-bool I2C_WriteRegisters16(u8 devid, u16 regid, const u16 *buf, u32 count) {
-	if (devid > I2C_DEVID_MAX)
-		return false;
+static bool _I2C_WriteRegisters16(u8 devid, u16 regid, const u16 *buf, u32 count) {
+	I2C_Cache_Invalidate(devid);
 	
-	const I2C_DeviceConfig *dc = &devConf[devid];
 	bool res = false;
-	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
-	
 	u32 index = 0;
 	
 	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
@@ -456,62 +729,142 @@ bool I2C_WriteRegisters16(u8 devid, u16 regid, const u16 *buf, u32 count) {
 retry:
 	}
 	
-	if (!res || !(res = I2C_WriteIntermediate(devid, buf[count - 1] >> 8))) goto exit;
+	if (!res || !(res = I2C_WriteIntermediate(devid, buf[count - 1] >> 8))) return false;
 	
-	res = I2C_FinishWrite(devid, buf[count - 1] & 0xFF);
-exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
-	return res;
+	return I2C_FinishWrite(devid, buf[count - 1] & 0xFF);
 }
-	
-bool I2C_ReadRegisters8(u8 devid, u8 regid, u8 *buf, u32 size) {
+
+bool I2C_WriteRegisters16(u8 devid, u16 regid, const u16 *buf, u32 count) {
 	if (devid > I2C_DEVID_MAX)
 		return false;
 	
 	const I2C_DeviceConfig *dc = &devConf[devid];
-	bool res = false;
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
+	bool res = _I2C_WriteRegisters16(devid, regid, buf, count);
+	I2C_UnlockBus(dc->port);
 	
+	return res;
+}
+
+#define I2C_TABLE_BURST_MAX 32 // values per burst, they are staged on the stack
+
+bool I2C_WriteRegisterTable16(u8 devid, const I2C_RegisterWrite16 *table, u32 count, u32 *failed_index) {
+	if (devid > I2C_DEVID_MAX) {
+		*failed_index = 0;
+		return false;
+	}
+	
+	const I2C_DeviceConfig *dc = &devConf[devid];
+	u16 values[I2C_TABLE_BURST_MAX];
 	u32 index = 0;
 	
-	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
-		index = 0;
-		
-		if (!(res = I2C_SelectDevice(devid)) ||
-			!(res = I2C_SelectRegister(devid, regid)) ||
-			!(res = I2C_BeginRead(devid))) {
-			I2C_CancelTransaction(devid);
-			continue;
-		}
+	while (index < count) {
+		I2C_LockBus(dc->port);
 		
-		if (size == 1)
-			break;
+		// runs of ascending registers up to a delay share the bus hold, one burst per run
+		do {
+			u32 n = 0;
+			
+			do {
+				values[n] = table[index + n].value;
+				n++;
+			} while (index + n < count && n < I2C_TABLE_BURST_MAX && !table[index + n - 1].delay_us &&
+				table[index + n].regid == (u16)(table[index + n - 1].regid + 2));
+			
+			if (!_I2C_WriteRegisters16(devid, table[index].regid, values, n)) {
+				I2C_UnlockBus(dc->port);
+				*failed_index = index;
+				return false;
+			}
+			
+			index += n;
+		} while (index < count && !table[index - 1].delay_us);
 		
-		for (; index < size - 1; index++) {
-			buf[index] = I2C_ReadIntermediate(devid);
-		}
+		I2C_UnlockBus(dc->port);
 		
-		break;
+		// the bus is free for other devices while the sensor settles
+		if (table[index - 1].delay_us)
+			svcSleepThread((s64)table[index - 1].delay_us * 1000);
 	}
 	
-	if (!res) goto exit;
-	
-	buf[size - 1] = I2C_FinishRead(devid);
-exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
-	return res;
+	*failed_index = count;
+	return true;
 }
+	
 
-bool I2C_ReadRegisters16(u8 devid, u16 regid, u16 *buf, u32 count) {
+bool I2C_ReadRegisters8(u8 devid, u8 regid, u8 *buf, u32 size) {
 	if (devid > I2C_DEVID_MAX)
 		return false;
 	
-	const I2C_DeviceConfig *dc = &devConf[devid];
-	bool res = false;
+	return I2C_Do_ReadRegisters8_At(false, devid, devConf[devid].port, devConf[devid].write_addr, regid, buf, size);
+}
+
+/*
+	Fast paths of the devices polled continuously: the MCU, and the gyroscopes read by HID
+	at the sampling rate. Each (command, device) pair is the command body above with the
+	port and address of the device as constants, so no phase looks at devConf and, on
+	hardware, the register block is addressed directly instead of through I2C_Bus.regs.
+	Merging, the read cache, stats and trace stay calls as on the generic path; every
+	pair costs a copy of its transaction, so only hot devices belong in these lists.
+*/
+#define I2C_FAST_READ_REGISTER8(X)  X(3) X(10) X(11) // MCU, gyroscopes
+#define I2C_FAST_WRITE_REGISTER8(X) X(3)
+#define I2C_FAST_READ_REGISTERS8(X) X(3) X(10) X(11)
+
+#define I2C_FAST_AT(devid) true, devid, devConf[devid].port, devConf[devid].write_addr // static const, folds
+
+#define I2C_FAST_CASE_READ_REGISTER8(devid)  case devid: return I2C_Do_ReadRegister8_At(I2C_FAST_AT(devid), regid, out_value);
+#define I2C_FAST_CASE_WRITE_REGISTER8(devid) case devid: return I2C_Do_WriteRegister8_At(I2C_FAST_AT(devid), regid, value);
+#define I2C_FAST_CASE_READ_REGISTERS8(devid) case devid: return I2C_Do_ReadRegisters8_At(I2C_FAST_AT(devid), regid, buf, size);
+
+bool I2C_FastReadRegister8(u8 devid, u8 regid, u8 *out_value) {
+	switch (devid) {
+	I2C_FAST_READ_REGISTER8(I2C_FAST_CASE_READ_REGISTER8)
+	default: return I2C_ReadRegister8(devid, regid, out_value);
+	}
+}
+
+bool I2C_FastWriteRegister8(u8 devid, u8 regid, u8 value) {
+	switch (devid) {
+	I2C_FAST_WRITE_REGISTER8(I2C_FAST_CASE_WRITE_REGISTER8)
+	default: return I2C_WriteRegister8(devid, regid, value);
+	}
+}
+
+bool I2C_FastReadRegisters8(u8 devid, u8 regid, u8 *buf, u32 size) {
+	switch (devid) {
+	I2C_FAST_READ_REGISTERS8(I2C_FAST_CASE_READ_REGISTERS8)
+	default: return I2C_ReadRegisters8(devid, regid, buf, size);
+	}
+}
+
+bool I2C_ReadRegisters8Bursts(const I2C_ReadBurst *bursts, u32 n_bursts, u8 *buf) {
+	for (u32 i = 0; i < n_bursts; i++) {
+		if (bursts[i].devid > I2C_DEVID_MAX)
+			return false;
+	}
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	bool res = true;
+	
+	for (u32 i = 0; i < n_bursts && res;) {
+		u8 port = devConf[bursts[i].devid].port;
+		
+		I2C_LockBus(port);
+		
+		for (; i < n_bursts && devConf[bursts[i].devid].port == port; i++) {
+			if (!(res = _I2C_ReadRegisters8(bursts[i].devid, bursts[i].regid, buf + bursts[i].offset, bursts[i].size)))
+				break;
+		}
+		
+		I2C_UnlockBus(port);
+	}
 	
+	return res;
+}
+
+static bool _I2C_ReadRegisters16(u8 devid, u16 regid, u16 *buf, u32 count) {
+	bool res = false;
 	u32 index = 0;
 	
 	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
@@ -536,42 +889,170 @@ bool I2C_ReadRegisters16(u8 devid, u16 regid, u16 *buf, u32 count) {
 		break;
 	}
 	
-	if (!res) goto exit;
+	if (!res) return res;
 	
 	buf[count - 1] = I2C_ReadIntermediate(devid) << 8;
 	buf[count - 1] |= I2C_FinishRead(devid);
-exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	
+	return !g_I2C_Buses[devConf[devid].port].timed_out;
+}
+
+bool I2C_ReadRegisters16(u8 devid, u16 regid, u16 *buf, u32 count) {
+	if (devid > I2C_DEVID_MAX)
+		return false;
+	
+	const I2C_DeviceConfig *dc = &devConf[devid];
+	bool leader;
+	I2C_Flight *flight = I2C_Flight_JoinSession(dc->port, I2C_FLIGHT_READ_REGISTERS16, devid, regid, count * sizeof(u16), &leader);
+	
+	if (flight && !leader)
+		return I2C_Flight_Wait(dc->port, flight, buf);
+	
+	I2C_LockBus(dc->port);
+	bool res = _I2C_ReadRegisters16(devid, regid, buf, count);
+	I2C_LandFlight(dc->port, flight, res, buf);
+	I2C_UnlockBus(dc->port);
+	
 	return res;
 }
 
+enum {
+	I2C_LEGACY_BEFORE  = 0,
+	I2C_LEGACY_BETWEEN = 1,
+	I2C_LEGACY_AFTER   = 2,
+};
+
+#define I2C_LEGACY_RAISE_MIN_US 8
+
+// written with the bus lock of the device held
+typedef struct I2C_LegacyDelayState {
+	u16 ceiling_us[3]; // as configured
+	u16 delay_us[3];   // in use
+	u16 flags;
+	u16 streak;        // first-try reads since the delays last changed
+	u32 reads;
+	u32 retries;
+} I2C_LegacyDelayState;
+
+static I2C_LegacyDelayState I2C_LegacyDelayStates[I2C_DEVID_MAX + 1];
+
+static void I2C_LegacyDelays_Reset(I2C_LegacyDelayState *s, u16 before_us, u16 between_us, u16 after_us, u16 flags) {
+	s->ceiling_us[I2C_LEGACY_BEFORE] = s->delay_us[I2C_LEGACY_BEFORE] = before_us;
+	s->ceiling_us[I2C_LEGACY_BETWEEN] = s->delay_us[I2C_LEGACY_BETWEEN] = between_us;
+	s->ceiling_us[I2C_LEGACY_AFTER] = s->delay_us[I2C_LEGACY_AFTER] = after_us;
+	s->flags = flags;
+	s->streak = 0;
+	s->reads = 0;
+	s->retries = 0;
+}
+
+void I2C_LegacyDelays_Init(void) {
+	for (u32 i = 0; i <= I2C_DEVID_MAX; i++)
+		I2C_LegacyDelays_Reset(&I2C_LegacyDelayStates[i], 50, 150, 150, 0);
+}
+
+static inline void I2C_LegacyDelays_Sleep(const I2C_LegacyDelayState *s, u32 which) {
+	if (s->delay_us[which])
+		svcSleepThread((s64)s->delay_us[which] * 1000);
+}
+
+static void I2C_LegacyDelays_Raise(I2C_LegacyDelayState *s, u32 which) {
+	if (!(s->flags & I2C_LEGACY_DELAYS_ADAPTIVE))
+		return;
+	
+	u32 delay = s->delay_us[which] * 2;
+	
+	if (delay < I2C_LEGACY_RAISE_MIN_US)
+		delay = I2C_LEGACY_RAISE_MIN_US;
+	
+	s->delay_us[which] = delay < s->ceiling_us[which] ? delay : s->ceiling_us[which];
+	s->streak = 0;
+}
+
+static void I2C_LegacyDelays_Succeeded(I2C_LegacyDelayState *s) {
+	if (!(s->flags & I2C_LEGACY_DELAYS_ADAPTIVE) || ++s->streak < I2C_LEGACY_DECAY_STREAK)
+		return;
+	
+	for (u32 i = 0; i < 3; i++)
+		s->delay_us[i] -= s->delay_us[i] / 8 + (s->delay_us[i] != 0);
+	
+	s->streak = 0;
+}
+
+Result I2C_ConfigureLegacyDelays(u8 devid, u16 before_us, u16 between_us, u16 after_us, u16 flags) {
+	if (devid > I2C_DEVID_MAX || (flags & ~I2C_LEGACY_DELAYS_ADAPTIVE))
+		return I2C_INTERNAL_RANGE;
+	
+	if (before_us > I2C_LEGACY_DELAY_MAX_US || between_us > I2C_LEGACY_DELAY_MAX_US || after_us > I2C_LEGACY_DELAY_MAX_US)
+		return I2C_INVALID_SIZE;
+	
+	u8 port = devConf[devid].port;
+	
+	I2C_LockBus(port);
+	I2C_LegacyDelays_Reset(&I2C_LegacyDelayStates[devid], before_us, between_us, after_us, flags);
+	I2C_UnlockBus(port);
+	
+	return 0;
+}
+
+Result I2C_GetLegacyDelays(u8 devid, I2C_LegacyDelays *out) {
+	if (devid > I2C_DEVID_MAX)
+		return I2C_INTERNAL_RANGE;
+	
+	const I2C_LegacyDelayState *s = &I2C_LegacyDelayStates[devid];
+	u8 port = devConf[devid].port;
+	
+	I2C_LockBus(port);
+	out->before_us = s->delay_us[I2C_LEGACY_BEFORE];
+	out->between_us = s->delay_us[I2C_LEGACY_BETWEEN];
+	out->after_us = s->delay_us[I2C_LEGACY_AFTER];
+	out->flags = s->flags;
+	out->reads = s->reads;
+	out->retries = s->retries;
+	I2C_UnlockBus(port);
+	
+	return 0;
+}
+
 /* no clue what this is for, maybe used in previous versions? not used in anything i've looked at */
 bool I2C_ReadRegisters8Legacy(u8 devid, u8 regid, u8 *buf, u32 size) {
 	if (devid > I2C_DEVID_MAX)
 		return false;
 	
 	const I2C_DeviceConfig *dc = &devConf[devid];
+	I2C_LegacyDelayState *delays = &I2C_LegacyDelayStates[devid];
 	bool res = false;
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
+	
+	delays->reads++;
 	
 	u32 index = 0;
+	int i;
 	
-	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
+	for (i = 0; i < I2C_MAX_N_TRIES; i++) {
 		index = 0;
 		
-		svcSleepThread(50000);
+		I2C_LegacyDelays_Sleep(delays, I2C_LEGACY_BEFORE);
 		
-		if (!(res = I2C_SelectDevice(devid)))
+		if (!(res = I2C_SelectDevice(devid))) {
+			I2C_LegacyDelays_Raise(delays, I2C_LEGACY_BEFORE);
+			I2C_LegacyDelays_Raise(delays, I2C_LEGACY_AFTER);
 			goto retry;
+		}
 		
-		if (!(res = I2C_FinishWrite(devid, regid)))
+		// a NACKed register byte is a device still busy with the previous transaction
+		if (!(res = I2C_FinishWrite(devid, regid))) {
+			I2C_LegacyDelays_Raise(delays, I2C_LEGACY_AFTER);
 			goto retry;
+		}
 		
-		svcSleepThread(150000);
+		I2C_LegacyDelays_Sleep(delays, I2C_LEGACY_BETWEEN);
 		
-		if (!(res = I2C_BeginRead(devid)))
+		if (!(res = I2C_BeginRead(devid))) {
+			I2C_LegacyDelays_Raise(delays, I2C_LEGACY_BETWEEN);
 			goto retry;
+		}
 		
 		if (size == 1)
 			break;
@@ -585,12 +1066,19 @@ retry:
 		I2C_CancelTransaction(devid);
 	}
 	
+	delays->retries += i; // every attempt NACKed counts, also the last one of a failed read
+	
 	if (!res) goto exit;
 	
 	buf[size - 1] = I2C_FinishRead(devid);
-	svcSleepThread(150000);
+	res = !g_I2C_Buses[dc->port].timed_out;
+	
+	if (res && !i)
+		I2C_LegacyDelays_Succeeded(delays);
+	
+	I2C_LegacyDelays_Sleep(delays, I2C_LEGACY_AFTER);
 exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	return res;
 }
 
@@ -602,7 +1090,7 @@ bool I2C_ReadDeviceRaw(u8 devid, u8 *out_value) {
 	const I2C_DeviceConfig *dc = &devConf[devid];
 	bool res = false;
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
 	
 	for (int i = 0; i < I2C_MAX_N_TRIES; i++) {
 		if (!(res = I2C_BeginRead(devid))) {
@@ -611,10 +1099,11 @@ bool I2C_ReadDeviceRaw(u8 devid, u8 *out_value) {
 		}
 		
 		*out_value = I2C_FinishRead(devid);
+		res = !g_I2C_Buses[dc->port].timed_out;
 		break;
 	}
 
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	return res;
 }
 
@@ -625,7 +1114,9 @@ bool I2C_WriteDeviceRawMulti(u8 devid, const u8 *buf, u32 size) {
 	const I2C_DeviceConfig *dc = &devConf[devid];
 	bool res = false;
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
+	
+	I2C_Cache_Invalidate(devid);
 	
 	u32 index = 0;
 	
@@ -656,7 +1147,7 @@ retry:
 	res = I2C_FinishWrite(devid, buf[size - 1]);
 	
 exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	return res;
 }
 	
@@ -667,7 +1158,7 @@ bool I2C_ReadDeviceRawMulti(u8 devid, u8 *buf, u32 size) {
 	const I2C_DeviceConfig *dc = &devConf[devid];
 	bool res = false;
 	
-	RecursiveLock_Lock(&g_I2C_BusLocks[dc->port]);
+	I2C_LockBus(dc->port);
 	
 	u32 index = 0;
 	
@@ -692,8 +1183,517 @@ bool I2C_ReadDeviceRawMulti(u8 devid, u8 *buf, u32 size) {
 	if (!res) goto exit;
 	
 	buf[size - 1] = I2C_FinishRead(devid);
+	res = !g_I2C_Buses[dc->port].timed_out;
 exit:
-	RecursiveLock_Unlock(&g_I2C_BusLocks[dc->port]);
+	I2C_UnlockBus(dc->port);
 	return res;
 }
 #endif
+
+// non-blocking transfers
+
+#define I2C_TICKS_PER_SECOND 268111856ULL
+
+enum {
+	I2C_XFER_SELECT = 0,
+	I2C_XFER_REGISTER_HI,
+	I2C_XFER_REGISTER,
+	I2C_XFER_WRITE,
+	I2C_XFER_FINISH_WRITE,
+	I2C_XFER_BEGIN_READ,
+	I2C_XFER_READ,
+	I2C_XFER_FINISH_READ,
+	I2C_XFER_CANCEL,
+	I2C_XFER_RECOVER_CANCEL, // I2C_RecoverBus, split at its waits
+	I2C_XFER_RECOVER_CLOCK,
+};
+
+static const u8 I2C_XferTracePhases[] = {
+	[I2C_XFER_SELECT]       = I2C_TRACE_SELECT,
+	[I2C_XFER_REGISTER_HI]  = I2C_TRACE_REGISTER,
+	[I2C_XFER_REGISTER]     = I2C_TRACE_REGISTER,
+	[I2C_XFER_WRITE]        = I2C_TRACE_WRITE,
+	[I2C_XFER_FINISH_WRITE] = I2C_TRACE_FINISH_WRITE,
+	[I2C_XFER_BEGIN_READ]   = I2C_TRACE_BEGIN_READ,
+	[I2C_XFER_READ]         = I2C_TRACE_READ,
+	[I2C_XFER_FINISH_READ]  = I2C_TRACE_FINISH_READ,
+	[I2C_XFER_CANCEL]       = I2C_TRACE_CANCEL,
+};
+
+static void I2C_Transfer_Issue(I2C_Transfer *xfer, u8 phase) {
+	const I2C_DeviceConfig *dc = &devConf[xfer->devid];
+	u8 port = dc->port;
+	u8 cnt = I2C_CNT_IRQ_ENABLE | I2C_CNT_ENABLE;
+	
+	xfer->phase = phase;
+	
+	// a recovery is traced as part of the phase it runs for
+	if (phase < I2C_XFER_RECOVER_CANCEL)
+		xfer->trace_tick = I2C_Trace_Now();
+	
+	switch (phase) {
+	case I2C_XFER_SELECT:
+	case I2C_XFER_BEGIN_READ:
+		xfer->trace_data = phase == I2C_XFER_SELECT ? dc->write_addr : dc->write_addr | 1;
+		xfer->timed_out = false;
+		
+		if (phase == I2C_XFER_SELECT)
+			I2C_LoadDeviceScl(xfer->devid, port);
+		
+		I2C_REG_WRITE(port, DATA, xfer->trace_data);
+		spinwait(1125);
+		xfer->trace_tick = I2C_Trace_Now();
+		cnt |= I2C_CNT_TXN_START;
+		break;
+	case I2C_XFER_REGISTER_HI:
+	case I2C_XFER_REGISTER:
+	case I2C_XFER_WRITE:
+	case I2C_XFER_FINISH_WRITE:
+		if (phase == I2C_XFER_REGISTER_HI)
+			xfer->trace_data = xfer->regid >> 8;
+		else if (phase == I2C_XFER_REGISTER)
+			xfer->trace_data = xfer->regid & 0xFF;
+		else
+			xfer->trace_data = xfer->buf[phase == I2C_XFER_WRITE ? xfer->index : xfer->count - 1];
+		
+		I2C_REG_WRITE(port, DATA, xfer->trace_data);
+		
+		if (phase == I2C_XFER_FINISH_WRITE)
+			cnt |= I2C_CNT_TXN_FINISH;
+		break;
+	case I2C_XFER_READ:
+		cnt |= I2C_CNT_TXN_ACK | I2C_CNT_DIRECTION_READ;
+		break;
+	case I2C_XFER_FINISH_READ:
+		cnt |= I2C_CNT_TXN_FINISH | I2C_CNT_DIRECTION_READ;
+		break;
+	case I2C_XFER_CANCEL:
+	case I2C_XFER_RECOVER_CANCEL:
+		cnt |= I2C_CNT_TXN_FINISH | I2C_CNT_TXN_CANCEL;
+		break;
+	case I2C_XFER_RECOVER_CLOCK:
+		I2C_REG_WRITE(port, CNT, 0);
+		I2C_ConfigureBus(port, g_I2C_Buses[port].scl);
+		cnt |= I2C_CNT_TXN_FINISH | I2C_CNT_DIRECTION_READ;
+		break;
+	}
+	
+	I2C_REG_WRITE(port, CNT, cnt);
+	xfer->phase_tick = (u64)svcGetSystemTick();
+	xfer->state = I2C_TRANSFER_PHASE;
+}
+
+static void I2C_Transfer_Finish(I2C_Transfer *xfer, bool ok) {
+	if (xfer->flight)
+		I2C_LandFlight(xfer->port, xfer->flight, ok, xfer->data);
+	
+	I2C_UnlockBus(xfer->port);
+	
+	xfer->ok = ok;
+	xfer->state = I2C_TRANSFER_DONE;
+}
+
+// the read, or the write, of the transfer with its own I2C_MAX_N_TRIES attempts
+static void I2C_Transfer_Stage(I2C_Transfer *xfer, bool reading) {
+	xfer->reading = reading;
+	xfer->tries = 0;
+	xfer->buf = xfer->data;
+	xfer->count = xfer->size;
+	
+	switch (xfer->op) {
+	case I2C_TRANSFER_REPLACE_BITS8:
+		xfer->buf = xfer->scratch;
+		xfer->count = 1;
+		break;
+	case I2C_TRANSFER_WRITE_REGISTER8:
+		xfer->count = 1;
+		break;
+	case I2C_TRANSFER_WRITE_REGISTER16:
+		xfer->scratch[0] = xfer->data[1];
+		xfer->scratch[1] = xfer->data[0];
+		xfer->buf = xfer->scratch;
+		xfer->count = 2;
+		break;
+	}
+	
+	if (!reading)
+		I2C_Cache_Invalidate(xfer->devid);
+	
+	xfer->tries++;
+	I2C_Transfer_Issue(xfer, I2C_XFER_SELECT);
+}
+
+static void I2C_Transfer_StageDone(I2C_Transfer *xfer, bool ok) {
+	if (ok && xfer->reading && xfer->op == I2C_TRANSFER_REPLACE_BITS8) {
+		xfer->scratch[0] = (xfer->scratch[0] &~ xfer->data[1]) | (xfer->data[0] & xfer->data[1]);
+		I2C_Transfer_Stage(xfer, false);
+		return;
+	}
+	
+	I2C_Transfer_Finish(xfer, ok);
+}
+
+// the phase on the wire ended; completed is false if it timed out and the bus was recovered
+static void I2C_Transfer_Complete(I2C_Transfer *xfer, bool completed) {
+	const I2C_DeviceConfig *dc = &devConf[xfer->devid];
+	u8 phase = xfer->phase;
+	
+	if (phase == I2C_XFER_READ || phase == I2C_XFER_FINISH_READ) {
+		u8 value = I2C_REG_READ(dc->port, DATA);
+		
+		xfer->timed_out |= !completed;
+		xfer->buf[xfer->index++] = value;
+		I2C_Trace_Record(xfer->trace_tick, I2C_XferTracePhases[phase], xfer->devid, dc->port, value, phase == I2C_XFER_READ);
+		
+		if (phase == I2C_XFER_READ) {
+			I2C_Transfer_Issue(xfer, xfer->index < xfer->count - 1 ? I2C_XFER_READ : I2C_XFER_FINISH_READ);
+		} else {
+			I2C_Stats_AttemptFinished();
+			I2C_Transfer_StageDone(xfer, !xfer->timed_out);
+		}
+		
+		return;
+	}
+	
+	if (phase == I2C_XFER_CANCEL) {
+		I2C_Trace_Record(xfer->trace_tick, I2C_TRACE_CANCEL, xfer->devid, dc->port, 0, false);
+		I2C_Stats_AttemptCancelled();
+		
+		if (xfer->tries < I2C_MAX_N_TRIES) {
+			xfer->tries++;
+			I2C_Transfer_Issue(xfer, I2C_XFER_SELECT);
+		} else {
+			I2C_Transfer_StageDone(xfer, false);
+		}
+		
+		return;
+	}
+	
+	bool ack = completed && CHECK_ACK(dc->port);
+	
+	I2C_Trace_Record(xfer->trace_tick, I2C_XferTracePhases[phase], xfer->devid, dc->port, xfer->trace_data, ack);
+	
+	if (phase == I2C_XFER_FINISH_WRITE) {
+		I2C_Stats_AttemptFinished();
+		
+		// I2C_WriteRegisters8 does not retry a NACKed last byte, the single register writes do
+		if (ack || xfer->op == I2C_TRANSFER_WRITE_REGISTERS8) {
+			I2C_Transfer_StageDone(xfer, ack);
+			return;
+		}
+	}
+	
+	if (!ack) {
+		I2C_Transfer_Issue(xfer, I2C_XFER_CANCEL);
+		return;
+	}
+	
+	switch (phase) {
+	case I2C_XFER_SELECT:
+		xfer->index = 0;
+		I2C_Transfer_Issue(xfer, xfer->op == I2C_TRANSFER_WRITE_REGISTER16 ? I2C_XFER_REGISTER_HI : I2C_XFER_REGISTER);
+		break;
+	case I2C_XFER_REGISTER_HI:
+		I2C_Transfer_Issue(xfer, I2C_XFER_REGISTER);
+		break;
+	case I2C_XFER_REGISTER:
+		if (xfer->reading)
+			I2C_Transfer_Issue(xfer, I2C_XFER_BEGIN_READ);
+		else
+			I2C_Transfer_Issue(xfer, xfer->count > 1 ? I2C_XFER_WRITE : I2C_XFER_FINISH_WRITE);
+		break;
+	case I2C_XFER_BEGIN_READ:
+		I2C_Transfer_Issue(xfer, xfer->count > 1 ? I2C_XFER_READ : I2C_XFER_FINISH_READ);
+		break;
+	case I2C_XFER_WRITE:
+		xfer->index++;
+		I2C_Transfer_Issue(xfer, xfer->index < xfer->count - 1 ? I2C_XFER_WRITE : I2C_XFER_FINISH_WRITE);
+		break;
+	}
+}
+
+void I2C_Transfer_Init(I2C_Transfer *xfer, I2C_TransferOp op, u8 devid, u16 regid, u8 *data, u32 size) {
+	xfer->op = op;
+	xfer->state = I2C_TRANSFER_LOCKING;
+	xfer->devid = devid;
+	xfer->regid = regid;
+	xfer->ok = false;
+	xfer->contended = false;
+	xfer->lock_requested = false;
+	xfer->joined = false;
+	xfer->size = size;
+	xfer->data = data;
+	xfer->flight = NULL;
+	
+	if (devid > I2C_DEVID_MAX || !size) {
+		xfer->state = I2C_TRANSFER_DONE;
+		return;
+	}
+	
+	xfer->port = devConf[devid].port;
+	
+	if (op == I2C_TRANSFER_READ_REGISTERS8) {
+		bool leader;
+		
+		xfer->flight = I2C_Flight_Join(xfer->port, I2C_FLIGHT_READ_REGISTERS8, devid, regid, size, &leader);
+		xfer->joined = xfer->flight && !leader;
+	}
+}
+
+bool I2C_Transfer_Begin(I2C_Transfer *xfer, Handle wake) {
+	if (xfer->state != I2C_TRANSFER_LOCKING)
+		return true;
+	
+	u8 port = xfer->port;
+	
+	// the leader lands its flight before it releases the bus lock
+	if (xfer->joined) {
+		g_I2C_Buses[port].lock_waiter = wake;
+		__dmb();
+		
+		if (!I2C_Flight_Poll(port, xfer->flight, xfer->data, &xfer->ok))
+			return false;
+		
+		g_I2C_Buses[port].lock_waiter = 0;
+		xfer->state = I2C_TRANSFER_DONE;
+		return true;
+	}
+	
+	if (!xfer->lock_requested) {
+		xfer->lock_requested = true;
+		I2C_Stats_LockRequested(port);
+	}
+	
+	if (!RecursiveLock_TryLock(&g_I2C_Buses[port].lock)) {
+		g_I2C_Buses[port].lock_waiter = wake;
+		__dmb();
+		
+		// the holder may have released it before it could see the waiter
+		if (!RecursiveLock_TryLock(&g_I2C_Buses[port].lock)) {
+			xfer->contended = true;
+			return false;
+		}
+	}
+	
+	g_I2C_Buses[port].lock_waiter = 0;
+	I2C_Stats_LockAcquired(port, xfer->contended ? LIGHTLOCK_BLOCKED : LIGHTLOCK_FREE);
+	
+	I2C_Transfer_Stage(xfer, xfer->op == I2C_TRANSFER_READ_REGISTERS8 || xfer->op == I2C_TRANSFER_REPLACE_BITS8);
+	return true;
+}
+
+void I2C_Transfer_Step(I2C_Transfer *xfer, bool interrupted) {
+	u8 port = xfer->port;
+	
+	switch (xfer->phase) {
+	case I2C_XFER_RECOVER_CANCEL:
+		if (!interrupted) {
+			xfer->clocked_out = true;
+			I2C_Transfer_Issue(xfer, I2C_XFER_RECOVER_CLOCK);
+			return;
+		}
+		break;
+	case I2C_XFER_RECOVER_CLOCK:
+		if (!interrupted)
+			I2C_REG_WRITE(port, CNT, 0); // still stuck, the next phase times out again
+		break;
+	default:
+		if (interrupted) {
+			I2C_Transfer_Complete(xfer, true);
+		} else {
+			I2C_Stats_BusTimeout(port);
+			xfer->failed_phase = xfer->phase;
+			xfer->clocked_out = false;
+			I2C_Transfer_Issue(xfer, I2C_XFER_RECOVER_CANCEL);
+		}
+		return;
+	}
+	
+	// recovery over, the phase it ran for failed
+	T(svcClearEvent(g_I2C_Buses[port].interrupt));
+	I2C_Stats_BusRecovery(port, xfer->clocked_out, interrupted);
+	
+	xfer->phase = xfer->failed_phase;
+	I2C_Transfer_Complete(xfer, false);
+}
+
+s64 I2C_Transfer_TimeLeft(const I2C_Transfer *xfer) {
+	u64 elapsed = (u64)svcGetSystemTick() - xfer->phase_tick;
+	
+	return g_I2C_Buses[xfer->port].timeout_ns - (s64)(elapsed * 1000 / (I2C_TICKS_PER_SECOND / 1000000));
+}
+
+// SCL tuning
+
+// setting k of the sweep, the same duration for both halves of the period
+static inline u16 I2C_SclTune_Setting(u8 k) {
+	return I2C_SCL_LOW_DURATION(k) | I2C_SCL_HIGH_DURATION(k);
+}
+
+// one attempt, no retries: a NACK is an error of the setting under test. The sweep programs
+// the setting itself, so these select without loading the device's own SCL
+static bool I2C_SclTune_Read(u8 devid, u8 regid, u8 *value) {
+	if (!I2C_SelectAddress(devid) || !I2C_SelectRegister(devid, regid) || !I2C_BeginRead(devid)) {
+		I2C_CancelTransaction(devid);
+		return false;
+	}
+	
+	*value = I2C_FinishRead(devid);
+	return !g_I2C_Buses[devConf[devid].port].timed_out;
+}
+
+static bool I2C_SclTune_Write(u8 devid, u8 regid, u8 value) {
+	if (!I2C_SelectAddress(devid) || !I2C_SelectRegister(devid, regid) || !I2C_FinishWrite(devid, value)) {
+		I2C_CancelTransaction(devid);
+		return false;
+	}
+	
+	return true;
+}
+
+// with the bus lock held and the setting programmed; returns the failed or mismatched iterations
+static u32 I2C_SclTune_Run(u8 devid, u8 regid, u32 iterations, bool scratch, u8 reference) {
+	u32 errors = 0;
+	
+	for (u32 i = 0; i < iterations; i++) {
+		u8 expected = scratch ? (u8)(0xA5 ^ (i * 0x3B)) : reference, value = 0;
+		
+		if ((scratch && !I2C_SclTune_Write(devid, regid, expected)) || !I2C_SclTune_Read(devid, regid, &value) || value != expected)
+			errors++;
+	}
+	
+	return errors;
+}
+
+// the reference read and the scratch restore, at the slowest setting with the usual retries
+static bool I2C_SclTune_Slowest(u8 devid, u8 regid, bool write, u8 *value) {
+	u8 port = devConf[devid].port;
+	u16 current = g_I2C_Buses[port].scl;
+	bool res = false;
+	
+	I2C_ConfigureBus(port, I2C_SclTune_Setting(I2C_SCL_TUNE_SETTINGS - 1));
+	
+	for (u32 i = 0; i < I2C_MAX_N_TRIES && !res; i++)
+		res = write ? I2C_SclTune_Write(devid, regid, *value) : I2C_SclTune_Read(devid, regid, value);
+	
+	I2C_ConfigureBus(port, current);
+	return res;
+}
+
+// with the bus lock held: devid runs at scl from its next selection on, or at the base SCL of its bus again
+static void I2C_SclTune_SetDeviceScl(u8 devid, bool own, u16 scl) {
+	I2C_DeviceScl *ds = &I2C_DeviceScls[devid];
+	I2C_Bus *bus = &g_I2C_Buses[devConf[devid].port];
+	
+	if (own == ds->own) {
+		ds->scl = scl;
+		return;
+	}
+	
+	// the first device with its own SCL keeps what the bus runs at for the others
+	if (own && !bus->scl_devices++)
+		bus->base_scl = bus->scl;
+	
+	ds->scl = scl;
+	ds->own = own;
+	
+	// the last one gives the bus back its base SCL, no device loads one anymore
+	if (!own && !--bus->scl_devices && bus->scl != bus->base_scl)
+		I2C_ConfigureBus(devConf[devid].port, bus->base_scl);
+}
+
+Result I2C_TuneScl(u8 devid, u8 regid, u32 iterations, u8 flags, I2C_SclTuneResult *results, u32 max_results, u32 *count, u32 *best) {
+	*count = 0;
+	*best = I2C_SCL_TUNE_NONE;
+	
+	if (devid > I2C_DEVID_MAX || (flags & ~(I2C_SCL_TUNE_SCRATCH | I2C_SCL_TUNE_APPLY | I2C_SCL_TUNE_RESET)))
+		return I2C_INTERNAL_RANGE;
+	
+	u8 port = devConf[devid].port;
+	
+	if (flags & I2C_SCL_TUNE_RESET) {
+		I2C_LockBus(port);
+		I2C_SclTune_SetDeviceScl(devid, false, 0);
+		I2C_UnlockBus(port);
+		return 0;
+	}
+	
+	if (!iterations || iterations > I2C_SCL_TUNE_MAX_ITERATIONS)
+		return I2C_INVALID_SIZE;
+	
+	bool scratch = flags & I2C_SCL_TUNE_SCRATCH;
+	u8 original = 0;
+	
+	// a scratch register holds test patterns until it is restored, so no other command may
+	// read it (and fill the read cache with one) before then: the sweep keeps the bus
+	// throughout, the per-setting holds below nest in this one
+	if (scratch)
+		I2C_LockBus(port);
+	
+	// read at the slowest setting, which the current one may be too fast for: the reference
+	// for a read-only register, and what a scratch one gets back
+	I2C_LockBus(port);
+	bool res = I2C_SclTune_Slowest(devid, regid, false, &original);
+	I2C_UnlockBus(port);
+	
+	if (!res) {
+		if (scratch)
+			I2C_UnlockBus(port);
+		
+		return I2C_FATAL_FAIL;
+	}
+	
+	// slowest first; the sweep ends at the first setting with errors, the faster ones would not do better
+	for (s32 k = I2C_SCL_TUNE_SETTINGS - 1; k >= 0 && *count < max_results; k--) {
+		I2C_SclTuneResult *r = &results[(*count)++];
+		u16 scl = I2C_SclTune_Setting((u8)k);
+		
+		// other devices on the bus wait out the sweep of a setting, never see it
+		I2C_LockBus(port);
+		u16 current = g_I2C_Buses[port].scl;
+		I2C_ConfigureBus(port, scl);
+		
+		u64 start = (u64)svcGetSystemTick();
+		u32 errors = I2C_SclTune_Run(devid, regid, iterations, scratch, original);
+		u64 ticks = (u64)svcGetSystemTick() - start;
+		
+		I2C_ConfigureBus(port, current);
+		I2C_UnlockBus(port);
+		
+		r->scl = scl;
+		r->errors = (u16)errors;
+		r->period_ns = (u32)I2C_SclPeriodNs(scl);
+		r->iteration_ns = (u32)(ticks * 1000 / (I2C_TICKS_PER_SECOND / 1000000) / iterations);
+		
+		if (errors)
+			break;
+		
+		*best = *count - 1;
+	}
+	
+	I2C_LockBus(port);
+	
+	if (scratch) {
+		res = I2C_SclTune_Slowest(devid, regid, true, &original);
+		I2C_Cache_Invalidate(devid);
+	}
+	
+	if ((flags & I2C_SCL_TUNE_APPLY) && *best != I2C_SCL_TUNE_NONE)
+		I2C_SclTune_SetDeviceScl(devid, true, results[*best].scl);
+	
+	I2C_UnlockBus(port);
+	
+	if (scratch)
+		I2C_UnlockBus(port);
+	
+	return res ? 0 : I2C_FATAL_FAIL;
+}
+
+u16 I2C_GetDeviceScl(u8 devid) {
+	if (devid > I2C_DEVID_MAX)
+		return 0;
+	
+	const I2C_Bus *bus = &g_I2C_Buses[devConf[devid].port];
+	
+	return I2C_DeviceScls[devid].own ? I2C_DeviceScls[devid].scl : bus->scl_devices ? bus->base_scl : bus->scl;
+}
@@ -3,417 +3,853 @@
 
 
 #include <i2c/globals.h>
+#include <i2c/snapshot.h>
+#include <i2c/cache.h>
+#include <i2c/async.h>
+#include <i2c/stats.h>
+#include <i2c/trace.h>
 #include <i2c/i2c.h>
 #include <i2c/ipc.h>
 
 #define CMD_ID_RANGE(id, lower, upper) \
 	(id >= lower && id <= upper)
 
-#define I2C_CHKPERM(x) (I2C_CheckDeviceAccess(session->session_type, devid) ? (x) : I2C_UNAUTHORIZED)
-#define I2C_CHKPERM_EXPLICIT (I2C_CheckDeviceAccess(session->session_type, devid) ? 0 : I2C_UNAUTHORIZED)
+// masks built from several devids with I2C_DevidMask are authorized in one test
+#define I2C_CHKPERM_MASK(mask) ((((mask) & ~session->device_mask) == 0) ? 0 : I2C_UNAUTHORIZED)
+#define I2C_CHKPERM(x) (R_SUCCEEDED(I2C_CHKPERM_MASK(I2C_DevidMask(devid))) ? (x) : I2C_UNAUTHORIZED)
+// the diagnostics cover every service's traffic and devices, so only i2c::DEB may run them
+#define I2C_CHKDIAG() ((session->session_type == I2C_SESSION_TYPE_DEB) ? 0 : I2C_UNAUTHORIZED)
 #define I2C_TRY(x) ((x) ? 0 : I2C_FATAL_FAIL)
 #define I2CT(x) I2C_CHKPERM(I2C_TRY(x))
 
-void I2C_HandleIPC(I2C_SessionData *session)
+// IPC_MakeHeader as a constant expression, for the command table and the fast path
+#define I2C_HEADER(id, normal, translate) \
+	(((u32)(id) << 16) | (((u32)(normal) & 0x3F) << 6) | ((u32)(translate) & 0x3F))
+
+enum {
+	I2C_CMD_N3DS_ONLY     = BIT(0), // o3ds skips the buffer checks, the handler replies I2C_NOT_IMPLEMENTED
+	I2C_CMD_STATIC_BUFFER = BIT(1), // cmdbuf[buffer_index] is static buffer buffer_arg, sized cmdbuf[size_index]
+	I2C_CMD_MAPPED_BUFFER = BIT(2), // cmdbuf[buffer_index] is a mapped buffer with rights buffer_arg, sized cmdbuf[size_index]
+	I2C_CMD_SIZE_U16      = BIT(3), // cmdbuf[size_index] counts u16 elements instead of bytes
+};
+
+typedef void (*I2C_CommandHandler)(I2C_SessionData *session, u32 *cmdbuf);
+
+typedef struct I2C_CommandDesc {
+	I2C_CommandHandler handler;
+	u32 header;      // expected request header, 0 for unused command ids
+	u8 flags;        // I2C_CMD_*
+	u8 buffer_index; // cmdbuf word holding the buffer descriptor
+	u8 size_index;   // cmdbuf word holding the size the buffer must have
+	u8 buffer_arg;   // static buffer id or IPC_BufferRights
+} I2C_CommandDesc;
+
+/*
+	Handlers run after the dispatcher has validated the header and the buffer
+	descriptor described by their table entry.
+*/
+
+static void I2C_Cmd_ReplaceRegisterBits8(I2C_SessionData *session, u32 *cmdbuf)
 {
-	u32 *cmdbuf = getThreadCommandBuffer();
-	u32 cmd_header = cmdbuf[0];
-	u16 cmd_id = (cmd_header >> 16) & 0xFFFF;
-	
-	switch (cmd_id)
-	{
-	case 0x0001: // replace register bits (8 bit variant)
-		{
-			CHECK_HEADER(0x0001, 4, 0);
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u8 value = (u8)(cmdbuf[3] & 0xFF);
+	u8 mask  = (u8)(cmdbuf[4] & 0xFF);
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u8 value = (u8)(cmdbuf[3] & 0xFF);
-			u8 mask  = (u8)(cmdbuf[4] & 0xFF);
+	Result res = session->posted_writes ?
+		I2C_CHKPERM(I2C_Async_Post(session, 0x0001, I2C_ASYNC_POSTED_REPLACE_BITS8, devid, regid, value, mask)) :
+		I2CT(I2C_ReplaceRegisterBits8(devid, regid, value, mask));
 
-			Result res = I2CT(I2C_ReplaceRegisterBits8(devid, regid, value, mask));
+	cmdbuf[0] = IPC_MakeHeader(0x0001, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			cmdbuf[0] = IPC_MakeHeader(0x0001, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x0002: // set register bits (8 bit variant)
-		{
-			CHECK_HEADER(0x0002, 3, 0);
+static void I2C_Cmd_SetRegisterBits8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u8 mask  = (u8)(cmdbuf[3] & 0xFF);
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u8 mask  = (u8)(cmdbuf[3] & 0xFF);
+	Result res = session->posted_writes ?
+		I2C_CHKPERM(I2C_Async_Post(session, 0x0002, I2C_ASYNC_POSTED_REPLACE_BITS8, devid, regid, mask, mask)) :
+		I2CT(I2C_ReplaceRegisterBits8(devid, regid, mask, mask));
 
-			Result res = I2CT(I2C_ReplaceRegisterBits8(devid, regid, mask, mask));
+	cmdbuf[0] = IPC_MakeHeader(0x0002, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			cmdbuf[0] = IPC_MakeHeader(0x0002, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x0003: // clear register bits (8 bit variant)
-		{
-			CHECK_HEADER(0x0003, 3, 0);
+static void I2C_Cmd_ClearRegisterBits8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u8 mask  = (u8)(cmdbuf[3] & 0xFF);
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u8 mask  = (u8)(cmdbuf[3] & 0xFF);
+	Result res = session->posted_writes ?
+		I2C_CHKPERM(I2C_Async_Post(session, 0x0003, I2C_ASYNC_POSTED_REPLACE_BITS8, devid, regid, 0, mask)) :
+		I2CT(I2C_ReplaceRegisterBits8(devid, regid, 0, mask));
 
-			Result res = I2CT(I2C_ReplaceRegisterBits8(devid, regid, 0, mask));
+	cmdbuf[0] = IPC_MakeHeader(0x0003, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			cmdbuf[0] = IPC_MakeHeader(0x0003, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x0004: // replace register bits (16 bit variant) across multiple devices
-		{
-			CHECK_HEADER(0x0004, 4, 2);
-
-			u16 regid = (u16)(cmdbuf[1] & 0xFFFF);
-			u16 value = (u16)(cmdbuf[2] & 0xFFFF);
-			u16 mask = (u16)(cmdbuf[3] & 0xFFFF);
-			u32 n_devids = cmdbuf[4];
-			const u8 *devids = (const u8 *)cmdbuf[6];
-
-			CHECK_WRONGARG(
-				!IPC_VerifyStaticBuffer(cmdbuf[5], 0) ||
-				IPC_GetStaticBufferSize(cmdbuf[5]) != n_devids
-			);
-
-			Result res = 0;
-
-			for (u32 i = 0; i < n_devids; i++) {
-				u8 devid = devids[i];
-				if (R_FAILED(res = I2C_CHKPERM_EXPLICIT)) {
-					break;
-				}
-			}
+static void I2C_Cmd_ReplaceRegisterBits16Multi(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u16 regid = (u16)(cmdbuf[1] & 0xFFFF);
+	u16 value = (u16)(cmdbuf[2] & 0xFFFF);
+	u16 mask = (u16)(cmdbuf[3] & 0xFFFF);
+	u32 n_devids = cmdbuf[4];
+	const u8 *devids = (const u8 *)IPC_WordToPointer(cmdbuf[6]);
 
-			if (R_SUCCEEDED(res)) {
-				for (u32 i = 0; i < n_devids; i++) {
-					if (R_FAILED(res = I2C_TRY(I2C_ReplaceRegisterBits16(devids[i], regid, value, mask)))) {
-						break;
-					}
-				}
-			}
+	u32 devid_mask = 0;
+
+	for (u32 i = 0; i < n_devids; i++)
+		devid_mask |= I2C_DevidMask(devids[i]);
 
-			cmdbuf[0] = IPC_MakeHeader(0x0004, 1, 0);
-			cmdbuf[1] = res;
+	Result res = I2C_CHKPERM_MASK(devid_mask);
+
+	if (R_SUCCEEDED(res)) {
+		for (u32 i = 0; i < n_devids; i++) {
+			if (R_FAILED(res = I2C_TRY(I2C_ReplaceRegisterBits16(devids[i], regid, value, mask)))) {
+				break;
+			}
 		}
-		break;
-	case 0x0005: // write register (8 bit variant)
-		{
-			CHECK_HEADER(0x0005, 3, 0);
+	}
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u8 value = (u8)(cmdbuf[3] & 0xFF);
+	cmdbuf[0] = IPC_MakeHeader(0x0004, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			Result res = I2CT(I2C_WriteRegister8(devid, regid, value));
+static inline void I2C_Cmd_WriteRegister8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u8 value = (u8)(cmdbuf[3] & 0xFF);
 
-			cmdbuf[0] = IPC_MakeHeader(0x0005, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x0006: // write (8 bit variant) (select device without selecting register afterwards)
-		{
-			CHECK_HEADER(0x0006, 2, 0);
+	Result res = session->posted_writes ?
+		I2C_CHKPERM(I2C_Async_Post(session, 0x0005, I2C_ASYNC_POSTED_WRITE_REGISTER8, devid, regid, value, 0)) :
+		I2CT(I2C_FastWriteRegister8(devid, regid, value));
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 value = (u8)(cmdbuf[2] & 0xFF);
+	cmdbuf[0] = IPC_MakeHeader(0x0005, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			Result res = I2CT(I2C_WriteDevice8(devid, value));
+static void I2C_Cmd_WriteDevice8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 value = (u8)(cmdbuf[2] & 0xFF);
 
-			cmdbuf[0] = IPC_MakeHeader(0x0006, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x0007: // write register (16 bit variant)
-		{
-			CHECK_HEADER(0x0007, 3, 0);
+	Result res = I2CT(I2C_WriteDevice8(devid, value));
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
-			u16 value = (u16)(cmdbuf[3] & 0xFFFF);
+	cmdbuf[0] = IPC_MakeHeader(0x0006, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			Result res = I2CT(I2C_WriteRegister16(devid, regid, value));
+static void I2C_Cmd_WriteRegister16(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
+	u16 value = (u16)(cmdbuf[3] & 0xFFFF);
 
-			cmdbuf[0] = IPC_MakeHeader(0x0007, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x0008: // write register (16 bit variant) across multiple devices
-		{
-			CHECK_HEADER(0x0008, 3, 2);
-
-			u16 regid = (u16)(cmdbuf[1] & 0xFFFF);
-			u16 value = (u16)(cmdbuf[2] & 0xFFFF);
-			u32 n_devids = cmdbuf[3];
-			const u8 *devids = (const u8 *)cmdbuf[5];
-
-			CHECK_WRONGARG(
-				!IPC_VerifyStaticBuffer(cmdbuf[4], 0) ||
-				IPC_GetStaticBufferSize(cmdbuf[4]) != n_devids
-			);
-
-			Result res = 0;
-
-			for (u32 i = 0; i < n_devids; i++) {
-				u8 devid = devids[i];
-				if (R_FAILED(res = I2C_CHKPERM_EXPLICIT)) {
-					break;
-				}
-			}
+	Result res = session->posted_writes ?
+		I2C_CHKPERM(I2C_Async_Post(session, 0x0007, I2C_ASYNC_POSTED_WRITE_REGISTER16, devid, regid, value, 0)) :
+		I2CT(I2C_WriteRegister16(devid, regid, value));
 
-			if (R_SUCCEEDED(res)) {
-				for (u32 i = 0; i < n_devids; i++) {
-					if (R_FAILED(res = I2C_TRY(I2C_WriteRegister16(devids[i], regid, value)))) {
-						break;
-					}
-				}
-			}
+	cmdbuf[0] = IPC_MakeHeader(0x0007, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			cmdbuf[0] = IPC_MakeHeader(0x0008, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x0009: // read register (8 bit variant)
-		{
-			CHECK_HEADER(0x0009, 2, 0);
+static void I2C_Cmd_WriteRegister16Multi(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u16 regid = (u16)(cmdbuf[1] & 0xFFFF);
+	u16 value = (u16)(cmdbuf[2] & 0xFFFF);
+	u32 n_devids = cmdbuf[3];
+	const u8 *devids = (const u8 *)IPC_WordToPointer(cmdbuf[5]);
+
+	u32 devid_mask = 0;
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u8 value = 0;
+	for (u32 i = 0; i < n_devids; i++)
+		devid_mask |= I2C_DevidMask(devids[i]);
 
-			Result res = I2CT(I2C_ReadRegister8(devid, regid, &value));
+	Result res = I2C_CHKPERM_MASK(devid_mask);
 
-			cmdbuf[0] = IPC_MakeHeader(0x0009, 2, 0);
-			cmdbuf[1] = res;
-			cmdbuf[2] = value;
+	if (R_SUCCEEDED(res)) {
+		for (u32 i = 0; i < n_devids; i++) {
+			if (R_FAILED(res = I2C_TRY(I2C_WriteRegister16(devids[i], regid, value)))) {
+				break;
+			}
 		}
-		break;
-	case 0x000A: // read register (16 bit variant)
-		{
-			CHECK_HEADER(0x000A, 2, 0);
+	}
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
-			u16 value = 0;
+	cmdbuf[0] = IPC_MakeHeader(0x0008, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			Result res = I2CT(I2C_ReadRegister16(devid, regid, &value));
+static inline void I2C_Cmd_ReadRegister8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u8 value = 0;
 
-			cmdbuf[0] = IPC_MakeHeader(0x000A, 2, 0);
-			cmdbuf[1] = res;
-			cmdbuf[2] = value;
-		}
-		break;
-	case 0x000B: // write registers (8 bit variant)
-	case 0x000E: // write registers (8 bit variant) same for some reason?
-		{
-			CHECK_HEADER(cmd_id, 3, 2);
-
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u32 size = cmdbuf[3];
-			const u8 *buf = (const u8 *)cmdbuf[5];
-
-			CHECK_WRONGARG(
-				!IPC_VerifyStaticBuffer(cmdbuf[4], 1) ||
-				IPC_GetStaticBufferSize(cmdbuf[4]) != size
-			);
-
-			Result res = I2CT(I2C_WriteRegisters8(devid, regid, buf, size));
-
-			cmdbuf[0] = IPC_MakeHeader(cmd_id, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x000C: // write registers (16 bit variant)
-		{
-			CHECK_HEADER(0x000C, 3, 2);
+	Result res = I2CT(I2C_Cache_ReadRegister8(devid, regid, &value) || I2C_FastReadRegister8(devid, regid, &value));
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
-			u32 count = cmdbuf[3];
-			const u16 *buf = (const u16 *)cmdbuf[5];
+	cmdbuf[0] = IPC_MakeHeader(0x0009, 2, 0);
+	cmdbuf[1] = res;
+	cmdbuf[2] = value;
+}
 
-			CHECK_WRONGARG(
-				!IPC_VerifyStaticBuffer(cmdbuf[4], 1) ||
-				(IPC_GetStaticBufferSize(cmdbuf[4]) / 2) != count
-			);
+static void I2C_Cmd_ReadRegister16(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
+	u16 value = 0;
 
-			Result res = I2CT(I2C_WriteRegisters16(devid, regid, buf, count));
+	Result res = I2CT(I2C_Cache_ReadRegister16(devid, regid, &value) || I2C_ReadRegister16(devid, regid, &value));
 
-			cmdbuf[0] = IPC_MakeHeader(0x000C, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x000D: // read registers (8 bit variant)
-		{
-			CHECK_HEADER(0x000D, 3, 0);
+	cmdbuf[0] = IPC_MakeHeader(0x000A, 2, 0);
+	cmdbuf[1] = res;
+	cmdbuf[2] = value;
+}
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u32 size = cmdbuf[3];
+// 0x000B and 0x000E are 1:1 identical
+static void I2C_Cmd_WriteRegisters8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u16 cmd_id = (cmdbuf[0] >> 16) & 0xFFFF;
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u32 size = cmdbuf[3];
+	const u8 *buf = (const u8 *)IPC_WordToPointer(cmdbuf[5]);
 
-			if (size > sizeof(session->output_staticbuf))
-				size = sizeof(session->output_staticbuf);
+	Result res = I2CT(I2C_WriteRegisters8(devid, regid, buf, size));
 
-			Result res = I2CT(I2C_ReadRegisters8(devid, regid, session->output_staticbuf, size));
+	cmdbuf[0] = IPC_MakeHeader(cmd_id, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			cmdbuf[0] = IPC_MakeHeader(0x000D, 1, 2);
-			cmdbuf[1] = res;
-			cmdbuf[2] = IPC_Desc_StaticBuffer(size, 0);
-			cmdbuf[3] = (u32)session->output_staticbuf;
-		}
-		break;
-	// note: 0x000E is handled with 0x000B since they're 1:1 identical
-	case 0x000F: // read registers (8 bit variant) with delay, possibly legacy?
-		{
-			CHECK_HEADER(0x000F, 3, 0);
+static void I2C_Cmd_WriteRegisters16(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
+	u32 count = cmdbuf[3];
+	const u16 *buf = (const u16 *)IPC_WordToPointer(cmdbuf[5]);
 
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u32 size = cmdbuf[3];
+	Result res = I2CT(I2C_WriteRegisters16(devid, regid, buf, count));
 
-			if (size > sizeof(session->output_staticbuf))
-				size = sizeof(session->output_staticbuf);
+	cmdbuf[0] = IPC_MakeHeader(0x000C, 1, 0);
+	cmdbuf[1] = res;
+}
 
-			Result res = I2CT(I2C_ReadRegisters8Legacy(devid, regid, session->output_staticbuf, size));
+static inline void I2C_Cmd_ReadRegisters8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u32 size = cmdbuf[3];
 
-			cmdbuf[0] = IPC_MakeHeader(0x000F, 1, 2);
-			cmdbuf[1] = res;
-			cmdbuf[2] = IPC_Desc_StaticBuffer(size, 0);
-			cmdbuf[3] = (u32)session->output_staticbuf;
-		}
-		break;
-	case 0x0010: // read registers (16 bit variant)
-		{
-			CHECK_HEADER(0x0010, 3, 0);
-		
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
-			u32 count = cmdbuf[3];
-		
-			if (count > sizeof(session->output_staticbuf) / 2)
-				count = sizeof(session->output_staticbuf) / 2;
-		
-			Result res = I2CT(I2C_ReadRegisters16(devid, regid, (u16 *)session->output_staticbuf, count));
-		
-			cmdbuf[0] = IPC_MakeHeader(0x0010, 1, 2);
-			cmdbuf[1] = res;
-			cmdbuf[2] = IPC_Desc_StaticBuffer(count * sizeof(u16), 0);
-			cmdbuf[3] = (u32)session->output_staticbuf;
-		}
-		break;
-	case 0x0011: // write registers (8 bit variant) using mapped buffer
-		{
-			CHECK_HEADER(0x0011, 3, 2);
-			
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u32 size = cmdbuf[3];
-			const u8 *buf = (const u8 *)cmdbuf[5];
-			
-			CHECK_WRONGARG(
-				!IPC_VerifyBuffer(cmdbuf[4], IPC_BUFFER_R) ||
-				IPC_GetBufferSize(cmdbuf[4]) != size
-			);
-			
-			Result res = I2CT(I2C_WriteRegisters8(devid, regid, buf, size));
-			
-			cmdbuf[0] = IPC_MakeHeader(0x0011, 1, 2);
-			cmdbuf[1] = res;
-			cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
-			cmdbuf[3] = (u32)buf;
-		}
-		break;
-	case 0x0012: // read registers (8 bit variant) using mapped buffer
-		{
-			CHECK_HEADER(0x0012, 3, 2);
-			
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u8 regid = (u8)(cmdbuf[2] & 0xFF);
-			u32 size = cmdbuf[3];
-			u8 *buf = (u8 *)cmdbuf[5];
-			
-			CHECK_WRONGARG(
-				!IPC_VerifyBuffer(cmdbuf[4], IPC_BUFFER_W) ||
-				IPC_GetBufferSize(cmdbuf[4]) != size
-			);
-			
-			Result res = I2CT(I2C_ReadRegisters8(devid, regid, buf, size));
-			
-			cmdbuf[0] = IPC_MakeHeader(0x0012, 1, 2);
-			cmdbuf[1] = res;
-			cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
-			cmdbuf[3] = (u32)buf;
-		}
-		break;
-	case 0x0013: // [n3ds only] read device raw
-		{
-			CHECK_HEADER(0x0013, 1, 0);
-			
-			u8 value = 0;
+	if (size > sizeof(session->output_staticbuf))
+		size = sizeof(session->output_staticbuf);
+
+	Result res = I2CT(I2C_FastReadRegisters8(devid, regid, session->output_staticbuf, size));
+
+	cmdbuf[0] = IPC_MakeHeader(0x000D, 1, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = IPC_Desc_StaticBuffer(size, 0);
+	cmdbuf[3] = IPC_PointerToWord(session->output_staticbuf);
+}
+
+// read registers (8 bit variant) with delay, possibly legacy?
+static void I2C_Cmd_ReadRegisters8Legacy(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u32 size = cmdbuf[3];
+
+	if (size > sizeof(session->output_staticbuf))
+		size = sizeof(session->output_staticbuf);
+
+	Result res = I2CT(I2C_ReadRegisters8Legacy(devid, regid, session->output_staticbuf, size));
+
+	cmdbuf[0] = IPC_MakeHeader(0x000F, 1, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = IPC_Desc_StaticBuffer(size, 0);
+	cmdbuf[3] = IPC_PointerToWord(session->output_staticbuf);
+}
+
+static void I2C_Cmd_ReadRegisters16(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
+	u32 count = cmdbuf[3];
+
+	if (count > sizeof(session->output_staticbuf) / 2)
+		count = sizeof(session->output_staticbuf) / 2;
+
+	Result res = I2CT(I2C_ReadRegisters16(devid, regid, (u16 *)session->output_staticbuf, count));
+
+	cmdbuf[0] = IPC_MakeHeader(0x0010, 1, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = IPC_Desc_StaticBuffer(count * sizeof(u16), 0);
+	cmdbuf[3] = IPC_PointerToWord(session->output_staticbuf);
+}
+
+static void I2C_Cmd_WriteRegisters8Mapped(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u32 size = cmdbuf[3];
+	const u8 *buf = (const u8 *)IPC_WordToPointer(cmdbuf[5]);
+
+	Result res = I2CT(I2C_WriteRegisters8(devid, regid, buf, size));
+
+	cmdbuf[0] = IPC_MakeHeader(0x0011, 1, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
+	cmdbuf[3] = IPC_PointerToWord(buf);
+}
+
+static void I2C_Cmd_ReadRegisters8Mapped(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u32 size = cmdbuf[3];
+	u8 *buf = (u8 *)IPC_WordToPointer(cmdbuf[5]);
+
+	Result res = I2CT(I2C_ReadRegisters8(devid, regid, buf, size));
+
+	cmdbuf[0] = IPC_MakeHeader(0x0012, 1, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[3] = IPC_PointerToWord(buf);
+}
+
+// [n3ds only] read device raw
+static void I2C_Cmd_ReadDeviceRaw(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 value = 0;
 #ifdef N3DS
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			
-			Result res = I2CT(I2C_ReadDeviceRaw(devid, &value));
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+
+	Result res = I2CT(I2C_ReadDeviceRaw(devid, &value));
 #else
-			Result res = I2C_NOT_IMPLEMENTED;
+	(void)session;
+	Result res = I2C_NOT_IMPLEMENTED;
 #endif
 
-			cmdbuf[0] = IPC_MakeHeader(0x0013, 2, 0);
-			cmdbuf[1] = res;
-			cmdbuf[2] = value;
-		}
-		break;
-	case 0x0014: // [n3ds only] write device raw (multi)
-		{
-			CHECK_HEADER(0x0014, 2, 2);
-			
+	cmdbuf[0] = IPC_MakeHeader(0x0013, 2, 0);
+	cmdbuf[1] = res;
+	cmdbuf[2] = value;
+}
+
+// [n3ds only] write device raw (multi)
+static void I2C_Cmd_WriteDeviceRawMulti(I2C_SessionData *session, u32 *cmdbuf)
+{
 #ifdef N3DS
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			u32 size = cmdbuf[2];
-			const u8 *buf = (const u8 *)cmdbuf[4];
-			
-			CHECK_WRONGARG(
-				!IPC_VerifyStaticBuffer(cmdbuf[3], 1) ||
-				IPC_GetStaticBufferSize(cmdbuf[3]) != cmdbuf[2]
-			);
-			
-			Result res = I2CT(I2C_WriteDeviceRawMulti(devid, buf, size));
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u32 size = cmdbuf[2];
+	const u8 *buf = (const u8 *)IPC_WordToPointer(cmdbuf[4]);
+
+	Result res = I2CT(I2C_WriteDeviceRawMulti(devid, buf, size));
 #else
-			Result res = I2C_NOT_IMPLEMENTED;
+	(void)session;
+	Result res = I2C_NOT_IMPLEMENTED;
 #endif
 
-			cmdbuf[0] = IPC_MakeHeader(0x0014, 1, 0);
-			cmdbuf[1] = res;
-		}
-		break;
-	case 0x0015: // [n3ds only] read device raw (multi)
-		{
-			CHECK_HEADER(0x0015, 2, 0);
-			
-			u32 size = cmdbuf[2];
+	cmdbuf[0] = IPC_MakeHeader(0x0014, 1, 0);
+	cmdbuf[1] = res;
+}
+
+// [n3ds only] read device raw (multi)
+static void I2C_Cmd_ReadDeviceRawMulti(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u32 size = cmdbuf[2];
 #ifdef N3DS
-			u8 devid = (u8)(cmdbuf[1] & 0xFF);
-			
-			if (size > sizeof(session->output_staticbuf))
-				size = sizeof(session->output_staticbuf);
-			
-			Result res = I2CT(I2C_ReadDeviceRawMulti(devid, session->output_staticbuf, size));
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+
+	if (size > sizeof(session->output_staticbuf))
+		size = sizeof(session->output_staticbuf);
+
+	Result res = I2CT(I2C_ReadDeviceRawMulti(devid, session->output_staticbuf, size));
 #else
-			Result res = I2C_NOT_IMPLEMENTED;
+	Result res = I2C_NOT_IMPLEMENTED;
 #endif
 
-			cmdbuf[0] = IPC_MakeHeader(0x0015, 1, 2);
-			cmdbuf[1] = res;
-			cmdbuf[2] = IPC_Desc_StaticBuffer(size, 0);
-			cmdbuf[3] = (u32)session->output_staticbuf;
-		}
-		break;
+	cmdbuf[0] = IPC_MakeHeader(0x0015, 1, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = IPC_Desc_StaticBuffer(size, 0);
+	cmdbuf[3] = IPC_PointerToWord(session->output_staticbuf);
+}
+
+// [diagnostics, i2c::DEB] dump (and optionally reset) latency histograms
+static void I2C_Cmd_GetLatencyHistograms(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u32 flags = cmdbuf[1];
+	u32 size = cmdbuf[2];
+	I2C_LatencyHistogram *buf = (I2C_LatencyHistogram *)IPC_WordToPointer(cmdbuf[4]);
+
+	u32 count = 0;
+	Result res = I2C_CHKDIAG();
+#ifdef I2C_STATS
+	if (R_SUCCEEDED(res))
+		count = I2C_Stats_Dump(buf, size / sizeof(I2C_LatencyHistogram), flags & I2C_LATENCY_DUMP_RESET);
+#else
+	(void)flags;
+	if (R_SUCCEEDED(res))
+		res = I2C_NOT_IMPLEMENTED;
+#endif
+
+	cmdbuf[0] = IPC_MakeHeader(0x0016, 2, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = count;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+}
+
+// [diagnostics, i2c::DEB] dump (and optionally reset) per-bus lock counters
+static void I2C_Cmd_GetBusStats(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u32 flags = cmdbuf[1];
+	u32 size = cmdbuf[2];
+	I2C_BusStats *buf = (I2C_BusStats *)IPC_WordToPointer(cmdbuf[4]);
+
+	u32 count = 0;
+	Result res = I2C_CHKDIAG();
+#ifdef I2C_STATS
+	if (R_SUCCEEDED(res))
+		count = I2C_Stats_DumpBuses(buf, size / sizeof(I2C_BusStats), flags & I2C_BUS_STATS_DUMP_RESET);
+#else
+	(void)flags;
+	if (R_SUCCEEDED(res))
+		res = I2C_NOT_IMPLEMENTED;
+#endif
+
+	cmdbuf[0] = IPC_MakeHeader(0x0017, 2, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = count;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+}
+
+// [diagnostics, i2c::DEB] dump (and optionally reset) the bus trace ring
+static void I2C_Cmd_GetTrace(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u32 flags = cmdbuf[1];
+	u32 size = cmdbuf[2];
+	I2C_TraceEntry *buf = (I2C_TraceEntry *)IPC_WordToPointer(cmdbuf[4]);
+
+	u32 count = 0, sequence = 0;
+	Result res = I2C_CHKDIAG();
+#ifdef I2C_TRACE
+	if (R_SUCCEEDED(res))
+		count = I2C_Trace_Dump(buf, size / sizeof(I2C_TraceEntry), flags & I2C_TRACE_DUMP_RESET, &sequence);
+#else
+	(void)flags;
+	if (R_SUCCEEDED(res))
+		res = I2C_NOT_IMPLEMENTED;
+#endif
+
+	cmdbuf[0] = IPC_MakeHeader(0x0018, 3, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = count;
+	cmdbuf[3] = sequence; // sequence number of the record after the last one returned
+	cmdbuf[4] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[5] = IPC_PointerToWord(buf);
+}
+
+// [async] completion event of this session's asynchronous transfers
+static void I2C_Cmd_GetAsyncEvent(I2C_SessionData *session, u32 *cmdbuf)
+{
+	Handle event = 0;
+
+	Result res = I2C_Async_GetEvent(session, &event);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0019, 1, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = IPC_Desc_SharedHandles(1);
+	cmdbuf[3] = event;
+}
+
+// [async] queue a register read (8 bit variant), the data comes back through 0x001C
+static void I2C_Cmd_SubmitReadRegisters8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u32 size = cmdbuf[3];
+	u32 ticket = 0;
+
+	Result res = I2C_CHKPERM_MASK(I2C_DevidMask(devid));
+
+	if (R_SUCCEEDED(res))
+		res = I2C_Async_Submit(session, I2C_ASYNC_READ_REGISTERS8, devid, regid, NULL, size, &ticket);
+
+	cmdbuf[0] = IPC_MakeHeader(0x001A, 2, 0);
+	cmdbuf[1] = res;
+	cmdbuf[2] = ticket;
+}
+
+// [async] queue a register write (8 bit variant), the data is copied before the reply
+static void I2C_Cmd_SubmitWriteRegisters8(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u32 size = cmdbuf[3];
+	const u8 *buf = (const u8 *)IPC_WordToPointer(cmdbuf[5]);
+	u32 ticket = 0;
+
+	Result res = I2C_CHKPERM_MASK(I2C_DevidMask(devid));
+
+	if (R_SUCCEEDED(res))
+		res = I2C_Async_Submit(session, I2C_ASYNC_WRITE_REGISTERS8, devid, regid, buf, size, &ticket);
+
+	cmdbuf[0] = IPC_MakeHeader(0x001B, 2, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = ticket;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+}
+
+// [async] oldest finished transfer of this session: ticket, its result and size, read data in the buffer
+static void I2C_Cmd_ReapAsync(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u32 size = cmdbuf[1];
+	u8 *buf = (u8 *)IPC_WordToPointer(cmdbuf[3]);
+	I2C_AsyncResult done = { 0 };
+
+	Result res = I2C_Async_Reap(session, buf, size, &done);
+
+	cmdbuf[0] = IPC_MakeHeader(0x001C, 4, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = done.ticket;
+	cmdbuf[3] = done.result;
+	cmdbuf[4] = done.size;
+	cmdbuf[5] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[6] = IPC_PointerToWord(buf);
+}
+
+// [posted] acknowledge 0x0001/0x0002/0x0003/0x0005/0x0007 once queued (flag bit 0), or back to synchronous
+static void I2C_Cmd_SetPostedWrites(I2C_SessionData *session, u32 *cmdbuf)
+{
+	bool enable = cmdbuf[1] & 1;
+
+	if (!enable)
+		I2C_Async_Drain(session);
+
+	session->posted_writes = enable;
+
+	cmdbuf[0] = IPC_MakeHeader(0x001D, 1, 0);
+	cmdbuf[1] = 0;
+}
+
+// [posted] wait for this session's posted writes, return and clear the first error and the failure count
+static void I2C_Cmd_FencePostedWrites(I2C_SessionData *session, u32 *cmdbuf)
+{
+	Result error = 0;
+	u32 failures = 0;
+
+	I2C_Async_Fence(session, &error, &failures);
+
+	cmdbuf[0] = IPC_MakeHeader(0x001E, 3, 0);
+	cmdbuf[1] = 0;
+	cmdbuf[2] = error;
+	cmdbuf[3] = failures;
+}
+
+// [snapshot] configure the register ranges 0x0020 reads; replies the packed size and how many bursts that takes
+static void I2C_Cmd_SetSnapshotRanges(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u32 size = cmdbuf[1];
+	const I2C_SnapshotRange *ranges = (const I2C_SnapshotRange *)IPC_WordToPointer(cmdbuf[3]);
+	u32 n_ranges = size / sizeof(I2C_SnapshotRange);
+	u32 devid_mask = 0;
+
+	for (u32 i = 0; i < n_ranges; i++)
+		devid_mask |= I2C_DevidMask(ranges[i].devid);
+
+	Result res = size % sizeof(I2C_SnapshotRange) ? I2C_INVALID_SIZE : I2C_CHKPERM_MASK(devid_mask);
+
+	if (R_SUCCEEDED(res))
+		res = I2C_Snapshot_Configure(&session->snapshot, ranges, n_ranges);
+	else
+		I2C_Snapshot_Clear(&session->snapshot);
+
+	cmdbuf[0] = IPC_MakeHeader(0x001F, 3, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = session->snapshot.size;
+	cmdbuf[3] = session->snapshot.n_bursts;
+	cmdbuf[4] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
+	cmdbuf[5] = IPC_PointerToWord(ranges);
+}
+
+// [snapshot] read the configured ranges, packed in configuration order, and the tick the last burst finished at
+static void I2C_Cmd_ReadSnapshot(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u32 size = cmdbuf[1];
+	u8 *buf = (u8 *)IPC_WordToPointer(cmdbuf[3]);
+	u64 tick = 0;
+
+	Result res = I2C_Snapshot_Read(&session->snapshot, buf, size, &tick);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0020, 4, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = R_SUCCEEDED(res) ? session->snapshot.size : 0;
+	cmdbuf[3] = (u32)tick;
+	cmdbuf[4] = (u32)(tick >> 32);
+	cmdbuf[5] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[6] = IPC_PointerToWord(buf);
+}
+
+// write a table of 16 bit register writes with optional delays, e.g. a camera mode switch; on failure replies
+// the first entry of the failing burst (see I2C_WriteRegisterTable16), the entry count on success
+static void I2C_Cmd_WriteRegisterTable16(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u32 size = cmdbuf[2];
+	const I2C_RegisterWrite16 *table = (const I2C_RegisterWrite16 *)IPC_WordToPointer(cmdbuf[4]);
+	u32 count = size / sizeof(I2C_RegisterWrite16);
+	u32 failed_index = 0;
+
+	Result res = (!count || size % sizeof(I2C_RegisterWrite16)) ? I2C_INVALID_SIZE :
+		I2CT(I2C_WriteRegisterTable16(devid, table, count, &failed_index));
+
+	cmdbuf[0] = IPC_MakeHeader(0x0021, 2, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = failed_index;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
+	cmdbuf[4] = IPC_PointerToWord(table);
+}
+
+// [cache] cache count registers of devid from regid for ttl_ticks (0 removes the entry), shared by all sessions
+static void I2C_Cmd_ConfigureReadCache(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u16 regid = (u16)(cmdbuf[2] & 0xFFFF);
+	u16 count = (u16)(cmdbuf[3] & 0xFFFF);
+	u32 ttl_ticks = cmdbuf[4];
+	u8 flags = (u8)(cmdbuf[5] & 0xFF);
+
+	Result res = I2C_CHKPERM(I2C_Cache_Configure(devid, regid, count, ttl_ticks, flags));
+
+	cmdbuf[0] = IPC_MakeHeader(0x0022, 1, 0);
+	cmdbuf[1] = res;
+}
+
+// [cache, i2c::DEB] dump (and optionally reset) the hit, miss and saved bus time counters of every cache entry
+static void I2C_Cmd_GetReadCacheStats(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u32 flags = cmdbuf[1];
+	u32 size = cmdbuf[2];
+	I2C_CacheStats *buf = (I2C_CacheStats *)IPC_WordToPointer(cmdbuf[4]);
+
+	u32 count = 0;
+	Result res = I2C_CHKDIAG();
+
+	if (R_SUCCEEDED(res))
+		count = I2C_Cache_Dump(buf, size / sizeof(I2C_CacheStats), flags & I2C_CACHE_STATS_DUMP_RESET);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0023, 2, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = count;
+	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[4] = IPC_PointerToWord(buf);
+}
+
+// [legacy] set the delays of 0x000F for devid (adaptive: their ceilings), or only query them; replies the delays in use
+static void I2C_Cmd_ConfigureLegacyDelays(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u16 before_us = (u16)(cmdbuf[2] & 0xFFFF);
+	u16 between_us = (u16)(cmdbuf[3] & 0xFFFF);
+	u16 after_us = (u16)(cmdbuf[4] & 0xFFFF);
+	u16 flags = (u16)(cmdbuf[5] & 0xFFFF);
+	I2C_LegacyDelays delays = { 0 };
+
+	Result res = I2C_CHKPERM((flags & I2C_LEGACY_DELAYS_QUERY) ? 0 :
+		I2C_ConfigureLegacyDelays(devid, before_us, between_us, after_us, flags));
+
+	if (R_SUCCEEDED(res))
+		res = I2C_GetLegacyDelays(devid, &delays);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0024, 7, 0);
+	cmdbuf[1] = res;
+	cmdbuf[2] = delays.before_us;
+	cmdbuf[3] = delays.between_us;
+	cmdbuf[4] = delays.after_us;
+	cmdbuf[5] = delays.flags;
+	cmdbuf[6] = delays.reads;
+	cmdbuf[7] = delays.retries;
+}
+
+// [diagnostics] sweep the SCL settings for devid, optionally apply the fastest clean one; replies the SCL devid runs at afterwards.
+// i2c::DEB only, on any devid: the sweep overclocks a shared bus and may write patterns to a live register
+static void I2C_Cmd_TuneScl(I2C_SessionData *session, u32 *cmdbuf)
+{
+	u8 devid = (u8)(cmdbuf[1] & 0xFF);
+	u8 regid = (u8)(cmdbuf[2] & 0xFF);
+	u32 iterations = cmdbuf[3];
+	u8 flags = (u8)(cmdbuf[4] & 0xFF);
+	u32 size = cmdbuf[5];
+	I2C_SclTuneResult *buf = (I2C_SclTuneResult *)IPC_WordToPointer(cmdbuf[7]);
+	u32 count = 0, best = I2C_SCL_TUNE_NONE;
+
+	Result res = I2C_CHKDIAG();
+
+	if (R_SUCCEEDED(res))
+		res = I2C_TuneScl(devid, regid, iterations, flags, buf, size / sizeof(I2C_SclTuneResult), &count, &best);
+
+	cmdbuf[0] = IPC_MakeHeader(0x0025, 4, 2);
+	cmdbuf[1] = res;
+	cmdbuf[2] = count;
+	cmdbuf[3] = best;
+	cmdbuf[4] = res != I2C_UNAUTHORIZED ? I2C_GetDeviceScl(devid) : 0;
+	cmdbuf[5] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+	cmdbuf[6] = IPC_PointerToWord(buf);
+}
+
+#define I2C_CMD(id, normal, translate, handler, ...) \
+	[id] = { handler, I2C_HEADER(id, normal, translate), __VA_ARGS__ }
+
+// flags, buffer_index, size_index, buffer_arg
+static const I2C_CommandDesc I2C_Commands[] = {
+	I2C_CMD(0x0001, 4, 0, I2C_Cmd_ReplaceRegisterBits8,      0),
+	I2C_CMD(0x0002, 3, 0, I2C_Cmd_SetRegisterBits8,          0),
+	I2C_CMD(0x0003, 3, 0, I2C_Cmd_ClearRegisterBits8,        0),
+	I2C_CMD(0x0004, 4, 2, I2C_Cmd_ReplaceRegisterBits16Multi, I2C_CMD_STATIC_BUFFER, 5, 4, 0),
+	I2C_CMD(0x0005, 3, 0, I2C_Cmd_WriteRegister8,            0),
+	I2C_CMD(0x0006, 2, 0, I2C_Cmd_WriteDevice8,              0),
+	I2C_CMD(0x0007, 3, 0, I2C_Cmd_WriteRegister16,           0),
+	I2C_CMD(0x0008, 3, 2, I2C_Cmd_WriteRegister16Multi,      I2C_CMD_STATIC_BUFFER, 4, 3, 0),
+	I2C_CMD(0x0009, 2, 0, I2C_Cmd_ReadRegister8,             0),
+	I2C_CMD(0x000A, 2, 0, I2C_Cmd_ReadRegister16,            0),
+	I2C_CMD(0x000B, 3, 2, I2C_Cmd_WriteRegisters8,           I2C_CMD_STATIC_BUFFER, 4, 3, 1),
+	I2C_CMD(0x000C, 3, 2, I2C_Cmd_WriteRegisters16,          I2C_CMD_STATIC_BUFFER | I2C_CMD_SIZE_U16, 4, 3, 1),
+	I2C_CMD(0x000D, 3, 0, I2C_Cmd_ReadRegisters8,            0),
+	I2C_CMD(0x000E, 3, 2, I2C_Cmd_WriteRegisters8,           I2C_CMD_STATIC_BUFFER, 4, 3, 1),
+	I2C_CMD(0x000F, 3, 0, I2C_Cmd_ReadRegisters8Legacy,      0),
+	I2C_CMD(0x0010, 3, 0, I2C_Cmd_ReadRegisters16,           0),
+	I2C_CMD(0x0011, 3, 2, I2C_Cmd_WriteRegisters8Mapped,     I2C_CMD_MAPPED_BUFFER, 4, 3, IPC_BUFFER_R),
+	I2C_CMD(0x0012, 3, 2, I2C_Cmd_ReadRegisters8Mapped,      I2C_CMD_MAPPED_BUFFER, 4, 3, IPC_BUFFER_W),
+	I2C_CMD(0x0013, 1, 0, I2C_Cmd_ReadDeviceRaw,             I2C_CMD_N3DS_ONLY),
+	I2C_CMD(0x0014, 2, 2, I2C_Cmd_WriteDeviceRawMulti,       I2C_CMD_N3DS_ONLY | I2C_CMD_STATIC_BUFFER, 3, 2, 1),
+	I2C_CMD(0x0015, 2, 0, I2C_Cmd_ReadDeviceRawMulti,        I2C_CMD_N3DS_ONLY),
+	I2C_CMD(0x0016, 2, 2, I2C_Cmd_GetLatencyHistograms,      I2C_CMD_MAPPED_BUFFER, 3, 2, IPC_BUFFER_W),
+	I2C_CMD(0x0017, 2, 2, I2C_Cmd_GetBusStats,               I2C_CMD_MAPPED_BUFFER, 3, 2, IPC_BUFFER_W),
+	I2C_CMD(0x0018, 2, 2, I2C_Cmd_GetTrace,                  I2C_CMD_MAPPED_BUFFER, 3, 2, IPC_BUFFER_W),
+	I2C_CMD(0x0019, 0, 0, I2C_Cmd_GetAsyncEvent,             0),
+	I2C_CMD(0x001A, 3, 0, I2C_Cmd_SubmitReadRegisters8,      0),
+	I2C_CMD(0x001B, 3, 2, I2C_Cmd_SubmitWriteRegisters8,     I2C_CMD_MAPPED_BUFFER, 4, 3, IPC_BUFFER_R),
+	I2C_CMD(0x001C, 1, 2, I2C_Cmd_ReapAsync,                 I2C_CMD_MAPPED_BUFFER, 2, 1, IPC_BUFFER_W),
+	I2C_CMD(0x001D, 1, 0, I2C_Cmd_SetPostedWrites,           0),
+	I2C_CMD(0x001E, 0, 0, I2C_Cmd_FencePostedWrites,         0),
+	I2C_CMD(0x001F, 1, 2, I2C_Cmd_SetSnapshotRanges,         I2C_CMD_MAPPED_BUFFER, 2, 1, IPC_BUFFER_R),
+	I2C_CMD(0x0020, 1, 2, I2C_Cmd_ReadSnapshot,              I2C_CMD_MAPPED_BUFFER, 2, 1, IPC_BUFFER_W),
+	I2C_CMD(0x0021, 2, 2, I2C_Cmd_WriteRegisterTable16,      I2C_CMD_MAPPED_BUFFER, 3, 2, IPC_BUFFER_R),
+	I2C_CMD(0x0022, 5, 0, I2C_Cmd_ConfigureReadCache,        0),
+	I2C_CMD(0x0023, 2, 2, I2C_Cmd_GetReadCacheStats,         I2C_CMD_MAPPED_BUFFER, 3, 2, IPC_BUFFER_W),
+	I2C_CMD(0x0024, 5, 0, I2C_Cmd_ConfigureLegacyDelays,     0),
+	I2C_CMD(0x0025, 5, 2, I2C_Cmd_TuneScl,                   I2C_CMD_MAPPED_BUFFER, 6, 5, IPC_BUFFER_W),
+};
+
+#define I2C_COMMAND_COUNT (sizeof(I2C_Commands) / sizeof(I2C_Commands[0]))
+
+static inline bool I2C_IsPostedWrite(u32 cmd_header)
+{
+	switch (cmd_header)
+	{
+	case I2C_HEADER(0x0001, 4, 0):
+	case I2C_HEADER(0x0002, 3, 0):
+	case I2C_HEADER(0x0003, 3, 0):
+	case I2C_HEADER(0x0005, 3, 0):
+	case I2C_HEADER(0x0007, 3, 0):
+		return true;
 	default:
+		return false;
+	}
+}
+
+void I2C_DispatchIPC(I2C_SessionData *session)
+{
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u32 cmd_header = cmdbuf[0];
+
+	// anything else the session asks for sees its posted writes done; only this thread raises the count
+	if (session->posted_pending && !(session->posted_writes && I2C_IsPostedWrite(cmd_header)))
+		I2C_Async_Drain(session);
+
+	// hot commands: one compare against the full header checks the id and the parameter layout
+	if (cmd_header == I2C_HEADER(0x0009, 2, 0)) {
+		I2C_Cmd_ReadRegister8(session, cmdbuf);
+		return;
+	}
+
+	if (cmd_header == I2C_HEADER(0x0005, 3, 0)) {
+		I2C_Cmd_WriteRegister8(session, cmdbuf);
+		return;
+	}
+
+	if (cmd_header == I2C_HEADER(0x000D, 3, 0)) {
+		I2C_Cmd_ReadRegisters8(session, cmdbuf);
+		return;
+	}
+
+	u16 cmd_id = (cmd_header >> 16) & 0xFFFF;
+
+	if (cmd_id >= I2C_COMMAND_COUNT || !I2C_Commands[cmd_id].header)
 		RET_OS_INVALID_IPCARG
+
+	const I2C_CommandDesc *desc = &I2C_Commands[cmd_id];
+
+	if (cmd_header != desc->header) {
+		cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
+		cmdbuf[1] = OS_INVALID_IPC_HEADER;
+		return;
+	}
+
+#ifndef N3DS
+	// nothing to validate, the handler only replies I2C_NOT_IMPLEMENTED
+	if (desc->flags & I2C_CMD_N3DS_ONLY) {
+		desc->handler(session, cmdbuf);
+		return;
+	}
+#endif
+
+	if (desc->flags & I2C_CMD_STATIC_BUFFER) {
+		u32 buf_desc = cmdbuf[desc->buffer_index];
+
+		CHECK_WRONGARG(
+			!IPC_VerifyStaticBuffer(buf_desc, desc->buffer_arg) ||
+			(IPC_GetStaticBufferSize(buf_desc) >> ((desc->flags & I2C_CMD_SIZE_U16) ? 1 : 0)) != cmdbuf[desc->size_index]
+		);
+	} else if (desc->flags & I2C_CMD_MAPPED_BUFFER) {
+		u32 buf_desc = cmdbuf[desc->buffer_index];
+
+		CHECK_WRONGARG(
+			!IPC_VerifyBuffer(buf_desc, (IPC_BufferRights)desc->buffer_arg) ||
+			IPC_GetBufferSize(buf_desc) != cmdbuf[desc->size_index]
+		);
 	}
+
+	desc->handler(session, cmdbuf);
+}
+
+void I2C_HandleIPC(I2C_SessionData *session)
+{
+#ifdef I2C_STATS
+	u32 *cmdbuf = getThreadCommandBuffer();
+	u16 cmd_id = (cmdbuf[0] >> 16) & 0xFFFF;
+
+	// the multi-device commands carry a register id or a size in the first parameter
+	u8 devid = (cmd_id == 0x0004 || cmd_id == 0x0008 || cmd_id == 0x0020) ? I2C_LATENCY_DEVID_MULTI :
+		(cmd_id == 0x0019 || CMD_ID_RANGE(cmd_id, 0x001C, 0x001F) || cmd_id == 0x0023) ? I2C_LATENCY_DEVID_NONE : (u8)(cmdbuf[1] & 0xFF);
+
+	I2C_Stats_BeginCommand(session->session_type, cmd_id, devid);
+
+	I2C_DispatchIPC(session);
+
+	/*
+		rejected requests reply with command id 0, and the diagnostics dumps are not sampled;
+		the submit commands are sampled by the transfer driver when their transfer runs
+	*/
+	if (((cmdbuf[0] >> 16) & 0xFFFF) == cmd_id && !CMD_ID_RANGE(cmd_id, 0x0016, 0x0018) && !CMD_ID_RANGE(cmd_id, 0x001A, 0x001B) &&
+		cmd_id != 0x0023)
+		I2C_Stats_EndCommand();
+#else
+	I2C_DispatchIPC(session);
+#endif
 }
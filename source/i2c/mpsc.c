@@ -0,0 +1,101 @@
+#include <3ds/synchronization.h>
+#include <3ds/svc.h>
+
+#include <i2c/mpsc.h>
+
+#define I2C_MPSC_MASK (I2C_MPSC_CAPACITY - 1)
+
+void I2C_Mpsc_Init(I2C_Mpsc *queue, Handle event)
+{
+	queue->event = event;
+	queue->tail = 0;
+	queue->pending = 0;
+	queue->head = 0;
+
+	for (s32 i = 0; i < I2C_MPSC_CAPACITY; i++) {
+		queue->cells[i].sequence = i;
+		queue->cells[i].item = NULL;
+	}
+
+	LightEvent_Init(&queue->ready, RESET_ONESHOT);
+	__dmb();
+}
+
+bool I2C_Mpsc_Push(I2C_Mpsc *queue, void *item)
+{
+	I2C_MpscCell *cell;
+	s32 pos;
+
+	while (true)
+	{
+		pos = __ldrex(&queue->tail);
+		cell = &queue->cells[pos & I2C_MPSC_MASK];
+
+		s32 diff = *(volatile s32 *)&cell->sequence - pos;
+
+		// the consumer has not popped this cell from the previous lap yet
+		if (diff < 0) {
+			__clrex();
+			return false;
+		}
+
+		// a newer tail than the one loaded is already published, so the store would fail anyway
+		if (diff > 0) {
+			__clrex();
+			continue;
+		}
+
+		if (!__strex(&queue->tail, pos + 1))
+			break;
+	}
+
+	__dmb();
+	cell->item = item;
+	__dmb();
+	*(volatile s32 *)&cell->sequence = pos + 1;
+	__dmb();
+
+	s32 pending;
+
+	do
+		pending = __ldrex(&queue->pending);
+	while (__strex(&queue->pending, pending + 1));
+
+	if (!pending)
+		I2C_Mpsc_Wake(queue);
+
+	return true;
+}
+
+void *I2C_Mpsc_Pop(I2C_Mpsc *queue)
+{
+	u32 pos = queue->head;
+	I2C_MpscCell *cell = &queue->cells[pos & I2C_MPSC_MASK];
+
+	if (*(volatile s32 *)&cell->sequence != (s32)(pos + 1))
+		return NULL;
+
+	__dmb();
+	void *item = cell->item;
+	__dmb();
+
+	*(volatile s32 *)&cell->sequence = (s32)(pos + I2C_MPSC_CAPACITY);
+	queue->head = pos + 1;
+
+	s32 pending;
+
+	do
+		pending = __ldrex(&queue->pending);
+	while (__strex(&queue->pending, pending - 1));
+
+	return item;
+}
+
+void I2C_Mpsc_Wait(I2C_Mpsc *queue)
+{
+	// published items behind an unpublished head: its producer was preempted mid-push
+	if (I2C_Mpsc_Stalled(queue))
+		svcSleepThread(I2C_MPSC_STALL_NS);
+	else
+		LightEvent_Wait(&queue->ready);
+}
@@ -0,0 +1,117 @@
+#include <3ds/svc.h>
+#include <3ds/err.h>
+
+#include <i2c/snapshot.h>
+#include <i2c/i2c.h>
+#include <memops.h>
+
+// bursts are built in (bus, devid, regid) order, so each bus is visited once per snapshot
+static inline bool I2C_Snapshot_Before(const I2C_SnapshotRange *a, const I2C_SnapshotRange *b)
+{
+	u8 port_a = I2C_GetDeviceConfig(a->devid)->port, port_b = I2C_GetDeviceConfig(b->devid)->port;
+
+	if (port_a != port_b)
+		return port_a < port_b;
+
+	if (a->devid != b->devid)
+		return a->devid < b->devid;
+
+	return a->regid < b->regid;
+}
+
+Result I2C_Snapshot_Configure(I2C_Snapshot *snapshot, const I2C_SnapshotRange *ranges, u32 n_ranges)
+{
+	u8 order[I2C_SNAPSHOT_MAX_RANGES];
+	u32 size = 0, read_size = 0;
+
+	I2C_Snapshot_Clear(snapshot);
+
+	if (!n_ranges || n_ranges > I2C_SNAPSHOT_MAX_RANGES)
+		return I2C_INVALID_SIZE;
+
+	for (u32 i = 0; i < n_ranges; i++) {
+		if (!ranges[i].size || ranges[i].regid + ranges[i].size > 0x100)
+			return I2C_INVALID_SIZE;
+
+		size += ranges[i].size;
+	}
+
+	if (size > I2C_SNAPSHOT_MAX_SIZE)
+		return I2C_INVALID_SIZE;
+
+	// insertion sort, there are at most I2C_SNAPSHOT_MAX_RANGES
+	for (u32 i = 0; i < n_ranges; i++) {
+		u32 j = i;
+
+		for (; j > 0 && I2C_Snapshot_Before(&ranges[i], &ranges[order[j - 1]]); j--)
+			order[j] = order[j - 1];
+
+		order[j] = (u8)i;
+	}
+
+	I2C_ReadBurst *burst = NULL;
+	u32 n_bursts = 0;
+	bool exact = false; // the range the burst currently ends with
+
+	for (u32 i = 0; i < n_ranges; i++) {
+		const I2C_SnapshotRange *range = &ranges[order[i]];
+		u32 end = range->regid + range->size;
+		u32 gap = (exact || (range->flags & I2C_SNAPSHOT_RANGE_EXACT)) ? 0 : I2C_SNAPSHOT_MAX_GAP;
+
+		if (burst && burst->devid == range->devid && range->regid <= burst->regid + burst->size + gap) {
+			u32 burst_end = burst->regid + burst->size;
+
+			if (end > burst_end) {
+				read_size += end - burst_end;
+				burst->size = (u16)(end - burst->regid);
+				exact = range->flags & I2C_SNAPSHOT_RANGE_EXACT;
+			} else if (end == burst_end) {
+				exact |= range->flags & I2C_SNAPSHOT_RANGE_EXACT;
+			}
+		} else {
+			burst = &snapshot->bursts[n_bursts++];
+			burst->devid = range->devid;
+			burst->regid = range->regid;
+			burst->size = range->size;
+			burst->offset = (u16)read_size;
+			read_size += range->size;
+			exact = range->flags & I2C_SNAPSHOT_RANGE_EXACT;
+		}
+
+		if (read_size > I2C_SNAPSHOT_MAX_SIZE)
+			return I2C_INVALID_SIZE;
+
+		snapshot->range_offsets[order[i]] = (u8)(burst->offset + (range->regid - burst->regid));
+		snapshot->range_sizes[order[i]] = range->size;
+	}
+
+	snapshot->n_bursts = (u8)n_bursts;
+	snapshot->n_ranges = (u8)n_ranges;
+	snapshot->size = (u8)size;
+	snapshot->read_size = (u8)read_size;
+
+	return 0;
+}
+
+Result I2C_Snapshot_Read(const I2C_Snapshot *snapshot, u8 *out, u32 size, u64 *tick)
+{
+	u8 data[I2C_SNAPSHOT_MAX_SIZE] __attribute__((aligned(4)));
+
+	if (!snapshot->n_ranges)
+		return I2C_SNAPSHOT_NOT_CONFIGURED;
+
+	if (size < snapshot->size)
+		return I2C_INVALID_SIZE;
+
+	if (!I2C_ReadRegisters8Bursts(snapshot->bursts, snapshot->n_bursts, data))
+		return I2C_FATAL_FAIL;
+
+	*tick = (u64)svcGetSystemTick();
+
+	for (u32 i = 0; i < snapshot->n_ranges; i++) {
+		_memcpy(out, data + snapshot->range_offsets[i], snapshot->range_sizes[i]);
+		out += snapshot->range_sizes[i];
+	}
+
+	return 0;
+}
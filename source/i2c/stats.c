@@ -0,0 +1,277 @@
+#ifdef I2C_STATS
+
+#include <3ds/synchronization.h>
+#include <3ds/svc.h>
+#include <3ds/ipc.h>
+
+#include <i2c/globals.h>
+#include <i2c/thread.h>
+#include <i2c/stats.h>
+#include <memops.h>
+
+/*
+	Per-thread accumulator for the command in flight. Each session has its own thread,
+	so this lives in the thread context in TLS and needs no locking.
+*/
+typedef struct I2C_ThreadStats {
+	u64 dispatch_tick;
+	u64 lock_requested_tick;
+	u64 lock_acquired_tick;
+	u64 attempt_tick;
+	u64 ticks[I2C_LATENCY_COMPONENT_COUNT];
+	u32 retries;
+	u16 cmd_id;
+	u8 service;
+	u8 devid;
+} I2C_ThreadStats;
+
+_Static_assert(sizeof(I2C_ThreadStats) <= sizeof(((I2C_ThreadContext *)0)->stats), "I2C_ThreadStats does not fit in the thread context");
+
+/*
+	Per-bus counters. Only the holder of the bus lock touches them, so the bus lock
+	doubles as their lock; a line apart like the buses themselves (I2C_Bus).
+*/
+typedef struct __attribute__((aligned(I2C_CPU_CACHE_LINE))) I2C_BusCounters {
+	I2C_BusStats stats;
+	u64 acquired_tick;
+	u32 slot_index[I2C_BUS_STATS_WINDOW_SLOTS]; // tick >> I2C_BUS_STATS_SLOT_SHIFT the slot belongs to
+	u32 slot_busy[I2C_BUS_STATS_WINDOW_SLOTS];
+} I2C_BusCounters;
+
+static LightLock I2C_StatsLock;
+static I2C_LatencyHistogram I2C_Histograms[I2C_LATENCY_MAX_ENTRIES];
+static u32 I2C_HistogramCount;
+static I2C_BusCounters I2C_Buses[3];
+
+static inline I2C_ThreadStats *I2C_Stats_GetThreadStats(void)
+{
+	return (I2C_ThreadStats *)I2C_GetThreadContext()->stats;
+}
+
+static inline u64 I2C_Stats_Now(void)
+{
+	return (u64)svcGetSystemTick();
+}
+
+static inline u32 I2C_Stats_Bucket(u64 ticks)
+{
+	ticks >>= I2C_LATENCY_BUCKET_SHIFT;
+
+	if (!ticks)
+		return 0;
+	if (ticks >> (I2C_LATENCY_BUCKET_COUNT - 2))
+		return I2C_LATENCY_BUCKET_COUNT - 1;
+
+	return 32 - __builtin_clz((u32)ticks); // floor(log2) + 1
+}
+
+void I2C_Stats_Init(void)
+{
+	LightLock_Init(&I2C_StatsLock);
+	I2C_HistogramCount = 0;
+}
+
+static inline u32 I2C_Stats_Clamp32(u64 ticks)
+{
+	return ticks > 0xFFFFFFFF ? 0xFFFFFFFF : (u32)ticks;
+}
+
+void I2C_Stats_BeginCommand(u8 service, u16 cmd_id, u8 devid)
+{
+	I2C_ThreadStats *ts = I2C_Stats_GetThreadStats();
+
+	_memset32_aligned(ts, 0, sizeof(I2C_ThreadStats));
+	ts->service = service;
+	ts->cmd_id = cmd_id;
+	ts->devid = devid;
+	ts->dispatch_tick = I2C_Stats_Now();
+}
+
+void I2C_Stats_LockRequested(u8 port)
+{
+	(void)port;
+	I2C_Stats_GetThreadStats()->lock_requested_tick = I2C_Stats_Now();
+}
+
+void I2C_Stats_LockAcquired(u8 port, LightLockWait how)
+{
+	I2C_ThreadStats *ts = I2C_Stats_GetThreadStats();
+	I2C_BusCounters *bc = &I2C_Buses[port];
+	u64 now = I2C_Stats_Now();
+	u64 wait = now - ts->lock_requested_tick;
+
+	ts->ticks[I2C_LATENCY_LOCK_WAIT] += wait;
+	ts->lock_acquired_tick = ts->attempt_tick = now;
+
+	bc->acquired_tick = now;
+	bc->stats.acquisitions++;
+	bc->stats.contended += how != LIGHTLOCK_FREE;
+	bc->stats.spun += how == LIGHTLOCK_SPUN;
+	bc->stats.wait_ticks += wait;
+
+	if (wait > bc->stats.max_wait_ticks)
+		bc->stats.max_wait_ticks = I2C_Stats_Clamp32(wait);
+}
+
+void I2C_Stats_LockReleased(u8 port)
+{
+	I2C_ThreadStats *ts = I2C_Stats_GetThreadStats();
+	I2C_BusCounters *bc = &I2C_Buses[port];
+	u64 now = I2C_Stats_Now();
+	u64 hold = now - bc->acquired_tick;
+
+	ts->ticks[I2C_LATENCY_BUS] += now - ts->lock_acquired_tick;
+
+	bc->stats.hold_ticks += hold;
+
+	if (hold > bc->stats.max_hold_ticks) {
+		bc->stats.max_hold_ticks = I2C_Stats_Clamp32(hold);
+		bc->stats.max_hold_service = ts->service;
+	}
+
+	u32 index = (u32)(now >> I2C_BUS_STATS_SLOT_SHIFT);
+	u32 slot = index % I2C_BUS_STATS_WINDOW_SLOTS;
+
+	if (bc->slot_index[slot] != index) {
+		bc->slot_index[slot] = index;
+		bc->slot_busy[slot] = 0;
+	}
+
+	bc->slot_busy[slot] += I2C_Stats_Clamp32(hold);
+}
+
+void I2C_Stats_AttemptFinished(void)
+{
+	I2C_Stats_GetThreadStats()->attempt_tick = I2C_Stats_Now();
+}
+
+void I2C_Stats_AttemptCancelled(void)
+{
+	I2C_ThreadStats *ts = I2C_Stats_GetThreadStats();
+	u64 now = I2C_Stats_Now();
+
+	ts->ticks[I2C_LATENCY_RETRY] += now - ts->attempt_tick;
+	ts->attempt_tick = now;
+	ts->retries++;
+}
+
+void I2C_Stats_BusTimeout(u8 port)
+{
+	I2C_Buses[port].stats.timeouts++;
+}
+
+void I2C_Stats_BusRecovery(u8 port, bool clocked_out, bool recovered)
+{
+	I2C_BusStats *stats = &I2C_Buses[port].stats;
+
+	stats->recoveries++;
+	stats->clock_outs += clocked_out;
+	stats->recovery_failures += !recovered;
+}
+
+void I2C_Stats_ReadsMerged(u8 port, u32 n)
+{
+	I2C_Buses[port].stats.merged_reads += n;
+}
+
+static I2C_LatencyHistogram *I2C_Stats_FindHistogram(u8 service, u16 cmd_id, u8 devid)
+{
+	for (u32 i = 0; i < I2C_HistogramCount; i++) {
+		I2C_LatencyHistogram *h = &I2C_Histograms[i];
+
+		if (h->service == service && h->cmd_id == cmd_id && h->devid == devid)
+			return h;
+	}
+
+	if (I2C_HistogramCount == I2C_LATENCY_MAX_ENTRIES)
+		return NULL; // table full, new keys are dropped until the next reset
+
+	I2C_LatencyHistogram *h = &I2C_Histograms[I2C_HistogramCount++];
+
+	h->service = service;
+	h->cmd_id = cmd_id;
+	h->devid = devid;
+
+	return h;
+}
+
+void I2C_Stats_EndCommand(void)
+{
+	I2C_ThreadStats *ts = I2C_Stats_GetThreadStats();
+
+	ts->ticks[I2C_LATENCY_TOTAL] = I2C_Stats_Now() - ts->dispatch_tick;
+
+	LightLock_Lock(&I2C_StatsLock);
+
+	I2C_LatencyHistogram *h = I2C_Stats_FindHistogram(ts->service, ts->cmd_id, ts->devid);
+
+	if (h) {
+		h->count++;
+		h->retries += ts->retries;
+
+		if (ts->ticks[I2C_LATENCY_TOTAL] > h->max_ticks)
+			h->max_ticks = I2C_Stats_Clamp32(ts->ticks[I2C_LATENCY_TOTAL]);
+
+		for (u32 c = 0; c < I2C_LATENCY_COMPONENT_COUNT; c++) {
+			h->sum_ticks[c] += ts->ticks[c];
+			h->buckets[c][I2C_Stats_Bucket(ts->ticks[c])]++;
+		}
+	}
+
+	LightLock_Unlock(&I2C_StatsLock);
+}
+
+u32 I2C_Stats_Dump(I2C_LatencyHistogram *out, u32 max_entries, bool reset)
+{
+	LightLock_Lock(&I2C_StatsLock);
+
+	u32 n = I2C_HistogramCount < max_entries ? I2C_HistogramCount : max_entries;
+
+	_memcpy(out, I2C_Histograms, n * sizeof(I2C_LatencyHistogram));
+
+	if (reset) {
+		_memset32_aligned(I2C_Histograms, 0, sizeof(I2C_Histograms));
+		I2C_HistogramCount = 0;
+	}
+
+	LightLock_Unlock(&I2C_StatsLock);
+	return n;
+}
+
+u32 I2C_Stats_DumpBuses(I2C_BusStats *out, u32 max_buses, bool reset)
+{
+	u32 n = max_buses < 3 ? max_buses : 3;
+
+	for (u32 port = 0; port < n; port++) {
+		I2C_BusCounters *bc = &I2C_Buses[port];
+
+		I2C_HoldBus(port);
+
+		u64 now = I2C_Stats_Now();
+		u32 index = (u32)(now >> I2C_BUS_STATS_SLOT_SHIFT);
+		u64 window = ((u64)(I2C_BUS_STATS_WINDOW_SLOTS - 1) << I2C_BUS_STATS_SLOT_SHIFT) +
+					 (now & ((1ULL << I2C_BUS_STATS_SLOT_SHIFT) - 1));
+		u64 busy = 0;
+
+		for (u32 slot = 0; slot < I2C_BUS_STATS_WINDOW_SLOTS; slot++)
+			if (index - bc->slot_index[slot] < I2C_BUS_STATS_WINDOW_SLOTS)
+				busy += bc->slot_busy[slot];
+
+		if (window > now)
+			window = now; // uptime shorter than the window
+
+		bc->stats.window_ticks = (u32)window;
+		bc->stats.window_busy_ticks = (u32)(busy < window ? busy : window);
+
+		_memcpy(&out[port], &bc->stats, sizeof(I2C_BusStats));
+
+		if (reset)
+			_memset32_aligned(bc, 0, sizeof(I2C_BusCounters));
+
+		I2C_ReleaseBus(port);
+	}
+
+	return n;
+}
+
+#endif
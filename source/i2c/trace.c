@@ -0,0 +1,56 @@
+#ifdef I2C_TRACE
+
+#include <3ds/synchronization.h>
+
+#include <i2c/thread.h>
+#include <i2c/trace.h>
+#include <memops.h>
+
+/*
+	Writers claim a slot by bumping I2C_TraceSequence with ldrex/strex and fill it in
+	without further locking; a dump racing a writer may copy a half-written record.
+*/
+static I2C_TraceEntry I2C_TraceRing[I2C_TRACE_RING_SIZE];
+static s32 I2C_TraceSequence; // sequence number of the next record
+static s32 I2C_TraceStart;    // oldest sequence number still wanted (reset point)
+
+void I2C_Trace_Record(u32 tick, I2C_TracePhase phase, u8 devid, u8 port, u8 data, bool ack)
+{
+	s32 seq;
+
+	do
+		seq = __ldrex(&I2C_TraceSequence);
+	while (__strex(&I2C_TraceSequence, seq + 1));
+
+	I2C_TraceEntry *e = &I2C_TraceRing[(u32)seq % I2C_TRACE_RING_SIZE];
+
+	e->tick = tick;
+	e->phase = (u8)phase;
+	e->devid = devid;
+	e->data = data;
+	e->flags = (u8)((port & I2C_TRACE_FLAG_BUS_MASK) | (ack ? I2C_TRACE_FLAG_ACK : 0) |
+		(I2C_GetThreadContext()->session_type << I2C_TRACE_SESSION_SHIFT));
+}
+
+u32 I2C_Trace_Dump(I2C_TraceEntry *out, u32 max_entries, bool reset, u32 *out_sequence)
+{
+	u32 end = (u32)*(volatile s32 *)&I2C_TraceSequence;
+	__dmb();
+	u32 start = (u32)I2C_TraceStart;
+
+	if (end - start > I2C_TRACE_RING_SIZE)
+		start = end - I2C_TRACE_RING_SIZE; // older records were overwritten
+	if (end - start > max_entries)
+		start = end - max_entries;         // keep the newest ones
+
+	for (u32 seq = start; seq != end; seq++)
+		_memcpy(&out[seq - start], &I2C_TraceRing[seq % I2C_TRACE_RING_SIZE], sizeof(I2C_TraceEntry));
+
+	if (reset)
+		I2C_TraceStart = (s32)end;
+
+	*out_sequence = end;
+	return end - start;
+}
+
+#endif
@@ -1,5 +1,10 @@
 #include <3ds/synchronization.h>
 #include <i2c/globals.h>
+#include <i2c/thread.h>
+#include <i2c/async.h>
+#include <i2c/cache.h>
+#include <i2c/flight.h>
+#include <i2c/stats.h>
 #include <3ds/result.h>
 #include <3ds/types.h>
 #include <3ds/svc.h>
@@ -13,7 +18,7 @@
 
 // service constants
 
-#define I2C_MAX_SESSIONS_PER_SERVICE 1
+#define I2C_MAX_SESSIONS_PER_SERVICE 1 // more lets sessions read one device at once, see I2C_Flight_JoinSession
 #ifdef N3DS
 #define I2C_IPC_THREAD_STACKSIZE     0x800
 #else
@@ -39,20 +44,26 @@ static const struct
 #endif
 };
 
-__attribute__((section(".data.thread_stacks"), aligned(8))) static u8 I2C_ThreadStacks[I2C_SERVICE_MAX][I2C_IPC_THREAD_STACKSIZE] = { 0 };
-__attribute__((section(".data.session_data"))) static I2C_SessionData I2C_SessionsData[I2C_SERVICE_MAX] = { 0 };
+// zero-initialized, so kept out of the code image: .bss.* is NOLOAD and cleared by initializeBSS
+__attribute__((section(".bss.thread_stacks"), aligned(8))) static u8 I2C_ThreadStacks[I2C_SERVICE_MAX][I2C_IPC_THREAD_STACKSIZE];
+__attribute__((section(".bss.session_data"))) static I2C_SessionData I2C_SessionsData[I2C_SERVICE_MAX];
 
 void _thread_start(void *);
 
 Result startThread(Handle *thread, void (* function)(void *), void *arg, void *stack_top, s32 priority, s32 processor_id)
 {
-	if ((u32)(stack_top) & (0x8 - 1))
+	if ((uintptr_t)(stack_top) & (0x8 - 1))
 		return OS_MISALIGNED_ADDRESS;
+#ifdef I2C_HOST
+	// host threads bring their own stacks and entry trampoline
+	return svcCreateThread(thread, function, arg, stack_top, priority, processor_id);
+#else
 	//_thread_start will pop these out
 	((u32 *)stack_top)[-1] = (u32)function;
 	((u32 *)stack_top)[-2] = (u32)arg;
 
 	return svcCreateThread(thread, _thread_start, function, stack_top, priority, processor_id);
+#endif
 }
 
 static inline void freeThread(Handle *thread)
@@ -65,18 +76,16 @@ static inline void freeThread(Handle *thread)
 	}
 }
 
-static inline I2C_SessionData *getNewSessionData(s32 service_index)
+// atomically replaces *slot, returning the previous handle
+static inline Handle exchangeHandle(Handle *slot, Handle value)
 {
-	I2C_SessionData *data = &I2C_SessionsData[service_index]; /* service_index = id */
-	
-	if (data->thread) {
-		freeThread(&data->thread);
-		_memset32_aligned(data, 0, sizeof(I2C_SessionData));
-	}
+	Handle old;
 
-	data->session_type = (I2C_SessionType)service_index;
-	
-	return data;
+	do
+		old = (Handle)__ldrex((s32 *)slot);
+	while (__strex((s32 *)slot, (s32)value));
+
+	return old;
 }
 
 void I2C_SessionThreadMain(void *arg)
@@ -85,6 +94,8 @@ void I2C_SessionThreadMain(void *arg)
 	Result res = 0;
 	s32 index = -1;
 	
+	I2C_GetThreadContext()->session_type = data->session_type;
+	
 	IPC_StaticBuffer *staticbufs = getThreadStaticBuffers();
 	
 	staticbufs[0].desc = IPC_Desc_StaticBuffer(I2C_INPUT_STATICBUF_SIZE, 0);
@@ -92,34 +103,108 @@ void I2C_SessionThreadMain(void *arg)
 	staticbufs[1].desc = IPC_Desc_StaticBuffer(I2C_INPUT_STATICBUF_SIZE, 0);
 	staticbufs[1].bufptr = data->input_staticbuf;
 
-	getThreadCommandBuffer()[0] = 0xFFFF0000;
-
 	while (true)
 	{
-		res = svcReplyAndReceive(&index, &data->session, 1, data->session);
+		// parked until the main thread hands over a session
+		T(svcWaitSynchronization(data->wake, -1))
 
-		if (R_FAILED(res))
+		data->session = exchangeHandle(&data->pending, 0);
+
+		if (!data->session)
+		{
+			if (data->shutdown)
+				break;
+
+			continue;
+		}
+
+		getThreadCommandBuffer()[0] = 0xFFFF0000;
+
+		while (true)
 		{
-			if (res != OS_REMOTE_SESSION_CLOSED)
-				Err_Panic(res);
+			res = svcReplyAndReceive(&index, &data->session, 1, data->session);
 
-			break;
+			if (R_FAILED(res))
+			{
+				if (res != OS_REMOTE_SESSION_CLOSED)
+					Err_Panic(res);
+
+				break;
+			}
+			else if (index != 0)
+				Err_Panic(OS_EXCEEDED_HANDLES_INDEX);
+
+			I2C_HandleIPC(data);
 		}
-		else if (index != 0)
-			Err_Panic(OS_EXCEEDED_HANDLES_INDEX);
 
-		I2C_HandleIPC(data);
+		T(svcCloseHandle(data->session))
+		data->session = 0;
+
+		I2C_Async_ReleaseSession(data);
+		I2C_Snapshot_Clear(&data->snapshot);
+
+		// whatever the last client left behind is cleared here, off the accept path
+		_memset32_aligned(data->input_staticbuf, 0, sizeof(data->input_staticbuf));
+		_memset32_aligned(data->output_staticbuf, 0, sizeof(data->output_staticbuf));
 	}
+}
+
+static inline I2C_SessionData *getSessionData(s32 service_index)
+{
+	I2C_SessionData *data = &I2C_SessionsData[service_index]; /* service_index = id */
 
-	T(svcCloseHandle(data->session))
+	if (data->thread)
+		return data;
+
+	data->session_type = (I2C_SessionType)service_index;
+	data->device_mask = I2C_GetDeviceAccessMask(data->session_type);
+	I2C_Async_InitSession(data);
+
+#ifdef N3DS
+	s32 processor_id;
+	switch (service_index)
+	{
+	case I2C_SESSION_TYPE_CAM:
+	case I2C_SESSION_TYPE_HID:
+	case I2C_SESSION_TYPE_QTM:
+		processor_id = 3;
+		break;
+	default:
+		processor_id = -2;
+	}
+#else
+	s32 processor_id = -2;
+#endif
+
+	T(svcCreateEvent(&data->wake, RESET_ONESHOT));
+	T(startThread(&data->thread, &I2C_SessionThreadMain, data, I2C_ThreadStacks[service_index + 1], 11, processor_id));
+
+	return data;
+}
+
+static inline void stopSessionWorker(I2C_SessionData *data)
+{
+	if (!data->thread)
+		return;
+
+	// the worker finishes the session it is serving (and one still pending), then sees nothing pending and exits
+	data->shutdown = true;
+	T(svcSignalEvent(data->wake));
+	freeThread(&data->thread);
+
+	T(svcCloseHandle(data->wake));
+	data->wake = 0;
 }
 
 static inline void initializeBSS()
 {
-	extern void *__bss_start__;
-	extern void *__bss_end__;
+#ifndef I2C_HOST // the host loader already zeroes .bss
+	// linker symbols: their addresses delimit .bss, they hold nothing
+	extern u8 __bss_start__[];
+	extern u8 __bss_end__[];
 
-	_memset32_aligned(__bss_start__, 0, (size_t)__bss_end__ - (size_t)__bss_start__);
+	_memset32_aligned(__bss_start__, 0, (size_t)(__bss_end__ - __bss_start__));
+#endif
 }
 
 #define SRV_NOTIF_REPLY(idx) (idx == 0) // handles[0]
@@ -147,12 +232,16 @@ void I2C_Main()
 	*/
 	Handle handles[1 + I2C_SERVICE_MAX];
 
-	RecursiveLock_Init(&g_I2C_BusLocks[0]);
-	RecursiveLock_Init(&g_I2C_BusLocks[1]);
-	RecursiveLock_Init(&g_I2C_BusLocks[2]);
-	T(svcCreateEvent(&g_I2C_BusInterrupts[0], RESET_ONESHOT));
-	T(svcCreateEvent(&g_I2C_BusInterrupts[1], RESET_ONESHOT));
-	T(svcCreateEvent(&g_I2C_BusInterrupts[2], RESET_ONESHOT));
+	RecursiveLock_Init(&g_I2C_Buses[0].lock);
+	RecursiveLock_Init(&g_I2C_Buses[1].lock);
+	RecursiveLock_Init(&g_I2C_Buses[2].lock);
+	I2C_Stats_Init();
+	I2C_Cache_Init();
+	I2C_Flight_Init();
+	I2C_LegacyDelays_Init();
+	T(svcCreateEvent(&g_I2C_Buses[0].interrupt, RESET_ONESHOT));
+	T(svcCreateEvent(&g_I2C_Buses[1].interrupt, RESET_ONESHOT));
+	T(svcCreateEvent(&g_I2C_Buses[2].interrupt, RESET_ONESHOT));
 	
 	// handles[0] - srv notification event
 	T(SRV_EnableNotification(&handles[0]));
@@ -161,9 +250,11 @@ void I2C_Main()
 	for (u8 i = 0, j = 1; i < I2C_SERVICE_MAX; i++, j++)
 		T(SRV_RegisterService(&handles[j], I2C_ServiceConfigs[i].name, I2C_ServiceConfigs[i].len, I2C_MAX_SESSIONS_PER_SERVICE));
 	
-	T(svcBindInterrupt(0x54, g_I2C_BusInterrupts[0], 8, false));
-	T(svcBindInterrupt(0x55, g_I2C_BusInterrupts[1], 8, false));
-	T(svcBindInterrupt(0x5C, g_I2C_BusInterrupts[2], 8, false));
+	T(svcBindInterrupt(0x54, g_I2C_Buses[0].interrupt, 8, false));
+	T(svcBindInterrupt(0x55, g_I2C_Buses[1].interrupt, 8, false));
+	T(svcBindInterrupt(0x5C, g_I2C_Buses[2].interrupt, 8, false));
+
+	I2C_Async_Init();
 	
 	while (true)
 	{
@@ -183,41 +274,32 @@ void I2C_Main()
 		}
 		else if (SERVICE_REPLY(index)) // service handle received request to create session
 		{
-			Handle session, thread;
+			Handle session;
 			
-			/* we only allow one active thread per service */
-			I2C_SessionData *data = getNewSessionData(index - 1);
-
-#ifdef N3DS
-			s32 processor_id;
-			switch (index - 1)
-			{
-			case I2C_SESSION_TYPE_CAM:
-			case I2C_SESSION_TYPE_HID:
-			case I2C_SESSION_TYPE_QTM:
-				processor_id = 3;
-				break;
-			default:
-				processor_id = -2;
-			}
-#else
-			s32 processor_id = -2;
-#endif
+			/* one worker per service, which serves one session at a time; never wait for it here */
+			I2C_SessionData *data = getSessionData(index - 1);
 			
 			T(svcAcceptSession(&session, handles[index]));
-			data->session = session;
-			
-			T(startThread(&thread, &I2C_SessionThreadMain, data, I2C_ThreadStacks[index], 11, processor_id));
 
-			data->thread = thread;
+			/* the port allows one session per service, so a session is only left pending
+			   while the worker is still closing the previous one; never more than one */
+			Handle stale = exchangeHandle(&data->pending, session);
+
+			if (stale)
+				T(svcCloseHandle(stale));
+
+			T(svcSignalEvent(data->wake));
 		}
 		else // invalid index
 			Err_Throw(I2C_INTERNAL_RANGE);
 	}
 
-	// wait and close thread handles
+	// stop the session workers and close their handles
 	for (u8 i = 0; i < I2C_SERVICE_MAX; i++)
-		freeThread(&I2C_SessionsData[i].thread);
+		stopSessionWorker(&I2C_SessionsData[i]);
+
+	// no session is left to submit, the transfer driver drains the queues and exits
+	I2C_Async_Exit();
 	
 	T(svcCloseHandle(handles[0]));
 
@@ -228,9 +310,9 @@ void I2C_Main()
 		T(svcCloseHandle(handles[j]));
 	}
 
-	svcCloseHandle(g_I2C_BusInterrupts[0]);
-	svcCloseHandle(g_I2C_BusInterrupts[1]);
-	svcCloseHandle(g_I2C_BusInterrupts[2]);
+	svcCloseHandle(g_I2C_Buses[0].interrupt);
+	svcCloseHandle(g_I2C_Buses[1].interrupt);
+	svcCloseHandle(g_I2C_Buses[2].interrupt);
 	
 	srvExit();
 	syncExit();
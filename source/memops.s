@@ -0,0 +1,150 @@
+@ LDM/STM block kernels behind _memcpy/_memset in memops.h, used for sizes of at
+@ least I2C_MEMOPS_BLOCK_MIN bytes. Both align the destination with byte stores
+@ first; the copy then moves 32 byte blocks when the source is word aligned too,
+@ or merges shifted aligned source words when it is not.
+
+	.arch armv6k
+	.syntax unified
+	.arm
+
+@ void _memcpy_armv6(void *dest, const void *src, size_t size)
+	.section .text._memcpy_armv6, "ax", %progbits
+	.align  2
+	.global _memcpy_armv6
+	.type   _memcpy_armv6, %function
+_memcpy_armv6:
+	cmp     r2, #0
+	bxeq    lr
+	push    {r4-r10, lr}
+
+	@ head: bytes until dest is word aligned
+	ands    r3, r0, #3
+	beq     1f
+	rsb     r3, r3, #4
+	cmp     r3, r2
+	movhi   r3, r2
+	sub     r2, r2, r3
+0:	ldrb    ip, [r1], #1
+	strb    ip, [r0], #1
+	subs    r3, r3, #1
+	bne     0b
+
+1:	ands    r3, r1, #3
+	bne     .Lmemcpy_shifted
+
+	@ both aligned: 32 byte blocks
+	subs    r2, r2, #32
+	blo     3f
+2:	ldmia   r1!, {r3-r10}
+	stmia   r0!, {r3-r10}
+	subs    r2, r2, #32
+	bhs     2b
+3:	adds    r2, r2, #32
+
+.Lmemcpy_words:
+	subs    r2, r2, #4
+	ldrhs   r3, [r1], #4
+	strhs   r3, [r0], #4
+	bhs     .Lmemcpy_words
+	adds    r2, r2, #4
+
+.Lmemcpy_bytes:
+	subs    r2, r2, #1
+	ldrbhs  r3, [r1], #1
+	strbhs  r3, [r0], #1
+	bhs     .Lmemcpy_bytes
+	pop     {r4-r10, pc}
+
+	@ source k = 1..3 bytes past a word boundary: every output word is the top
+	@ 4 - k bytes of one aligned source word and the low k bytes of the next.
+	@ Only aligned words holding at least one wanted byte are loaded.
+.macro MEMCPY_SHIFTED k
+	subs    r2, r2, #16
+	blo     11f
+10:	ldmia   r1!, {r4-r7}
+	mov     r3, ip, lsr #(8 * \k)
+	orr     r3, r3, r4, lsl #(32 - 8 * \k)
+	mov     r4, r4, lsr #(8 * \k)
+	orr     r4, r4, r5, lsl #(32 - 8 * \k)
+	mov     r5, r5, lsr #(8 * \k)
+	orr     r5, r5, r6, lsl #(32 - 8 * \k)
+	mov     r6, r6, lsr #(8 * \k)
+	orr     r6, r6, r7, lsl #(32 - 8 * \k)
+	mov     ip, r7
+	stmia   r0!, {r3-r6}
+	subs    r2, r2, #16
+	bhs     10b
+11:	adds    r2, r2, #16
+12:	subs    r2, r2, #4
+	blo     13f
+	ldr     r4, [r1], #4
+	mov     r3, ip, lsr #(8 * \k)
+	orr     r3, r3, r4, lsl #(32 - 8 * \k)
+	mov     ip, r4
+	str     r3, [r0], #4
+	b       12b
+13:	adds    r2, r2, #4
+	sub     r1, r1, #(4 - \k) @ back to the first source byte not yet copied
+	b       .Lmemcpy_bytes
+.endm
+
+.Lmemcpy_shifted:
+	cmp     r2, #4
+	blo     .Lmemcpy_bytes
+	bic     r1, r1, #3
+	ldr     ip, [r1], #4
+	cmp     r3, #2
+	beq     .Lmemcpy_shifted2
+	bhi     .Lmemcpy_shifted3
+	MEMCPY_SHIFTED 1
+.Lmemcpy_shifted2:
+	MEMCPY_SHIFTED 2
+.Lmemcpy_shifted3:
+	MEMCPY_SHIFTED 3
+	.size   _memcpy_armv6, .-_memcpy_armv6
+
+@ void _memset_armv6(void *dest, uint32_t c, size_t size)
+@ c is stored as a word pattern; head and tail bytes store its low byte
+	.section .text._memset_armv6, "ax", %progbits
+	.align  2
+	.global _memset_armv6
+	.type   _memset_armv6, %function
+_memset_armv6:
+	cmp     r2, #0
+	bxeq    lr
+	push    {r4-r8, lr}
+
+	ands    r3, r0, #3
+	beq     1f
+	rsb     r3, r3, #4
+	cmp     r3, r2
+	movhi   r3, r2
+	sub     r2, r2, r3
+0:	strb    r1, [r0], #1
+	subs    r3, r3, #1
+	bne     0b
+
+1:	mov     r3, r1
+	mov     r4, r1
+	mov     r5, r1
+	mov     r6, r1
+	mov     r7, r1
+	mov     r8, r1
+	mov     ip, r1
+	subs    r2, r2, #32
+	blo     3f
+2:	stmia   r0!, {r1, r3-r8, ip}
+	subs    r2, r2, #32
+	bhs     2b
+3:	adds    r2, r2, #32
+
+4:	subs    r2, r2, #4
+	strhs   r1, [r0], #4
+	bhs     4b
+	adds    r2, r2, #4
+
+5:	subs    r2, r2, #1
+	strbhs  r1, [r0], #1
+	bhs     5b
+	pop     {r4-r8, pc}
+	.size   _memset_armv6, .-_memset_armv6